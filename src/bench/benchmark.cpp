@@ -0,0 +1,553 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* Benchmark driver for the pair quantity calculators.
+*
+* Every workload structure is evaluated with every calculator using the
+* BASIC and OPTIMIZED evaluators, where supported, and with the BASIC
+* evaluator split over forked worker processes as in the parallel runs
+* of diffpy.srreal.  Each evaluation is preceded by a small displacement
+* of one site, so that the OPTIMIZED evaluator updates only the changed
+* pairs.  Results are written to the standard output as JSON.
+*
+* Usage: benchmark [-t seconds] [-n ncpu] [pattern ...]
+*
+*   -t seconds  minimum duration of every measurement [0.5]
+*   -n ncpu     number of worker processes in the parallel mode
+*               [number of online processors]
+*   pattern     run only workloads whose name contains some pattern
+*
+*****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <functional>
+#include <boost/scoped_ptr.hpp>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <diffpy/version.hpp>
+#include <diffpy/srreal/PDFCalculator.hpp>
+#include <diffpy/srreal/DebyePDFCalculator.hpp>
+#include <diffpy/srreal/BVSCalculator.hpp>
+#include <diffpy/srreal/OverlapCalculator.hpp>
+#include <diffpy/srreal/BondCalculator.hpp>
+#include <diffpy/srreal/ConstantRadiiTable.hpp>
+#include <diffpy/srreal/PeriodicStructureAdapter.hpp>
+#include <diffpy/srreal/BondBlock.hpp>
+#include "test_helpers.hpp"
+
+using namespace std;
+using namespace diffpy::srreal;
+
+namespace {
+
+// Options -------------------------------------------------------------------
+
+double gmintime = 0.5;
+int gncpu = 0;
+vector<string> gpatterns;
+
+// Bond counting -------------------------------------------------------------
+
+/// calculator T that counts the pair contributions it receives
+template <class T>
+class BondCounting : public T
+{
+    public:
+
+        BondCounting() : mcount(0)  { }
+        long long countBonds() const  { return mcount; }
+        void resetBondCount()  { mcount = 0; }
+
+    protected:
+
+        virtual void addPairContribution(
+                const BaseBondGenerator& bnds, int summationscale)
+        {
+            ++mcount;
+            this->T::addPairContribution(bnds, summationscale);
+        }
+
+        virtual void addPairContributions(const BondBlock& blk)
+        {
+            mcount += blk.count;
+            this->T::addPairContributions(blk);
+        }
+
+    private:
+
+        long long mcount;
+};
+
+// Workloads -----------------------------------------------------------------
+
+struct Workload
+{
+    string name;
+    AtomicStructureAdapterPtr structure;
+};
+
+
+struct CalculatorCase
+{
+    string name;
+    /// create a fresh bond counting calculator
+    function<PairQuantity*()> create;
+    /// number of bonds received by calculator created above
+    function<long long(const PairQuantity&)> countbonds;
+    function<void(PairQuantity&)> resetbonds;
+};
+
+
+template <class T>
+CalculatorCase makeCase(const string& name,
+        const function<void(T&)>& setup = function<void(T&)>())
+{
+    typedef BondCounting<T> CT;
+    CalculatorCase rv;
+    rv.name = name;
+    rv.create = [setup]() {
+        CT* pq = new CT;
+        if (setup)  setup(*pq);
+        return pq;
+    };
+    rv.countbonds = [](const PairQuantity& pq) {
+        return static_cast<const CT&>(pq).countBonds();
+    };
+    rv.resetbonds = [](PairQuantity& pq) {
+        static_cast<CT&>(pq).resetBondCount();
+    };
+    return rv;
+}
+
+
+AtomicStructureAdapterPtr cloneAtomic(const AtomicStructureAdapterPtr stru)
+{
+    StructureAdapterPtr rv = stru->clone();
+    return boost::static_pointer_cast<AtomicStructureAdapter>(rv);
+}
+
+
+AtomicStructureAdapterPtr loadPeriodic(const string& filename)
+{
+    StructureAdapterPtr stru = loadTestPeriodicStructure(filename);
+    return boost::static_pointer_cast<AtomicStructureAdapter>(stru);
+}
+
+
+/// spherical cut of fcc lattice with cell parameter a
+AtomicStructureAdapterPtr makeNanoparticle(
+        const string& smbl, double a, double radius)
+{
+    AtomicStructureAdapterPtr rv(new AtomicStructureAdapter);
+    const double basis[4][3] = {
+        {0.0, 0.0, 0.0}, {0.0, 0.5, 0.5}, {0.5, 0.0, 0.5}, {0.5, 0.5, 0.0}};
+    const int n = int(ceil(radius / a));
+    Atom ai;
+    ai.atomtype = smbl;
+    ai.uij_cartn = 0.005 * R3::identity();
+    for (int i = -n; i <= n; ++i)
+    {
+        for (int j = -n; j <= n; ++j)
+        {
+            for (int k = -n; k <= n; ++k)
+            {
+                for (const double* b : basis)
+                {
+                    R3::Vector xyz(i + b[0], j + b[1], k + b[2]);
+                    xyz *= a;
+                    if (R3::norm(xyz) > radius)  continue;
+                    ai.xyz_cartn = xyz;
+                    rv->append(ai);
+                }
+            }
+        }
+    }
+    return rv;
+}
+
+
+/// periodic structure with cell expanded n times along every axis
+AtomicStructureAdapterPtr makeSupercell(
+        const AtomicStructureAdapterPtr stru, int n)
+{
+    const PeriodicStructureAdapter& pstru =
+        static_cast<const PeriodicStructureAdapter&>(*stru);
+    const Lattice& L = pstru.getLattice();
+    PeriodicStructureAdapterPtr rv(new PeriodicStructureAdapter);
+    rv->setLatPar(n * L.a(), n * L.b(), n * L.c(),
+            L.alpha(), L.beta(), L.gamma());
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            for (int k = 0; k < n; ++k)
+            {
+                const R3::Vector cell = L.cartesian(R3::Vector(i, j, k));
+                for (const Atom& a : pstru)
+                {
+                    Atom ai = a;
+                    ai.xyz_cartn += cell;
+                    rv->append(ai);
+                }
+            }
+        }
+    }
+    return rv;
+}
+
+
+vector<Workload> canonicalWorkloads()
+{
+    vector<Workload> rv;
+    const char* stru_files[] = {
+        "Ni.stru", "CaTiO3.stru",
+        "alpha_K2Bi8Se13.stru", "PbScW25TiO3.stru"};
+    for (const char* f : stru_files)
+    {
+        Workload w;
+        w.name = string(f).substr(0, strlen(f) - 5);
+        w.structure = loadPeriodic(f);
+        rv.push_back(w);
+    }
+    Workload w;
+    w.name = "Ni_nanoparticle_r12";
+    w.structure = makeNanoparticle("Ni", 3.52387, 12.0);
+    rv.push_back(w);
+    w.name = "Ni_nanoparticle_r20";
+    w.structure = makeNanoparticle("Ni", 3.52387, 20.0);
+    rv.push_back(w);
+    w.name = "Ni_supercell_4x4x4";
+    w.structure = makeSupercell(loadPeriodic("Ni.stru"), 4);
+    rv.push_back(w);
+    w.name = "CaTiO3_supercell_2x2x2";
+    w.structure = makeSupercell(loadPeriodic("CaTiO3.stru"), 2);
+    rv.push_back(w);
+    return rv;
+}
+
+
+vector<CalculatorCase> canonicalCalculators()
+{
+    vector<CalculatorCase> rv;
+    rv.push_back(makeCase<PDFCalculator>("PDFCalculator"));
+    rv.push_back(makeCase<DebyePDFCalculator>("DebyePDFCalculator",
+                [](DebyePDFCalculator& pq) { pq.setRmax(10.0); }));
+    rv.push_back(makeCase<BVSCalculator>("BVSCalculator"));
+    rv.push_back(makeCase<OverlapCalculator>("OverlapCalculator",
+                [](OverlapCalculator& pq) {
+                    ConstantRadiiTable rtb;
+                    rtb.setDefault(1.3);
+                    pq.setAtomRadiiTable(rtb.clone());
+                }));
+    rv.push_back(makeCase<BondCalculator>("BondCalculator",
+                [](BondCalculator& pq) { pq.setRmax(5.0); }));
+    return rv;
+}
+
+
+bool isSelected(const string& name)
+{
+    if (gpatterns.empty())  return true;
+    for (const string& p : gpatterns)
+    {
+        if (name.find(p) != string::npos)  return true;
+    }
+    return false;
+}
+
+// Measurement ---------------------------------------------------------------
+
+double wallTime()
+{
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+
+long peakRSS(int who)
+{
+    rusage ru;
+    getrusage(who, &ru);
+    long rv = ru.ru_maxrss;
+#ifdef __APPLE__
+    rv /= 1024;
+#endif
+    return rv;
+}
+
+
+bool supportsOptimized(const CalculatorCase& cc)
+{
+    boost::scoped_ptr<PairQuantity> pq(cc.create());
+    try
+    {
+        pq->setEvaluatorType(OPTIMIZED);
+    }
+    catch (invalid_argument&)
+    {
+        return false;
+    }
+    return true;
+}
+
+
+/// displace one site back and forth to make a small structure change
+void moveSite(AtomicStructureAdapter& stru, long iteration)
+{
+    const int cntsites = stru.countSites();
+    if (!cntsites)  return;
+    Atom& a = stru[iteration % cntsites];
+    a.xyz_cartn[0] += (iteration / cntsites % 2) ? -0.01 : 0.01;
+}
+
+
+struct Result
+{
+    string structure;
+    int sites;
+    string calculator;
+    string evaluator;
+    int ncpu;
+    long evals;
+    double seconds;
+    double bonds;
+    long peakrss;
+};
+
+
+/// evaluate in this process until at least mintime passes
+Result runSerial(const Workload& w, const CalculatorCase& cc,
+        PQEvaluatorType evtp)
+{
+    AtomicStructureAdapterPtr stru = cloneAtomic(w.structure);
+    boost::scoped_ptr<PairQuantity> pq(cc.create());
+    pq->setEvaluatorType(evtp);
+    pq->eval(stru);
+    cc.resetbonds(*pq);
+    long cnt = 0;
+    const double t0 = wallTime();
+    double t1 = t0;
+    while (cnt == 0 || t1 - t0 < gmintime)
+    {
+        moveSite(*stru, cnt);
+        pq->eval(stru);
+        ++cnt;
+        t1 = wallTime();
+    }
+    Result rv;
+    rv.evaluator = evtp == OPTIMIZED ? "OPTIMIZED" : "BASIC";
+    rv.ncpu = 1;
+    rv.evals = cnt;
+    rv.seconds = t1 - t0;
+    rv.bonds = double(cc.countbonds(*pq)) / cnt;
+    rv.peakrss = peakRSS(RUSAGE_SELF);
+    return rv;
+}
+
+
+void writeAll(int fd, const char* data, size_t n)
+{
+    while (n)
+    {
+        ssize_t k = write(fd, data, n);
+        if (k <= 0)  _exit(1);
+        data += k;
+        n -= k;
+    }
+}
+
+
+string readAll(int fd)
+{
+    string rv;
+    char buffer[65536];
+    ssize_t k;
+    while ((k = read(fd, buffer, sizeof(buffer))) > 0)  rv.append(buffer, k);
+    return rv;
+}
+
+
+/// evaluate cnt times in ncpu forked workers and merge their results
+Result runParallel(const Workload& w, const CalculatorCase& cc, long cnt)
+{
+    cout.flush();
+    vector<int> fds;
+    vector<pid_t> pids;
+    const double t0 = wallTime();
+    for (int cpuindex = 0; cpuindex < gncpu; ++cpuindex)
+    {
+        int pfd[2];
+        if (pipe(pfd) != 0)
+        {
+            const char* emsg = "Cannot create pipe for worker process.";
+            throw runtime_error(emsg);
+        }
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(pfd[0]);
+            AtomicStructureAdapterPtr stru = cloneAtomic(w.structure);
+            boost::scoped_ptr<PairQuantity> pq(cc.create());
+            pq->setEvaluatorType(BASIC);
+            pq->setupParallelRun(cpuindex, gncpu);
+            for (long i = 0; i < cnt; ++i)
+            {
+                moveSite(*stru, i);
+                pq->eval(stru);
+            }
+            const string pdata = pq->getParallelData();
+            writeAll(pfd[1], pdata.data(), pdata.size());
+            close(pfd[1]);
+            _exit(0);
+        }
+        close(pfd[1]);
+        fds.push_back(pfd[0]);
+        pids.push_back(pid);
+    }
+    AtomicStructureAdapterPtr stru = cloneAtomic(w.structure);
+    for (long i = 0; i < cnt; ++i)  moveSite(*stru, i);
+    boost::scoped_ptr<PairQuantity> pq(cc.create());
+    pq->setStructure(stru);
+    for (int fd : fds)
+    {
+        pq->mergeParallelData(readAll(fd), gncpu);
+        close(fd);
+    }
+    for (pid_t pid : pids)  waitpid(pid, NULL, 0);
+    Result rv;
+    rv.evaluator = "BASIC";
+    rv.ncpu = gncpu;
+    rv.evals = cnt;
+    rv.seconds = wallTime() - t0;
+    rv.bonds = 0.0;
+    rv.peakrss = peakRSS(RUSAGE_CHILDREN);
+    return rv;
+}
+
+// Output --------------------------------------------------------------------
+
+string jsonString(const string& s)
+{
+    ostringstream out;
+    out << '"';
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')  out << '\\';
+        out << c;
+    }
+    out << '"';
+    return out.str();
+}
+
+
+void writeResult(ostream& out, const Result& r, bool last)
+{
+    const double evalsps = r.evals / r.seconds;
+    const double nsperbond = r.bonds > 0 ?
+        1e9 * r.seconds / (r.evals * r.bonds) : 0.0;
+    out << "    {" <<
+        "\"structure\": " << jsonString(r.structure) << ", " <<
+        "\"sites\": " << r.sites << ", " <<
+        "\"calculator\": " << jsonString(r.calculator) << ", " <<
+        "\"evaluator\": " << jsonString(r.evaluator) << ", " <<
+        "\"ncpu\": " << r.ncpu << ", " <<
+        "\"evals\": " << r.evals << ", " <<
+        "\"seconds\": " << r.seconds << ", " <<
+        "\"evals_per_sec\": " << evalsps << ", " <<
+        "\"bonds_per_eval\": " << r.bonds << ", " <<
+        "\"ns_per_bond\": " << nsperbond << ", " <<
+        "\"peak_rss_kb\": " << r.peakrss << "}" <<
+        (last ? "\n" : ",\n");
+}
+
+
+void parseOptions(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const string opt = argv[i];
+        if ((opt == "-t" || opt == "-n") && i + 1 < argc)
+        {
+            if (opt == "-t")  gmintime = atof(argv[++i]);
+            else  gncpu = atoi(argv[++i]);
+            continue;
+        }
+        if (opt == "-h" || opt == "--help" || opt[0] == '-')
+        {
+            cerr << "usage: benchmark [-t seconds] [-n ncpu] [pattern ...]\n";
+            exit(opt[0] == '-' && opt != "-h" && opt != "--help");
+        }
+        gpatterns.push_back(opt);
+    }
+    if (gncpu < 1)  gncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (gncpu < 1)  gncpu = 1;
+}
+
+}   // namespace
+
+// Main ----------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    parseOptions(argc, argv);
+    vector<Result> results;
+    for (const Workload& w : canonicalWorkloads())
+    {
+        for (const CalculatorCase& cc : canonicalCalculators())
+        {
+            if (!isSelected(w.name + ' ' + cc.name))  continue;
+            vector<Result> rs(1, runSerial(w, cc, BASIC));
+            if (supportsOptimized(cc))
+            {
+                rs.push_back(runSerial(w, cc, OPTIMIZED));
+            }
+            rs.push_back(runParallel(w, cc, rs[0].evals));
+            // bonds per evaluation are the same as in the BASIC run
+            rs.back().bonds = rs[0].bonds;
+            for (Result* r = &rs[0]; r != &rs[0] + rs.size(); ++r)
+            {
+                r->structure = w.name;
+                r->sites = w.structure->countSites();
+                r->calculator = cc.name;
+                results.push_back(*r);
+            }
+        }
+    }
+    cout << "{\n" <<
+        "  \"library\": \"libdiffpy\",\n" <<
+        "  \"version\": " <<
+        jsonString(libdiffpy_version_info::version_str) << ",\n" <<
+        "  \"git_sha\": " <<
+        jsonString(libdiffpy_version_info::git_sha) << ",\n" <<
+        "  \"mintime\": " << gmintime << ",\n" <<
+        "  \"peak_rss_kb\": " << peakRSS(RUSAGE_SELF) << ",\n" <<
+        "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        writeResult(cout, results[i], i + 1 == results.size());
+    }
+    cout << "  ]\n}\n";
+    return 0;
+}
+
+// End of file
@@ -24,6 +24,7 @@
 
 #include <diffpy/serialization.ipp>
 #include <diffpy/srreal/AtomRadiiTable.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
 #include <diffpy/HasClassRegistry.ipp>
 
 namespace diffpy {
@@ -35,6 +36,11 @@ namespace srreal {
 
 using namespace std;
 
+// Constructor ---------------------------------------------------------------
+
+AtomRadiiTable::AtomRadiiTable() : mcustombyidvalid(false)
+{ }
+
 // Public Methods ------------------------------------------------------------
 
 double AtomRadiiTable::lookup(const string& smbl) const
@@ -46,9 +52,21 @@ double AtomRadiiTable::lookup(const string& smbl) const
 }
 
 
+double AtomRadiiTable::lookup(int tid) const
+{
+    if (!mcustombyidvalid)  this->updateCustomById();
+    if (tid < int(mcustombyid.size()) && mcustombyid[tid].first)
+    {
+        return mcustombyid[tid].second;
+    }
+    return this->standardLookup(atomTypeName(tid));
+}
+
+
 void AtomRadiiTable::setCustom(const string& smbl, double radius)
 {
     mcustomradius[smbl] = radius;
+    mcustombyidvalid = false;
 }
 
 
@@ -85,18 +103,21 @@ void AtomRadiiTable::fromString(const string& s)
     // everything worked up to here, we can do the assignment
     CustomRadiiStorage::const_iterator kv = rds.begin();
     for (; kv != rds.end(); ++kv)  mcustomradius[kv->first] = kv->second;
+    mcustombyidvalid = false;
 }
 
 
 void AtomRadiiTable::resetCustom(const string& smbl)
 {
     mcustomradius.erase(smbl);
+    mcustombyidvalid = false;
 }
 
 
 void AtomRadiiTable::resetAll()
 {
     mcustomradius.clear();
+    mcustombyidvalid = false;
 }
 
 
@@ -126,6 +147,24 @@ string AtomRadiiTable::toString(string separator) const
     return rv.str();
 }
 
+// Private Methods -----------------------------------------------------------
+
+void AtomRadiiTable::updateCustomById() const
+{
+    mcustombyid.clear();
+    CustomRadiiStorage::const_iterator tb;
+    for (tb = mcustomradius.begin(); tb != mcustomradius.end(); ++tb)
+    {
+        const int tid = atomTypeId(tb->first);
+        if (tid >= int(mcustombyid.size()))
+        {
+            mcustombyid.resize(tid + 1, make_pair(false, 0.0));
+        }
+        mcustombyid[tid] = make_pair(true, tb->second);
+    }
+    mcustombyidvalid = true;
+}
+
 }   // srreal
 }   // diffpy
 
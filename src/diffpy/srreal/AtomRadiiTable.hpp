@@ -24,6 +24,7 @@
 #define ATOMRADIITABLE_HPP_INCLUDED
 
 #include <string>
+#include <vector>
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/assume_abstract.hpp>
 #include <boost/serialization/export.hpp>
@@ -43,9 +44,14 @@ class AtomRadiiTable :
         // types
         typedef std::unordered_map<std::string,double> CustomRadiiStorage;
 
+        // constructor
+        AtomRadiiTable();
+
         // methods
         /// fast value lookup, which does not change the table.
         double lookup(const std::string& smbl) const;
+        /// lookup by interned atom type id from atomTypeId
+        double lookup(int tid) const;
         /// overloadable lookup function that retrieved standard values
         virtual double standardLookup(const std::string& smbl) const = 0;
         /// set custom radius for a specified atom symbol
@@ -63,8 +69,14 @@ class AtomRadiiTable :
 
     private:
 
+        // methods
+        void updateCustomById() const;
+
         // data
         CustomRadiiStorage mcustomradius;
+        /// flag and value of custom radii indexed by atom type id
+        mutable std::vector< std::pair<bool, double> > mcustombyid;
+        mutable bool mcustombyidvalid;
 
         // serialization
         friend class boost::serialization::access;
@@ -72,6 +84,7 @@ class AtomRadiiTable :
             void serialize(Archive& ar, const unsigned int version)
         {
             ar & mcustomradius;
+            mcustombyidvalid = false;
         }
 
 };
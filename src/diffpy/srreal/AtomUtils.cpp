@@ -16,11 +16,37 @@
 *
 *****************************************************************************/
 
+#include <cassert>
+#include <deque>
+#include <unordered_map>
+
 #include <diffpy/srreal/AtomUtils.hpp>
 
 namespace diffpy {
 namespace srreal {
 
+// Local Helpers -------------------------------------------------------------
+
+namespace {
+
+// deque keeps references to the names valid when it grows
+struct AtomTypeInterningTable
+{
+    std::deque<std::string> names;
+    std::unordered_map<std::string, int> ids;
+};
+
+
+AtomTypeInterningTable& getAtomTypeInterningTable()
+{
+    static AtomTypeInterningTable the_table;
+    return the_table;
+}
+
+}   // namespace
+
+// Implementation ------------------------------------------------------------
+
 std::string atomBareSymbol(const std::string& atomtype)
 {
     std::string::size_type pb, pe;
@@ -66,6 +92,30 @@ int atomValence(const std::string& atomtype)
     return rv;
 }
 
+
+int atomTypeId(const std::string& atomtype)
+{
+    AtomTypeInterningTable& tb = getAtomTypeInterningTable();
+    std::pair<std::unordered_map<std::string, int>::iterator, bool> tid;
+    tid = tb.ids.emplace(atomtype, int(tb.names.size()));
+    if (tid.second)  tb.names.push_back(atomtype);
+    return tid.first->second;
+}
+
+
+const std::string& atomTypeName(int tid)
+{
+    const AtomTypeInterningTable& tb = getAtomTypeInterningTable();
+    assert(0 <= tid && tid < int(tb.names.size()));
+    return tb.names[tid];
+}
+
+
+int countAtomTypeIds()
+{
+    return getAtomTypeInterningTable().names.size();
+}
+
 }   // namespace srreal
 }   // namespace diffpy
 
@@ -31,6 +31,17 @@ std::string atomBareSymbol(const std::string& atomtype);
 /// Return valence of possibly ionic symbol such as "S2-" or "Cl-".
 int atomValence(const std::string& atomtype);
 
+/// Return integer id of the atom type, which is interned in a global
+/// table on the first use.  Ids are consecutive from 0 and stay valid
+/// for the lifetime of the process.  The table is not thread safe.
+int atomTypeId(const std::string& atomtype);
+
+/// Return atom type string for the id from atomTypeId.
+const std::string& atomTypeName(int tid);
+
+/// Return the number of interned atom types.
+int countAtomTypeIds();
+
 }   // namespace srreal
 }   // namespace diffpy
 
@@ -19,9 +19,12 @@
 
 #include <cassert>
 #include <algorithm>
+#include <numeric>
 #include <boost/functional/hash.hpp>
+#include <boost/make_shared.hpp>
 
 #include <diffpy/serialization.ipp>
+#include <diffpy/validators.hpp>
 #include <diffpy/srreal/AtomicStructureAdapter.hpp>
 #include <diffpy/srreal/StructureDifference.hpp>
 
@@ -96,6 +99,78 @@ size_t hash_value(const Atom& a)
 // class AtomicStructureAdapter
 //////////////////////////////////////////////////////////////////////////////
 
+// Static Data Members -------------------------------------------------------
+
+unsigned long AtomicStructureAdapter::gversion = 0;
+
+// Constructors --------------------------------------------------------------
+
+AtomicStructureAdapter::AtomicStructureAdapter() :
+    matoms(new AtomVector),
+    mversion(++gversion),
+    mexposed(false),
+    mbondcacheskin(0.0)
+{ }
+
+
+AtomicStructureAdapter::AtomicStructureAdapter(
+        const AtomicStructureAdapter& src) :
+    StructureAdapter(src),
+    matoms(src.matoms),
+    mversion(src.mversion),
+    mexposed(false),
+    mjournal(src.mjournal),
+    mbondcacheskin(src.mbondcacheskin),
+    mneighborlist(src.mneighborlist),
+    mtypeids(src.mtypeids)
+{
+    // exposed atoms may change through references held by the caller.
+    // Take a private copy, which cannot be equal by version to the source.
+    if (src.mexposed)
+    {
+        matoms.reset(new AtomVector(*src.matoms));
+        mversion = ++gversion;
+        mjournal.reset(mversion, this->countSites());
+    }
+    // further changes of the source are relative to the shared version
+    src.mjournal.reset(src.mversion, src.countSites());
+}
+
+
+AtomicStructureAdapter&
+AtomicStructureAdapter::operator=(const AtomicStructureAdapter& src)
+{
+    if (this == &src)  return *this;
+    this->StructureAdapter::operator=(src);
+    // keep references to our exposed atoms valid, copy the new atoms
+    // in place and compare them on the next diff.
+    if (mexposed)
+    {
+        assert(matoms.unique());
+        *matoms = *src.matoms;
+        mversion = ++gversion;
+        mjournal.invalidate();
+    }
+    else if (src.mexposed)
+    {
+        matoms.reset(new AtomVector(*src.matoms));
+        mversion = ++gversion;
+        mjournal.reset(mversion, this->countSites());
+        mtypeids.reset();
+    }
+    else
+    {
+        matoms = src.matoms;
+        mversion = src.mversion;
+        mjournal = src.mjournal;
+        mtypeids = src.mtypeids;
+    }
+    src.mjournal.reset(src.mversion, src.countSites());
+    mbondcacheskin = src.mbondcacheskin;
+    mneighborlist = src.mneighborlist;
+    return *this;
+}
+
 // Public Methods ------------------------------------------------------------
 
 StructureAdapterPtr AtomicStructureAdapter::clone() const
@@ -107,49 +182,77 @@ StructureAdapterPtr AtomicStructureAdapter::clone() const
 
 BaseBondGeneratorPtr AtomicStructureAdapter::createBondGenerator() const
 {
-    BaseBondGeneratorPtr bnds(new BaseBondGenerator(shared_from_this()));
+    BaseBondGeneratorPtr bnds;
+    if (this->getBondCacheSkin() > 0)
+    {
+        bnds.reset(new AtomicBondCacheGenerator(shared_from_this()));
+    }
+    else
+    {
+        bnds.reset(new BaseBondGenerator(shared_from_this()));
+    }
     return bnds;
 }
 
 
 int AtomicStructureAdapter::countSites() const
 {
-    return matoms.size();
+    return matoms->size();
 }
 
 
 const string& AtomicStructureAdapter::siteAtomType(int idx) const
 {
     assert(0 <= idx && idx < this->countSites());
-    return matoms[idx].atomtype;
+    return (*matoms)[idx].atomtype;
+}
+
+
+int AtomicStructureAdapter::siteAtomTypeId(int idx) const
+{
+    assert(0 <= idx && idx < this->countSites());
+    // exposed atoms may change their types through held references
+    if (mexposed)  return atomTypeId((*matoms)[idx].atomtype);
+    if (!mtypeids)
+    {
+        const int cntsites = this->countSites();
+        boost::shared_ptr<SiteIndices> tids =
+            boost::make_shared<SiteIndices>(cntsites);
+        for (int i = 0; i < cntsites; ++i)
+        {
+            (*tids)[i] = atomTypeId((*matoms)[i].atomtype);
+        }
+        mtypeids = tids;
+    }
+    return (*mtypeids)[idx];
 }
 
 
 const R3::Vector& AtomicStructureAdapter::siteCartesianPosition(int idx) const
 {
     assert(0 <= idx && idx < this->countSites());
-    return matoms[idx].xyz_cartn;
+    return (*matoms)[idx].xyz_cartn;
 }
 
 
 double AtomicStructureAdapter::siteOccupancy(int idx) const
 {
     assert(0 <= idx && idx < this->countSites());
-    return matoms[idx].occupancy;
+    return (*matoms)[idx].occupancy;
 }
 
 
 bool AtomicStructureAdapter::siteAnisotropy(int idx) const
 {
     assert(0 <= idx && idx < this->countSites());
-    return matoms[idx].anisotropy;
+    return (*matoms)[idx].anisotropy;
 }
 
 
 const R3::Matrix& AtomicStructureAdapter::siteCartesianUij(int idx) const
 {
     assert(0 <= idx && idx < this->countSites());
-    return matoms[idx].uij_cartn;
+    return (*matoms)[idx].uij_cartn;
 }
 
 // helper for diff
@@ -168,19 +271,33 @@ StructureDifference
 AtomicStructureAdapter::diff(StructureAdapterConstPtr other) const
 {
     using std::min;
-    StructureDifference sd = this->StructureAdapter::diff(other);
-    if (sd.stru0 == sd.stru1)  return sd;
     typedef boost::shared_ptr<const class AtomicStructureAdapter> APtr;
     APtr pother = boost::dynamic_pointer_cast<APtr::element_type>(other);
-    if (!pother)  return sd;
-    // try fast side-by-side comparison
+    if (!pother || pother.get() == this)
+    {
+        return this->StructureAdapter::diff(other);
+    }
+    // start with empty difference without filling the default site indices
+    StructureDifference sd;
+    sd.stru0 = this->shared_from_this();
+    sd.stru1 = other;
     sd.diffmethod = StructureDifference::Method::SIDEBYSIDE;
+    // equal versions mean there were no changes in the atoms
+    if (mversion == pother->mversion)  return sd;
+    // try fast side-by-side comparison
     const AtomicStructureAdapter& astru0 = *this;
     const AtomicStructureAdapter& astru1 = *pother;
-    sd.pop0.clear();
-    sd.add1.clear();
-    const_iterator ai0 = astru0.matoms.begin();
-    const_iterator ai1 = astru1.matoms.begin();
+    // use the journal of changes when it starts at this version
+    if (astru1.mjournal.isValidFrom(astru0.mversion))
+    {
+        astru1.mjournal.getDifference(sd);
+        if (sd.allowsfastupdate())  return sd;
+        sd.diffmethod = StructureDifference::Method::SIDEBYSIDE;
+        sd.pop0.clear();
+        sd.add1.clear();
+    }
+    const_iterator ai0 = astru0.matoms->begin();
+    const_iterator ai1 = astru1.matoms->begin();
     int nboth = min(astru0.countSites(), astru1.countSites());
     for (int i = 0; i < nboth; ++i, ++ai0, ++ai1)
     {
@@ -190,11 +307,11 @@ AtomicStructureAdapter::diff(StructureAdapterConstPtr other) const
             sd.add1.push_back(i);
         }
     }
-    for (int i = nboth; ai0 != astru0.matoms.end(); ++i, ++ai0)
+    for (int i = nboth; ai0 != astru0.matoms->end(); ++i, ++ai0)
     {
         sd.pop0.push_back(i);
     }
-    for (int i = nboth; ai1 != astru1.matoms.end(); ++i, ++ai1)
+    for (int i = nboth; ai1 != astru1.matoms->end(); ++i, ++ai1)
     {
         sd.add1.push_back(i);
     }
@@ -207,16 +324,16 @@ AtomicStructureAdapter::diff(StructureAdapterConstPtr other) const
     sd.diffmethod = StructureDifference::Method::SORTED;
     std::vector<atomindex> satoms0, satoms1;
     satoms0.reserve(astru0.countSites());
-    const_iterator ai = astru0.matoms.begin();
-    for (int i = 0; ai != astru0.matoms.end(); ++ai, ++i)
+    const_iterator ai = astru0.matoms->begin();
+    for (int i = 0; ai != astru0.matoms->end(); ++ai, ++i)
     {
         satoms0.push_back(atomindex(&(*ai), i));
     }
     // use negative index for stru1 atoms so we can tell them apart
     // in the output of set_symmetric_difference
     satoms1.reserve(astru1.countSites());
-    ai = astru1.matoms.begin();
-    for (int i = -1; ai != astru1.matoms.end(); ++ai, --i)
+    ai = astru1.matoms->begin();
+    for (int i = -1; ai != astru1.matoms->end(); ++ai, --i)
     {
         satoms1.push_back(atomindex(&(*ai), i));
     }
@@ -245,58 +362,413 @@ typedef AtomicStructureAdapter::iterator iterator;
 iterator AtomicStructureAdapter::insert(int idx, const Atom& atom)
 {
     assert(0 <= idx && idx <= this->countSites());
-    return this->insert(matoms.begin() + idx, atom);
+    AtomVector& atoms = this->detachAtoms();
+    mjournal.inserted(idx);
+    mexposed = true;
+    mtypeids.reset();
+    return atoms.insert(atoms.begin() + idx, atom);
 }
 
 
 iterator AtomicStructureAdapter::insert(iterator ii, const Atom& atom)
 {
-    return matoms.insert(ii, atom);
+    difference_type offset = ii - matoms->begin();
+    return this->insert(int(offset), atom);
 }
 
 
 void AtomicStructureAdapter::append(const Atom& atom)
 {
-    matoms.push_back(atom);
+    AtomVector& atoms = this->detachAtoms();
+    mjournal.inserted(atoms.size());
+    atoms.push_back(atom);
+    SiteIndices* tids = this->detachTypeIds();
+    if (tids)  tids->push_back(atomTypeId(atom.atomtype));
 }
 
 
 void AtomicStructureAdapter::clear()
 {
-    matoms.clear();
+    this->detachAtoms().clear();
+    mjournal.cleared();
+    // there are no atoms left to be referenced
+    mexposed = false;
+    mtypeids.reset();
 }
 
 
 iterator AtomicStructureAdapter::erase(int idx)
 {
     assert(0 <= idx && idx < this->countSites());
-    return matoms.erase(matoms.begin() + idx);
+    AtomVector& atoms = this->detachAtoms();
+    mjournal.erased(idx);
+    mexposed = true;
+    mtypeids.reset();
+    return atoms.erase(atoms.begin() + idx);
 }
 
 
 iterator AtomicStructureAdapter::erase(iterator pos)
 {
-    return matoms.erase(pos);
+    difference_type offset = pos - matoms->begin();
+    return this->erase(int(offset));
 }
 
 
 iterator AtomicStructureAdapter::erase(iterator first, iterator last)
 {
-    return matoms.erase(first, last);
+    difference_type offset0 = first - matoms->begin();
+    difference_type offset1 = last - matoms->begin();
+    AtomVector& atoms = this->detachAtoms();
+    for (int i = offset1 - 1; i >= offset0; --i)  mjournal.erased(i);
+    mexposed = true;
+    mtypeids.reset();
+    return atoms.erase(atoms.begin() + offset0, atoms.begin() + offset1);
 }
 
 
 Atom& AtomicStructureAdapter::operator[](int idx)
 {
     assert(0 <= idx && idx < this->countSites());
-    return matoms[idx];
+    AtomVector& atoms = this->detachAtoms();
+    mjournal.modified(idx);
+    mexposed = true;
+    mtypeids.reset();
+    return atoms[idx];
 }
 
 
 const Atom& AtomicStructureAdapter::operator[](int idx) const
 {
     assert(0 <= idx && idx < this->countSites());
-    return matoms[idx];
+    return (*matoms)[idx];
+}
+
+
+void AtomicStructureAdapter::setAtom(int idx, const Atom& atom)
+{
+    assert(0 <= idx && idx < this->countSites());
+    AtomVector& atoms = this->detachAtoms();
+    mjournal.modified(idx);
+    SiteIndices* tids = this->detachTypeIds();
+    if (tids && atoms[idx].atomtype != atom.atomtype)
+    {
+        (*tids)[idx] = atomTypeId(atom.atomtype);
+    }
+    atoms[idx] = atom;
+}
+
+
+void AtomicStructureAdapter::setAtomPosition(int idx, const R3::Vector& xyz)
+{
+    assert(0 <= idx && idx < this->countSites());
+    AtomVector& atoms = this->detachAtoms();
+    mjournal.modified(idx);
+    atoms[idx].xyz_cartn = xyz;
+}
+
+
+bool AtomicStructureAdapter::hasChangeJournal() const
+{
+    return mjournal.isValid();
+}
+
+
+void AtomicStructureAdapter::setBondCacheSkin(double skin)
+{
+    using diffpy::validators::ensureNonNegative;
+    ensureNonNegative("skin", skin);
+    if (skin != mbondcacheskin)  mneighborlist.reset();
+    mbondcacheskin = skin;
+}
+
+
+const double& AtomicStructureAdapter::getBondCacheSkin() const
+{
+    return mbondcacheskin;
+}
+
+
+boost::shared_ptr<const AtomicBondCache>
+AtomicStructureAdapter::getNeighborList(double rmax) const
+{
+    if (mneighborlist && mneighborlist->covers(*this, rmax))
+    {
+        return mneighborlist;
+    }
+    // build a new instance, the old list may be still used by the clones
+    mneighborlist = boost::make_shared<AtomicBondCache>(
+            *this, rmax + this->getBondCacheSkin());
+    return mneighborlist;
+}
+
+// Private Methods -----------------------------------------------------------
+
+AtomicStructureAdapter::AtomVector& AtomicStructureAdapter::detachAtoms()
+{
+    if (!matoms.unique())  matoms.reset(new AtomVector(*matoms));
+    mversion = ++gversion;
+    return *matoms;
+}
+
+
+AtomicStructureAdapter::AtomVector& AtomicStructureAdapter::mutableAtoms()
+{
+    mjournal.invalidate();
+    mtypeids.reset();
+    return this->detachAtoms();
+}
+
+
+AtomicStructureAdapter::AtomVector& AtomicStructureAdapter::exposeAtoms()
+{
+    AtomVector& atoms = this->mutableAtoms();
+    mexposed = true;
+    return atoms;
+}
+
+
+SiteIndices* AtomicStructureAdapter::detachTypeIds()
+{
+    if (!mtypeids)  return NULL;
+    if (!mtypeids.unique())
+    {
+        mtypeids = boost::make_shared<SiteIndices>(*mtypeids);
+    }
+    return mtypeids.get();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// class AtomicBondCache
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+AtomicBondCache::AtomicBondCache(
+        const AtomicStructureAdapter& stru, double rcut) :
+    mrcut(rcut)
+{
+    const int cntsites = stru.countSites();
+    mpositions.resize(cntsites);
+    for (int i = 0; i < cntsites; ++i)  mpositions[i] = stru[i].xyz_cartn;
+    moffsets.reserve(cntsites + 1);
+    moffsets.push_back(0);
+    if (!cntsites)  return;
+    // bounding box of the sites
+    R3::Vector xyzlo = mpositions[0];
+    R3::Vector xyzhi = mpositions[0];
+    for (int i = 1; i < cntsites; ++i)
+    {
+        for (int k = 0; k < R3::Ndim; ++k)
+        {
+            xyzlo[k] = std::min(xyzlo[k], mpositions[i][k]);
+            xyzhi[k] = std::max(xyzhi[k], mpositions[i][k]);
+        }
+    }
+    // use cells not thinner than rcut, but no more than 2 per site
+    const double maxcells = std::max(1, 2 * cntsites);
+    // small margin for round-off errors at the cell boundaries
+    const double eps = 1e-6;
+    int ncells[R3::Ndim];
+    for (int k = 0; k < R3::Ndim; ++k)
+    {
+        double n = (xyzhi[k] - xyzlo[k]) / (rcut + eps);
+        ncells[k] = int(std::max(1.0, std::min(n, maxcells)));
+    }
+    while (double(ncells[0]) * ncells[1] * ncells[2] > maxcells)
+    {
+        int* nmax = std::max_element(ncells, ncells + R3::Ndim);
+        *nmax = std::max(1, *nmax / 2);
+    }
+    // sort sites by their cells
+    SiteIndices sitecells(R3::Ndim * cntsites);
+    SiteIndices flatcell(cntsites);
+    SiteIndices celloffsets(ncells[0] * ncells[1] * ncells[2] + 1, 0);
+    for (int i = 0; i < cntsites; ++i)
+    {
+        int* ci = &(sitecells[R3::Ndim * i]);
+        for (int k = 0; k < R3::Ndim; ++k)
+        {
+            const double w = xyzhi[k] - xyzlo[k];
+            ci[k] = (w > 0.0) ?
+                int((mpositions[i][k] - xyzlo[k]) / w * ncells[k]) : 0;
+            ci[k] = std::max(0, std::min(ncells[k] - 1, ci[k]));
+        }
+        flatcell[i] = (ci[0] * ncells[1] + ci[1]) * ncells[2] + ci[2];
+        ++celloffsets[flatcell[i] + 1];
+    }
+    std::partial_sum(celloffsets.begin(), celloffsets.end(),
+            celloffsets.begin());
+    SiteIndices cellfill(celloffsets.begin(), celloffsets.end() - 1);
+    SiteIndices cellsites(cntsites);
+    for (int i = 0; i < cntsites; ++i)
+    {
+        cellsites[cellfill[flatcell[i]]++] = i;
+    }
+    // neighbors are in the same or adjacent cells,
+    // keep coincident sites, they may split apart later
+    R3::Vector r01;
+    for (int i = 0; i < cntsites; ++i)
+    {
+        const int* ci = &(sitecells[R3::Ndim * i]);
+        int cfirst[R3::Ndim], clast[R3::Ndim];
+        for (int k = 0; k < R3::Ndim; ++k)
+        {
+            cfirst[k] = std::max(0, ci[k] - 1);
+            clast[k] = std::min(ncells[k] - 1, ci[k] + 1);
+        }
+        for (int cx = cfirst[0]; cx <= clast[0]; ++cx)
+        {
+            for (int cy = cfirst[1]; cy <= clast[1]; ++cy)
+            {
+                for (int cz = cfirst[2]; cz <= clast[2]; ++cz)
+                {
+                    const int c = (cx * ncells[1] + cy) * ncells[2] + cz;
+                    for (int n = celloffsets[c]; n < celloffsets[c + 1]; ++n)
+                    {
+                        const int j = cellsites[n];
+                        if (j == i)  continue;
+                        r01 = mpositions[j] - mpositions[i];
+                        if (fabs(r01[0]) > rcut || fabs(r01[1]) > rcut ||
+                                fabs(r01[2]) > rcut || R3::norm(r01) > rcut)
+                        {
+                            continue;
+                        }
+                        mneighbors.push_back(j);
+                    }
+                }
+            }
+        }
+        std::sort(mneighbors.begin() + moffsets.back(), mneighbors.end());
+        moffsets.push_back(mneighbors.size());
+    }
+}
+
+// Public Methods ------------------------------------------------------------
+
+const double& AtomicBondCache::getRcut() const
+{
+    return mrcut;
+}
+
+
+bool AtomicBondCache::covers(
+        const AtomicStructureAdapter& stru, double rmax) const
+{
+    if (stru.countSites() != int(mpositions.size()))  return false;
+    double dmax = 0.0;
+    for (size_t i = 0; i < mpositions.size(); ++i)
+    {
+        const double d = R3::distance(stru[i].xyz_cartn, mpositions[i]);
+        dmax = std::max(dmax, d);
+    }
+    bool rv = (mrcut - 2 * dmax >= rmax);
+    return rv;
+}
+
+
+std::pair<SiteIndices::const_iterator, SiteIndices::const_iterator>
+AtomicBondCache::neighbors(int site0) const
+{
+    assert(0 <= site0 && site0 + 1 < int(moffsets.size()));
+    SiteIndices::const_iterator first = mneighbors.begin();
+    SiteIndices::const_iterator last = first + moffsets[site0 + 1];
+    first += moffsets[site0];
+    return std::make_pair(first, last);
+}
+
+
+int AtomicBondCache::countNeighbors() const
+{
+    return mneighbors.size();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// class AtomicBondCacheGenerator
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+AtomicBondCacheGenerator::AtomicBondCacheGenerator(
+        StructureAdapterConstPtr adpt) :
+    BaseBondGenerator(adpt),
+    mrangefirst(0),
+    mrangelast(adpt->countSites()),
+    musesselection(false)
+{
+    mastructure = dynamic_cast<const AtomicStructureAdapter*>(adpt.get());
+    assert(mastructure);
+}
+
+// Public Methods ------------------------------------------------------------
+
+void AtomicBondCacheGenerator::rewind()
+{
+    // Delay cache lookup to here, so it is possible to use setRmax.
+    if (!mcache)  mcache = mastructure->getNeighborList(this->getRmax());
+    // iterate over the selected neighbors of the anchor
+    SiteIndices::const_iterator first, last;
+    if (mastructure->countSites())
+    {
+        std::pair<SiteIndices::const_iterator, SiteIndices::const_iterator>
+            nbrs = mcache->neighbors(this->site0());
+        first = nbrs.first;
+        last = nbrs.second;
+    }
+    else  first = last = mselectedneighbors.end();
+    if (musesselection)
+    {
+        mselectedneighbors.clear();
+        std::set_intersection(first, last,
+                mselection.begin(), mselection.end(),
+                std::back_inserter(mselectedneighbors));
+        msite_first = mselectedneighbors.begin();
+        msite_last = mselectedneighbors.end();
+    }
+    else
+    {
+        msite_first = std::lower_bound(first, last, mrangefirst);
+        msite_last = std::lower_bound(msite_first, last, mrangelast);
+    }
+    this->BaseBondGenerator::rewind();
+}
+
+
+void AtomicBondCacheGenerator::selectSiteRange(int first, int last)
+{
+    this->BaseBondGenerator::selectSiteRange(first, last);
+    mrangefirst = first;
+    mrangelast = last;
+    musesselection = false;
+}
+
+
+void AtomicBondCacheGenerator::selectSites(const SiteIndices& selection)
+{
+    this->selectSites(selection.begin(), selection.end());
+}
+
+
+void AtomicBondCacheGenerator::selectSites(
+        SiteIndices::const_iterator first,
+        SiteIndices::const_iterator last)
+{
+    mselection.assign(first, last);
+    if (!std::is_sorted(mselection.begin(), mselection.end()))
+    {
+        std::sort(mselection.begin(), mselection.end());
+    }
+    musesselection = true;
+    this->BaseBondGenerator::selectSites(
+            mselection.begin(), mselection.end());
+}
+
+
+void AtomicBondCacheGenerator::setRmax(double rmax)
+{
+    // release the cache so it will be checked on rewind with new rmax
+    if (this->getRmax() != rmax)    mcache.reset();
+    this->BaseBondGenerator::setRmax(rmax);
 }
 
 }   // namespace srreal
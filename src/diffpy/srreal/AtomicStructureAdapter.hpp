@@ -21,12 +21,17 @@
 #define ATOMICSTRUCTUREADAPTER_HPP_INCLUDED
 
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/split_member.hpp>
 
 #include <diffpy/srreal/StructureAdapter.hpp>
+#include <diffpy/srreal/SiteChangeJournal.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
 
 namespace diffpy {
 namespace srreal {
 
+class AtomicBondCache;
+
 class Atom
 {
     public:
@@ -87,12 +92,20 @@ class AtomicStructureAdapter : public StructureAdapter
         typedef AtomVector::difference_type difference_type;
         typedef AtomVector::size_type size_type;
 
+        // constructors
+        AtomicStructureAdapter();
+        /// copy shares the atoms and resets the change journal of the source.
+        /// Atoms are copied when writable references to them were handed out.
+        AtomicStructureAdapter(const AtomicStructureAdapter&);
+        AtomicStructureAdapter& operator=(const AtomicStructureAdapter&);
+
         // methods - overloaded
         virtual StructureAdapterPtr clone() const;
         virtual BaseBondGeneratorPtr createBondGenerator() const;
         virtual int countSites() const;
         // reusing StructureAdapter::numberDensity()
         virtual const std::string& siteAtomType(int idx) const;
+        virtual int siteAtomTypeId(int idx) const;
         virtual const R3::Vector& siteCartesianPosition(int idx) const;
         // reusing StructureAdapter::siteMultiplicity()
         virtual double siteOccupancy(int idx) const;
@@ -106,54 +119,142 @@ class AtomicStructureAdapter : public StructureAdapter
         template <class Iter>
         void insert(iterator position, Iter first, Iter last)
         {
-            matoms.insert(position, first, last);
+            difference_type offset = position - matoms->begin();
+            AtomVector& atoms = this->detachAtoms();
+            const int cnt0 = atoms.size();
+            atoms.insert(atoms.begin() + offset, first, last);
+            const int cnt1 = atoms.size();
+            for (int i = 0; i < cnt1 - cnt0; ++i)
+            {
+                mjournal.inserted(offset + i);
+            }
+            SiteIndices* tids = this->detachTypeIds();
+            if (!tids)  return;
+            tids->insert(tids->begin() + offset, cnt1 - cnt0, 0);
+            for (int i = offset; i < offset + cnt1 - cnt0; ++i)
+            {
+                (*tids)[i] = atomTypeId(atoms[i].atomtype);
+            }
         }
         void append(const Atom&);
         void clear();
         iterator erase(int idx);
         iterator erase(iterator pos);
         iterator erase(iterator first, iterator last);
-        void reserve(size_t sz)  { matoms.reserve(sz); }
-        size_type size() const  { return matoms.size(); }
+        void reserve(size_t sz)  { this->detachAtoms().reserve(sz); }
+        size_type size() const  { return matoms->size(); }
         Atom& operator[](int);
         const Atom& operator[](int) const;
         Atom& at(int idx)  { return (*this)[idx]; }
         const Atom& at(int idx) const  { return (*this)[idx]; }
         template <class Iter>
-            void assign (Iter first, Iter last)  { matoms.assign(first, last); }
-        void assign (size_t n, const Atom& a)  { matoms.assign(n, a); }
+            void assign (Iter first, Iter last)
+        {
+            this->mutableAtoms().assign(first, last);
+            mexposed = false;
+        }
+        void assign (size_t n, const Atom& a)
+        {
+            this->mutableAtoms().assign(n, a);
+            mexposed = false;
+        }
+        /// replace atom at idx without handing out a writable reference
+        void setAtom(int idx, const Atom&);
+        /// set Cartesian position of atom idx without exposing the atoms
+        void setAtomPosition(int idx, const R3::Vector& xyz);
+        /// version of the atom data.  The version is copied by clone and
+        /// changes with every non-const access to the atoms.  Adapters with
+        /// equal versions are guaranteed to contain the same atoms.
+        /// Clones of adapters with exposed atoms get a new version.
+        unsigned long getAtomsVersion() const  { return mversion; }
+        /// return true if the sites changed since the last copy or clone
+        /// are recorded in the change journal.  Journal is not maintained
+        /// after non-const iterator access or assignment of atoms.
+        bool hasChangeJournal() const;
+        /// cache pairs up to rmax + skin, no caching when skin is zero.
+        /// Cached pairs are reused until some atom moves more than skin/2.
+        void setBondCacheSkin(double skin);
+        const double& getBondCacheSkin() const;
+        /// cached neighbors complete up to rmax, rebuild when necessary
+        boost::shared_ptr<const AtomicBondCache>
+            getNeighborList(double rmax) const;
+        /// return true if writable references or iterators to the atoms
+        /// were handed out.  Such atoms are never shared with the clones
+        /// and their changes are found by comparison of the atoms.
+        bool hasExposedAtoms() const  { return mexposed; }
         // iterator forwarding
-        iterator begin()  { return matoms.begin(); }
-        iterator end()  { return matoms.end(); }
-        const_iterator begin() const  { return matoms.begin(); }
-        const_iterator end() const  { return matoms.end(); }
-        reverse_iterator rbegin()  { return matoms.rbegin(); }
-        reverse_iterator rend()  { return matoms.rend(); }
-        const_reverse_iterator rbegin() const  { return matoms.rbegin(); }
-        const_reverse_iterator rend() const  { return matoms.rend(); }
+        iterator begin()  { return this->exposeAtoms().begin(); }
+        iterator end()  { return this->exposeAtoms().end(); }
+        const_iterator begin() const  { return matoms->begin(); }
+        const_iterator end() const  { return matoms->end(); }
+        reverse_iterator rbegin()  { return this->exposeAtoms().rbegin(); }
+        reverse_iterator rend()  { return this->exposeAtoms().rend(); }
+        const_reverse_iterator rbegin() const  { return matoms->rbegin(); }
+        const_reverse_iterator rend() const  { return matoms->rend(); }
 
     private:
 
+        // global counter of atom data versions
+        static unsigned long gversion;
+
         // data
-        AtomVector matoms;
+        /// atoms are shared copy-on-write among the clones
+        boost::shared_ptr<AtomVector> matoms;
+        unsigned long mversion;
+        /// writable references to atoms may be held by the caller
+        bool mexposed;
+        /// record of changed sites since the last copy of this adapter
+        mutable SiteChangeJournal mjournal;
+        double mbondcacheskin;
+        /// neighbor list shared with the clones
+        mutable boost::shared_ptr<const AtomicBondCache> mneighborlist;
+        /// interned atom type ids shared with the clones, built on demand.
+        /// The ids are not cached for exposed atoms.
+        mutable boost::shared_ptr<SiteIndices> mtypeids;
+
+        // methods
+        /// return writable atoms, copy them first if shared with a clone
+        AtomVector& detachAtoms();
+        /// return writable atoms for untracked changes
+        AtomVector& mutableAtoms();
+        /// return writable atoms for references kept by the caller
+        AtomVector& exposeAtoms();
+        /// return writable cached type ids or NULL when they are not cached
+        SiteIndices* detachTypeIds();
 
         // comparison
         friend bool operator==(
                 const AtomicStructureAdapter& stru0,
                 const AtomicStructureAdapter& stru1)
         {
-            return (stru0.matoms == stru1.matoms);
+            return (stru0.matoms == stru1.matoms) ||
+                (*stru0.matoms == *stru1.matoms);
         }
 
         // serialization
         friend class boost::serialization::access;
         template<class Archive>
-            void serialize(Archive& ar, const unsigned int version)
+            void save(Archive& ar, const unsigned int version) const
+        {
+            ar & boost::serialization::base_object<StructureAdapter>(*this);
+            const AtomVector& atoms = *matoms;
+            ar & atoms;
+            ar & mbondcacheskin;
+        }
+
+        template<class Archive>
+            void load(Archive& ar, const unsigned int version)
         {
             ar & boost::serialization::base_object<StructureAdapter>(*this);
-            ar & matoms;
+            ar & this->mutableAtoms();
+            if (version >= 1)
+            {
+                ar & mbondcacheskin;
+            }
         }
 
+        BOOST_SERIALIZATION_SPLIT_MEMBER()
+
 };
 
 typedef boost::shared_ptr<AtomicStructureAdapter> AtomicStructureAdapterPtr;
@@ -168,11 +269,74 @@ bool operator!=(
     return !(stru0 == stru1);
 }
 
+
+class AtomicBondCache
+{
+    public:
+
+        // constructor
+        AtomicBondCache(const AtomicStructureAdapter&, double rcut);
+
+        // methods
+        /// cutoff distance used when the cache was built
+        const double& getRcut() const;
+        /// return true if the cache has all pairs of stru up to rmax
+        bool covers(const AtomicStructureAdapter& stru, double rmax) const;
+        /// sorted indices of sites within rcut from site0
+        std::pair<SiteIndices::const_iterator, SiteIndices::const_iterator>
+            neighbors(int site0) const;
+        int countNeighbors() const;
+
+    private:
+
+        // data
+        double mrcut;
+        std::vector<R3::Vector> mpositions;
+        SiteIndices moffsets;
+        SiteIndices mneighbors;
+};
+
+
+class AtomicBondCacheGenerator : public BaseBondGenerator
+{
+    public:
+
+        // constructors
+        AtomicBondCacheGenerator(StructureAdapterConstPtr);
+
+        // methods
+        // loop control
+        virtual void rewind();
+
+        // configuration
+        virtual void selectSiteRange(int first, int last);
+        virtual void selectSites(const SiteIndices&);
+        virtual void selectSites(
+                SiteIndices::const_iterator first,
+                SiteIndices::const_iterator last);
+        virtual void setRmax(double);
+
+    private:
+
+        // data
+        const AtomicStructureAdapter* mastructure;
+        boost::shared_ptr<const AtomicBondCache> mcache;
+        /// site range when mselection is not used
+        int mrangefirst;
+        int mrangelast;
+        bool musesselection;
+        /// sorted selection of sites
+        SiteIndices mselection;
+        /// selected neighbors of the anchor site
+        SiteIndices mselectedneighbors;
+};
+
 }   // namespace srreal
 }   // namespace diffpy
 
 // Serialization -------------------------------------------------------------
 
+BOOST_CLASS_VERSION(diffpy::srreal::AtomicStructureAdapter, 1)
 BOOST_CLASS_EXPORT_KEY(diffpy::srreal::AtomicStructureAdapter)
 
 #endif  // ATOMICSTRUCTUREADAPTER_HPP_INCLUDED
@@ -162,19 +162,19 @@ void BVSCalculator::configureBondGenerator(BaseBondGenerator& bnds) const
 void BVSCalculator::addPairContribution(const BaseBondGenerator& bnds,
         int summationscale)
 {
-    const string& a0 = mstructure_cache.baresymbols[bnds.site0()];
-    const string& a1 = mstructure_cache.baresymbols[bnds.site1()];
+    const PackedStructureView& sv = this->getPackedView();
+    const int k = sv.siteTypeId(bnds.site0()) * sv.countTypes() +
+        sv.siteTypeId(bnds.site1());
+    const BVParam* bp = mstructure_cache.typepairparams[k];
+    // do nothing if there are no bond parameters for this pair
+    if (!bp)    return;
     int v0 = mstructure_cache.valences[bnds.site0()];
     int v1 = mstructure_cache.valences[bnds.site1()];
-    const BVParametersTable& bvtb = *(this->getBVParamTable());
-    const BVParam& bp = bvtb.lookup(a0, v0, a1, v1);
-    // do nothing if there are no bond parameters for this pair
-    if (&bp == &bvtb.none())    return;
-    double valencehalf = bp.bondvalence(bnds.distance()) / 2.0;
+    double valencehalf = bp->bondvalence(bnds.distance()) / 2.0;
     int pm0 = (v0 >= 0) ? 1 : -1;
     int pm1 = (v1 >= 0) ? 1 : -1;
-    const double& o0 = mstructure->siteOccupancy(bnds.site0());
-    const double& o1 = mstructure->siteOccupancy(bnds.site1());
+    const double& o0 = sv.siteOccupancy(bnds.site0());
+    const double& o1 = sv.siteOccupancy(bnds.site1());
     mvalue[bnds.site0()] += summationscale * pm0 * valencehalf * o1;
     mvalue[bnds.site1()] += summationscale * pm1 * valencehalf * o0;
 }
@@ -183,16 +183,38 @@ void BVSCalculator::addPairContribution(const BaseBondGenerator& bnds,
 
 void BVSCalculator::cacheStructureData()
 {
-    int cntsites = this->countSites();
+    const PackedStructureView& sv = this->getPackedView();
+    int cntsites = sv.countSites();
     mstructure_cache.baresymbols.resize(cntsites);
     mstructure_cache.valences.resize(cntsites);
     const BVParametersTable& bvtb = *(this->getBVParamTable());
     for (int i = 0; i < cntsites; ++i)
     {
-        const string& smbl = mstructure->siteAtomType(i);
+        const string& smbl = sv.siteAtomType(i);
         mstructure_cache.baresymbols[i] = atomBareSymbol(smbl);
         mstructure_cache.valences[i] = bvtb.getAtomValence(smbl);
     }
+    // bond parameters for every pair of atom types
+    const int cnttypes = sv.countTypes();
+    const vector<string>& atomtypes = sv.atomTypes();
+    vector<string> tpsymbols(cnttypes);
+    vector<int> tpvalences(cnttypes);
+    for (int tp = 0; tp < cnttypes; ++tp)
+    {
+        tpsymbols[tp] = atomBareSymbol(atomtypes[tp]);
+        tpvalences[tp] = bvtb.getAtomValence(atomtypes[tp]);
+    }
+    mstructure_cache.typepairparams.resize(cnttypes * cnttypes);
+    for (int t0 = 0; t0 < cnttypes; ++t0)
+    {
+        for (int t1 = 0; t1 < cnttypes; ++t1)
+        {
+            const BVParam& bp = bvtb.lookup(tpsymbols[t0], tpvalences[t0],
+                    tpsymbols[t1], tpvalences[t1]);
+            mstructure_cache.typepairparams[t0 * cnttypes + t1] =
+                (&bp == &bvtb.none()) ? NULL : &bp;
+        }
+    }
 }
 
 
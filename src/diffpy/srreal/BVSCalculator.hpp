@@ -79,6 +79,9 @@ class BVSCalculator : public PairQuantity
         struct {
             std::vector<std::string> baresymbols;
             std::vector<int> valences;
+            /// bond valence parameters for pairs of the packed view types,
+            /// rebuilt in every resetValue
+            std::vector<const BVParam*> typepairparams;
         } mstructure_cache;
 
         // serialization
@@ -18,6 +18,9 @@
 *****************************************************************************/
 
 #include <diffpy/srreal/BaseBondGenerator.hpp>
+#include <diffpy/srreal/BondBlock.hpp>
+#include <diffpy/srreal/EvalCounters.hpp>
+#include <diffpy/srreal/PackedStructureView.hpp>
 #include <diffpy/srreal/StructureAdapter.hpp>
 #include <diffpy/mathutils.hpp>
 
@@ -38,7 +41,12 @@ BaseBondGenerator::BaseBondGenerator(StructureAdapterConstPtr stru) :
     mr0(R3::zerovector),
     mr1(R3::zerovector),
     mr01(R3::zerovector),
-    mdistance(0.0)
+    mdistance(0.0),
+    msymmetryreduction(false),
+    mpackedview(NULL),
+    mtallyaccepted(0),
+    mtallyrejected(0),
+    mdirectfillenabled(true)
 {
     int cnt = stru->countSites();
     msite_all.resize(cnt);
@@ -48,6 +56,14 @@ BaseBondGenerator::BaseBondGenerator(StructureAdapterConstPtr stru) :
     this->setFinishedFlag();
 }
 
+// Destructor ----------------------------------------------------------------
+
+BaseBondGenerator::~BaseBondGenerator()
+{
+    DIFFPY_EVAL_COUNT(BONDS_VISITED, mtallyaccepted + mtallyrejected);
+    DIFFPY_EVAL_COUNT(BONDS_ACCEPTED, mtallyaccepted);
+}
+
 // Public Methods ------------------------------------------------------------
 
 // loop control
@@ -59,6 +75,7 @@ void BaseBondGenerator::rewind()
     if (this->finished())   return;
     this->rewindSymmetry();
     this->advanceWhileInvalid();
+    DIFFPY_EVAL_TALLY(mtallyaccepted += !this->finished());
 }
 
 
@@ -66,6 +83,7 @@ void BaseBondGenerator::next()
 {
     this->getNextBond();
     this->advanceWhileInvalid();
+    DIFFPY_EVAL_TALLY(mtallyaccepted += !this->finished());
 }
 
 
@@ -74,13 +92,48 @@ bool BaseBondGenerator::finished() const
     return msite_current >= msite_last;
 }
 
+
+int BaseBondGenerator::fillBlock(BondBlock& blk)
+{
+    const int cnt0 = blk.count;
+    if (!mdirectfillenabled)
+    {
+        for (; !this->finished() && !blk.full(); this->next())
+        {
+            blk.append(*this);
+        }
+        return blk.count - cnt0;
+    }
+    if (this->finished())  return 0;
+    // all bonds of the plain site loop share the anchor multiplicity
+    const int mult = this->multiplicity();
+    while (!blk.full())
+    {
+        blk.append(msite_anchor, *msite_current, mdistance, mr01, mult);
+        for (++msite_current; !this->finished(); ++msite_current)
+        {
+            mr1 = mpackedview ?
+                mpackedview->siteCartesianPosition(*msite_current) :
+                mstructure->siteCartesianPosition(*msite_current);
+            this->updateDistance();
+            if (this->bondInRange())  break;
+            DIFFPY_EVAL_TALLY(++mtallyrejected);
+        }
+        if (this->finished())  break;
+        DIFFPY_EVAL_TALLY(++mtallyaccepted);
+    }
+    return blk.count - cnt0;
+}
+
 // configuration
 
 void BaseBondGenerator::selectAnchorSite(int anchor)
 {
     assert(0 <= anchor && anchor < mstructure->countSites());
     msite_anchor = anchor;
-    mr0 = mstructure->siteCartesianPosition(msite_anchor);
+    mr0 = mpackedview ?
+        mpackedview->siteCartesianPosition(msite_anchor) :
+        mstructure->siteCartesianPosition(msite_anchor);
     this->setFinishedFlag();
 }
 
@@ -127,6 +180,26 @@ void BaseBondGenerator::setRmax(double rmax)
     mrmax = rmax;
 }
 
+
+void BaseBondGenerator::setSymmetryReduction(bool flag)
+{
+    if (flag != msymmetryreduction)  this->setFinishedFlag();
+    msymmetryreduction = flag;
+}
+
+
+bool BaseBondGenerator::getSymmetryReduction() const
+{
+    return msymmetryreduction;
+}
+
+
+void BaseBondGenerator::setPackedView(const PackedStructureView* view)
+{
+    assert(!view || view->countSites() == mstructure->countSites());
+    mpackedview = view;
+}
+
 // data query
 
 const double& BaseBondGenerator::getRmin() const
@@ -155,6 +228,7 @@ int BaseBondGenerator::site1() const
 
 int BaseBondGenerator::multiplicity() const
 {
+    if (mpackedview)  return mpackedview->siteMultiplicity(this->site0());
     return mstructure->siteMultiplicity(this->site0());
 }
 
@@ -185,13 +259,23 @@ const R3::Vector& BaseBondGenerator::r01() const
 
 const R3::Matrix& BaseBondGenerator::Ucartesian0() const
 {
-    return mstructure->siteCartesianUij(this->site0());
+    const int i0 = this->site0();
+    if (mpackedview && mpackedview->siteAnisotropy(i0))
+    {
+        return mpackedview->siteCartesianUij(i0);
+    }
+    return mstructure->siteCartesianUij(i0);
 }
 
 
 const R3::Matrix& BaseBondGenerator::Ucartesian1() const
 {
-    return mstructure->siteCartesianUij(this->site1());
+    const int i1 = this->site1();
+    if (mpackedview && mpackedview->siteAnisotropy(i1))
+    {
+        return mpackedview->siteCartesianUij(i1);
+    }
+    return mstructure->siteCartesianUij(i1);
 }
 
 
@@ -199,10 +283,16 @@ double BaseBondGenerator::msd() const
 {
     static R3::Vector s;
     s = this->r01();
-    double msd0 = meanSquareDisplacement(this->Ucartesian0(), s,
-            mstructure->siteAnisotropy(this->site0()));
-    double msd1 = meanSquareDisplacement(this->Ucartesian1(), s,
-            mstructure->siteAnisotropy(this->site1()));
+    // the packed view has the isotropic displacements of the sites
+    const PackedStructureView* sv = mpackedview;
+    const bool aniso0 = sv ? sv->siteAnisotropy(this->site0()) :
+        mstructure->siteAnisotropy(this->site0());
+    const bool aniso1 = sv ? sv->siteAnisotropy(this->site1()) :
+        mstructure->siteAnisotropy(this->site1());
+    double msd0 = (sv && !aniso0) ? sv->siteUiso(this->site0()) :
+        meanSquareDisplacement(this->Ucartesian0(), s, aniso0);
+    double msd1 = (sv && !aniso1) ? sv->siteUiso(this->site1()) :
+        meanSquareDisplacement(this->Ucartesian1(), s, aniso1);
     double rv = msd0 + msd1;
     return rv;
 }
@@ -217,7 +307,9 @@ bool BaseBondGenerator::iterateSymmetry()
 
 void BaseBondGenerator::rewindSymmetry()
 {
-    mr1 = mstructure->siteCartesianPosition(this->site1());
+    mr1 = mpackedview ?
+        mpackedview->siteCartesianPosition(this->site1()) :
+        mstructure->siteCartesianPosition(this->site1());
     this->updateDistance();
 }
 
@@ -246,6 +338,7 @@ void BaseBondGenerator::advanceWhileInvalid()
     while (!this->finished() &&
             (this->bondOutOfRange() || this->atSelfPair()))
     {
+        DIFFPY_EVAL_TALLY(++mtallyrejected);
         this->getNextBond();
     }
 }
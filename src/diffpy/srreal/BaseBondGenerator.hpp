@@ -29,36 +29,50 @@ namespace srreal {
 /// Use zero default for rmax so any misconfiguration of r-limits is obvious.
 const double DEFAULT_BONDGENERATOR_RMAX = 0.0;
 
+class BondBlock;
+class PackedStructureView;
+
 class BaseBondGenerator
 {
     public:
 
         // constructor
         BaseBondGenerator(StructureAdapterConstPtr);
-        virtual ~BaseBondGenerator()  { }
+        /// destructor adds the visited bonds to EvalCounters
+        virtual ~BaseBondGenerator();
 
         // methods
         // loop control
         virtual void rewind();
         bool finished() const;
         void next();
+        /// append bonds to blk until it is full or the loop is finished,
+        /// return the number of added bonds
+        virtual int fillBlock(BondBlock& blk);
 
         // configuration
         virtual void selectAnchorSite(int);
-        void selectSiteRange(int first, int last);
-        void selectSites(const SiteIndices&);
-        void selectSites(
+        virtual void selectSiteRange(int first, int last);
+        virtual void selectSites(const SiteIndices&);
+        virtual void selectSites(
                 SiteIndices::const_iterator first,
                 SiteIndices::const_iterator last);
         virtual void setRmin(double);
         virtual void setRmax(double);
+        /// skip bonds related by the site symmetry of the anchor and
+        /// count them in multiplicity, only used by crystal generators
+        void setSymmetryReduction(bool);
+        bool getSymmetryReduction() const;
+        /// read site data from a packed copy of the structure, which
+        /// must outlive the generator.  Use NULL to query the structure.
+        void setPackedView(const PackedStructureView*);
 
         // get data
         const double& getRmin() const;
         const double& getRmax() const;
         int site0() const;
         int site1() const;
-        int multiplicity() const;
+        virtual int multiplicity() const;
         const R3::Vector& r0() const;
         const R3::Vector& r1() const;
         const double& distance() const;
@@ -81,14 +95,24 @@ class BaseBondGenerator
         R3::Vector mr1;
         R3::Vector mr01;
         double mdistance;
+        bool msymmetryreduction;
+        const PackedStructureView* mpackedview;
         SiteIndices msite_all;
         SiteIndices msite_selection;
+        // bond counts for EvalCounters
+        long long mtallyaccepted;
+        long long mtallyrejected;
+        /// allow the direct bond loop in fillBlock, derived generators
+        /// that override the bond iteration should disable it
+        bool mdirectfillenabled;
 
         // methods
         virtual bool iterateSymmetry();
         virtual void rewindSymmetry();
         virtual void getNextBond();
         void updateDistance();
+        /// true if the current bond is within r-limits and not a self-pair
+        bool bondInRange() const;
 
     private:
 
@@ -100,6 +124,15 @@ class BaseBondGenerator
 
 };
 
+// Inline Methods ------------------------------------------------------------
+
+inline
+bool BaseBondGenerator::bondInRange() const
+{
+    using diffpy::mathutils::eps_eq;
+    return (mrmin <= mdistance) && (mdistance <= mrmax) &&
+        !eps_eq(mdistance, 0.0);
+}
 
 }   // namespace srreal
 }   // namespace diffpy
@@ -17,6 +17,8 @@
 *****************************************************************************/
 
 #include <cassert>
+#include <cmath>
+#include <algorithm>
 #include <string>
 #include <stdexcept>
 #include <sstream>
@@ -44,13 +46,18 @@ const double DEFAULT_DEBYE_PRECISION = 1e-6;
 
 }   // namespace
 
+// Class Constants -----------------------------------------------------------
+
+const double BaseDebyeSum::MIXED_PRECISION_RTOL = 2e-6;
+
 // Constructor ---------------------------------------------------------------
 
 BaseDebyeSum::BaseDebyeSum() :
     mqmin(0.0),
     mqmax(DEFAULT_QGRID_QMAX),
     mqstep(DEFAULT_QGRID_QSTEP),
-    mdebyeprecision(DEFAULT_DEBYE_PRECISION)
+    mdebyeprecision(DEFAULT_DEBYE_PRECISION),
+    mmixedprecision(false)
 {
     mstructure_cache.totaloccupancy = 0.0;
     // default configuration
@@ -152,6 +159,19 @@ const double& BaseDebyeSum::getDebyePrecision() const
     return mdebyeprecision;
 }
 
+
+void BaseDebyeSum::setMixedPrecision(bool flag)
+{
+    if (mmixedprecision != flag)  mticker.click();
+    mmixedprecision = flag;
+}
+
+
+bool BaseDebyeSum::getMixedPrecision() const
+{
+    return mmixedprecision;
+}
+
 // Protected Methods ---------------------------------------------------------
 
 // PairQuantity overloads
@@ -167,6 +187,11 @@ void BaseDebyeSum::resetValue()
 void BaseDebyeSum::addPairContribution(const BaseBondGenerator& bnds,
         int summationscale)
 {
+    if (mmixedprecision)
+    {
+        this->addPairContributionMixed(bnds, summationscale);
+        return;
+    }
     const double dist = bnds.distance();
     if (eps_eq(0.0, dist))  return;
     // calculate sigma parameter for the Debye-Waller dampign Gaussian
@@ -231,22 +256,17 @@ double BaseDebyeSum::sfAverageAtkQ(int kq) const
 void BaseDebyeSum::cacheStructureData()
 {
     using std::placeholders::_1;
-    int cntsites = this->countSites();
+    const PackedStructureView& sv = this->getPackedView();
+    int cntsites = sv.countSites();
     const int nqpts = pdfutils_qmaxSteps(this);
     QuantityType zeros(nqpts, 0.0);
-    unordered_map<string,int> atomtypeidx;
     // sftypeatkq
     mstructure_cache.typeofsite.clear();
     mstructure_cache.typeofsite.reserve(cntsites);
     mstructure_cache.sftypeatkq.clear();
     for (int siteidx = 0; siteidx < cntsites; ++siteidx)
     {
-        const string& smbl = mstructure->siteAtomType(siteidx);
-        if (!atomtypeidx.count(smbl))
-        {
-            atomtypeidx.insert(make_pair(smbl, int(atomtypeidx.size())));
-        }
-        int tpidx = atomtypeidx[smbl];
+        int tpidx = sv.siteTypeId(siteidx);
         mstructure_cache.typeofsite.push_back(tpidx);
         // do nothing if the type has been already cached
         if (tpidx < int(mstructure_cache.sftypeatkq.size()))  continue;
@@ -261,9 +281,25 @@ void BaseDebyeSum::cacheStructureData()
         }
     }
     assert(cntsites == int(mstructure_cache.typeofsite.size()));
-    assert(atomtypeidx.size() == mstructure_cache.sftypeatkq.size());
+    assert(sv.countTypes() == int(mstructure_cache.sftypeatkq.size()));
+    // float copies for the mixed precision summation
+    const int ntypes = mstructure_cache.sftypeatkq.size();
+    mstructure_cache.sftypeatkqf.resize(ntypes);
+    mstructure_cache.sftypemax.assign(ntypes, 0.0);
+    for (int tpidx = 0; tpidx < ntypes; ++tpidx)
+    {
+        const QuantityType& sfarray = mstructure_cache.sftypeatkq[tpidx];
+        mstructure_cache.sftypeatkqf[tpidx].assign(
+                sfarray.begin(), sfarray.end());
+        QuantityType::const_iterator sf = sfarray.begin();
+        for (; sf != sfarray.end(); ++sf)
+        {
+            double& sfmax = mstructure_cache.sftypemax[tpidx];
+            sfmax = max(sfmax, fabs(*sf));
+        }
+    }
     // totaloccupancy
-    mstructure_cache.totaloccupancy = mstructure->totalOccupancy();
+    mstructure_cache.totaloccupancy = sv.totalOccupancy();
     // sfaverageatkq
     QuantityType& sfak = mstructure_cache.sfaverageatkq;
     sfak = zeros;
@@ -273,7 +309,7 @@ void BaseDebyeSum::cacheStructureData()
     {
         int tpidx = mstructure_cache.typeofsite[siteidx];
         assert(tpidx < ntps);
-        tpmultipl[tpidx] += mstructure->siteMultiplicity(siteidx);
+        tpmultipl[tpidx] += sv.siteMultiplicity(siteidx);
     }
     for (int tpidx = 0; tpidx < ntps; ++tpidx)
     {
@@ -290,6 +326,50 @@ void BaseDebyeSum::cacheStructureData()
             bind(multiplies<double>(), tosc, _1));
 }
 
+
+void BaseDebyeSum::addPairContributionMixed(
+        const BaseBondGenerator& bnds, int summationscale)
+{
+    const double dist = bnds.distance();
+    if (eps_eq(0.0, dist))  return;
+    const double fwhm = this->getPeakWidthModel()->calculate(bnds);
+    const double fwhmtosigma = 1.0 / (2 * sqrt(2 * M_LN2));
+    const double dwsigma = fwhmtosigma * fwhm;
+    const int smscale = summationscale * bnds.multiplicity();
+    const int tp0 = mstructure_cache.typeofsite[bnds.site0()];
+    const int tp1 = mstructure_cache.typeofsite[bnds.site1()];
+    // find where the Gaussian envelope of the terms drops below cutoff
+    const double& sineprec = this->getDebyePrecision();
+    const double scalemax = fabs(smscale / dist) *
+        mstructure_cache.sftypemax[tp0] * mstructure_cache.sftypemax[tp1];
+    if (scalemax <= sineprec)  return;
+    const double& qstep = this->getQstep();
+    const int kqlo = pdfutils_qminSteps(this);
+    int kqhi = pdfutils_qmaxSteps(this);
+    if (sineprec > 0.0 && dwsigma > 0.0)
+    {
+        const double qcut = sqrt(2 * log(scalemax / sineprec)) / dwsigma;
+        kqhi = min(double(kqhi), floor(qcut / qstep) + 1);
+    }
+    if (kqlo >= kqhi)  return;
+    // branch-free loop in float arithmetic with the sine phase reduced
+    // to [-pi, pi] in double precision
+    const float* sf0 = &(mstructure_cache.sftypeatkqf[tp0][0]);
+    const float* sf1 = &(mstructure_cache.sftypeatkqf[tp1][0]);
+    const float fscale = smscale / dist;
+    const float dwa = -0.5 * pow(dwsigma * qstep, 2);
+    const double qd = qstep * dist;
+    const double twopi = 2 * M_PI;
+    double* y = &(mvalue[0]);
+    for (int kq = kqlo; kq < kqhi; ++kq)
+    {
+        const double phase = kq * qd;
+        const float x = phase - twopi * int(phase / twopi + 0.5);
+        const float dwscale = expf(dwa * float(kq) * float(kq));
+        y[kq] += fscale * dwscale * sf0[kq] * sf1[kq] * sinf(x);
+    }
+}
+
 }   // namespace srreal
 }   // namespace diffpy
 
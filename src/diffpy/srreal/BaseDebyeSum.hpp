@@ -59,6 +59,17 @@ class BaseDebyeSum :
         /// return relative cutoff value for Debye sum contribution
         const double& getDebyePrecision() const;
 
+        // Mixed precision summation
+        /// Compute the pair terms from float structure factors in float
+        /// arithmetic and add them to the double sum.  Every pair term
+        /// differs from the double term by less than MIXED_PRECISION_RTOL
+        /// times its magnitude without the Debye-Waller damping.
+        /// The terms are also cut off by their Gaussian envelope, which
+        /// changes the sum by at most debyeprecision per pair and Q.
+        void setMixedPrecision(bool);
+        bool getMixedPrecision() const;
+        static const double MIXED_PRECISION_RTOL;
+
     protected:
 
         // PairQuantity overloads
@@ -78,6 +89,7 @@ class BaseDebyeSum :
         double sfSiteAtkQ(int siteidx, int kq) const;
         double sfAverageAtkQ(int kq) const;
         void cacheStructureData();
+        void addPairContributionMixed(const BaseBondGenerator&, int);
 
         // data
         // configuration
@@ -85,9 +97,13 @@ class BaseDebyeSum :
         double mqmax;
         double mqstep;
         double mdebyeprecision;
+        bool mmixedprecision;
         struct {
             std::vector<int> typeofsite;
             std::vector<QuantityType> sftypeatkq;
+            std::vector< std::vector<float> > sftypeatkqf;
+            /// largest magnitude of the structure factor per type
+            QuantityType sftypemax;
             QuantityType sfaverageatkq;
             double totaloccupancy;
         } mstructure_cache;
@@ -109,6 +125,12 @@ class BaseDebyeSum :
             ar & mstructure_cache.sftypeatkq;
             ar & mstructure_cache.sfaverageatkq;
             ar & mstructure_cache.totaloccupancy;
+            if (version >= 1)
+            {
+                ar & mmixedprecision;
+                ar & mstructure_cache.sftypeatkqf;
+                ar & mstructure_cache.sftypemax;
+            }
         }
 
 };  // class BaseDebyeSum
@@ -118,6 +140,7 @@ class BaseDebyeSum :
 
 // Serialization -------------------------------------------------------------
 
+BOOST_CLASS_VERSION(diffpy::srreal::BaseDebyeSum, 1)
 BOOST_CLASS_EXPORT_KEY(diffpy::srreal::BaseDebyeSum)
 
 #endif  // BASEDEBYESUM_HPP_INCLUDED
@@ -0,0 +1,105 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class BondBlock -- fixed-size block of bonds stored as structure of arrays
+*
+* Bond generators fill the block in BaseBondGenerator::fillBlock and
+* PairQuantity classes may process it in addPairContributions with one
+* virtual call per block.
+*
+*****************************************************************************/
+
+#ifndef BONDBLOCK_HPP_INCLUDED
+#define BONDBLOCK_HPP_INCLUDED
+
+#include <diffpy/srreal/BaseBondGenerator.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+class BondBlock
+{
+    public:
+
+        // constants
+        enum { CAPACITY = 64 };
+
+        // constructor
+        BondBlock() : count(0)  { }
+
+        // methods
+        void clear()  { count = 0; }
+        bool full() const  { return count >= CAPACITY; }
+        /// append the current bond of the generator with unit scale
+        void append(const BaseBondGenerator& bnds);
+        /// append bond data with unit scale, used by the generator loops
+        void append(int i0, int i1, const double& d,
+                const R3::Vector& rv, int mult);
+        /// copy bond data from index i to index j
+        void copyEntry(int i, int j);
+
+        // data
+        int count;
+        int site0[CAPACITY];
+        int site1[CAPACITY];
+        double distance[CAPACITY];
+        double r01[R3::Ndim][CAPACITY];
+        int multiplicity[CAPACITY];
+        int summationscale[CAPACITY];
+
+};
+
+// Inline Methods ------------------------------------------------------------
+
+inline
+void BondBlock::append(const BaseBondGenerator& bnds)
+{
+    this->append(bnds.site0(), bnds.site1(), bnds.distance(),
+            bnds.r01(), bnds.multiplicity());
+}
+
+
+inline
+void BondBlock::append(int i0, int i1, const double& d,
+        const R3::Vector& rv, int mult)
+{
+    const int& k = count;
+    site0[k] = i0;
+    site1[k] = i1;
+    distance[k] = d;
+    r01[0][k] = rv[0];
+    r01[1][k] = rv[1];
+    r01[2][k] = rv[2];
+    multiplicity[k] = mult;
+    summationscale[k] = 1;
+    ++count;
+}
+
+
+inline
+void BondBlock::copyEntry(int i, int j)
+{
+    site0[j] = site0[i];
+    site1[j] = site1[i];
+    distance[j] = distance[i];
+    r01[0][j] = r01[0][i];
+    r01[1][j] = r01[1][i];
+    r01[2][j] = r01[2][i];
+    multiplicity[j] = multiplicity[i];
+    summationscale[j] = summationscale[i];
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+#endif  // BONDBLOCK_HPP_INCLUDED
@@ -18,9 +18,11 @@
 
 #include <cassert>
 #include <cmath>
+#include <algorithm>
 #include <sstream>
 
 #include <diffpy/srreal/BondCalculator.hpp>
+#include <diffpy/srreal/BondBlock.hpp>
 #include <diffpy/validators.hpp>
 #include <diffpy/mathutils.hpp>
 #include <diffpy/serialization.ipp>
@@ -95,11 +97,57 @@ class BondOp {
         }
 
 
+        static BondCalculator::BondEntry entryFrom(
+                const BondBlock& blk, int k)
+        {
+            BondCalculator::BondEntry rv;
+            rv.distance = blk.distance[k];
+            rv.site0 = blk.site0[k];
+            rv.site1 = blk.site1[k];
+            rv.direction0 = blk.r01[0][k];
+            rv.direction1 = blk.r01[1][k];
+            rv.direction2 = blk.r01[2][k];
+            return rv;
+        }
+
+
+        static bool distanceLess(
+                const BondCalculator::BondEntry& be, double d)
+        {
+            return be.distance < d;
+        }
+
+
+        static bool lessDistance(
+                double d, const BondCalculator::BondEntry& be)
+        {
+            return d < be.distance;
+        }
+
+
+        static bool insideCone(
+                const BondCalculator::BondEntry& be,
+                const R3::Vector& coneaxis, double degrees)
+        {
+            if (180.0 <= degrees)  return true;
+            double cosangle = (be.direction0 * coneaxis[0] +
+                    be.direction1 * coneaxis[1] +
+                    be.direction2 * coneaxis[2]) / be.distance;
+            cosangle = max(-1.0, min(1.0, cosangle));
+            double angledegrees = 180.0 / M_PI * acos(cosangle);
+            return (angledegrees <= degrees);
+        }
+
+
 };  // class BondOp
 
 // Constructor ---------------------------------------------------------------
 
-BondCalculator::BondCalculator()
+BondCalculator::BondCalculator() :
+    mbondindexing(false),
+    mbondsrmin(0.0),
+    mbondsrmax(-1.0),
+    mrangeupdating(false)
 {
     this->setRmax(DEFAULT_BONDCALCULATOR_RMAX);
     this->setEvaluatorType(OPTIMIZED);
@@ -112,13 +160,20 @@ BondCalculator::BondCalculator()
 QuantityType BondCalculator::distances() const
 {
     QuantityType rv;
-    rv.reserve(this->count());
-    BondDataStorage::const_iterator bi = mbonds.begin();
-    for (; bi != mbonds.end(); bi++)  rv.push_back(bi->distance);
+    this->distances(rv);
     return rv;
 }
 
 
+void BondCalculator::distances(QuantityType& rv) const
+{
+    rv.resize(this->count());
+    QuantityType::iterator di = rv.begin();
+    BondDataStorage::const_iterator bi = mbonds.begin();
+    for (; bi != mbonds.end(); ++bi, ++di)  *di = bi->distance;
+}
+
+
 vector<R3::Vector> BondCalculator::directions() const
 {
     vector<R3::Vector> rv;
@@ -184,6 +239,67 @@ void BondCalculator::filterOff()
     mfilter_degrees.clear();
 }
 
+// queries over the calculated bonds
+
+void BondCalculator::setBondIndexing(bool flag)
+{
+    if (mbondindexing == flag)  return;
+    mbondindexing = flag;
+    this->rebuildBondIndex();
+}
+
+
+bool BondCalculator::getBondIndexing() const
+{
+    return mbondindexing;
+}
+
+
+BondCalculator::BondDataStorage
+BondCalculator::siteBonds(int i, double dmin, double dmax) const
+{
+    BondDataStorage scratch;
+    const BondDataStorage& sb = this->siteBondsAll(i, scratch);
+    BondDataStorage::const_iterator lo, hi;
+    lo = lower_bound(sb.begin(), sb.end(), dmin, BondOp::distanceLess);
+    hi = upper_bound(lo, sb.end(), dmax, BondOp::lessDistance);
+    BondDataStorage rv(lo, hi);
+    return rv;
+}
+
+
+BondCalculator::BondDataStorage
+BondCalculator::siteBondsInCone(int i, double dmin, double dmax,
+        R3::Vector coneaxis, double degrees) const
+{
+    using namespace diffpy::validators;
+    double nmconeaxis = R3::norm(coneaxis);
+    ensureEpsilonPositive("magnitude of cone vector", nmconeaxis);
+    coneaxis /= nmconeaxis;
+    BondDataStorage scratch;
+    const BondDataStorage& sb = this->siteBondsAll(i, scratch);
+    BondDataStorage::const_iterator bi, hi;
+    bi = lower_bound(sb.begin(), sb.end(), dmin, BondOp::distanceLess);
+    hi = upper_bound(bi, sb.end(), dmax, BondOp::lessDistance);
+    BondDataStorage rv;
+    for (; bi != hi; ++bi)
+    {
+        if (BondOp::insideCone(*bi, coneaxis, degrees))  rv.push_back(*bi);
+    }
+    return rv;
+}
+
+
+BondCalculator::BondDataStorage
+BondCalculator::bondsInRange(double dmin, double dmax) const
+{
+    BondDataStorage::const_iterator lo, hi;
+    lo = lower_bound(mbonds.begin(), mbonds.end(), dmin, BondOp::distanceLess);
+    hi = upper_bound(lo, mbonds.end(), dmax, BondOp::lessDistance);
+    BondDataStorage rv(lo, hi);
+    return rv;
+}
+
 // PairQuantity overloads
 
 string BondCalculator::getParallelData() const
@@ -202,6 +318,10 @@ void BondCalculator::resetValue()
     mbonds.clear();
     maddbonds.clear();
     mpopbonds.clear();
+    msitebonds.clear();
+    mbondsrmin = this->getRmin();
+    mbondsrmax = this->getRmax();
+    mrangeupdating = false;
     this->PairQuantity::resetValue();
 }
 
@@ -213,6 +333,7 @@ void BondCalculator::addPairContribution(
     assert(summationscale == +1 || summationscale == -1);
     static R3::Vector ru01;
     const R3::Vector& r01 = bnds.r01();
+    if (mrangeupdating && this->inStashedRange(bnds.distance()))  return;
     ru01 = r01 / bnds.distance();
     if (!(this->checkConeFilters(ru01)))  return;
     BondDataStorage& bes = (summationscale > 0) ? maddbonds : mpopbonds;
@@ -220,6 +341,25 @@ void BondCalculator::addPairContribution(
 }
 
 
+void BondCalculator::addPairContributions(const BondBlock& blk)
+{
+    R3::Vector ru01;
+    for (int k = 0; k < blk.count; ++k)
+    {
+        assert(blk.summationscale[k] == +1 || blk.summationscale[k] == -1);
+        if (mrangeupdating && this->inStashedRange(blk.distance[k]))  continue;
+        ru01[0] = blk.r01[0][k];
+        ru01[1] = blk.r01[1][k];
+        ru01[2] = blk.r01[2][k];
+        ru01 /= blk.distance[k];
+        if (!(this->checkConeFilters(ru01)))  continue;
+        BondDataStorage& bes =
+            (blk.summationscale[k] > 0) ? maddbonds : mpopbonds;
+        bes.push_back(BondOp::entryFrom(blk, k));
+    }
+}
+
+
 void BondCalculator::executeParallelMerge(const std::string& pdata)
 {
     istringstream storage(pdata, ios::binary);
@@ -243,9 +383,10 @@ void BondCalculator::finishValue()
             mpopbonds.begin(), mpopbonds.end(),
             mbonds.begin(), BondOp::compare);
     mbonds.erase(last, mbonds.end());
+    if (mbondindexing)  this->updateBondIndex();
     if (mbonds.empty())  mbonds.swap(maddbonds);
     else  BondOp::bmerge(mbonds, maddbonds);
-    mvalue = this->distances();
+    this->distances(mvalue);
     mpopbonds.clear();
     maddbonds.clear();
 }
@@ -255,6 +396,7 @@ void BondCalculator::stashPartialValue()
 {
     mstashedvalue.bonds.swap(mbonds);
     mstashedvalue.popbonds.swap(mpopbonds);
+    mstashedvalue.sitebonds.swap(msitebonds);
     // No need to stash maddbonds as they are evaluated after partial value.
 }
 
@@ -263,8 +405,78 @@ void BondCalculator::restorePartialValue()
 {
     mbonds.swap(mstashedvalue.bonds);
     mpopbonds.swap(mstashedvalue.popbonds);
-    mstashedvalue.bonds.clear();
-    mstashedvalue.popbonds.clear();
+    msitebonds.swap(mstashedvalue.sitebonds);
+    this->clearStashedValue();
+}
+
+
+bool BondCalculator::stashRangeValue()
+{
+    if (mbondsrmin > mbondsrmax)  return false;
+    this->stashPartialValue();
+    mstashedvalue.rmin = mbondsrmin;
+    mstashedvalue.rmax = mbondsrmax;
+    return true;
+}
+
+
+bool BondCalculator::restoreRangeValue(RangeShells& shells)
+{
+    const double& rmin0 = mstashedvalue.rmin;
+    const double& rmax0 = mstashedvalue.rmax;
+    const double& rmin1 = this->getRmin();
+    const double& rmax1 = this->getRmax();
+    // drop the stashed bonds when the range update is abandoned
+    if (rmin1 > rmax0 || rmin0 > rmax1)
+    {
+        this->clearStashedValue();
+        return false;
+    }
+    this->restorePartialValue();
+    // bonds outside of the new r-range are removed in finishValue
+    BondDataStorage::iterator lo, hi;
+    lo = lower_bound(mbonds.begin(), mbonds.end(), rmin1,
+            BondOp::distanceLess);
+    hi = upper_bound(lo, mbonds.end(), rmax1, BondOp::lessDistance);
+    mpopbonds.assign(mbonds.begin(), lo);
+    mpopbonds.insert(mpopbonds.end(), hi, mbonds.end());
+    // the stashed bonds at the shell boundaries are skipped
+    shells.clear();
+    if (rmin1 < rmin0)  shells.push_back(make_pair(rmin1, rmin0));
+    if (rmax1 > rmax0)  shells.push_back(make_pair(rmax0, rmax1));
+    mrangeupdating = true;
+    return true;
+}
+
+
+void BondCalculator::finishRangeUpdate()
+{
+    mrangeupdating = false;
+}
+
+
+void BondCalculator::stashMoveValue()
+{
+    this->PairQuantity::stashMoveValue();
+    mmovevalue.bonds = mbonds;
+    mmovevalue.sitebonds = msitebonds;
+}
+
+
+void BondCalculator::restoreMoveValue()
+{
+    this->PairQuantity::restoreMoveValue();
+    mbonds.swap(mmovevalue.bonds);
+    msitebonds.swap(mmovevalue.sitebonds);
+    this->discardMoveValue();
+}
+
+
+void BondCalculator::discardMoveValue()
+{
+    this->PairQuantity::discardMoveValue();
+    mmovevalue.bonds.clear();
+    mmovevalue.sitebonds.clear();
 }
 
 // Private Methods -----------------------------------------------------------
@@ -275,6 +487,21 @@ int BondCalculator::count() const
 }
 
 
+bool BondCalculator::inStashedRange(double d) const
+{
+    // same test as in BaseBondGenerator
+    return (mstashedvalue.rmin <= d) && (d <= mstashedvalue.rmax);
+}
+
+
+void BondCalculator::clearStashedValue()
+{
+    mstashedvalue.bonds.clear();
+    mstashedvalue.popbonds.clear();
+    mstashedvalue.sitebonds.clear();
+}
+
+
 bool BondCalculator::checkConeFilters(const R3::Vector& ru01) const
 {
     using diffpy::mathutils::eps_eq;
@@ -291,6 +518,76 @@ bool BondCalculator::checkConeFilters(const R3::Vector& ru01) const
     return false;
 }
 
+
+const BondCalculator::BondDataStorage&
+BondCalculator::siteBondsAll(int i, BondDataStorage& scratch) const
+{
+    if (i < 0 || i >= this->countSites())
+    {
+        const char* emsg = "Index out of range.";
+        throw invalid_argument(emsg);
+    }
+    if (mbondindexing)
+    {
+        assert(int(msitebonds.size()) == this->countSites() ||
+                msitebonds.empty());
+        static BondDataStorage nobonds;
+        return (i < int(msitebonds.size())) ? msitebonds[i] : nobonds;
+    }
+    // without index scan all bonds, mbonds are already sorted by distance
+    scratch.clear();
+    BondDataStorage::const_iterator bi = mbonds.begin();
+    for (; bi != mbonds.end(); ++bi)
+    {
+        if (bi->site0 == i)  scratch.push_back(*bi);
+    }
+    return scratch;
+}
+
+
+void BondCalculator::rebuildBondIndex()
+{
+    msitebonds.clear();
+    if (!mbondindexing)  return;
+    msitebonds.resize(this->countSites());
+    BondDataStorage::const_iterator bi = mbonds.begin();
+    for (; bi != mbonds.end(); ++bi)
+    {
+        assert(bi->site0 < int(msitebonds.size()));
+        msitebonds[bi->site0].push_back(*bi);
+    }
+}
+
+
+void BondCalculator::updateBondIndex()
+{
+    // remove popped bonds from the index of their anchor sites
+    BondDataStorage::const_iterator bi;
+    BondDataStorage::iterator pos;
+    for (bi = mpopbonds.begin(); bi != mpopbonds.end(); ++bi)
+    {
+        assert(bi->site0 < int(msitebonds.size()));
+        BondDataStorage& sb = msitebonds[bi->site0];
+        pos = lower_bound(sb.begin(), sb.end(), *bi, BondOp::compare);
+        if (pos != sb.end() && !BondOp::compare(*bi, *pos))  sb.erase(pos);
+    }
+    // site indices are fixed, but the structure may have grown or shrunk
+    msitebonds.resize(this->countSites());
+    // maddbonds are sorted so the new bonds are mostly appended
+    for (bi = maddbonds.begin(); bi != maddbonds.end(); ++bi)
+    {
+        assert(bi->site0 < int(msitebonds.size()));
+        BondDataStorage& sb = msitebonds[bi->site0];
+        if (sb.empty() || !BondOp::compare(*bi, sb.back()))
+        {
+            sb.push_back(*bi);
+            continue;
+        }
+        pos = upper_bound(sb.begin(), sb.end(), *bi, BondOp::compare);
+        sb.insert(pos, *bi);
+    }
+}
+
 }   // namespace srreal
 }   // namespace diffpy
 
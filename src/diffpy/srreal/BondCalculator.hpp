@@ -28,12 +28,39 @@ class BondCalculator : public PairQuantity
 {
     public:
 
+        class BondEntry {
+
+            public:
+
+                double distance;
+                int site0;
+                int site1;
+                double direction0;
+                double direction1;
+                double direction2;
+
+            private:
+
+                friend class boost::serialization::access;
+                template<class Archive>
+                void serialize(Archive& ar, const unsigned int version)
+                {
+                    ar & distance & site0 & site1;
+                    ar & direction0 & direction1 & direction2;
+                }
+
+        };
+
+        typedef std::vector<BondEntry> BondDataStorage;
+
         // constructor
         BondCalculator();
 
         // methods
         template <class T> QuantityType operator()(const T&);
         QuantityType distances() const;
+        /// write bond distances to the caller buffer rv
+        void distances(QuantityType& rv) const;
         std::vector<R3::Vector> directions() const;
         SiteIndices sites0() const;
         SiteIndices sites1() const;
@@ -42,6 +69,20 @@ class BondCalculator : public PairQuantity
         void filterCone(R3::Vector coneaxis, double degrees);
         void filterOff();
 
+        // queries over the calculated bonds
+        /// maintain per-site index of bonds ordered by distance
+        void setBondIndexing(bool flag);
+        /// return true if the per-site bond index is maintained
+        bool getBondIndexing() const;
+        /// bonds anchored at site i with distance in [dmin, dmax]
+        BondDataStorage siteBonds(int i, double dmin, double dmax) const;
+        /// bonds anchored at site i with distance in [dmin, dmax]
+        /// and direction within a cone about coneaxis
+        BondDataStorage siteBondsInCone(int i, double dmin, double dmax,
+                R3::Vector coneaxis, double degrees) const;
+        /// bonds of all sites with distance in [dmin, dmax]
+        BondDataStorage bondsInRange(double dmin, double dmax) const;
+
         // PairQuantity overloads
         virtual std::string getParallelData() const;
 
@@ -50,38 +91,24 @@ class BondCalculator : public PairQuantity
         // PairQuantity overloads
         virtual void resetValue();
         virtual void addPairContribution(const BaseBondGenerator&, int);
+        virtual bool usesBondBlocks() const  { return true; }
+        virtual void addPairContributions(const BondBlock&);
         virtual void executeParallelMerge(const std::string& pdata);
         virtual void finishValue();
 
         // support for PQEvaluatorOptimized
         virtual void stashPartialValue();
         virtual void restorePartialValue();
+        virtual bool stashRangeValue();
+        virtual bool restoreRangeValue(RangeShells& shells);
+        virtual void finishRangeUpdate();
 
-        friend class BondOp;
-        class BondEntry {
-
-            public:
-
-                double distance;
-                int site0;
-                int site1;
-                double direction0;
-                double direction1;
-                double direction2;
-
-            private:
-
-                friend class boost::serialization::access;
-                template<class Archive>
-                void serialize(Archive& ar, const unsigned int version)
-                {
-                    ar & distance & site0 & site1;
-                    ar & direction0 & direction1 & direction2;
-                }
+        // support for trial moves
+        virtual void stashMoveValue();
+        virtual void restoreMoveValue();
+        virtual void discardMoveValue();
 
-        };
-
-        typedef std::vector<BondEntry> BondDataStorage;
+        friend class BondOp;
 
     private:
 
@@ -95,11 +122,28 @@ class BondCalculator : public PairQuantity
             ar & mbonds;
             ar & mfilter_directions;
             ar & mfilter_degrees;
+            if (version >= 1)
+            {
+                ar & mbondindexing;
+            }
+            // r-limits of the loaded bonds are not known and
+            // the bond index is rebuilt from the loaded bonds
+            if (Archive::is_loading::value)
+            {
+                mbondsrmax = -1.0;
+                this->rebuildBondIndex();
+            }
         }
 
         // methods
         int count() const;
+        bool inStashedRange(double d) const;
+        void clearStashedValue();
         bool checkConeFilters(const R3::Vector& ru01) const;
+        const BondDataStorage& siteBondsAll(int i,
+                BondDataStorage& scratch) const;
+        void rebuildBondIndex();
+        void updateBondIndex();
 
         // data
         std::vector<R3::Vector> mfilter_directions;
@@ -107,11 +151,27 @@ class BondCalculator : public PairQuantity
         BondDataStorage mbonds;
         BondDataStorage mpopbonds;
         BondDataStorage maddbonds;
+        // per-site index of bonds sorted by distance
+        bool mbondindexing;
+        std::vector<BondDataStorage> msitebonds;
+        // r-limits of the bonds in mbonds, undefined when rmin > rmax
+        double mbondsrmin;
+        double mbondsrmax;
         // support for PQEvaluatorOptimized
         struct {
             BondDataStorage bonds;
             BondDataStorage popbonds;
+            std::vector<BondDataStorage> sitebonds;
+            double rmin;
+            double rmax;
         } mstashedvalue;
+        // skip the stashed r-range in incremental r-range update
+        bool mrangeupdating;
+        // bonds before the pending trial move
+        struct {
+            BondDataStorage bonds;
+            std::vector<BondDataStorage> sitebonds;
+        } mmovevalue;
 
 };
 
@@ -130,6 +190,7 @@ QuantityType BondCalculator::operator()(const T& stru)
 
 // Serialization -------------------------------------------------------------
 
+BOOST_CLASS_VERSION(diffpy::srreal::BondCalculator, 1)
 BOOST_CLASS_EXPORT_KEY(diffpy::srreal::BondCalculator)
 
 #endif  // BONDCALCULATOR_HPP_INCLUDED
@@ -0,0 +1,111 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class CompiledPairMask -- compact pair mask for the evaluator inner loops
+*
+*****************************************************************************/
+
+#include <cassert>
+
+#include <diffpy/srreal/CompiledPairMask.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+//////////////////////////////////////////////////////////////////////////////
+// class CompiledPairMask
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+CompiledPairMask::CompiledPairMask() :
+    mvalid(false), mdefaultmask(true), mcounttypes(0)
+{ }
+
+// Public Methods ------------------------------------------------------------
+
+void CompiledPairMask::reset(int cntsites, bool defaultmask)
+{
+    mvalid = true;
+    mdefaultmask = defaultmask;
+    msiteflags.assign(cntsites, 0);
+    mexceptions.clear();
+    msitetypes.clear();
+    mcounttypes = 0;
+    mtypematrix.clear();
+}
+
+
+void CompiledPairMask::invalidate()
+{
+    mvalid = false;
+}
+
+
+bool CompiledPairMask::isValid() const
+{
+    return mvalid;
+}
+
+
+void CompiledPairMask::setSiteMask(int i, bool mask)
+{
+    assert(0 <= i && i < int(msiteflags.size()));
+    unsigned char& fi = msiteflags[i];
+    fi |= SITEALL;
+    if (mask)  fi |= SITEALLVALUE;
+    else  fi &= ~SITEALLVALUE;
+}
+
+
+void CompiledPairMask::setPairException(int i, int j, bool mask)
+{
+    assert(0 <= i && i < int(msiteflags.size()));
+    assert(0 <= j && j < int(msiteflags.size()));
+    if (mask == this->getSiteMask(i, j))  return;
+    msiteflags[i] |= SITEEXCEPTION;
+    msiteflags[j] |= SITEEXCEPTION;
+    IndexPair ij = (i > j) ? IndexPair(j, i) : IndexPair(i, j);
+    mexceptions.push_back(ij);
+}
+
+
+void CompiledPairMask::setSiteTypes(const SiteIndices& typeids, int cnttypes)
+{
+    assert(typeids.size() == msiteflags.size());
+    msitetypes = typeids;
+    mcounttypes = cnttypes;
+    mtypematrix.assign(cnttypes * cnttypes, mdefaultmask);
+}
+
+
+void CompiledPairMask::setTypePairMask(int ti, int tj, bool mask)
+{
+    assert(0 <= ti && ti < mcounttypes);
+    assert(0 <= tj && tj < mcounttypes);
+    mtypematrix[ti * mcounttypes + tj] = mask;
+    mtypematrix[tj * mcounttypes + ti] = mask;
+}
+
+
+void CompiledPairMask::finalize()
+{
+    std::sort(mexceptions.begin(), mexceptions.end());
+    mexceptions.erase(std::unique(mexceptions.begin(), mexceptions.end()),
+            mexceptions.end());
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+// End of file
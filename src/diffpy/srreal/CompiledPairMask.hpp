@@ -0,0 +1,138 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class CompiledPairMask -- compact pair mask for the evaluator inner loops
+*
+* The mask is compiled from the pair and type masks in PairQuantity.
+* Index masks use per-site flags for masks set with ALLATOMSINT and a
+* sorted list of exceptional pairs.  Type masks use a matrix over atom
+* type ids.  Lookups need no hashing.
+*
+*****************************************************************************/
+
+#ifndef COMPILEDPAIRMASK_HPP_INCLUDED
+#define COMPILEDPAIRMASK_HPP_INCLUDED
+
+#include <utility>
+#include <algorithm>
+
+#include <diffpy/srreal/forwardtypes.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+class CompiledPairMask
+{
+    public:
+
+        // constructor
+        CompiledPairMask();
+
+        // methods
+        /// start a new mask for cntsites with the default pair mask value
+        void reset(int cntsites, bool defaultmask);
+        /// mark the mask as outdated
+        void invalidate();
+        /// return true if the mask has been compiled since invalidate
+        bool isValid() const;
+        /// apply mask to all pairs with site i
+        void setSiteMask(int i, bool mask);
+        /// mask value of pair i, j given by its site masks
+        bool getSiteMask(int i, int j) const;
+        /// set exceptional mask value for pair i, j
+        void setPairException(int i, int j, bool mask);
+        /// use type matrix with the type id of every site
+        void setSiteTypes(const SiteIndices& typeids, int cnttypes);
+        /// set mask value in the type matrix
+        void setTypePairMask(int ti, int tj, bool mask);
+        /// sort exceptional pairs after they were all added
+        void finalize();
+        /// return mask value for the pair of sites i and j
+        bool operator()(int i, int j) const;
+
+    private:
+
+        // constants
+        enum {
+            SITEALL = 1,
+            SITEALLVALUE = 2,
+            SITEEXCEPTION = 4,
+        };
+
+        // types
+        typedef std::pair<int,int> IndexPair;
+
+        // methods
+        bool lookupException(int i, int j, bool dflt) const;
+
+        // data
+        bool mvalid;
+        bool mdefaultmask;
+        /// flag bits for every site
+        std::vector<unsigned char> msiteflags;
+        /// sorted pairs with i <= j that differ from their site masks
+        std::vector<IndexPair> mexceptions;
+        /// type id of every site when masking by atom types
+        SiteIndices msitetypes;
+        int mcounttypes;
+        std::vector<unsigned char> mtypematrix;
+
+};
+
+// Inline Methods ------------------------------------------------------------
+
+inline
+bool CompiledPairMask::getSiteMask(int i, int j) const
+{
+    const unsigned char& fi = msiteflags[i];
+    const unsigned char& fj = msiteflags[j];
+    const bool hasi = fi & SITEALL;
+    const bool hasj = fj & SITEALL;
+    const bool vi = fi & SITEALLVALUE;
+    const bool vj = fj & SITEALLVALUE;
+    // conflicting site masks are resolved in the exceptions
+    if (hasi && hasj && vi != vj)  return mdefaultmask;
+    return hasi ? vi : hasj ? vj : mdefaultmask;
+}
+
+
+inline
+bool CompiledPairMask::operator()(int i, int j) const
+{
+    if (mcounttypes)
+    {
+        const int k = msitetypes[i] * mcounttypes + msitetypes[j];
+        return mtypematrix[k];
+    }
+    const bool rv = this->getSiteMask(i, j);
+    if (msiteflags[i] & msiteflags[j] & SITEEXCEPTION)
+    {
+        return this->lookupException(i, j, rv);
+    }
+    return rv;
+}
+
+
+inline
+bool CompiledPairMask::lookupException(int i, int j, bool dflt) const
+{
+    IndexPair ij = (i > j) ? IndexPair(j, i) : IndexPair(i, j);
+    const bool found =
+        std::binary_search(mexceptions.begin(), mexceptions.end(), ij);
+    return found ? !dflt : dflt;
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+#endif  // COMPILEDPAIRMASK_HPP_INCLUDED
@@ -21,12 +21,15 @@
 *****************************************************************************/
 
 #include <cassert>
+#include <limits>
 
 #include <diffpy/serialization.ipp>
 #include <diffpy/validators.hpp>
+#include <diffpy/srreal/BondBlock.hpp>
 #include <diffpy/srreal/PointsInSphere.hpp>
 #include <diffpy/srreal/StructureDifference.hpp>
 #include <diffpy/srreal/CrystalStructureAdapter.hpp>
+#include <diffpy/srreal/EvalCounters.hpp>
 
 using namespace std;
 
@@ -46,6 +49,7 @@ const double DEFAULT_SYMMETRY_PRECISION = 5e-5;
 CrystalStructureAdapter::CrystalStructureAdapter() :
     PeriodicStructureAdapter(),
     msymmetry_precision(DEFAULT_SYMMETRY_PRECISION),
+    msymatoms(new std::vector<AtomVector>),
     msymmetry_cached(false)
 { }
 
@@ -70,7 +74,7 @@ BaseBondGeneratorPtr CrystalStructureAdapter::createBondGenerator() const
 int CrystalStructureAdapter::siteMultiplicity(int idx) const
 {
     if (!this->isSymmetryCached())  this->updateSymmetryPositions();
-    int rv = msymatoms[idx].size();
+    int rv = (*msymatoms)[idx].size();
     return rv;
 }
 
@@ -148,7 +152,7 @@ CrystalStructureAdapter::getEquivalentAtoms(int idx) const
 {
     assert(0 <= idx && idx < this->countSites());
     if (!this->isSymmetryCached())  this->updateSymmetryPositions();
-    return msymatoms[idx];
+    return (*msymatoms)[idx];
 }
 
 
@@ -214,17 +218,21 @@ void CrystalStructureAdapter::updateSymmetryPositions() const
     AtomVector lcatoms(this->begin(), this->end());
     AtomVector::iterator lcai = lcatoms.begin();
     for (; lcai != lcatoms.end(); ++lcai)  this->toFractional(*lcai);
-    // build symmetry positions for all atoms in the asymmetric unit
-    msymatoms.resize(this->countSites());
-    assert(lcatoms.size() == msymatoms.size());
+    // build symmetry positions for all atoms in the asymmetric unit.
+    // Use a new container, because the old one may be shared with clones.
+    boost::shared_ptr<std::vector<AtomVector> >
+        symatoms(new std::vector<AtomVector>(this->countSites()));
+    assert(lcatoms.size() == symatoms->size());
     lcai = lcatoms.begin();
-    std::vector<AtomVector>::iterator saii = msymatoms.begin();
+    std::vector<AtomVector>::iterator saii = symatoms->begin();
     for (; lcai != lcatoms.end(); ++lcai, ++saii)
     {
         *saii = this->expandLatticeAtom(*lcai);
+        DIFFPY_EVAL_COUNT(SYMMETRY_IMAGES, saii->size());
         iterator ai = saii->begin();
         for (; ai != saii->end(); ++ai)  this->toCartesian(*ai);
     }
+    msymatoms = symatoms;
     msymmetry_cached = true;
 }
 
@@ -251,7 +259,7 @@ int CrystalStructureAdapter::findEqualPosition(
 bool CrystalStructureAdapter::isSymmetryCached() const
 {
     msymmetry_cached = msymmetry_cached &&
-        (int(msymatoms.size()) == this->countSites());
+        (int(msymatoms->size()) == this->countSites());
     return msymmetry_cached;
 }
 
@@ -288,12 +296,69 @@ CrystalStructureBondGenerator::CrystalStructureBondGenerator(
 {
     mcstructure = dynamic_cast<const CrystalStructureAdapter*>(adpt.get());
     assert(mcstructure);
+    // symmetry positions are iterated over the sphere lattice points
+    mcelllistenabled = false;
     msymidx = 0;
     mpuc1 = &(R3::zeromatrix());
+    morbitsize = 1;
+    msymmetryexact = -1;
 }
 
 // Public Methods ------------------------------------------------------------
 
+void CrystalStructureBondGenerator::rewind()
+{
+    mstabilizer.clear();
+    morbitsize = 1;
+    if (this->getSymmetryReduction() && mcstructure->countSites())
+    {
+        if (msymmetryexact < 0)  msymmetryexact = this->isSymmetryExact();
+        if (msymmetryexact)  this->findStabilizer(this->site0(), mstabilizer);
+        // there is nothing to gain for a trivial stabilizer
+        if (mstabilizer.size() < 2)  mstabilizer.clear();
+    }
+    this->PeriodicStructureBondGenerator::rewind();
+}
+
+
+int CrystalStructureBondGenerator::fillBlock(BondBlock& blk)
+{
+    if (!mdirectfillenabled)  return this->BaseBondGenerator::fillBlock(blk);
+    const int cnt0 = blk.count;
+    if (this->finished())  return 0;
+    const int mult0 = this->BaseBondGenerator::multiplicity();
+    const Lattice& L = mpstructure->getLattice();
+    while (!blk.full())
+    {
+        blk.append(msite_anchor, *msite_current, mdistance, mr01,
+                mult0 * morbitsize);
+        // step over the sphere points, then over the symmetry positions
+        // of the current site, then over the sites
+        while (true)
+        {
+            msphere->next();
+            if (msphere->finished())
+            {
+                if (++msymidx >= this->symatoms(*msite_current).size())
+                {
+                    if (++msite_current >= msite_last)  break;
+                    msymidx = 0;
+                }
+                msphere->rewind();
+            }
+            mrcsphere = msphere->finished() ? R3::zerovector :
+                L.cartesian(msphere->mno());
+            this->CrystalStructureBondGenerator::updater1();
+            if (this->bondInRange())  break;
+            DIFFPY_EVAL_TALLY(++mtallyrejected);
+        }
+        if (this->finished())  break;
+        DIFFPY_EVAL_TALLY(++mtallyaccepted);
+    }
+    return blk.count - cnt0;
+}
+
+
 void CrystalStructureBondGenerator::selectAnchorSite(int anchor)
 {
     this->BaseBondGenerator::selectAnchorSite(anchor);
@@ -302,6 +367,13 @@ void CrystalStructureBondGenerator::selectAnchorSite(int anchor)
 }
 
 
+int CrystalStructureBondGenerator::multiplicity() const
+{
+    int rv = this->BaseBondGenerator::multiplicity() * morbitsize;
+    return rv;
+}
+
+
 const R3::Matrix& CrystalStructureBondGenerator::Ucartesian1() const
 {
     return *mpuc1;
@@ -350,6 +422,15 @@ void CrystalStructureBondGenerator::updater1()
     mr1 = mrcsphere + sa[msymidx].xyz_cartn;
     mpuc1 = &(sa[msymidx].uij_cartn);
     this->updateDistance();
+    // skip bonds that are not the first in their stabilizer orbit
+    using diffpy::mathutils::eps_eq;
+    if (mstabilizer.empty())  return;
+    const bool inrange = (this->getRmin() <= mdistance) &&
+        (mdistance <= this->getRmax()) && !eps_eq(mdistance, 0.0);
+    if (inrange && !this->isOrbitRepresentative())
+    {
+        mdistance = numeric_limits<double>::max();
+    }
 }
 
 // Private Methods -----------------------------------------------------------
@@ -357,8 +438,83 @@ void CrystalStructureBondGenerator::updater1()
 const CrystalStructureAdapter::AtomVector&
 CrystalStructureBondGenerator::symatoms(int idx)
 {
-    assert(0 <= idx && idx < int(mcstructure->msymatoms.size()));
-    return mcstructure->msymatoms[idx];
+    assert(0 <= idx && idx < int(mcstructure->msymatoms->size()));
+    return (*mcstructure->msymatoms)[idx];
+}
+
+
+void CrystalStructureBondGenerator::findStabilizer(
+        int idx, vector<R3::Matrix>& rots)
+{
+    using diffpy::mathutils::EpsilonEqual;
+    const Lattice& L = mcstructure->getLattice();
+    const double symeps = mcstructure->getSymmetryPrecision();
+    const EpsilonEqual allclose;
+    const R3::Vector f0 = L.fractional(this->symatoms(idx)[0].xyz_cartn);
+    rots.assign(1, R3::identity());
+    R3::Vector df;
+    CrystalStructureAdapter::SymOpVector::const_iterator op;
+    op = mcstructure->msymops.begin();
+    for (; op != mcstructure->msymops.end(); ++op)
+    {
+        df = R3::mxvecproduct(op->R, f0) + op->t - f0;
+        for (int k = 0; k < R3::Ndim; ++k)  df[k] -= round(df[k]);
+        if (L.norm(df) > symeps)  continue;
+        // rotation acting on Cartesian row vectors
+        R3::Matrix Rc = R3::prod(L.recbase(),
+                R3::Matrix(R3::prod(R3::trans(op->R), L.base())));
+        // the lattice may not conform to the symmetry
+        R3::Matrix RRt = R3::prod(Rc, R3::trans(Rc));
+        if (!allclose(RRt, R3::identity()))  continue;
+        vector<R3::Matrix>::const_iterator ri = rots.begin();
+        for (; ri != rots.end(); ++ri)  if (allclose(*ri, Rc))  break;
+        if (ri == rots.end())  rots.push_back(Rc);
+    }
+}
+
+
+bool CrystalStructureBondGenerator::isSymmetryExact()
+{
+    using diffpy::mathutils::EpsilonEqual;
+    const EpsilonEqual allclose;
+    vector<R3::Matrix> rots;
+    for (int i = 0; i < mcstructure->countSites(); ++i)
+    {
+        const Atom& a0 = this->symatoms(i)[0];
+        const R3::Matrix& U0 = mstructure->siteCartesianUij(i);
+        if (!allclose(a0.uij_cartn, U0))  return false;
+        // displacement parameters must conform to the site symmetry
+        this->findStabilizer(i, rots);
+        vector<R3::Matrix>::const_iterator ri = rots.begin();
+        for (; ri != rots.end(); ++ri)
+        {
+            R3::Matrix RU = R3::prod(R3::trans(*ri), U0);
+            R3::Matrix RUR = R3::prod(RU, *ri);
+            if (!allclose(RUR, U0))  return false;
+        }
+    }
+    return true;
+}
+
+
+bool CrystalStructureBondGenerator::isOrbitRepresentative()
+{
+    const double symeps = mcstructure->getSymmetryPrecision();
+    int cntfixed = 0;
+    R3::Vector w;
+    vector<R3::Matrix>::const_iterator ri = mstabilizer.begin();
+    for (; ri != mstabilizer.end(); ++ri)
+    {
+        w = R3::mxvecproduct(mr01, *ri);
+        // compare w with mr01 in lexical order
+        int k = 0;
+        for (; k < R3::Ndim && fabs(w[k] - mr01[k]) <= symeps; ++k)  { }
+        if (k == R3::Ndim)  ++cntfixed;
+        else if (w[k] < mr01[k])  return false;
+    }
+    assert(cntfixed > 0);
+    morbitsize = mstabilizer.size() / cntfixed;
+    return true;
 }
 
 }   // namespace srreal
@@ -99,7 +99,8 @@ class CrystalStructureAdapter : public PeriodicStructureAdapter
         /// array of symmetry operations
         SymOpVector msymops;
         double msymmetry_precision;
-        mutable std::vector<AtomVector> msymatoms;
+        /// symmetry expanded atoms, shared with the clones
+        mutable boost::shared_ptr<const std::vector<AtomVector> > msymatoms;
         mutable bool msymmetry_cached;
 
         // symmetry helpers
@@ -117,15 +118,30 @@ class CrystalStructureAdapter : public PeriodicStructureAdapter
         // serialization
         friend class boost::serialization::access;
         template<class Archive>
-            void serialize(Archive& ar, const unsigned int version)
+            void save(Archive& ar, const unsigned int version) const
+        {
+            ar & boost::serialization::base_object<PeriodicStructureAdapter>(*this);
+            ar & msymops;
+            ar & msymmetry_precision;
+            ar & *msymatoms;
+            ar & msymmetry_cached;
+        }
+
+        template<class Archive>
+            void load(Archive& ar, const unsigned int version)
         {
             ar & boost::serialization::base_object<PeriodicStructureAdapter>(*this);
             ar & msymops;
             ar & msymmetry_precision;
-            ar & msymatoms;
+            boost::shared_ptr<std::vector<AtomVector> >
+                symatoms(new std::vector<AtomVector>);
+            ar & *symatoms;
+            msymatoms = symatoms;
             ar & msymmetry_cached;
         }
 
+        BOOST_SERIALIZATION_SPLIT_MEMBER()
+
 };
 
 
@@ -144,10 +160,16 @@ class CrystalStructureBondGenerator : public PeriodicStructureBondGenerator
         // constructors
         CrystalStructureBondGenerator(StructureAdapterConstPtr);
 
+        // methods
+        // loop control
+        virtual void rewind();
+        virtual int fillBlock(BondBlock& blk);
+
         // configuration
         virtual void selectAnchorSite(int);
 
         // data access
+        virtual int multiplicity() const;
         virtual const R3::Matrix& Ucartesian1() const;
 
     protected:
@@ -162,13 +184,25 @@ class CrystalStructureBondGenerator : public PeriodicStructureBondGenerator
         const CrystalStructureAdapter* mcstructure;
         size_t msymidx;
         const R3::Matrix* mpuc1;
+        /// Cartesian rotations of the anchor site-stabilizer group
+        std::vector<R3::Matrix> mstabilizer;
+        /// number of bonds equivalent to the current bond
+        int morbitsize;
 
     private:
 
         typedef CrystalStructureAdapter::AtomVector AtomVector;
 
+        // data
+        /// 1 if symmetry reduction gives exact results, 0 if not,
+        /// -1 when not yet checked
+        int msymmetryexact;
+
         // methods
         const AtomVector& symatoms(int idx);
+        void findStabilizer(int idx, std::vector<R3::Matrix>& rots);
+        bool isSymmetryExact();
+        bool isOrbitRepresentative();
 
 };
 
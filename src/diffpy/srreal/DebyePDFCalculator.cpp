@@ -275,15 +275,18 @@ void DebyePDFCalculator::configureBondGenerator(BaseBondGenerator& bnds) const
 {
     bnds.setRmin(this->rcalclo());
     bnds.setRmax(this->rcalchi());
+    // pair contributions depend only on distance and msd
+    bnds.setSymmetryReduction(true);
 }
 
 
 double DebyePDFCalculator::sfSiteAtQ(int siteidx, const double& Q) const
 {
     const ScatteringFactorTablePtr& sftable = this->getScatteringFactorTable();
-    const string& smbl = mstructure->siteAtomType(siteidx);
-    const double occupancy = mstructure->siteOccupancy(siteidx);
-    double rv = sftable->lookup(smbl, Q) * occupancy;
+    const PackedStructureView& sv = this->getPackedView();
+    const int tid = sv.siteAtomTypeId(siteidx);
+    const double occupancy = sv.siteOccupancy(siteidx);
+    double rv = sftable->lookup(tid, Q) * occupancy;
     return rv;
 }
 
@@ -299,7 +302,10 @@ QuantityType DebyePDFCalculator::getPDFAtQmin(double qmin) const
     fill(fpad.begin(), fpad.begin() + nqmin, 0.0);
     int nfromdr = int(ceil(M_PI / this->getRstep() / this->getQstep()));
     if (nfromdr > int(fpad.size()))  fpad.resize(nfromdr, 0.0);
+    // count the transform with the last evaluation
+    mevalcounters.resumeRecording();
     QuantityType gpad = fftftog(fpad, this->getQstep());
+    mevalcounters.stopRecording();
     const double drpad = M_PI / (gpad.size() * this->getQstep());
     QuantityType rgrid = this->getRgrid();
     QuantityType pdf0(rgrid.size());
@@ -0,0 +1,198 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class EvalCounters -- work counters and optional timers of one
+*     PairQuantity evaluation
+*
+*****************************************************************************/
+
+#include <chrono>
+#include <cassert>
+#include <algorithm>
+
+#include <diffpy/srreal/EvalCounters.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+// Local Helpers -------------------------------------------------------------
+
+namespace {
+
+#ifdef DIFFPY_HAS_EVAL_COUNTERS
+
+/// running totals of the calling thread
+thread_local long long gtotals[EvalCounters::NCOUNTERS];
+
+
+double steadySeconds()
+{
+    using namespace std::chrono;
+    duration<double> t = steady_clock::now().time_since_epoch();
+    return t.count();
+}
+
+#endif  // DIFFPY_HAS_EVAL_COUNTERS
+
+}   // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// class EvalCounters
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+EvalCounters::EvalCounters() :
+    mtimersenabled(false),
+    mlaptime(0.0),
+    mrecording(false),
+    mresumed(false)
+{
+    this->clear();
+}
+
+// Public Methods ------------------------------------------------------------
+
+bool EvalCounters::enabled()
+{
+#ifdef DIFFPY_HAS_EVAL_COUNTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+const char* EvalCounters::counterName(Counter c)
+{
+    static const char* names[NCOUNTERS] = {
+        "bonds_visited",
+        "bonds_accepted",
+        "sphere_points",
+        "symmetry_images",
+        "pair_contributions",
+        "grid_points",
+        "fft_calls",
+        "fft_points",
+        "full_recomputes",
+        "fast_updates",
+        "range_updates",
+        "checks",
+        "check_mismatches",
+    };
+    assert(0 <= c && c < NCOUNTERS);
+    return names[c];
+}
+
+
+const char* EvalCounters::timerName(Timer tm)
+{
+    static const char* names[NTIMERS] = {
+        "pair_sum_time",
+        "finish_time",
+    };
+    assert(0 <= tm && tm < NTIMERS);
+    return names[tm];
+}
+
+
+void EvalCounters::add(Counter c, long long n)
+{
+#ifdef DIFFPY_HAS_EVAL_COUNTERS
+    gtotals[c] += n;
+#endif
+}
+
+
+long long EvalCounters::count(Counter c) const
+{
+    assert(0 <= c && c < NCOUNTERS);
+    return mcounts[c];
+}
+
+
+double EvalCounters::seconds(Timer tm) const
+{
+    assert(0 <= tm && tm < NTIMERS);
+    return mseconds[tm];
+}
+
+
+void EvalCounters::setTimersEnabled(bool flag)
+{
+    mtimersenabled = flag;
+}
+
+
+bool EvalCounters::getTimersEnabled() const
+{
+    return mtimersenabled;
+}
+
+
+void EvalCounters::clear()
+{
+    std::fill(mcounts, mcounts + NCOUNTERS, 0);
+    std::fill(mseconds, mseconds + NTIMERS, 0.0);
+}
+
+
+void EvalCounters::startRecording()
+{
+#ifdef DIFFPY_HAS_EVAL_COUNTERS
+    // use the counts slots for the starting totals until stopRecording
+    std::copy(gtotals, gtotals + NCOUNTERS, mcounts);
+    std::fill(mseconds, mseconds + NTIMERS, 0.0);
+    if (mtimersenabled)  mlaptime = steadySeconds();
+    mrecording = true;
+    mresumed = false;
+#endif
+}
+
+
+void EvalCounters::lapTimer(Timer tm)
+{
+#ifdef DIFFPY_HAS_EVAL_COUNTERS
+    if (!mtimersenabled)  return;
+    const double t = steadySeconds();
+    mseconds[tm] += t - mlaptime;
+    mlaptime = t;
+#endif
+}
+
+
+void EvalCounters::stopRecording()
+{
+#ifdef DIFFPY_HAS_EVAL_COUNTERS
+    if (!mrecording)  return;
+    for (int i = 0; i < NCOUNTERS; ++i)  mcounts[i] = gtotals[i] - mcounts[i];
+    mrecording = false;
+#endif
+}
+
+
+void EvalCounters::resumeRecording()
+{
+#ifdef DIFFPY_HAS_EVAL_COUNTERS
+    if (mrecording || mresumed)  return;
+    // shift the starting totals so that stopRecording adds to the counts
+    for (int i = 0; i < NCOUNTERS; ++i)  mcounts[i] = gtotals[i] - mcounts[i];
+    mrecording = true;
+    mresumed = true;
+#endif
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+// End of file
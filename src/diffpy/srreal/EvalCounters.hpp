@@ -0,0 +1,139 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class EvalCounters -- work counters and optional timers of one
+*     PairQuantity evaluation
+*
+* The hot paths add to per-thread running totals with the
+* DIFFPY_EVAL_COUNT macro.  PairQuantity::eval records the change of the
+* totals over the evaluation.  Counters cost one addition per event or
+* less, because the tight loops accumulate in local variables with
+* DIFFPY_EVAL_TALLY and flush them once.  Both macros and the timers are
+* compiled out when the library is built with eval_counters=False.
+*
+*****************************************************************************/
+
+#ifndef EVALCOUNTERS_HPP_INCLUDED
+#define EVALCOUNTERS_HPP_INCLUDED
+
+#include <diffpy/features.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+class EvalCounters
+{
+    public:
+
+        // types
+        enum Counter {
+            /// candidate pairs inspected by the bond generators
+            BONDS_VISITED,
+            /// pairs within the rmin, rmax range
+            BONDS_ACCEPTED,
+            /// lattice points generated by PointsInSphere
+            SPHERE_POINTS,
+            /// symmetry equivalent sites expanded in CrystalStructureAdapter
+            SYMMETRY_IMAGES,
+            /// bonds passed to the pair quantity by the evaluators
+            PAIR_CONTRIBUTIONS,
+            /// grid points of the drawn PDF peaks
+            GRID_POINTS,
+            /// number of fast Fourier transforms
+            FFT_CALLS,
+            /// sum of the complex array lengths of the transforms
+            FFT_POINTS,
+            /// evaluations summed over all pairs
+            FULL_RECOMPUTES,
+            /// OPTIMIZED evaluations updated from the changed sites
+            FAST_UPDATES,
+            /// OPTIMIZED evaluations updated from the changed r-range shells
+            RANGE_UPDATES,
+            /// fast updates compared with the BASIC value in CHECK mode
+            CHECKS,
+            /// checked fast updates that disagreed with the BASIC value
+            CHECK_MISMATCHES,
+            NCOUNTERS
+        };
+
+        enum Timer {
+            /// time spent in the evaluator summation over pairs
+            PAIR_SUM_TIME,
+            /// time spent in finishValue, e.g., in the PDF corrections
+            FINISH_TIME,
+            NTIMERS
+        };
+
+        // constructor
+        EvalCounters();
+
+        // methods
+        /// return true if the library was compiled with the counters
+        static bool enabled();
+        static const char* counterName(Counter);
+        static const char* timerName(Timer);
+        /// add n to the running total of the calling thread
+        static void add(Counter, long long n);
+        /// count of the last evaluation including the work recorded
+        /// in the first result query, for example the FFT in
+        /// PDFCalculator::getPDF
+        long long count(Counter) const;
+        /// duration in seconds, zero unless timers are enabled
+        double seconds(Timer) const;
+        /// timers are off by default as they query the system clock
+        void setTimersEnabled(bool);
+        bool getTimersEnabled() const;
+        void clear();
+
+        // recording of one evaluation
+        /// save the running totals and start the timer
+        void startRecording();
+        /// add elapsed time to timer tm and restart the timer
+        void lapTimer(Timer tm);
+        /// store the difference of the running totals
+        void stopRecording();
+        /// continue recording, the new counts are added to the old.
+        /// Recording is resumed only once per evaluation so that
+        /// repeated queries of the same result are not counted again.
+        void resumeRecording();
+
+    private:
+
+        // data
+        long long mcounts[NCOUNTERS];
+        double mseconds[NTIMERS];
+        bool mtimersenabled;
+        double mlaptime;
+        bool mrecording;
+        bool mresumed;
+};
+
+}   // namespace srreal
+}   // namespace diffpy
+
+// Macros --------------------------------------------------------------------
+
+#ifdef DIFFPY_HAS_EVAL_COUNTERS
+/// add n to counter c, for example DIFFPY_EVAL_COUNT(GRID_POINTS, n)
+#define DIFFPY_EVAL_COUNT(c, n) \
+    ::diffpy::srreal::EvalCounters::add( \
+            ::diffpy::srreal::EvalCounters::c, (n))
+/// evaluate expression used only for counting
+#define DIFFPY_EVAL_TALLY(expr)  (expr)
+#else
+// sizeof keeps the operands referenced, but never evaluated
+#define DIFFPY_EVAL_COUNT(c, n)  ((void) sizeof(n))
+#define DIFFPY_EVAL_TALLY(expr)  ((void) sizeof(expr))
+#endif
+
+#endif  // EVALCOUNTERS_HPP_INCLUDED
@@ -0,0 +1,375 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class MultiPhasePDFCalculator -- sum of PDFs from several phases on one
+*     shared r-grid with a single Q-range termination
+*
+*****************************************************************************/
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include <diffpy/srreal/MultiPhasePDFCalculator.hpp>
+#include <diffpy/srreal/PDFUtils.hpp>
+#include <diffpy/serialization.hpp>
+#include <diffpy/validators.hpp>
+#include <diffpy/mathutils.hpp>
+
+using namespace std;
+
+namespace diffpy {
+namespace srreal {
+
+using namespace diffpy::validators;
+using diffpy::mathutils::DOUBLE_MAX;
+using diffpy::mathutils::eps_lt;
+
+//////////////////////////////////////////////////////////////////////////////
+// class MultiPhasePDFCalculator
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+MultiPhasePDFCalculator::MultiPhasePDFCalculator() :
+    mrmin(0.0),
+    mrmax(DEFAULT_PDFCALCULATOR_RMAX),
+    mrstep(DEFAULT_PDFCALCULATOR_RSTEP),
+    mqmin(0.0),
+    mqmax(DOUBLE_MAX),
+    mmaxextension(DEFAULT_PDFCALCULATOR_MAXEXTENSION)
+{ }
+
+// Public Methods ------------------------------------------------------------
+
+// phases
+
+void MultiPhasePDFCalculator::addPhase(
+        PDFCalculatorPtr pdfc, StructureAdapterPtr stru)
+{
+    if (!pdfc)
+    {
+        const char* emsg = "Phase calculator must be defined.";
+        throw invalid_argument(emsg);
+    }
+    this->configurePhase(*pdfc);
+    pdfc->setStructure(stru);
+    mphases.push_back(pdfc);
+}
+
+
+int MultiPhasePDFCalculator::countPhases() const
+{
+    return mphases.size();
+}
+
+
+PDFCalculator& MultiPhasePDFCalculator::getPhase(int idx)
+{
+    this->ensurePhaseIndex(idx);
+    return *(mphases[idx]);
+}
+
+
+const PDFCalculator& MultiPhasePDFCalculator::getPhase(int idx) const
+{
+    this->ensurePhaseIndex(idx);
+    return *(mphases[idx]);
+}
+
+
+void MultiPhasePDFCalculator::clearPhases()
+{
+    mphases.clear();
+}
+
+// evaluation
+
+void MultiPhasePDFCalculator::eval()
+{
+    for (PDFCalculatorPtr& ph : mphases)
+    {
+        this->configurePhase(*ph);
+        ph->eval();
+    }
+}
+
+
+void MultiPhasePDFCalculator::setupParallelRun(int cpuindex, int ncpu)
+{
+    for (PDFCalculatorPtr& ph : mphases)  ph->setupParallelRun(cpuindex, ncpu);
+}
+
+
+string MultiPhasePDFCalculator::getParallelData() const
+{
+    vector<string> phasedata;
+    for (const PDFCalculatorPtr& ph : mphases)
+    {
+        phasedata.push_back(ph->getParallelData());
+    }
+    ostringstream storage(ios::binary);
+    diffpy::serialization::oarchive oa(storage, ios::binary);
+    oa << phasedata;
+    return storage.str();
+}
+
+
+void MultiPhasePDFCalculator::mergeParallelData(
+        const string& pdata, int ncpu)
+{
+    istringstream storage(pdata, ios::binary);
+    diffpy::serialization::iarchive ia(storage, ios::binary);
+    vector<string> phasedata;
+    ia >> phasedata;
+    if (phasedata.size() != mphases.size())
+    {
+        const char* emsg = "Parallel data must have one entry per phase.";
+        throw invalid_argument(emsg);
+    }
+    for (size_t i = 0; i < mphases.size(); ++i)
+    {
+        this->configurePhase(*mphases[i]);
+        mphases[i]->mergeParallelData(phasedata[i], ncpu);
+    }
+}
+
+// results
+
+QuantityType MultiPhasePDFCalculator::getPDF() const
+{
+    if (mphases.empty())  return QuantityType();
+    // union of the extended r-grids of all phases
+    int kmin = mphases.front()->extendedRminSteps();
+    int kmax = mphases.front()->extendedRmaxSteps();
+    for (const PDFCalculatorPtr& ph : mphases)
+    {
+        kmin = min(kmin, ph->extendedRminSteps());
+        kmax = max(kmax, ph->extendedRmaxSteps());
+    }
+    QuantityType rgrid_ext(kmax - kmin);
+    for (int k = kmin; k < kmax; ++k)  rgrid_ext[k - kmin] = k * mrstep;
+    // phases with constant envelopes are summed before one termination,
+    // the others are terminated before their envelopes as in PDFCalculator
+    const int krmin = pdfutils_rminSteps(this);
+    const int krmax = pdfutils_rmaxSteps(this);
+    QuantityType pdf(krmax - krmin, 0.0);
+    QuantityType pdf_ext(rgrid_ext.size(), 0.0);
+    bool hasshared = false;
+    for (const PDFCalculatorPtr& ph : mphases)
+    {
+        double sc;
+        if (!this->envelopeScale(*ph, rgrid_ext, sc))
+        {
+            const QuantityType pdfph = ph->getPDF();
+            assert(pdfph.size() == pdf.size());
+            for (size_t i = 0; i < pdf.size(); ++i)  pdf[i] += pdfph[i];
+            continue;
+        }
+        const QuantityType pdfph = this->unterminatedPDF(*ph, kmin, rgrid_ext);
+        for (size_t i = 0; i < pdf_ext.size(); ++i)
+        {
+            pdf_ext[i] += sc * pdfph[i];
+        }
+        hasshared = true;
+    }
+    if (hasshared)
+    {
+        const QuantityType pdf1 = this->terminatePDF(pdf_ext, kmin);
+        assert(kmin <= krmin && krmax <= kmax);
+        for (int k = krmin; k < krmax; ++k)
+        {
+            pdf[k - krmin] += pdf1[k - kmin];
+        }
+    }
+    QuantityType rv = this->applyEnvelopes(this->getRgrid(), pdf);
+    return rv;
+}
+
+
+QuantityType MultiPhasePDFCalculator::getRgrid() const
+{
+    if (mphases.empty())  return QuantityType();
+    return pdfutils_getRgrid(this);
+}
+
+// shared r-grid and Q-range configuration
+
+void MultiPhasePDFCalculator::setRmin(double rmin)
+{
+    ensureNonNegative("Rmin", rmin);
+    mrmin = rmin;
+}
+
+
+const double& MultiPhasePDFCalculator::getRmin() const
+{
+    return mrmin;
+}
+
+
+void MultiPhasePDFCalculator::setRmax(double rmax)
+{
+    ensureNonNegative("Rmax", rmax);
+    mrmax = rmax;
+}
+
+
+const double& MultiPhasePDFCalculator::getRmax() const
+{
+    return mrmax;
+}
+
+
+void MultiPhasePDFCalculator::setRstep(double rstep)
+{
+    ensureEpsilonPositive("Rstep", rstep);
+    mrstep = rstep;
+}
+
+
+const double& MultiPhasePDFCalculator::getRstep() const
+{
+    return mrstep;
+}
+
+
+void MultiPhasePDFCalculator::setQmin(double qmin)
+{
+    ensureNonNegative("Qmin", qmin);
+    mqmin = qmin;
+}
+
+
+const double& MultiPhasePDFCalculator::getQmin() const
+{
+    return mqmin;
+}
+
+
+void MultiPhasePDFCalculator::setQmax(double qmax)
+{
+    ensureNonNegative("Qmax", qmax);
+    mqmax = (qmax > 0.0) ? qmax : DOUBLE_MAX;
+}
+
+
+const double& MultiPhasePDFCalculator::getQmax() const
+{
+    return mqmax;
+}
+
+
+void MultiPhasePDFCalculator::setMaxExtension(double maxextension)
+{
+    ensureNonNegative("maxextension", maxextension);
+    mmaxextension = maxextension;
+}
+
+
+const double& MultiPhasePDFCalculator::getMaxExtension() const
+{
+    return mmaxextension;
+}
+
+// Private Methods -----------------------------------------------------------
+
+void MultiPhasePDFCalculator::ensurePhaseIndex(int idx) const
+{
+    if (idx < 0 || idx >= this->countPhases())
+    {
+        const char* emsg = "Phase index out of range.";
+        throw out_of_range(emsg);
+    }
+}
+
+
+void MultiPhasePDFCalculator::configurePhase(PDFCalculator& pdfc) const
+{
+    pdfc.setRstep(mrstep);
+    pdfc.setRmin(mrmin);
+    pdfc.setRmax(mrmax);
+    pdfc.setQmin(mqmin);
+    pdfc.setQmax(mqmax);
+    pdfc.setMaxExtension(mmaxextension);
+}
+
+
+bool MultiPhasePDFCalculator::envelopeScale(const PDFCalculator& pdfc,
+        const QuantityType& rgrid_ext, double& sc) const
+{
+    const QuantityType ones(rgrid_ext.size(), 1.0);
+    const QuantityType env = pdfc.applyEnvelopes(rgrid_ext, ones);
+    sc = env.empty() ? 1.0 : env.front();
+    for (const double& e : env)
+    {
+        if (e != sc)  return false;
+    }
+    return true;
+}
+
+
+QuantityType MultiPhasePDFCalculator::unterminatedPDF(
+        const PDFCalculator& pdfc, int kmin,
+        const QuantityType& rgrid_ext) const
+{
+    // the points outside of the phase extended grid stay at zero RDF
+    const QuantityType rdfph = pdfc.getExtendedRDF();
+    const int offset = pdfc.extendedRminSteps() - kmin;
+    QuantityType rdfperr(rgrid_ext.size(), 0.0);
+    for (size_t i = 0; i < rdfperr.size(); ++i)
+    {
+        const int j = int(i) - offset;
+        const bool inrange = (0 <= j && j < int(rdfph.size()));
+        const double& r = rgrid_ext[i];
+        if (inrange && r > 0.0)  rdfperr[i] = rdfph[j] / r;
+    }
+    QuantityType rv = pdfc.applyBaseline(rgrid_ext, rdfperr);
+    return rv;
+}
+
+
+QuantityType MultiPhasePDFCalculator::terminatePDF(
+        const QuantityType& pdf_ext, int kmin) const
+{
+    // replicate PDFCalculator::terminateExtendedPDF on the union grid
+    const double qmax = min(mqmax, M_PI / mrstep);
+    const int kmax = kmin + int(pdf_ext.size());
+    const int npad = (kmax > 0) ? (1 << int(ceil(log2(kmax)))) : 0;
+    const double qstep = (npad > 0) ? M_PI / (npad * mrstep) : 0.0;
+    const int kqmin = pdfutils_qminSteps(mqmin, qstep);
+    const bool skipfft = !eps_lt(qmax, M_PI / mrstep) && !(1 < kqmin);
+    if (skipfft)  return pdf_ext;
+    QuantityType f_ext = fftgtof(pdf_ext, mrstep, kmin * mrstep);
+    assert(int(f_ext.size()) == npad);
+    // zero all F points at Q < Qmin and at Q >= Qmax
+    const int kqmax = (qstep > 0.0) ? int(ceil(qmax / qstep)) : 0;
+    assert(kqmax <= int(f_ext.size()));
+    fill(f_ext.begin(), f_ext.begin() + min(kqmin, int(f_ext.size())), 0.0);
+    fill(f_ext.begin() + kqmax, f_ext.end(), 0.0);
+    QuantityType pdf1 = fftftog(f_ext, qstep);
+    // cut away the FFT padded points
+    assert(kmax <= int(pdf1.size()));
+    pdf1.erase(pdf1.begin() + kmax, pdf1.end());
+    pdf1.erase(pdf1.begin(), pdf1.begin() + kmin);
+    return pdf1;
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+// End of file
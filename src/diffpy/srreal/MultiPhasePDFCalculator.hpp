@@ -0,0 +1,112 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class MultiPhasePDFCalculator -- sum of PDFs from several phases on one
+*     shared r-grid with a single Q-range termination
+*
+* Every phase is a PDFCalculator with its own structure, peak widths,
+* scattering factors, baseline and envelopes.  Phases with constant
+* envelopes are scaled, summed on the union of the phase extended r-grids
+* and terminated in one pair of FFTs.  Phases with r-dependent envelopes
+* do not commute with the termination and contribute their own getPDF.
+* The composite envelopes are applied to the sum, for example a shared
+* instrument resolution.
+*
+*****************************************************************************/
+
+#ifndef MULTIPHASEPDFCALCULATOR_HPP_INCLUDED
+#define MULTIPHASEPDFCALCULATOR_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include <diffpy/srreal/PDFCalculator.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+typedef boost::shared_ptr<PDFCalculator> PDFCalculatorPtr;
+
+class MultiPhasePDFCalculator : public PDFEnvelopeOwner
+{
+    public:
+
+        // constructor
+        MultiPhasePDFCalculator();
+
+        // phases
+        /// add phase calculator for the structure, the calculator
+        /// takes the shared r-grid and Q-range configuration
+        void addPhase(PDFCalculatorPtr pdfc, StructureAdapterPtr stru);
+        int countPhases() const;
+        PDFCalculator& getPhase(int);
+        const PDFCalculator& getPhase(int) const;
+        void clearPhases();
+
+        // evaluation
+        /// evaluate pair sums of all phases
+        void eval();
+        void setupParallelRun(int cpuindex, int ncpu);
+        std::string getParallelData() const;
+        void mergeParallelData(const std::string& pdata, int ncpu);
+
+        // results
+        QuantityType getPDF() const;
+        QuantityType getRgrid() const;
+
+        // shared r-grid and Q-range configuration
+        void setRmin(double);
+        const double& getRmin() const;
+        void setRmax(double);
+        const double& getRmax() const;
+        void setRstep(double);
+        const double& getRstep() const;
+        void setQmin(double);
+        const double& getQmin() const;
+        void setQmax(double);
+        const double& getQmax() const;
+        void setMaxExtension(double);
+        const double& getMaxExtension() const;
+
+    private:
+
+        // methods
+        void ensurePhaseIndex(int) const;
+        /// copy the shared configuration to the phase calculator
+        void configurePhase(PDFCalculator&) const;
+        /// check if phase envelopes are constant on the grid, set sc
+        /// to their value
+        bool envelopeScale(const PDFCalculator&,
+                const QuantityType& rgrid_ext, double& sc) const;
+        /// baseline PDF of a phase before the Q-range termination
+        /// on the extended grid starting at kmin * rstep
+        QuantityType unterminatedPDF(const PDFCalculator&, int kmin,
+                const QuantityType& rgrid_ext) const;
+        /// Q-range termination of PDF on the grid starting at kmin * rstep
+        QuantityType terminatePDF(const QuantityType& pdf_ext, int kmin) const;
+
+        // data
+        std::vector<PDFCalculatorPtr> mphases;
+        double mrmin;
+        double mrmax;
+        double mrstep;
+        double mqmin;
+        double mqmax;
+        double mmaxextension;
+};
+
+}   // namespace srreal
+}   // namespace diffpy
+
+#endif  // MULTIPHASEPDFCALCULATOR_HPP_INCLUDED
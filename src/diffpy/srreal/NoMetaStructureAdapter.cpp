@@ -80,6 +80,12 @@ const std::string& NoMetaStructureAdapter::siteAtomType(int idx) const
 }
 
 
+int NoMetaStructureAdapter::siteAtomTypeId(int idx) const
+{
+    return msrcstructure->siteAtomTypeId(idx);
+}
+
+
 const R3::Vector& NoMetaStructureAdapter::siteCartesianPosition(
         int idx) const
 {
@@ -44,6 +44,7 @@ class NoMetaStructureAdapter : public StructureAdapter
         virtual int countSites() const;
         virtual double numberDensity() const;
         virtual const std::string& siteAtomType(int idx) const;
+        virtual int siteAtomTypeId(int idx) const;
         virtual const R3::Vector& siteCartesianPosition(int idx) const;
         virtual int siteMultiplicity(int idx) const;
         virtual double siteOccupancy(int idx) const;
@@ -83,6 +83,12 @@ const std::string& NoSymmetryStructureAdapter::siteAtomType(int idx) const
 }
 
 
+int NoSymmetryStructureAdapter::siteAtomTypeId(int idx) const
+{
+    return msrcstructure->siteAtomTypeId(idx);
+}
+
+
 const R3::Vector& NoSymmetryStructureAdapter::siteCartesianPosition(
         int idx) const
 {
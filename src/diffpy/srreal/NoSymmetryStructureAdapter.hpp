@@ -46,6 +46,7 @@ class NoSymmetryStructureAdapter : public StructureAdapter
         virtual int countSites() const;
         virtual double numberDensity() const;
         virtual const std::string& siteAtomType(int idx) const;
+        virtual int siteAtomTypeId(int idx) const;
         virtual const R3::Vector& siteCartesianPosition(int idx) const;
         // reusing base-class StructureAdapter::siteMultiplicity()
         virtual double siteOccupancy(int idx) const;
@@ -522,13 +522,19 @@ double OverlapCalculator::suboverlap(int index, int flipi, int flipj) const
 
 void OverlapCalculator::cacheStructureData()
 {
-    int cntsites = this->countSites();
+    const PackedStructureView& sv = this->getPackedView();
+    int cntsites = sv.countSites();
     mstructure_cache.siteradii.resize(cntsites);
     const AtomRadiiTablePtr& table = this->getAtomRadiiTable();
+    const SiteIndices& atomtypeids = sv.atomTypeIds();
+    QuantityType tpradii(atomtypeids.size());
+    for (size_t tp = 0; tp < atomtypeids.size(); ++tp)
+    {
+        tpradii[tp] = table->lookup(atomtypeids[tp]);
+    }
     for (int i = 0; i < cntsites; ++i)
     {
-        const string& smbl = mstructure->siteAtomType(i);
-        mstructure_cache.siteradii[i] = table->lookup(smbl);
+        mstructure_cache.siteradii[i] = tpradii[sv.siteTypeId(i)];
     }
     double maxradius = mstructure_cache.siteradii.empty() ?
         0.0 : *max_element(mstructure_cache.siteradii.begin(),
@@ -17,6 +17,8 @@
 *****************************************************************************/
 
 #include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
 #include <sstream>
 #include <cmath>
 #include <cassert>
@@ -24,8 +26,10 @@
 #include <diffpy/serialization.ipp>
 #include <diffpy/srreal/PDFCalculator.hpp>
 #include <diffpy/srreal/StructureAdapter.hpp>
+#include <diffpy/srreal/StructureDifference.hpp>
 #include <diffpy/srreal/R3linalg.hpp>
 #include <diffpy/srreal/PDFUtils.hpp>
+#include <diffpy/srreal/EvalCounters.hpp>
 #include <diffpy/mathutils.hpp>
 #include <diffpy/validators.hpp>
 
@@ -52,6 +56,22 @@ bool _initialQstepUpdate(const PDFC* pc)
     return rv;
 }
 
+
+/// Return y with added baseline function at points x.
+QuantityType _applyBaseline(const PDFBaseline& baseline,
+        const QuantityType& x, const QuantityType& y)
+{
+    assert(x.size() == y.size());
+    QuantityType z = y;
+    QuantityType::const_iterator xi = x.begin();
+    QuantityType::iterator zi = z.begin();
+    for (; xi != x.end(); ++xi, ++zi)
+    {
+        *zi += baseline(*xi);
+    }
+    return z;
+}
+
 }   // namespace
 
 // Constructor ---------------------------------------------------------------
@@ -60,8 +80,21 @@ PDFCalculator::PDFCalculator() :
     mqmin(0.0),
     mqmax(DOUBLE_MAX),
     mrstep(DEFAULT_PDFCALCULATOR_RSTEP),
-    mmaxextension(DEFAULT_PDFCALCULATOR_MAXEXTENSION)
+    mmaxextension(DEFAULT_PDFCALCULATOR_MAXEXTENSION),
+    msitecaching(false),
+    mrcontinuum(0.0),
+    mcontinuumtol(0.0),
+    mrcontinuumused(0.0)
 {
+    msitecache.recording = false;
+    msitecache.updating = false;
+    msitecacheundo.active = false;
+    msitecacheundo.backedup = false;
+    msitecacheundo.count = 0;
+    mstashedvalue.exactgrid = false;
+    mrangeupdate.exactgrid = false;
+    mrangeupdate.movestashexactgrid = false;
+    mrangeupdate.active = false;
     // default configuration
     mrmax = DEFAULT_PDFCALCULATOR_RMAX;
     this->setPeakWidthModelByType("jeong");
@@ -92,6 +125,11 @@ PDFCalculator::PDFCalculator() :
             &PDFCalculator::getRstep, &PDFCalculator::setRstep);
     this->registerDoubleAttribute("maxextension", this,
             &PDFCalculator::getMaxExtension, &PDFCalculator::setMaxExtension);
+    this->registerDoubleAttribute("rcontinuum", this,
+            &PDFCalculator::getRcontinuum, &PDFCalculator::setRcontinuum);
+    this->registerDoubleAttribute("continuumtolerance", this,
+            &PDFCalculator::getContinuumTolerance,
+            &PDFCalculator::setContinuumTolerance);
     this->registerDoubleAttribute("extendedrmin", this,
             &PDFCalculator::getExtendedRmin);
     this->registerDoubleAttribute("extendedrmax", this,
@@ -150,47 +188,24 @@ QuantityType PDFCalculator::getF() const
 
 QuantityType PDFCalculator::getExtendedPDF() const
 {
-    QuantityType rgrid_ext = this->getExtendedRgrid();
-    // Skip FFT when qmax is not specified and qmin does not exclude the
-    // the F(Q=Qstep) point (excluding F(0) == 0 makes no difference to G).
-    const bool skipfft =
-        !eps_lt(this->getQmax(), M_PI / this->getRstep()) &&
-        !(1 < pdfutils_qminSteps(this));
-    if (skipfft)
-    {
-        QuantityType rdfpr = this->getExtendedRDFperR();
-        QuantityType rdfprb = this->applyBaseline(rgrid_ext, rdfpr);
-        QuantityType pdf = this->applyEnvelopes(rgrid_ext, rdfprb);
-        return pdf;
-    }
-    // FFT required here
-    // we need a full range PDF to apply termination ripples correctly
-    QuantityType f_ext = this->getExtendedF();
-    // zero all F points at Q < Qmin
-    QuantityType::iterator ii_qmin =
-        f_ext.begin() + min(pdfutils_qminSteps(this), int(f_ext.size()));
-    fill(f_ext.begin(), ii_qmin, 0.0);
-    // zero all F points at Q >= Qmax
-    assert(pdfutils_qmaxSteps(this) <= int(f_ext.size()));
-    QuantityType::iterator ii_qmax = f_ext.begin() + pdfutils_qmaxSteps(this);
-    fill(ii_qmax, f_ext.end(), 0.0);
-    QuantityType pdf1 = fftftog(f_ext, this->getQstep());
-    // cut away the FFT padded points
-    assert(this->extendedRmaxSteps() <= int(pdf1.size()));
-    pdf1.erase(pdf1.begin() + this->extendedRmaxSteps(), pdf1.end());
-    pdf1.erase(pdf1.begin(), pdf1.begin() + this->extendedRminSteps());
-    QuantityType pdf2 = this->applyEnvelopes(rgrid_ext, pdf1);
-    return pdf2;
+    QuantityType rdf_ext = this->getExtendedRDF();
+    QuantityType pdf = this->extendedPDFFromRDF(rdf_ext, *(this->getBaseline()));
+    return pdf;
 }
 
 
 QuantityType PDFCalculator::getExtendedRDF() const
 {
-    QuantityType rdf(this->countExtendedPoints());
-    const double& totocc = mstructure_cache.totaloccupancy;
-    double sfavg = this->sfAverage();
-    double rdf_scale = (totocc * sfavg == 0.0) ? 0.0 :
-        1.0 / (totocc * sfavg * sfavg);
+    QuantityType rdf;
+    this->getExtendedRDF(rdf);
+    return rdf;
+}
+
+
+void PDFCalculator::getExtendedRDF(QuantityType& rdf) const
+{
+    rdf.resize(this->countExtendedPoints());
+    const double rdf_scale = this->rdfScale();
     QuantityType::iterator iirdf = rdf.begin();
     QuantityType::const_iterator iival, iival_last;
     iival = this->value().begin() +
@@ -204,34 +219,20 @@ QuantityType PDFCalculator::getExtendedRDF() const
     {
         *iirdf = *iival * rdf_scale;
     }
-    return rdf;
+    if (this->isContinuumActive())  this->applyContinuum(rdf);
 }
 
 
 QuantityType PDFCalculator::getExtendedRDFperR() const
 {
-    QuantityType rdf_ext = this->getExtendedRDF();
-    QuantityType rgrid_ext = this->getExtendedRgrid();
-    assert(rdf_ext.size() == rgrid_ext.size());
-    QuantityType::const_iterator ri = rgrid_ext.begin();
-    QuantityType::iterator rdfi = rdf_ext.begin();
-    for (; ri != rgrid_ext.end(); ++ri, ++rdfi)
-    {
-        *rdfi = eps_gt(*ri, 0) ? (*rdfi / *ri) : 0.0;
-    }
-    return rdf_ext;
+    return this->extendedRDFperR(this->getExtendedRDF());
 }
 
 
 QuantityType PDFCalculator::getExtendedF() const
 {
-    QuantityType rdfperr_ext = this->getExtendedRDFperR();
-    QuantityType rgrid_ext = this->getExtendedRgrid();
-    QuantityType rdfperr_ext1 = this->applyBaseline(rgrid_ext, rdfperr_ext);
-    const double rmin_ext = this->getExtendedRmin();
-    QuantityType rv = fftgtof(rdfperr_ext1, this->getRstep(), rmin_ext);
-    assert(rv.empty() || eps_eq(M_PI,
-                this->getQstep() * rv.size() * this->getRstep()));
+    QuantityType rdf_ext = this->getExtendedRDF();
+    QuantityType rv = this->extendedFFromRDF(rdf_ext, *(this->getBaseline()));
     return rv;
 }
 
@@ -239,6 +240,14 @@ QuantityType PDFCalculator::getExtendedF() const
 QuantityType PDFCalculator::getExtendedRgrid() const
 {
     QuantityType rv;
+    this->getExtendedRgrid(rv);
+    return rv;
+}
+
+
+void PDFCalculator::getExtendedRgrid(QuantityType& rv) const
+{
+    rv.clear();
     rv.reserve(this->countExtendedPoints());
     // make sure exact value of rmin will be in the extended grid
     for (int i = this->extendedRminSteps(); i < this->extendedRmaxSteps(); ++i)
@@ -247,7 +256,6 @@ QuantityType PDFCalculator::getExtendedRgrid() const
     }
     assert(rv.empty() || !eps_lt(rv.front(), this->getExtendedRmin()));
     assert(rv.empty() || !eps_gt(rv.back(), this->getExtendedRmax()));
-    return rv;
 }
 
 // Q-range methods
@@ -307,6 +315,18 @@ QuantityType PDFCalculator::getRgrid() const
     return pdfutils_getRgrid(this);
 }
 
+
+void PDFCalculator::getRgrid(QuantityType& rv) const
+{
+    const int ndrmin = pdfutils_rminSteps(this);
+    const int ndrmax = pdfutils_rmaxSteps(this);
+    rv.clear();
+    for (int ndr = ndrmin; ndr < ndrmax; ++ndr)
+    {
+        rv.push_back(ndr * this->getRstep());
+    }
+}
+
 // R-range configuration
 
 void PDFCalculator::setRmin(double rmin)
@@ -405,16 +425,7 @@ const PeakProfilePtr& PDFCalculator::getPeakProfile() const
 QuantityType PDFCalculator::applyBaseline(
         const QuantityType& x, const QuantityType& y) const
 {
-    assert(x.size() == y.size());
-    QuantityType z = y;
-    const PDFBaseline& baseline = *(this->getBaseline());
-    QuantityType::const_iterator xi = x.begin();
-    QuantityType::iterator zi = z.begin();
-    for (; xi != x.end(); ++xi, ++zi)
-    {
-        *zi += baseline(*xi);
-    }
-    return z;
+    return _applyBaseline(*(this->getBaseline()), x, y);
 }
 
 
@@ -444,6 +455,143 @@ const PDFBaselinePtr& PDFCalculator::getBaseline() const
     return mbaseline;
 }
 
+// per-site contribution cache
+
+void PDFCalculator::setSiteCaching(bool flag)
+{
+    if (msitecaching != flag)  mticker.click();
+    msitecaching = flag;
+}
+
+
+bool PDFCalculator::getSiteCaching() const
+{
+    return msitecaching;
+}
+
+
+int PDFCalculator::countCachedSites() const
+{
+    const vector<SiteContribution>& sites = msitecache.sites;
+    int rv = 0;
+    vector<SiteContribution>::const_iterator sc = sites.begin();
+    for (; sc != sites.end(); ++sc)  rv += sc->valid;
+    return rv;
+}
+
+// site-resolved local PDF
+
+void PDFCalculator::setLocalSites(const SiteIndices& sites)
+{
+    SiteIndices::const_iterator ii = sites.begin();
+    for (; ii != sites.end(); ++ii)  ensureNonNegative("site index", *ii);
+    SiteIndices lsites = sites;
+    sort(lsites.begin(), lsites.end());
+    lsites.erase(unique(lsites.begin(), lsites.end()), lsites.end());
+    if (lsites == mlocalsites)  return;
+    mticker.click();
+    mlocalsites.swap(lsites);
+    // OPTIMIZED updates keep the rows only for unchanged site indices
+    mevaluator->setFlag(FIXEDSITEINDEX, !mlocalsites.empty());
+    this->resetLocalRows(false);
+}
+
+
+const SiteIndices& PDFCalculator::getLocalSites() const
+{
+    return mlocalsites;
+}
+
+
+QuantityType PDFCalculator::getLocalRDF(int site) const
+{
+    QuantityType rdf = this->getExtendedLocalRDF(site);
+    this->cutRipplePoints(rdf);
+    return rdf;
+}
+
+
+QuantityType PDFCalculator::getLocalPDF(int site) const
+{
+    QuantityType rdf_ext = this->getExtendedLocalRDF(site);
+    PDFBaselinePtr bl = this->getBaseline();
+    // linear baseline is scaled by the occupancy of the site pairs
+    if (bl->type() == "linear")
+    {
+        const double& totocc = mstructure_cache.totaloccupancy;
+        const double wi = (site < this->countSites()) ?
+            (mstructure->siteOccupancy(site) *
+             mstructure->siteMultiplicity(site)) : 0.0;
+        double partialpdfscale = (0.0 == totocc) ? 0.0 :
+            wi * (2 * totocc - wi) / (totocc * totocc);
+        double pnumdensity = partialpdfscale * mstructure->numberDensity();
+        bl = bl->clone();
+        bl->setDoubleAttr("slope", -4 * M_PI * pnumdensity);
+    }
+    QuantityType pdf = this->extendedPDFFromRDF(rdf_ext, *bl);
+    this->cutRipplePoints(pdf);
+    return pdf;
+}
+
+
+size_t PDFCalculator::getLocalMemoryUsage() const
+{
+    size_t rv = mlocal.rows.capacity() * sizeof(GridWindow) +
+        mlocal.rowindex.capacity() * sizeof(int);
+    vector<GridWindow>::const_iterator ri = mlocal.rows.begin();
+    for (; ri != mlocal.rows.end(); ++ri)
+    {
+        rv += ri->values.capacity() * sizeof(double);
+    }
+    return rv;
+}
+
+// long-range continuum approximation
+
+void PDFCalculator::setRcontinuum(double rc)
+{
+    ensureNonNegative("Rcontinuum", rc);
+    if (mrcontinuum != rc || mrcontinuumused != rc)  mticker.click();
+    mrcontinuum = rc;
+    mrcontinuumused = rc;
+}
+
+
+const double& PDFCalculator::getRcontinuum() const
+{
+    return mrcontinuum;
+}
+
+
+void PDFCalculator::setContinuumTolerance(double tol)
+{
+    ensureNonNegative("continuumtolerance", tol);
+    if (mcontinuumtol == tol)  return;
+    mcontinuumtol = tol;
+    if (mrcontinuumused != mrcontinuum)  mticker.click();
+    mrcontinuumused = mrcontinuum;
+}
+
+
+const double& PDFCalculator::getContinuumTolerance() const
+{
+    return mcontinuumtol;
+}
+
+
+const double& PDFCalculator::getRcontinuumUsed() const
+{
+    return mrcontinuumused;
+}
+
+
+double PDFCalculator::getContinuumError() const
+{
+    if (!this->isContinuumActive())  return 0.0;
+    double slope;
+    return this->fitContinuum(slope);
+}
+
 // Protected Methods ---------------------------------------------------------
 
 // Attributes overloads
@@ -500,6 +648,36 @@ void PDFCalculator::resetValue()
     }
     this->resizeValue(this->countCalcPoints());
     this->PairQuantity::resetValue();
+    mrangeupdate.exactgrid = true;
+    mrangeupdate.active = false;
+    // site contributions are kept for the OPTIMIZED update in progress
+    const bool keeprows = msitecache.updating;
+    if (msitecache.updating)
+    {
+        msitecache.updating = false;
+        msitecache.recording =
+            this->isSiteCachingActive() && !msitecache.sites.empty();
+    }
+    else  this->resetSiteCache();
+    this->resetLocalRows(keeprows);
+}
+
+
+void PDFCalculator::finishValue()
+{
+    const double tol = this->getContinuumTolerance();
+    if (tol <= 0.0 || mevaluator->isParallel())  return;
+    // Sum pairs again with a larger rc until the error estimate meets
+    // the tolerance.  The geometric growth keeps the total work within
+    // a small multiple of the last sum.  The continuum turns off once
+    // rc is beyond the extended r-grid.
+    const double rcgrowth = 1.5;
+    while (this->isContinuumActive() && this->getContinuumError() > tol)
+    {
+        mrcontinuumused *= rcgrowth;
+        mticker.click();
+        mevaluator->updateValue(*this, mstructure);
+    }
 }
 
 
@@ -507,12 +685,24 @@ void PDFCalculator::configureBondGenerator(BaseBondGenerator& bnds) const
 {
     bnds.setRmin(this->rcalclo());
     bnds.setRmax(this->rcalchi());
+    if (this->isContinuumActive())
+    {
+        double rexact = mrlimits_cache.exactrmaxsteps * this->getRstep();
+        bnds.setRmax(min(this->rcalchi(), rexact));
+    }
+    // pair contributions depend only on distance and msd
+    bnds.setSymmetryReduction(true);
 }
 
 
 void PDFCalculator::addPairContribution(const BaseBondGenerator& bnds,
         int summationscale)
 {
+    if (mrangeupdate.active)
+    {
+        this->addShellContribution(bnds, summationscale);
+        return;
+    }
     double sfprod = this->sfSite(bnds.site0()) * this->sfSite(bnds.site1());
     double peakscale = sfprod * bnds.multiplicity() * summationscale;
     double fwhm = this->getPeakWidthModel()->calculate(bnds);
@@ -524,6 +714,11 @@ void PDFCalculator::addPairContribution(const BaseBondGenerator& bnds,
     int ilast = min(this->countCalcPoints(), this->calcIndex(xhi) + 1);
     assert(ilast <= int(mvalue.size()));
     assert(eps_gt(dist, 0.0));
+    const int ifirst = i;
+    DIFFPY_EVAL_COUNT(GRID_POINTS, max(0, ilast - ifirst));
+    QuantityType& buffer = msitecache.buffer;
+    const bool keeppeak = msitecache.recording || !mlocal.rows.empty();
+    if (keeppeak)  buffer.resize(max(0, ilast - ifirst));
     for (; i < ilast; ++i)
     {
         double x = (this->rcalcloSteps() + i) * this->getRstep() - dist;
@@ -533,6 +728,15 @@ void PDFCalculator::addPairContribution(const BaseBondGenerator& bnds,
         // in such way that division by r will give a correct result.
         double yrdf = y * (x / dist + 1);
         mvalue[i] += peakscale * yrdf;
+        if (keeppeak)  buffer[i - ifirst] = peakscale * yrdf;
+    }
+    if (msitecache.recording)
+    {
+        this->recordSiteContribution(bnds, summationscale, ifirst, ilast);
+    }
+    if (!mlocal.rows.empty())
+    {
+        this->recordLocalContribution(bnds, ifirst, ilast);
     }
 }
 
@@ -541,6 +745,8 @@ void PDFCalculator::stashPartialValue()
 {
     mstashedvalue.value = this->value();
     mstashedvalue.rclosteps = this->rcalcloSteps();
+    mstashedvalue.rchisteps = this->rcalchiSteps();
+    mstashedvalue.exactgrid = mrangeupdate.exactgrid;
 }
 
 
@@ -554,12 +760,213 @@ void PDFCalculator::restorePartialValue()
     QuantityType::iterator tlast = mvalue.end();
     int leftshift = this->rcalcloSteps() - mstashedvalue.rclosteps;
     int sz = mstashedvalue.value.size();
+    // swap the buffers when the grid is the same, the cleared stash
+    // keeps its capacity for the next update
+    if (leftshift == 0 && sz == int(mvalue.size()))
+    {
+        mvalue.swap(mstashedvalue.value);
+        mstashedvalue.value.clear();
+        mrangeupdate.exactgrid = mstashedvalue.exactgrid;
+        return;
+    }
+    // points at the edges of a changed grid may miss some old bonds
+    mrangeupdate.exactgrid = false;
     if (leftshift >= 0)  si += min(leftshift, sz);
     else  ti += min(-leftshift, int(mvalue.size()));
     for (; si != slast && ti != tlast; ++si, ++ti)  *ti = *si;
     mstashedvalue.value.clear();
 }
 
+
+bool PDFCalculator::popCachedSites(const StructureDifference& sd)
+{
+    vector<SiteContribution>& sites = msitecache.sites;
+    msitecache.recording = false;
+    msitecache.updating = true;
+    if (sites.empty())  return false;
+    // site indices must be preserved between the structures
+    const int cntsites0 = sd.stru0->countSites();
+    if (sd.diffmethod != StructureDifference::Method::SIDEBYSIDE ||
+            int(sites.size()) != cntsites0)
+    {
+        this->touchCachedSite(-1, true);
+        sites.clear();
+        return false;
+    }
+    SiteIndices::const_iterator ii;
+    bool rv = true;
+    for (ii = sd.pop0.begin(); rv && ii != sd.pop0.end(); ++ii)
+    {
+        rv = sites[*ii].valid;
+    }
+    // Site contributions include half of every pair so the removal of
+    // 2 * contribution takes away also the pairs with other popped sites
+    // twice.  PQEvaluatorOptimized adds those pairs back.
+    const int offset = this->rcalcloSteps();
+    const int cntpoints = mvalue.size();
+    for (ii = sd.pop0.begin(); rv && ii != sd.pop0.end(); ++ii)
+    {
+        const SiteContribution& sc = sites[*ii];
+        int i = max(0, sc.kfirst - offset);
+        int ilast = min(cntpoints, sc.kfirst - offset + int(sc.values.size()));
+        QuantityType::const_iterator yi = sc.values.begin() +
+            (i - sc.kfirst + offset);
+        for (; i < ilast; ++i, ++yi)  mvalue[i] -= 2 * (*yi);
+    }
+    // contributions of the partner sites are no longer valid
+    for (ii = sd.pop0.begin(); ii != sd.pop0.end(); ++ii)
+    {
+        const SiteIndices& partners = sites[*ii].partners;
+        SiteIndices::const_iterator pi = partners.begin();
+        for (; pi != partners.end(); ++pi)
+        {
+            if (!sites[*pi].valid)  continue;
+            this->touchCachedSite(*pi, false);
+            sites[*pi].valid = false;
+        }
+    }
+    // prepare empty contributions for the added sites
+    const int cntsites1 = sd.stru1->countSites();
+    for (int k = cntsites1; k < cntsites0; ++k)
+    {
+        this->touchCachedSite(k, true);
+    }
+    sites.resize(cntsites1);
+    for (ii = sd.add1.begin(); ii != sd.add1.end(); ++ii)
+    {
+        this->touchCachedSite(*ii, true);
+        sites[*ii] = SiteContribution();
+    }
+    return rv;
+}
+
+
+bool PDFCalculator::stashRangeValue()
+{
+    // cached site contributions and local rows are not kept, the bonds
+    // beyond rc are not summed at all in the continuum approximation
+    if (this->isSiteCachingActive() || !mlocalsites.empty() ||
+            this->isContinuumActive())
+    {
+        return false;
+    }
+    // the kept points must be exact over the whole old grid
+    if (!mrangeupdate.exactgrid)  return false;
+    this->stashPartialValue();
+    return true;
+}
+
+
+bool PDFCalculator::restoreRangeValue(RangeShells& shells)
+{
+    const int klo0 = mstashedvalue.rclosteps;
+    const int khi0 = mstashedvalue.rchisteps;
+    const int klo1 = this->rcalcloSteps();
+    const int khi1 = this->rcalchiSteps();
+    // recalculate if the old and new grids do not overlap
+    if (klo1 >= khi0 || klo0 >= khi1)  return false;
+    const double& dr = this->getRstep();
+    const double lo0 = klo0 * dr;
+    const double hi0 = khi0 * dr;
+    const double lo1 = this->rcalclo();
+    const double hi1 = this->rcalchi();
+    // old bonds within peak tails from the added grid points
+    // need to be visited as well
+    const double ext_pktails = this->extFromPeakTails();
+    shells.clear();
+    if (klo0 != klo1)
+    {
+        double tlo = (klo1 < klo0) ? ext_pktails : 0.0;
+        shells.push_back(make_pair(min(lo0, lo1), max(lo0, lo1) + tlo));
+    }
+    if (khi0 != khi1)
+    {
+        double thi = (khi1 > khi0) ? ext_pktails : 0.0;
+        double shlo = max(0.0, min(hi0, hi1) - thi);
+        double shhi = max(hi0, hi1);
+        if (!shells.empty() && shlo <= shells.back().second)
+        {
+            shells.back().second = shhi;
+        }
+        else  shells.push_back(make_pair(shlo, shhi));
+    }
+    // pair count grows as r^3, use full calculation if it is cheaper
+    double shellvolume = 0.0;
+    RangeShells::const_iterator sh;
+    for (sh = shells.begin(); sh != shells.end(); ++sh)
+    {
+        shellvolume += pow(sh->second, 3) - pow(sh->first, 3);
+    }
+    if (shellvolume >= pow(hi1, 3) - pow(lo1, 3))  return false;
+    this->restorePartialValue();
+    // the shells complete all points in the new grid
+    mrangeupdate.exactgrid = true;
+    mrangeupdate.active = true;
+    mrangeupdate.rmin = lo0;
+    mrangeupdate.rmax = hi0;
+    mrangeupdate.ifirst = klo0 - klo1;
+    mrangeupdate.ilast = khi0 - klo1;
+    return true;
+}
+
+
+void PDFCalculator::finishRangeUpdate()
+{
+    mrangeupdate.active = false;
+}
+
+
+void PDFCalculator::stashMoveValue()
+{
+    this->PairQuantity::stashMoveValue();
+    mrangeupdate.movestashexactgrid = mrangeupdate.exactgrid;
+    mlocal.movestash = mlocal.rows;
+    msitecacheundo.active = true;
+    msitecacheundo.backedup = false;
+    msitecacheundo.count = msitecache.sites.size();
+    msitecacheundo.base.clear();
+    msitecacheundo.entries.clear();
+}
+
+
+void PDFCalculator::restoreMoveValue()
+{
+    this->PairQuantity::restoreMoveValue();
+    mrangeupdate.exactgrid = mrangeupdate.movestashexactgrid;
+    vector<SiteContribution>& sites = msitecache.sites;
+    if (msitecacheundo.backedup)  sites.swap(msitecacheundo.base);
+    sites.resize(msitecacheundo.count);
+    map<int, SiteContributionUndo>::iterator ue;
+    ue = msitecacheundo.entries.begin();
+    for (; ue != msitecacheundo.entries.end(); ++ue)
+    {
+        if (ue->first >= int(sites.size()))  continue;
+        SiteContribution& sc = sites[ue->first];
+        if (ue->second.saved)
+        {
+            sc = ue->second.entry;
+            continue;
+        }
+        sc.valid = ue->second.wasvalid;
+        sc.partners.resize(ue->second.npartners);
+    }
+    msitecache.recording = this->isSiteCachingActive() && !sites.empty();
+    mlocal.rows.swap(mlocal.movestash);
+    this->discardMoveValue();
+}
+
+
+void PDFCalculator::discardMoveValue()
+{
+    this->PairQuantity::discardMoveValue();
+    mlocal.movestash.clear();
+    msitecacheundo.active = false;
+    msitecacheundo.backedup = false;
+    msitecacheundo.count = 0;
+    msitecacheundo.base.clear();
+    msitecacheundo.entries.clear();
+}
+
 // calculation specific
 
 double PDFCalculator::rcalclo() const
@@ -664,6 +1071,16 @@ void PDFCalculator::cutRipplePoints(QuantityType& y) const
 }
 
 
+double PDFCalculator::rdfScale() const
+{
+    const double& totocc = mstructure_cache.totaloccupancy;
+    double sfavg = this->sfAverage();
+    double rv = (totocc * sfavg == 0.0) ? 0.0 :
+        1.0 / (totocc * sfavg * sfavg);
+    return rv;
+}
+
+
 const double& PDFCalculator::sfSite(int siteidx) const
 {
     assert(0 <= siteidx && siteidx < int(mstructure_cache.sfsite.size()));
@@ -679,28 +1096,28 @@ double PDFCalculator::sfAverage() const
 
 void PDFCalculator::cacheStructureData()
 {
-    int cntsites = this->countSites();
+    const PackedStructureView& sv = this->getPackedView();
+    int cntsites = sv.countSites();
     // sfsite
-    unordered_map<string, double> fcache;
-    mstructure_cache.sfsite.resize(cntsites);
     const ScatteringFactorTablePtr sftable = this->getScatteringFactorTable();
+    const SiteIndices& atomtypeids = sv.atomTypeIds();
+    QuantityType sftype(atomtypeids.size());
+    for (size_t tp = 0; tp < atomtypeids.size(); ++tp)
+    {
+        sftype[tp] = sftable->lookup(atomtypeids[tp]);
+    }
+    mstructure_cache.sfsite.resize(cntsites);
     for (int i = 0; i < cntsites; ++i)
     {
-        const string& smbl = mstructure->siteAtomType(i);
-        unordered_map<string, double>::iterator ff = fcache.find(smbl);
-        if (ff == fcache.end())
-        {
-            const double value = sftable->lookup(smbl);
-            ff = fcache.insert(make_pair(smbl, value)).first;
-        }
-        mstructure_cache.sfsite[i] = ff->second * mstructure->siteOccupancy(i);
+        mstructure_cache.sfsite[i] =
+            sftype[sv.siteTypeId(i)] * sv.siteOccupancy(i);
     }
     // sfaverage
-    double totocc = mstructure->totalOccupancy();
+    double totocc = sv.totalOccupancy();
     double totsf = 0.0;
     for (int i = 0; i < cntsites; ++i)
     {
-        totsf += this->sfSite(i) * mstructure->siteMultiplicity(i);
+        totsf += this->sfSite(i) * sv.siteMultiplicity(i);
     }
     mstructure_cache.sfaverage = (totocc == 0.0) ? 0.0 : (totsf / totocc);
     // totaloccupancy
@@ -715,8 +1132,8 @@ void PDFCalculator::cacheStructureData()
         if (outofbounds)  continue;
         int sumscale = (i == j) ? 1 : 2;
         double occij = sumscale *
-            mstructure->siteOccupancy(i) * mstructure->siteMultiplicity(i) *
-            mstructure->siteOccupancy(j) * mstructure->siteMultiplicity(j);
+            sv.siteOccupancy(i) * sv.siteMultiplicity(i) *
+            sv.siteOccupancy(j) * sv.siteMultiplicity(j);
         invmasktotal += occij;
     }
     if (totocc > 0.0)   invmasktotal /= totocc;
@@ -731,6 +1148,7 @@ void PDFCalculator::cacheRlimitsData()
     mrlimits_cache.extendedrmaxsteps = 0;
     mrlimits_cache.rcalclosteps = 0;
     mrlimits_cache.rcalchisteps = 0;
+    mrlimits_cache.exactrmaxsteps = 0;
     if (pdfutils_rminSteps(this) >= pdfutils_rmaxSteps(this))   return;
     // obtain extension magnitudes and rescale to fit maximum extension
     double ext_ripples = this->extFromTerminationRipples();
@@ -751,6 +1169,377 @@ void PDFCalculator::cacheRlimitsData()
     mrlimits_cache.extendedrmaxsteps = pdfutils_rmaxSteps(rmax + ext_ripples, dr);
     mrlimits_cache.rcalclosteps = max(0, pdfutils_rminSteps(rmin - ext_total, dr));
     mrlimits_cache.rcalchisteps = pdfutils_rmaxSteps(rmax + ext_total, dr);
+    if (!this->isContinuumActive())  return;
+    // calculate at least from rc/2 for the density fit and include
+    // pairs with peaks reaching into the crossover region above rc
+    const double rc = this->getRcontinuumUsed();
+    const double wc = this->continuumWidth();
+    mrlimits_cache.rcalclosteps = min(mrlimits_cache.rcalclosteps,
+            pdfutils_rminSteps(rc / 2, dr));
+    mrlimits_cache.exactrmaxsteps =
+        pdfutils_rmaxSteps(rc + wc + ext_pktails, dr);
+}
+
+// per-site contribution cache
+
+bool PDFCalculator::isSiteCachingActive() const
+{
+    const bool rv = msitecaching && mlocalsites.empty() &&
+        (mevaluator->typeint() != BASIC) && !mevaluator->isParallel();
+    return rv;
+}
+
+
+void PDFCalculator::resetSiteCache()
+{
+    this->touchCachedSite(-1, true);
+    msitecache.recording = this->isSiteCachingActive();
+    msitecache.sites.clear();
+    if (msitecache.recording)
+    {
+        msitecache.sites.resize(this->countSites());
+    }
+}
+
+
+void PDFCalculator::touchCachedSite(int k, bool content)
+{
+    if (!msitecacheundo.active || msitecacheundo.backedup)  return;
+    // k < 0 means all sites are going to be replaced
+    if (k < 0)
+    {
+        msitecacheundo.base.swap(msitecache.sites);
+        msitecacheundo.backedup = true;
+        return;
+    }
+    const SiteContribution& sc = msitecache.sites[k];
+    map<int, SiteContributionUndo>::iterator ue;
+    ue = msitecacheundo.entries.find(k);
+    if (ue == msitecacheundo.entries.end())
+    {
+        SiteContributionUndo& u = msitecacheundo.entries[k];
+        u.wasvalid = sc.valid;
+        u.npartners = sc.partners.size();
+        u.saved = false;
+        ue = msitecacheundo.entries.find(k);
+    }
+    SiteContributionUndo& u = ue->second;
+    if (!content || u.saved)  return;
+    u.entry = sc;
+    u.entry.valid = u.wasvalid;
+    u.entry.partners.resize(u.npartners);
+    u.saved = true;
+}
+
+
+void PDFCalculator::recordSiteContribution(const BaseBondGenerator& bnds,
+        int summationscale, int ifirst, int ilast)
+{
+    const int i0 = bnds.site0();
+    const int i1 = bnds.site1();
+    // pairs summed twice are split evenly between both sites
+    const bool split = (abs(summationscale) != 1) && (i0 != i1);
+    const double sc = split ? 0.5 : 1.0;
+    const int k0 = this->rcalcloSteps() + ifirst;
+    const int cnt = ilast - ifirst;
+    const QuantityType& buffer = msitecache.buffer;
+    const int cntrecorded = split ? 2 : 1;
+    const int recorded[2] = {i0, i1};
+    for (int n = 0; n < cntrecorded; ++n)
+    {
+        const int& i = recorded[n];
+        SiteContribution& c = msitecache.sites[i];
+        // stale sites only track their partners
+        if (!c.valid || cnt <= 0)  continue;
+        this->touchCachedSite(i, true);
+        c.add(k0, buffer, cnt, sc);
+    }
+    // a change of either site invalidates contributions of the other
+    if (i0 == i1)  return;
+    for (int n = 0; n < 2; ++n)
+    {
+        SiteIndices& partners = msitecache.sites[recorded[n]].partners;
+        const int& p = recorded[1 - n];
+        if (find(partners.begin(), partners.end(), p) != partners.end())
+        {
+            continue;
+        }
+        this->touchCachedSite(recorded[n], false);
+        partners.push_back(p);
+    }
+}
+
+// site-resolved local PDF
+
+void PDFCalculator::resetLocalRows(bool keepvalues)
+{
+    // swap with new containers to release memory when local mode is off
+    if (!keepvalues)
+    {
+        vector<GridWindow> rows(mlocalsites.size());
+        mlocal.rows.swap(rows);
+    }
+    const int cntsites = this->countSites();
+    SiteIndices rowindex;
+    if (!mlocalsites.empty())  rowindex.resize(cntsites, -1);
+    for (int n = 0; n < int(mlocalsites.size()); ++n)
+    {
+        if (mlocalsites[n] < cntsites)  rowindex[mlocalsites[n]] = n;
+    }
+    mlocal.rowindex.swap(rowindex);
+}
+
+
+void PDFCalculator::recordLocalContribution(const BaseBondGenerator& bnds,
+        int ifirst, int ilast)
+{
+    const int cnt = ilast - ifirst;
+    if (cnt <= 0)  return;
+    const int i0 = bnds.site0();
+    const int i1 = bnds.site1();
+    const int k0 = this->rcalcloSteps() + ifirst;
+    // every row gets the complete pair contribution
+    const int n0 = mlocal.rowindex[i0];
+    const int n1 = (i1 != i0) ? mlocal.rowindex[i1] : -1;
+    if (n0 >= 0)  mlocal.rows[n0].add(k0, msitecache.buffer, cnt, 1.0);
+    if (n1 >= 0)  mlocal.rows[n1].add(k0, msitecache.buffer, cnt, 1.0);
+}
+
+
+QuantityType PDFCalculator::getExtendedLocalRDF(int site) const
+{
+    SiteIndices::const_iterator ii =
+        lower_bound(mlocalsites.begin(), mlocalsites.end(), site);
+    if (ii == mlocalsites.end() || *ii != site)
+    {
+        const char* emsg = "Site is not a local anchor site.";
+        throw invalid_argument(emsg);
+    }
+    QuantityType rdf(this->countExtendedPoints(), 0.0);
+    const size_t n = ii - mlocalsites.begin();
+    if (n >= mlocal.rows.size())  return rdf;
+    const GridWindow& row = mlocal.rows[n];
+    const double rdf_scale = this->rdfScale();
+    const int kext = this->extendedRminSteps();
+    int k = max(kext, row.kfirst);
+    int klast = min(this->extendedRmaxSteps(),
+            row.kfirst + int(row.values.size()));
+    for (; k < klast; ++k)
+    {
+        rdf[k - kext] = row.values[k - row.kfirst] * rdf_scale;
+    }
+    return rdf;
+}
+
+// incremental r-range update
+
+void PDFCalculator::addShellContribution(
+        const BaseBondGenerator& bnds, int summationscale)
+{
+    // bond ranges are tested the same way as in BaseBondGenerator
+    const double dist = bnds.distance();
+    const bool inold =
+        (mrangeupdate.rmin <= dist) && (dist <= mrangeupdate.rmax);
+    const bool innew = (this->rcalclo() <= dist) && (dist <= this->rcalchi());
+    if (!inold && !innew)  return;
+    // new bonds are added at all points, removed bonds only at the kept
+    // points and retained bonds only at the points added to the grid
+    const int sign = innew ? +1 : -1;
+    double sfprod = this->sfSite(bnds.site0()) * this->sfSite(bnds.site1());
+    double peakscale = sign * sfprod * bnds.multiplicity() * summationscale;
+    double fwhm = this->getPeakWidthModel()->calculate(bnds);
+    const PeakProfile& pkf = *(this->getPeakProfile());
+    double xlo = dist + pkf.xboundlo(fwhm);
+    double xhi = dist + pkf.xboundhi(fwhm);
+    int i = max(0, this->calcIndex(xlo));
+    int ilast = min(this->countCalcPoints(), this->calcIndex(xhi) + 1);
+    const int ifirst = i;
+    for (; i < ilast; ++i)
+    {
+        const bool keptpoint =
+            (mrangeupdate.ifirst <= i && i < mrangeupdate.ilast);
+        if (innew ? (inold && keptpoint) : !keptpoint)  continue;
+        double x = (this->rcalcloSteps() + i) * this->getRstep() - dist;
+        double y = pkf(x, fwhm);
+        double yrdf = y * (x / dist + 1);
+        mvalue[i] += peakscale * yrdf;
+    }
+    DIFFPY_EVAL_COUNT(GRID_POINTS, max(0, ilast - ifirst));
+}
+
+// long-range continuum approximation
+
+bool PDFCalculator::isContinuumActive() const
+{
+    // there is nothing to approximate beyond the extended r-grid
+    const bool rv = mrcontinuumused > 0.0 &&
+        pdfutils_rminSteps(mrcontinuumused, this->getRstep()) <
+        this->extendedRmaxSteps();
+    return rv;
+}
+
+
+double PDFCalculator::continuumWidth() const
+{
+    // crossover width relative to rc
+    const double relwidth = 0.1;
+    return max(relwidth * this->getRcontinuumUsed(), this->getRstep());
+}
+
+
+double PDFCalculator::fitContinuum(double& slope) const
+{
+    const double& dr = this->getRstep();
+    const double rc = this->getRcontinuumUsed();
+    const int klo = this->rcalcloSteps();
+    const int kc = min(pdfutils_rmaxSteps(rc, dr), this->rcalchiSteps());
+    const int kw = max(max(1, klo), pdfutils_rminSteps(rc / 2, dr));
+    const double rdf_scale = this->rdfScale();
+    const QuantityType& v = this->value();
+    // match the pair count between rlo and rc to RDF = slope * r**2,
+    // which gives 4 * pi * rho for bulk materials including masked
+    // and partial PDFs
+    double cntpairs = 0.0;
+    for (int k = klo; k < kc; ++k)  cntpairs += v[k - klo] * rdf_scale * dr;
+    const double rlo = klo * dr;
+    const double rhi = kc * dr;
+    slope = (kc > klo) ?
+        (3 * cntpairs / (pow(rhi, 3) - pow(rlo, 3))) : 0.0;
+    // the largest G(r) residual over the outer half of the exact range
+    // estimates the far-field error, assuming the oscillation amplitude
+    // does not grow with r
+    double rv = 0.0;
+    for (int k = kw; k < kc; ++k)
+    {
+        const double r = k * dr;
+        const double g = v[k - klo] * rdf_scale / r;
+        rv = max(rv, fabs(g - slope * r));
+    }
+    return rv;
+}
+
+
+void PDFCalculator::applyContinuum(QuantityType& rdf_ext) const
+{
+    double slope;
+    this->fitContinuum(slope);
+    const double& dr = this->getRstep();
+    const double rc = this->getRcontinuumUsed();
+    const double wc = this->continuumWidth();
+    const int kext = this->extendedRminSteps();
+    const int kfirst = max(kext, pdfutils_rminSteps(rc, dr));
+    for (int k = kfirst; k < this->extendedRmaxSteps(); ++k)
+    {
+        const double r = k * dr;
+        // cosine crossover from the exact RDF to the continuum
+        const double t = (r >= rc + wc) ? 1.0 :
+            0.5 * (1.0 - cos(M_PI * (r - rc) / wc));
+        double& rdfk = rdf_ext[k - kext];
+        rdfk = (1.0 - t) * rdfk + t * slope * r * r;
+    }
+}
+
+// conversions of RDF on the extended r-grid
+
+QuantityType PDFCalculator::extendedRDFperR(QuantityType rdf_ext) const
+{
+    QuantityType rgrid_ext = this->getExtendedRgrid();
+    assert(rdf_ext.size() == rgrid_ext.size());
+    QuantityType::const_iterator ri = rgrid_ext.begin();
+    QuantityType::iterator rdfi = rdf_ext.begin();
+    for (; ri != rgrid_ext.end(); ++ri, ++rdfi)
+    {
+        *rdfi = eps_gt(*ri, 0) ? (*rdfi / *ri) : 0.0;
+    }
+    return rdf_ext;
+}
+
+
+QuantityType PDFCalculator::extendedFFromRDF(
+        const QuantityType& rdf_ext, const PDFBaseline& bl) const
+{
+    QuantityType rdfperr_ext = this->extendedRDFperR(rdf_ext);
+    QuantityType rgrid_ext = this->getExtendedRgrid();
+    QuantityType rdfperr_ext1 = _applyBaseline(bl, rgrid_ext, rdfperr_ext);
+    const double rmin_ext = this->getExtendedRmin();
+    // count the transform with the last evaluation
+    mevalcounters.resumeRecording();
+    QuantityType rv = fftgtof(rdfperr_ext1, this->getRstep(), rmin_ext);
+    mevalcounters.stopRecording();
+    assert(rv.empty() || eps_eq(M_PI,
+                this->getQstep() * rv.size() * this->getRstep()));
+    return rv;
+}
+
+
+QuantityType PDFCalculator::extendedPDFFromRDF(
+        const QuantityType& rdf_ext, const PDFBaseline& bl) const
+{
+    QuantityType rgrid_ext = this->getExtendedRgrid();
+    QuantityType rdfpr = this->extendedRDFperR(rdf_ext);
+    QuantityType rdfprb = _applyBaseline(bl, rgrid_ext, rdfpr);
+    QuantityType pdf1 = this->terminateExtendedPDF(rdfprb);
+    QuantityType pdf2 = this->applyEnvelopes(rgrid_ext, pdf1);
+    return pdf2;
+}
+
+
+QuantityType PDFCalculator::terminateExtendedPDF(
+        const QuantityType& pdf_ext) const
+{
+    // Skip FFT when qmax is not specified and qmin does not exclude the
+    // the F(Q=Qstep) point (excluding F(0) == 0 makes no difference to G).
+    const bool skipfft =
+        !eps_lt(this->getQmax(), M_PI / this->getRstep()) &&
+        !(1 < pdfutils_qminSteps(this));
+    if (skipfft)  return pdf_ext;
+    // FFT required here
+    // we need a full range PDF to apply termination ripples correctly
+    const double rmin_ext = this->getExtendedRmin();
+    // count both transforms with the last evaluation
+    mevalcounters.resumeRecording();
+    QuantityType f_ext = fftgtof(pdf_ext, this->getRstep(), rmin_ext);
+    assert(f_ext.empty() || eps_eq(M_PI,
+                this->getQstep() * f_ext.size() * this->getRstep()));
+    // zero all F points at Q < Qmin
+    QuantityType::iterator ii_qmin =
+        f_ext.begin() + min(pdfutils_qminSteps(this), int(f_ext.size()));
+    fill(f_ext.begin(), ii_qmin, 0.0);
+    // zero all F points at Q >= Qmax
+    assert(pdfutils_qmaxSteps(this) <= int(f_ext.size()));
+    QuantityType::iterator ii_qmax = f_ext.begin() + pdfutils_qmaxSteps(this);
+    fill(ii_qmax, f_ext.end(), 0.0);
+    QuantityType pdf1 = fftftog(f_ext, this->getQstep());
+    mevalcounters.stopRecording();
+    // cut away the FFT padded points
+    assert(this->extendedRmaxSteps() <= int(pdf1.size()));
+    pdf1.erase(pdf1.begin() + this->extendedRmaxSteps(), pdf1.end());
+    pdf1.erase(pdf1.begin(), pdf1.begin() + this->extendedRminSteps());
+    return pdf1;
+}
+
+// r-grid windows
+
+void PDFCalculator::GridWindow::add(
+        int k0, const QuantityType& y, int cnt, double sc)
+{
+    assert(cnt <= int(y.size()));
+    if (values.empty())  kfirst = k0;
+    const int klo = min(kfirst, k0);
+    const int khi = max(kfirst + int(values.size()), k0 + cnt);
+    // extend the lower end by at least the window size so that
+    // the shifts of prepended points are amortized over the window
+    if (klo < kfirst)
+    {
+        const int kpad = max(kfirst - klo, int(values.size()));
+        const int knew = min(klo, max(0, kfirst - kpad));
+        values.insert(values.begin(), kfirst - knew, 0.0);
+        kfirst = knew;
+    }
+    values.resize(khi - kfirst, 0.0);
+    QuantityType::iterator vi = values.begin() + (k0 - kfirst);
+    QuantityType::const_iterator yi = y.begin();
+    for (int j = 0; j < cnt; ++j, ++vi, ++yi)  *vi += sc * (*yi);
 }
 
 }   // namespace diffpy
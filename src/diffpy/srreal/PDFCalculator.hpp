@@ -19,6 +19,8 @@
 #ifndef PDFCALCULATOR_HPP_INCLUDED
 #define PDFCALCULATOR_HPP_INCLUDED
 
+#include <map>
+
 #include <diffpy/srreal/PairQuantity.hpp>
 #include <diffpy/srreal/PeakProfile.hpp>
 #include <diffpy/srreal/PeakWidthModel.hpp>
@@ -53,12 +55,16 @@ class PDFCalculator :
         QuantityType getExtendedPDF() const;
         /// RDF on an r-range extended for termination ripples
         QuantityType getExtendedRDF() const;
+        /// write the extended RDF to the caller buffer rv
+        void getExtendedRDF(QuantityType& rv) const;
         /// RDF divided by r on an r-range extended for termination ripples
         QuantityType getExtendedRDFperR() const;
         /// F(Q) on a zero-padded grid that reaches r-sampling Qmax = PI/dr
         QuantityType getExtendedF() const;
         /// r-grid extended for termination ripples
         QuantityType getExtendedRgrid() const;
+        /// write the extended r-grid to the caller buffer rv
+        void getExtendedRgrid(QuantityType& rv) const;
 
         // Q-range methods
         QuantityType getQgrid() const;
@@ -71,6 +77,8 @@ class PDFCalculator :
 
         // R-range methods
         QuantityType getRgrid() const;
+        /// write the r-grid to the caller buffer rv
+        void getRgrid(QuantityType& rv) const;
         // R-range configuration
         virtual void setRmin(double);
         virtual void setRmax(double);
@@ -101,22 +109,103 @@ class PDFCalculator :
         PDFBaselinePtr& getBaseline();
         const PDFBaselinePtr& getBaseline() const;
 
+        // per-site contribution cache
+        /// keep contributions of every site for OPTIMIZED updates that
+        /// remove changed sites without summing over their pairs
+        void setSiteCaching(bool flag);
+        bool getSiteCaching() const;
+        /// number of sites with cached contributions valid for removal
+        int countCachedSites() const;
+
+        // site-resolved local PDF
+        /// accumulate separate RDF rows for the anchor sites in one pass
+        void setLocalSites(const SiteIndices& sites);
+        const SiteIndices& getLocalSites() const;
+        /// RDF from all pairs of the local anchor site.  The rows are
+        /// not saved with the calculator and they are zero after loading
+        /// until the next evaluation.
+        QuantityType getLocalRDF(int site) const;
+        /// PDF from all pairs of the local anchor site, equivalent to
+        /// the PDF with pair mask applied to all pairs of that site only
+        QuantityType getLocalPDF(int site) const;
+        /// memory in bytes used by the local RDF rows
+        size_t getLocalMemoryUsage() const;
+
+        // long-range continuum approximation
+        /// sum pairs exactly only up to rc and replace the PDF beyond rc
+        /// with the average density fitted below rc, zero rc disables it.
+        /// The density is fitted from rc/2 or a lower calculation limit,
+        /// which is thus lowered to rc/2 when rmin is larger.
+        void setRcontinuum(double rc);
+        const double& getRcontinuum() const;
+        /// extend rc after evaluation until the continuum error is at
+        /// most tol, zero tol keeps rc fixed.  Parallel evaluation does
+        /// not extend rc.
+        void setContinuumTolerance(double tol);
+        const double& getContinuumTolerance() const;
+        /// rc used in the last evaluation, it stays extended for the
+        /// tolerance until rcontinuum or tolerance changes
+        const double& getRcontinuumUsed() const;
+        /// largest deviation of G(r) from the density fit below rc,
+        /// an estimate of the G(r) error beyond rc
+        double getContinuumError() const;
+
     protected:
 
+        friend class MultiPhasePDFCalculator;
+
         // Attributes overload to direct visitors around data structures
         virtual void accept(diffpy::BaseAttributesVisitor& v);
         virtual void accept(diffpy::BaseAttributesVisitor& v) const;
 
         // PairQuantity overloads
         virtual void resetValue();
+        virtual void finishValue();
         virtual void configureBondGenerator(BaseBondGenerator&) const;
         virtual void addPairContribution(const BaseBondGenerator&, int);
         // support for PQEvaluatorOptimized
         virtual void stashPartialValue();
         virtual void restorePartialValue();
+        virtual bool popCachedSites(const StructureDifference& sd);
+        virtual bool stashRangeValue();
+        virtual bool restoreRangeValue(RangeShells& shells);
+        virtual void finishRangeUpdate();
+        // support for trial moves
+        virtual void stashMoveValue();
+        virtual void restoreMoveValue();
+        virtual void discardMoveValue();
 
     private:
 
+        // types
+        /// values over a window of the calculated r-grid
+        struct GridWindow
+        {
+            GridWindow() : kfirst(0)  { }
+            /// r-grid steps from zero at the first point in values
+            int kfirst;
+            QuantityType values;
+            /// add scaled values at r-grid steps from k0, extend as needed
+            void add(int k0, const QuantityType& y, int cnt, double sc);
+        };
+        /// contributions of one site to the calculated grid
+        struct SiteContribution : public GridWindow
+        {
+            SiteContribution() : valid(true)  { }
+            /// sites that contributed to values
+            SiteIndices partners;
+            /// false when some partner has changed since values were summed
+            bool valid;
+        };
+        /// state of a SiteContribution before the pending trial move
+        struct SiteContributionUndo
+        {
+            bool wasvalid;
+            size_t npartners;
+            bool saved;
+            SiteContribution entry;
+        };
+
         // methods - calculation specific
         /// complete lower bound extension of the calculated grid
         double rcalclo() const;
@@ -143,6 +232,8 @@ class PDFCalculator :
         /// reduce extended grid to user-requested results grid
         /// by cutting away the points for termination ripples
         void cutRipplePoints(QuantityType& y) const;
+        /// conversion factor from the summed value to RDF
+        double rdfScale() const;
 
         // structure factors - fast lookup by site index
         /// effective scattering factor at a given site scaled by occupancy
@@ -152,6 +243,45 @@ class PDFCalculator :
         void cacheStructureData();
         void cacheRlimitsData();
 
+        // per-site contribution cache
+        bool isSiteCachingActive() const;
+        void resetSiteCache();
+        /// save state of a cached site before its change in a trial move
+        void touchCachedSite(int k, bool content);
+        void recordSiteContribution(const BaseBondGenerator& bnds,
+                int summationscale, int ifirst, int ilast);
+
+        // site-resolved local PDF
+        void resetLocalRows(bool keepvalues);
+        void recordLocalContribution(const BaseBondGenerator& bnds,
+                int ifirst, int ilast);
+        /// RDF on the extended r-grid for a local anchor site
+        QuantityType getExtendedLocalRDF(int site) const;
+
+        // incremental r-range update
+        /// add the peak change at grid points in the changed r-range
+        void addShellContribution(const BaseBondGenerator& bnds,
+                int summationscale);
+
+        // long-range continuum approximation
+        bool isContinuumActive() const;
+        /// width of the crossover region above rc
+        double continuumWidth() const;
+        /// fit RDF below rc by average density, return the largest
+        /// residual in G(r) and the RDF/r^2 ratio in slope
+        double fitContinuum(double& slope) const;
+        /// blend RDF on the extended grid into the continuum beyond rc
+        void applyContinuum(QuantityType& rdf_ext) const;
+
+        // conversions of RDF on the extended r-grid
+        QuantityType extendedRDFperR(QuantityType rdf_ext) const;
+        QuantityType extendedFFromRDF(
+                const QuantityType& rdf_ext, const PDFBaseline& bl) const;
+        QuantityType extendedPDFFromRDF(
+                const QuantityType& rdf_ext, const PDFBaseline& bl) const;
+        /// apply the Qmin and Qmax termination to PDF on the extended grid
+        QuantityType terminateExtendedPDF(const QuantityType& pdf_ext) const;
+
         // data
         // configuration
         double mqmin;
@@ -171,12 +301,60 @@ class PDFCalculator :
             int extendedrmaxsteps;
             int rcalclosteps;
             int rcalchisteps;
+            /// upper bound of the exactly summed pair distances
+            int exactrmaxsteps;
         } mrlimits_cache;
         // support for PQEvaluatorOptimized
         struct {
             QuantityType value;
             int rclosteps;
+            int rchisteps;
+            bool exactgrid;
         } mstashedvalue;
+        // incremental r-range update
+        struct {
+            /// value is exact over the whole calculated grid.  This is
+            /// false after a fast update that changed the calculated grid,
+            /// because it does not sum the old bonds beyond the new grid.
+            bool exactgrid;
+            /// exactgrid before the pending trial move
+            bool movestashexactgrid;
+            bool active;
+            /// bond distances summed in the stashed value
+            double rmin;
+            double rmax;
+            /// calculated grid of the stashed value in the current indices
+            int ifirst;
+            int ilast;
+        } mrangeupdate;
+        // per-site contribution cache
+        bool msitecaching;
+        struct {
+            std::vector<SiteContribution> sites;
+            bool recording;
+            /// keep sites for the OPTIMIZED update in progress
+            bool updating;
+            QuantityType buffer;
+        } msitecache;
+        struct {
+            bool active;
+            bool backedup;
+            size_t count;
+            std::vector<SiteContribution> base;
+            std::map<int, SiteContributionUndo> entries;
+        } msitecacheundo;
+        // site-resolved local PDF
+        SiteIndices mlocalsites;
+        struct {
+            std::vector<GridWindow> rows;
+            /// row index for every site or -1
+            SiteIndices rowindex;
+            std::vector<GridWindow> movestash;
+        } mlocal;
+        // long-range continuum approximation
+        double mrcontinuum;
+        double mcontinuumtol;
+        double mrcontinuumused;
         // serialization
         friend class boost::serialization::access;
         template<class Archive>
@@ -201,6 +379,24 @@ class PDFCalculator :
             ar & mrlimits_cache.extendedrmaxsteps;
             ar & mrlimits_cache.rcalclosteps;
             ar & mrlimits_cache.rcalchisteps;
+            if (version >= 1)
+            {
+                ar & msitecaching;
+                ar & mlocalsites;
+                ar & mrcontinuum;
+                ar & mcontinuumtol;
+                ar & mrcontinuumused;
+                ar & mrlimits_cache.exactrmaxsteps;
+            }
+            // Cached site contributions, local RDF rows and the state of
+            // incremental updates are not saved.  They are rebuilt by
+            // a complete recalculation in the first evaluation after loading.
+            if (Archive::is_loading::value)
+            {
+                msitecache.sites.clear();
+                this->resetLocalRows(false);
+                mticker.click();
+            }
         }
 
 };  // class PDFCalculator
@@ -210,6 +406,7 @@ class PDFCalculator :
 
 // Serialization -------------------------------------------------------------
 
+BOOST_CLASS_VERSION(diffpy::srreal::PDFCalculator, 1)
 BOOST_CLASS_EXPORT_KEY(diffpy::srreal::PDFCalculator)
 
 #endif  // PDFCALCULATOR_HPP_INCLUDED
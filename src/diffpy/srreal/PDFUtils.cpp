@@ -22,6 +22,7 @@
 #include <gsl/gsl_fft_complex.h>
 
 #include <diffpy/srreal/PDFUtils.hpp>
+#include <diffpy/srreal/EvalCounters.hpp>
 #include <diffpy/mathutils.hpp>
 #include <diffpy/validators.hpp>
 
@@ -68,6 +69,8 @@ QuantityType fftgtof(const QuantityType& g, double rstep, double rmin)
         gpadc[2 * ihi] = -1 * gpadc[2 * ilo];
     }
     int status;
+    DIFFPY_EVAL_COUNT(FFT_CALLS, 1);
+    DIFFPY_EVAL_COUNT(FFT_POINTS, 2 * Npad2);
     status = gsl_fft_complex_radix2_inverse(&(gpadc[0]), 1, 2 * Npad2);
     if (status != GSL_SUCCESS)  throw invalid_argument(EMSGFFT);
     QuantityType f(Npad2);
@@ -18,15 +18,21 @@
 * class PQEvaluatorOptimized -- optimized PairQuantity evaluator with fast
 *     quantity updates
 *
+* class PQEvaluatorCheck -- OPTIMIZED evaluator that verifies sampled
+*     fast updates against the BASIC evaluation
+*
 *****************************************************************************/
 
 
+#include <cmath>
 #include <stdexcept>
 #include <sstream>
 
 #include <diffpy/serialization.ipp>
 #include <diffpy/srreal/PQEvaluator.hpp>
 #include <diffpy/srreal/PairQuantity.hpp>
+#include <diffpy/srreal/BondBlock.hpp>
+#include <diffpy/srreal/EvalCounters.hpp>
 #include <diffpy/srreal/BondCalculator.hpp>
 #include <diffpy/srreal/StructureDifference.hpp>
 
@@ -42,11 +48,10 @@ namespace {
 // tolerated load variance for splitting outer loop for parallel evaluation
 const double CPU_LOAD_VARIANCE = 0.1;
 
-SiteIndices
-complementary_indices(const int sz, const SiteIndices& indices0)
+void complementary_indices(
+        const int sz, const SiteIndices& indices0, SiteIndices& rv)
 {
-    SiteIndices rv;
-    rv.reserve(sz);
+    rv.clear();
     SiteIndices::const_iterator ii0 = indices0.begin();
     for (int k = 0; k < sz; ++k)
     {
@@ -60,7 +65,6 @@ complementary_indices(const int sz, const SiteIndices& indices0)
             ++ii0;
         }
     }
-    return rv;
 }
 
 }   // namespace
@@ -75,6 +79,13 @@ PQEvaluatorBasic::PQEvaluatorBasic() :
 { }
 
 
+PQEvaluatorPtr PQEvaluatorBasic::clone() const
+{
+    PQEvaluatorPtr rv(new PQEvaluatorBasic(*this));
+    return rv;
+}
+
+
 PQEvaluatorType PQEvaluatorBasic::typeint() const
 {
     return BASIC;
@@ -97,9 +108,11 @@ void PQEvaluatorBasic::updateValue(
         PairQuantity& pq, StructureAdapterPtr stru)
 {
     mtypeused = BASIC;
+    DIFFPY_EVAL_COUNT(FULL_RECOMPUTES, 1);
     pq.setStructure(stru);
     BaseBondGeneratorPtr bnds = pq.mstructure->createBondGenerator();
     pq.configureBondGenerator(*bnds);
+    bnds->setPackedView(&pq.getPackedView());
     int cntsites = pq.mstructure->countSites();
     // loop counter
     long n = mcpuindex;
@@ -107,27 +120,30 @@ void PQEvaluatorBasic::updateValue(
     bool chop_outer = (mncpu <= ((cntsites - 1) * CPU_LOAD_VARIANCE + 1));
     bool chop_inner = !chop_outer;
     const bool hasmask = pq.hasMask();
+    const CompiledPairMask* pmask =
+        hasmask ? &(pq.getCompiledPairMask()) : NULL;
     if (!this->isParallel())  chop_outer = chop_inner = false;
     const bool usefullsum = this->getFlag(USEFULLSUM);
+    long* pchop = chop_inner ? &n : NULL;
     for (int i0 = 0; i0 < cntsites; ++i0)
     {
         if (chop_outer && (n++ % mncpu))    continue;
         bnds->selectAnchorSite(i0);
         int i1hi = usefullsum ? cntsites : (i0 + 1);
         bnds->selectSiteRange(0, i1hi);
-        for (bnds->rewind(); !bnds->finished(); bnds->next())
-        {
-            if (chop_inner && (n++ % mncpu))    continue;
-            int i1 = bnds->site1();
-            if (hasmask && !pq.getPairMask(i0, i1))   continue;
-            int summationscale = (usefullsum || i0 == i1) ? 1 : 2;
-            pq.addPairContribution(*bnds, summationscale);
-        }
+        this->addAnchorContributions(pq, *bnds, pmask, +1, pchop);
     }
     mvalue_ticker.click();
 }
 
 
+void PQEvaluatorBasic::recordCompleteUpdate(PairQuantity& pq)
+{
+    mtypeused = BASIC;
+    mvalue_ticker.click();
+}
+
+
 void PQEvaluatorBasic::setFlag(PQEvaluatorFlag flag, bool value)
 {
     if (value)  mconfigflags |= int(flag);
@@ -159,10 +175,64 @@ bool PQEvaluatorBasic::isParallel() const
     return mncpu > 1;
 }
 
+// Protected Methods ---------------------------------------------------------
+
+void PQEvaluatorBasic::addAnchorContributions(
+        PairQuantity& pq, BaseBondGenerator& bnds,
+        const CompiledPairMask* pmask, int sign, long* pchop) const
+{
+    const bool usefullsum = this->getFlag(USEFULLSUM);
+    const int i0 = bnds.site0();
+    long long cntpairs = 0;
+    if (!pq.usesBondBlocks())
+    {
+        for (bnds.rewind(); !bnds.finished(); bnds.next())
+        {
+            if (pchop && ((*pchop)++ % mncpu))  continue;
+            int i1 = bnds.site1();
+            if (pmask && !(*pmask)(i0, i1))   continue;
+            const int summationscale =
+                sign * ((usefullsum || i0 == i1) ? 1 : 2);
+            pq.addPairContribution(bnds, summationscale);
+            DIFFPY_EVAL_TALLY(++cntpairs);
+        }
+        DIFFPY_EVAL_COUNT(PAIR_CONTRIBUTIONS, cntpairs);
+        return;
+    }
+    // pass the bonds in blocks with one virtual call per block
+    BondBlock blk;
+    for (bnds.rewind(); !bnds.finished();)
+    {
+        blk.clear();
+        bnds.fillBlock(blk);
+        int cnt = 0;
+        for (int k = 0; k < blk.count; ++k)
+        {
+            if (pchop && ((*pchop)++ % mncpu))  continue;
+            int i1 = blk.site1[k];
+            if (pmask && !(*pmask)(i0, i1))   continue;
+            blk.summationscale[k] = sign * ((usefullsum || i0 == i1) ? 1 : 2);
+            if (cnt != k)  blk.copyEntry(k, cnt);
+            ++cnt;
+        }
+        blk.count = cnt;
+        if (cnt)  pq.addPairContributions(blk);
+        DIFFPY_EVAL_TALLY(cntpairs += cnt);
+    }
+    DIFFPY_EVAL_COUNT(PAIR_CONTRIBUTIONS, cntpairs);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // class PQEvaluatorOptimized
 //////////////////////////////////////////////////////////////////////////////
 
+PQEvaluatorPtr PQEvaluatorOptimized::clone() const
+{
+    PQEvaluatorPtr rv(new PQEvaluatorOptimized(*this));
+    return rv;
+}
+
+
 PQEvaluatorType PQEvaluatorOptimized::typeint() const
 {
     return OPTIMIZED;
@@ -183,12 +253,24 @@ void PQEvaluatorOptimized::updateValue(
     mtypeused = OPTIMIZED;
     // revert to normal calculation if there is no structure or
     // if PairQuantity uses mask
-    if (pq.ticker() >= mvalue_ticker || !mlast_structure)
+    if (!mlast_structure)  return this->updateValueCompletely(pq, stru);
+    if (pq.ticker() >= mvalue_ticker)
     {
+        if (this->updateValueRange(pq, stru))  return;
         return this->updateValueCompletely(pq, stru);
     }
-    // do not do fast updates if they take more work
     StructureDifference sd = mlast_structure->diff(stru);
+    // nothing to do when the same structure has not changed,
+    // the CHECK evaluator always verifies the fast update instead
+    if (this->typeint() == OPTIMIZED &&
+            sd.diffmethod != StructureDifference::Method::NONE &&
+            sd.pop0.empty() && sd.add1.empty() && stru == pq.getStructure())
+    {
+        mvalue_ticker.click();
+        DIFFPY_EVAL_COUNT(FAST_UPDATES, 1);
+        return;
+    }
+    // do not do fast updates if they take more work
     if (!sd.allowsfastupdate())
     {
         return this->updateValueCompletely(pq, stru);
@@ -201,6 +283,8 @@ void PQEvaluatorOptimized::updateValue(
     // Remove contributions from the extra sites in the old structure
     assert(sd.stru0 == mlast_structure);
     int cntsites0 = sd.stru0->countSites();
+    // bnds0 queries stru0, because the packed view in pq may be
+    // built for a structure that was changed in place since.
     BaseBondGeneratorPtr bnds0 = sd.stru0->createBondGenerator();
     pq.configureBondGenerator(*bnds0);
     // loop counter
@@ -208,19 +292,28 @@ void PQEvaluatorOptimized::updateValue(
     bool usefullsum = this->getFlag(USEFULLSUM);
     // the loop is adjusted according to usefullsum and split within
     // the outer loop in case of parallel evaluation.
-    SiteIndices anchors = sd.pop0;
-    SiteIndices unchanged;
-    if (!sd.pop0.empty())
+    // When pq has subtracted cached contributions of the popped sites,
+    // their mutual pairs were removed twice and only those are added back.
+    const bool cachedpop = pq.popCachedSites(sd);
+    const int popsign = cachedpop ? +1 : -1;
+    // site indices are kept in scratch vectors reused between updates
+    SiteIndices& anchors = manchors;
+    SiteIndices& unchanged = munchanged;
+    anchors.assign(sd.pop0.begin(), sd.pop0.end());
+    unchanged.clear();
+    if (!sd.pop0.empty() && !cachedpop)
     {
-        unchanged = complementary_indices(cntsites0, sd.pop0);
+        complementary_indices(cntsites0, sd.pop0, unchanged);
         anchors.insert(anchors.end(), unchanged.begin(), unchanged.end());
     }
     bnds0->selectSites(anchors.begin(), anchors.end());
-    SiteIndices::const_iterator last_anchor = usefullsum ?
+    SiteIndices::const_iterator last_anchor = (usefullsum || cachedpop) ?
         anchors.end() : (anchors.begin() + sd.pop0.size());
     SiteIndices::const_iterator ii0;
-    bool needsreselection = usefullsum;
+    bool needsreselection = usefullsum && !cachedpop;
     const bool hasmask = pq.hasMask();
+    const CompiledPairMask* pmask =
+        hasmask ? &(pq.getCompiledPairMask()) : NULL;
     for (ii0 = anchors.begin(); ii0 != last_anchor; ++ii0)
     {
         if (n++ % mncpu)    continue;
@@ -235,13 +328,7 @@ void PQEvaluatorOptimized::updateValue(
             bnds0->selectSites(sd.pop0.begin(), sd.pop0.end());
             needsreselection = false;
         }
-        for (bnds0->rewind(); !bnds0->finished(); bnds0->next())
-        {
-            int i1 = bnds0->site1();
-            if (hasmask && !pq.getPairMask(i0, i1))   continue;
-            const int summationscale = (usefullsum || i0 == i1) ? -1 : -2;
-            pq.addPairContribution(*bnds0, summationscale);
-        }
+        this->addAnchorContributions(pq, *bnds0, pmask, popsign);
     }
     // Add contributions from the new atoms in the updated structure
     // save current value to override the resetValue call from setStructure
@@ -250,7 +337,7 @@ void PQEvaluatorOptimized::updateValue(
     // setStructure(stru1) calls stru1->customPQConfig(pq), which may totally
     // change pq configuration.  If so, revert to full calculation.
     assert(pq.ticker() < mvalue_ticker);
-    pq.setStructure(sd.stru1);
+    pq.updateStructure(sd);
     if (pq.ticker() >= mvalue_ticker)
     {
         return this->updateValueCompletely(pq, stru);
@@ -259,14 +346,17 @@ void PQEvaluatorOptimized::updateValue(
     int cntsites1 = sd.stru1->countSites();
     BaseBondGeneratorPtr bnds1 = sd.stru1->createBondGenerator();
     pq.configureBondGenerator(*bnds1);
-    anchors = sd.add1;
+    bnds1->setPackedView(&pq.getPackedView());
+    anchors.assign(sd.add1.begin(), sd.add1.end());
     unchanged.clear();
     if (!sd.add1.empty())
     {
-        unchanged = complementary_indices(cntsites1, sd.add1);
+        complementary_indices(cntsites1, sd.add1, unchanged);
         anchors.insert(anchors.begin(), unchanged.begin(), unchanged.end());
     }
     bnds1->selectSites(sd.add1.begin(), sd.add1.end());
+    // the mask was compiled again for the new structure
+    if (hasmask)  pmask = &(pq.getCompiledPairMask());
     SiteIndices::const_iterator first_anchor = usefullsum ?
         anchors.begin() : (anchors.end() - sd.add1.size());
     SiteIndices::const_iterator ii1;
@@ -285,16 +375,18 @@ void PQEvaluatorOptimized::updateValue(
             bnds1->selectSites(anchors.begin(), anchors.end());
             needsreselection = false;
         }
-        for (bnds1->rewind(); !bnds1->finished(); bnds1->next())
-        {
-            int i1 = bnds1->site1();
-            if (hasmask && !pq.getPairMask(i0, i1))   continue;
-            const int summationscale = (usefullsum || i0 == i1) ? +1 : +2;
-            pq.addPairContribution(*bnds1, summationscale);
-        }
+        this->addAnchorContributions(pq, *bnds1, pmask, +1);
     }
-    mlast_structure = pq.getStructure()->clone();
+    this->recordLastStructure(pq);
     mvalue_ticker.click();
+    DIFFPY_EVAL_COUNT(FAST_UPDATES, 1);
+}
+
+
+void PQEvaluatorOptimized::recordCompleteUpdate(PairQuantity& pq)
+{
+    this->PQEvaluatorBasic::recordCompleteUpdate(pq);
+    this->recordLastStructure(pq);
 }
 
 
@@ -302,7 +394,63 @@ void PQEvaluatorOptimized::updateValueCompletely(
         PairQuantity& pq, StructureAdapterPtr stru)
 {
     this->PQEvaluatorBasic::updateValue(pq, stru);
+    this->recordLastStructure(pq);
+}
+
+
+void PQEvaluatorOptimized::recordLastStructure(PairQuantity& pq)
+{
     mlast_structure = pq.getStructure()->clone();
+    // the packed view holds the same sites and can be updated from
+    // differences to mlast_structure
+    pq.mpackedview.setSource(mlast_structure);
+}
+
+
+bool PQEvaluatorOptimized::updateValueRange(
+        PairQuantity& pq, StructureAdapterPtr stru)
+{
+    // parallel runs merge partial values that do not keep the r-range
+    if (this->isParallel() || !pq.hasOnlyRangeChanges(mvalue_ticker))
+    {
+        return false;
+    }
+    StructureDifference sd = mlast_structure->diff(stru);
+    if (!sd.stru1 || !sd.pop0.empty() || !sd.add1.empty())  return false;
+    if (!pq.stashRangeValue())  return false;
+    // setStructure caches the new r-range and resets the value.
+    // customPQConfig may change other configuration as well.
+    const eventticker::EventTicker tic0 = pq.ticker();
+    pq.updateStructure(sd);
+    PairQuantity::RangeShells shells;
+    if (pq.ticker() > tic0 || !pq.restoreRangeValue(shells))  return false;
+    BaseBondGeneratorPtr bnds = pq.mstructure->createBondGenerator();
+    pq.configureBondGenerator(*bnds);
+    bnds->setPackedView(&pq.getPackedView());
+    const int cntsites = pq.mstructure->countSites();
+    const bool usefullsum = this->getFlag(USEFULLSUM);
+    const bool hasmask = pq.hasMask();
+    const CompiledPairMask* pmask =
+        hasmask ? &(pq.getCompiledPairMask()) : NULL;
+    // the calculator applies sign and clipping by the r-range changes
+    PairQuantity::RangeShells::const_iterator sh;
+    for (sh = shells.begin(); sh != shells.end(); ++sh)
+    {
+        bnds->setRmin(sh->first);
+        bnds->setRmax(sh->second);
+        for (int i0 = 0; i0 < cntsites; ++i0)
+        {
+            bnds->selectAnchorSite(i0);
+            int i1hi = usefullsum ? cntsites : (i0 + 1);
+            bnds->selectSiteRange(0, i1hi);
+            this->addAnchorContributions(pq, *bnds, pmask, +1);
+        }
+    }
+    pq.finishRangeUpdate();
+    pq.mpackedview.setSource(mlast_structure);
+    mvalue_ticker.click();
+    DIFFPY_EVAL_COUNT(RANGE_UPDATES, 1);
+    return true;
 }
 
 // Helper classes and functions for PQEvaluatorCheck -------------------------
@@ -327,6 +475,20 @@ class pqresults
         virtual ~pqresults()  { }
 
 
+        /// largest absolute difference from the saved value
+        double deviation(const PairQuantity& pq) const
+        {
+            const QuantityType& cur_value = pq.value();
+            if (msaved_value.size() != cur_value.size())  return HUGE_VAL;
+            double rv = 0.0;
+            for (size_t i = 0; i < cur_value.size(); ++i)
+            {
+                rv = max(rv, fabs(cur_value[i] - msaved_value[i]));
+            }
+            return rv;
+        }
+
+
         virtual bool compare(const PairQuantity& pq) const
         {
             QuantityType::const_iterator smx = max_element(
@@ -406,6 +568,22 @@ pqresults* create_pqresults(const PairQuantity& pq)
 // class PQEvaluatorCheck
 //////////////////////////////////////////////////////////////////////////////
 
+PQEvaluatorCheck::PQEvaluatorCheck() :
+    mcheckinterval(1),
+    mthrowonmismatch(true),
+    mcntskipped(0)
+{
+    this->resetStatistics();
+}
+
+
+PQEvaluatorPtr PQEvaluatorCheck::clone() const
+{
+    PQEvaluatorPtr rv(new PQEvaluatorCheck(*this));
+    return rv;
+}
+
+
 PQEvaluatorType PQEvaluatorCheck::typeint() const
 {
     return CHECK;
@@ -417,16 +595,81 @@ void PQEvaluatorCheck::updateValue(
 {
     this->PQEvaluatorOptimized::updateValue(pq, stru);
     if (mtypeused == BASIC)  return;
+    if (++mcntskipped < mcheckinterval)  return;
+    mcntskipped = 0;
     unique_ptr<pqresults> results(create_pqresults(pq));
     this->PQEvaluatorBasic::updateValue(pq, stru);
     mtypeused = CHECK;
-    if (!results->compare(pq))
+    ++mcntchecks;
+    mmaxdeviation = max(mmaxdeviation, results->deviation(pq));
+    DIFFPY_EVAL_COUNT(CHECKS, 1);
+    if (results->compare(pq))  return;
+    ++mcntmismatches;
+    DIFFPY_EVAL_COUNT(CHECK_MISMATCHES, 1);
+    // the value is left at the correct result from BASIC evaluation
+    if (mthrowonmismatch)
     {
         const char* emsg = "Inconsistent results from OPTIMIZED evaluation.";
         throw logic_error(emsg);
     }
 }
 
+
+void PQEvaluatorCheck::setCheckInterval(int n)
+{
+    if (n < 1)
+    {
+        const char* emsg = "Check interval must be at least 1.";
+        throw invalid_argument(emsg);
+    }
+    mcheckinterval = n;
+    mcntskipped = 0;
+}
+
+
+int PQEvaluatorCheck::getCheckInterval() const
+{
+    return mcheckinterval;
+}
+
+
+void PQEvaluatorCheck::setThrowOnMismatch(bool flag)
+{
+    mthrowonmismatch = flag;
+}
+
+
+bool PQEvaluatorCheck::getThrowOnMismatch() const
+{
+    return mthrowonmismatch;
+}
+
+
+long PQEvaluatorCheck::countChecks() const
+{
+    return mcntchecks;
+}
+
+
+long PQEvaluatorCheck::countMismatches() const
+{
+    return mcntmismatches;
+}
+
+
+double PQEvaluatorCheck::getMaxDeviation() const
+{
+    return mmaxdeviation;
+}
+
+
+void PQEvaluatorCheck::resetStatistics()
+{
+    mcntchecks = 0;
+    mcntmismatches = 0;
+    mmaxdeviation = 0.0;
+}
+
 // Factory for PairQuantity evaluators ---------------------------------------
 
 PQEvaluatorPtr createPQEvaluator(PQEvaluatorType pqtp, PQEvaluatorPtr pqevsrc)
@@ -472,5 +715,7 @@ DIFFPY_INSTANTIATE_SERIALIZATION(diffpy::srreal::PQEvaluatorBasic)
 BOOST_CLASS_EXPORT_IMPLEMENT(diffpy::srreal::PQEvaluatorBasic)
 DIFFPY_INSTANTIATE_SERIALIZATION(diffpy::srreal::PQEvaluatorOptimized)
 BOOST_CLASS_EXPORT_IMPLEMENT(diffpy::srreal::PQEvaluatorOptimized)
+DIFFPY_INSTANTIATE_SERIALIZATION(diffpy::srreal::PQEvaluatorCheck)
+BOOST_CLASS_EXPORT_IMPLEMENT(diffpy::srreal::PQEvaluatorCheck)
 
 // End of file
@@ -18,6 +18,9 @@
 * class PQEvaluatorOptimized -- optimized PairQuantity evaluator with fast
 *     quantity updates
 *
+* class PQEvaluatorCheck -- OPTIMIZED evaluator that verifies sampled
+*     fast updates against the BASIC evaluation
+*
 *****************************************************************************/
 
 
@@ -37,6 +40,7 @@ namespace diffpy {
 namespace srreal {
 
 class PairQuantity;
+class CompiledPairMask;
 
 /// shared pointer to PQEvaluatorBasic
 
@@ -62,9 +66,13 @@ class PQEvaluatorBasic
         virtual ~PQEvaluatorBasic()  { }
 
         // methods
+        virtual PQEvaluatorPtr clone() const;
         virtual PQEvaluatorType typeint() const;
         PQEvaluatorType typeintused() const;
         virtual void updateValue(PairQuantity&, StructureAdapterPtr);
+        /// record that the value of pq was summed over all pairs
+        /// of its current structure outside of this evaluator
+        virtual void recordCompleteUpdate(PairQuantity&);
         virtual void validate(PairQuantity&) const;
         void setFlag(PQEvaluatorFlag flag, bool value);
         bool getFlag(PQEvaluatorFlag flag) const;
@@ -73,6 +81,12 @@ class PQEvaluatorBasic
 
     protected:
 
+        // methods
+        /// add contributions of the bonds at the current anchor site,
+        /// count bonds in pchop to process only those for this CPU
+        void addAnchorContributions(PairQuantity&, BaseBondGenerator&,
+                const CompiledPairMask* pmask, int sign,
+                long* pchop=NULL) const;
 
         // data
         /// per-bit storage of boolean configuration flags
@@ -103,17 +117,27 @@ class PQEvaluatorOptimized : public PQEvaluatorBasic
     public:
 
         // methods
+        virtual PQEvaluatorPtr clone() const;
         virtual PQEvaluatorType typeint() const;
         virtual void validate(PairQuantity&) const;
         virtual void updateValue(PairQuantity&, StructureAdapterPtr);
+        virtual void recordCompleteUpdate(PairQuantity&);
 
     private:
 
         // data
         StructureAdapterPtr mlast_structure;
+        /// scratch site indices reused in fast updates
+        SiteIndices manchors;
+        SiteIndices munchanged;
 
         // helper method
         void updateValueCompletely(PairQuantity&, StructureAdapterPtr);
+        /// keep a clone of the pq structure for the next fast update
+        void recordLastStructure(PairQuantity&);
+        /// sum only bonds in the shells of a changed r-range,
+        /// return false if the value must be calculated otherwise
+        bool updateValueRange(PairQuantity&, StructureAdapterPtr);
 
         // serialization
         friend class boost::serialization::access;
@@ -131,12 +155,40 @@ class PQEvaluatorCheck : public PQEvaluatorOptimized
 {
     public:
 
+        // constructor
+        PQEvaluatorCheck();
+
         // methods
+        virtual PQEvaluatorPtr clone() const;
         virtual PQEvaluatorType typeint() const;
         virtual void updateValue(PairQuantity&, StructureAdapterPtr);
 
+        // sampling
+        /// compare every n-th OPTIMIZED evaluation with the BASIC one
+        void setCheckInterval(int n);
+        int getCheckInterval() const;
+        /// throw logic_error on mismatch, otherwise only record it
+        void setThrowOnMismatch(bool);
+        bool getThrowOnMismatch() const;
+
+        // mismatch statistics
+        long countChecks() const;
+        long countMismatches() const;
+        /// largest difference from the BASIC value over all checks
+        double getMaxDeviation() const;
+        void resetStatistics();
+
     private:
 
+        // data
+        int mcheckinterval;
+        bool mthrowonmismatch;
+        /// OPTIMIZED evaluations since the last check
+        int mcntskipped;
+        long mcntchecks;
+        long mcntmismatches;
+        double mmaxdeviation;
+
         // serialization
         friend class boost::serialization::access;
         template<class Archive>
@@ -144,6 +196,8 @@ class PQEvaluatorCheck : public PQEvaluatorOptimized
         {
             using boost::serialization::base_object;
             ar & base_object<PQEvaluatorOptimized>(*this);
+            ar & mcheckinterval & mthrowonmismatch & mcntskipped;
+            ar & mcntchecks & mcntmismatches & mmaxdeviation;
         }
 };
 
@@ -160,5 +214,6 @@ PQEvaluatorPtr createPQEvaluator(
 BOOST_SERIALIZATION_ASSUME_ABSTRACT(diffpy::srreal::PQEvaluatorBasic)
 BOOST_CLASS_EXPORT_KEY(diffpy::srreal::PQEvaluatorBasic)
 BOOST_CLASS_EXPORT_KEY(diffpy::srreal::PQEvaluatorOptimized)
+BOOST_CLASS_EXPORT_KEY(diffpy::srreal::PQEvaluatorCheck)
 
 #endif  // PQEVALUATOR_HPP_INCLUDED
@@ -0,0 +1,185 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class PackedStructureView -- contiguous copy of the site data of
+*     a StructureAdapter
+*
+*****************************************************************************/
+
+#include <algorithm>
+
+#include <diffpy/srreal/PackedStructureView.hpp>
+#include <diffpy/srreal/StructureAdapter.hpp>
+#include <diffpy/srreal/StructureDifference.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
+
+using namespace std;
+
+namespace diffpy {
+namespace srreal {
+
+//////////////////////////////////////////////////////////////////////////////
+// class PackedStructureView
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+PackedStructureView::PackedStructureView() : mtotaloccupancy(0.0)
+{ }
+
+// Public Methods ------------------------------------------------------------
+
+void PackedStructureView::assign(const StructureAdapter& stru)
+{
+    this->clear();
+    const int cntsites = stru.countSites();
+    mpositions.resize(cntsites);
+    mtypeids.resize(cntsites);
+    moccupancies.resize(cntsites);
+    mmultiplicities.resize(cntsites);
+    muiso.resize(cntsites);
+    muijindex.resize(cntsites, -1);
+    // local type index for every interned atom type id
+    SiteIndices localtypes;
+    for (int i = 0; i < cntsites; ++i)
+    {
+        const int tid = stru.siteAtomTypeId(i);
+        if (tid >= int(localtypes.size()))  localtypes.resize(tid + 1, -1);
+        int& tp = localtypes[tid];
+        if (tp < 0)
+        {
+            tp = matomtypes.size();
+            matomtypes.push_back(atomTypeName(tid));
+            matomtypeids.push_back(tid);
+            mtypecounts.push_back(0);
+        }
+        this->copySite(stru, i, tp);
+    }
+}
+
+
+void PackedStructureView::update(const StructureDifference& sd)
+{
+    assert(sd.stru1);
+    StructureAdapterConstPtr src = msource.lock();
+    msource.reset();
+    const bool samesource = src && src == sd.stru0 &&
+        sd.diffmethod == StructureDifference::Method::SIDEBYSIDE;
+    if (samesource && this->updateSites(sd))  return;
+    this->assign(*sd.stru1);
+}
+
+
+void PackedStructureView::setSource(StructureAdapterConstPtr stru)
+{
+    assert(!stru || stru->countSites() == this->countSites());
+    msource = stru;
+}
+
+
+void PackedStructureView::clear()
+{
+    msource.reset();
+    mpositions.clear();
+    mtypeids.clear();
+    matomtypes.clear();
+    matomtypeids.clear();
+    mtypecounts.clear();
+    moccupancies.clear();
+    mmultiplicities.clear();
+    muiso.clear();
+    muijindex.clear();
+    muijaniso.clear();
+    mtotaloccupancy = 0.0;
+}
+
+// Private Methods -----------------------------------------------------------
+
+bool PackedStructureView::updateSites(const StructureDifference& sd)
+{
+    const StructureAdapter& stru = *sd.stru1;
+    const int n0 = this->countSites();
+    const int n1 = stru.countSites();
+    // side-by-side differences list all sites beyond the shorter structure
+    mchanged.assign(sd.add1.begin(), sd.add1.end());
+    SiteIndices::const_iterator ii;
+    for (ii = sd.pop0.begin(); ii != sd.pop0.end(); ++ii)
+    {
+        if (*ii < n1)  mchanged.push_back(*ii);
+    }
+    sort(mchanged.begin(), mchanged.end());
+    mchanged.erase(unique(mchanged.begin(), mchanged.end()), mchanged.end());
+    const int cntadded = mchanged.end() -
+        lower_bound(mchanged.begin(), mchanged.end(), n0);
+    if (n1 > n0 && cntadded != n1 - n0)  return false;
+    for (int i = n1; i < n0; ++i)  this->removeSite(i);
+    mpositions.resize(n1);
+    mtypeids.resize(n1);
+    moccupancies.resize(n1);
+    mmultiplicities.resize(n1);
+    muiso.resize(n1);
+    muijindex.resize(n1, -1);
+    for (ii = mchanged.begin(); ii != mchanged.end(); ++ii)
+    {
+        if (*ii < n0)  this->removeSite(*ii);
+        // new atom types are added by copying all sites
+        const int tid = stru.siteAtomTypeId(*ii);
+        SiteIndices::const_iterator tt =
+            find(matomtypeids.begin(), matomtypeids.end(), tid);
+        if (tt == matomtypeids.end())  return false;
+        this->copySite(stru, *ii, tt - matomtypeids.begin());
+    }
+    // so are the atom types without any site
+    SiteIndices::const_iterator tc;
+    for (tc = mtypecounts.begin(); tc != mtypecounts.end(); ++tc)
+    {
+        if (*tc <= 0)  return false;
+    }
+    return true;
+}
+
+
+void PackedStructureView::removeSite(int idx)
+{
+    mtotaloccupancy -= moccupancies[idx] * mmultiplicities[idx];
+    --mtypecounts[mtypeids[idx]];
+}
+
+
+void PackedStructureView::copySite(
+        const StructureAdapter& stru, int idx, int tp)
+{
+    mtypeids[idx] = tp;
+    ++mtypecounts[tp];
+    mpositions[idx] = stru.siteCartesianPosition(idx);
+    moccupancies[idx] = stru.siteOccupancy(idx);
+    mmultiplicities[idx] = stru.siteMultiplicity(idx);
+    mtotaloccupancy += moccupancies[idx] * mmultiplicities[idx];
+    const R3::Matrix& Uijc = stru.siteCartesianUij(idx);
+    muiso[idx] = Uijc(0, 0);
+    int& kuij = muijindex[idx];
+    if (!stru.siteAnisotropy(idx))  kuij = -1;
+    else if (kuij >= 0)  muijaniso[kuij] = Uijc;
+    else
+    {
+        // slots of sites that were removed or became isotropic are
+        // dropped when all sites are copied again
+        kuij = muijaniso.size();
+        muijaniso.push_back(Uijc);
+    }
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+// End of file
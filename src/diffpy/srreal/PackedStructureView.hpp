@@ -0,0 +1,213 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class PackedStructureView -- contiguous copy of the site data of
+*     a StructureAdapter
+*
+* PairQuantity fills the view in setStructure so that calculators and
+* bond generators can read the site data during one evaluation without
+* virtual calls through the adapter and any wrapper adapters.  The fast
+* updates in PQEvaluatorOptimized copy only the changed sites.  The view
+* keeps the Uij matrices only for the anisotropic sites.
+*
+*****************************************************************************/
+
+#ifndef PACKEDSTRUCTUREVIEW_HPP_INCLUDED
+#define PACKEDSTRUCTUREVIEW_HPP_INCLUDED
+
+#include <cassert>
+#include <string>
+#include <vector>
+#include <boost/weak_ptr.hpp>
+
+#include <diffpy/srreal/R3linalg.hpp>
+#include <diffpy/srreal/forwardtypes.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+class StructureAdapter;
+class StructureDifference;
+
+class PackedStructureView
+{
+    public:
+
+        // constructor
+        PackedStructureView();
+
+        // methods
+        /// copy site data from the structure adapter
+        void assign(const StructureAdapter& stru);
+        /// copy only the sites changed in sd when the view holds the sites
+        /// of sd.stru0, otherwise copy all sites of sd.stru1
+        void update(const StructureDifference& sd);
+        /// mark the view as a copy of the sites in stru, which is a clone
+        /// of the assigned structure kept for later updates
+        void setSource(StructureAdapterConstPtr stru);
+        void clear();
+        int countSites() const;
+        /// number of distinct atom types
+        int countTypes() const;
+        /// distinct atom types in the order of their first site when
+        /// all sites were copied
+        const std::vector<std::string>& atomTypes() const;
+        /// interned atom type ids of atomTypes
+        const SiteIndices& atomTypeIds() const;
+        /// index of the site atom type in atomTypes
+        int siteTypeId(int idx) const;
+        const std::string& siteAtomType(int idx) const;
+        /// interned id of the site atom type
+        int siteAtomTypeId(int idx) const;
+        const R3::Vector& siteCartesianPosition(int idx) const;
+        int siteMultiplicity(int idx) const;
+        const double& siteOccupancy(int idx) const;
+        bool siteAnisotropy(int idx) const;
+        /// diagonal element U(0,0) of the site Uij matrix
+        const double& siteUiso(int idx) const;
+        /// Uij matrix of an anisotropic site
+        const R3::Matrix& siteCartesianUij(int idx) const;
+        const double& totalOccupancy() const;
+
+    private:
+
+        // data
+        boost::weak_ptr<const StructureAdapter> msource;
+        std::vector<R3::Vector> mpositions;
+        SiteIndices mtypeids;
+        std::vector<std::string> matomtypes;
+        SiteIndices matomtypeids;
+        /// number of sites of every type in atomTypes
+        SiteIndices mtypecounts;
+        std::vector<double> moccupancies;
+        std::vector<int> mmultiplicities;
+        std::vector<double> muiso;
+        /// index of the site in muijaniso or -1 for isotropic sites
+        SiteIndices muijindex;
+        std::vector<R3::Matrix> muijaniso;
+        double mtotaloccupancy;
+        /// scratch indices of the sites copied in update
+        SiteIndices mchanged;
+
+        // methods
+        bool updateSites(const StructureDifference& sd);
+        void removeSite(int idx);
+        /// copy site idx of stru that has the tp-th type in atomTypes
+        void copySite(const StructureAdapter& stru, int idx, int tp);
+
+};
+
+// Inline Methods ------------------------------------------------------------
+
+inline
+int PackedStructureView::countSites() const
+{
+    return mpositions.size();
+}
+
+
+inline
+int PackedStructureView::countTypes() const
+{
+    return matomtypes.size();
+}
+
+
+inline
+const std::vector<std::string>& PackedStructureView::atomTypes() const
+{
+    return matomtypes;
+}
+
+
+inline
+const SiteIndices& PackedStructureView::atomTypeIds() const
+{
+    return matomtypeids;
+}
+
+
+inline
+int PackedStructureView::siteTypeId(int idx) const
+{
+    return mtypeids[idx];
+}
+
+
+inline
+const std::string& PackedStructureView::siteAtomType(int idx) const
+{
+    return matomtypes[mtypeids[idx]];
+}
+
+
+inline
+int PackedStructureView::siteAtomTypeId(int idx) const
+{
+    return matomtypeids[mtypeids[idx]];
+}
+
+
+inline
+const R3::Vector& PackedStructureView::siteCartesianPosition(int idx) const
+{
+    return mpositions[idx];
+}
+
+
+inline
+int PackedStructureView::siteMultiplicity(int idx) const
+{
+    return mmultiplicities[idx];
+}
+
+
+inline
+const double& PackedStructureView::siteOccupancy(int idx) const
+{
+    return moccupancies[idx];
+}
+
+
+inline
+bool PackedStructureView::siteAnisotropy(int idx) const
+{
+    return muijindex[idx] >= 0;
+}
+
+
+inline
+const double& PackedStructureView::siteUiso(int idx) const
+{
+    return muiso[idx];
+}
+
+
+inline
+const R3::Matrix& PackedStructureView::siteCartesianUij(int idx) const
+{
+    assert(this->siteAnisotropy(idx));
+    return muijaniso[muijindex[idx]];
+}
+
+
+inline
+const double& PackedStructureView::totalOccupancy() const
+{
+    return mtotaloccupancy;
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+#endif  // PACKEDSTRUCTUREVIEW_HPP_INCLUDED
@@ -17,6 +17,7 @@
 *****************************************************************************/
 
 #include <diffpy/srreal/PairCounter.hpp>
+#include <diffpy/srreal/BondBlock.hpp>
 
 using namespace diffpy::srreal;
 
@@ -37,4 +38,12 @@ void PairCounter::addPairContribution(const BaseBondGenerator& bnds,
     mvalue.front() += summationscale / 2.0;
 }
 
+
+void PairCounter::addPairContributions(const BondBlock& blk)
+{
+    int sumscale = 0;
+    for (int k = 0; k < blk.count; ++k)  sumscale += blk.summationscale[k];
+    mvalue.front() += sumscale / 2.0;
+}
+
 // End of file
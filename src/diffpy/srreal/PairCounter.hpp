@@ -38,6 +38,8 @@ class PairCounter : public PairQuantity
 
         // methods
         virtual void addPairContribution(const BaseBondGenerator&, int);
+        virtual bool usesBondBlocks() const  { return true; }
+        virtual void addPairContributions(const BondBlock&);
 
 };
 
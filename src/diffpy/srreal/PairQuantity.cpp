@@ -21,6 +21,8 @@
 #include <sstream>
 
 #include <diffpy/srreal/PairQuantity.hpp>
+#include <diffpy/srreal/AtomicStructureAdapter.hpp>
+#include <diffpy/srreal/StructureDifference.hpp>
 #include <diffpy/mathutils.hpp>
 #include <diffpy/serialization.ipp>
 
@@ -60,8 +62,12 @@ const QuantityType& PairQuantity::eval()
 
 const QuantityType& PairQuantity::eval(StructureAdapterPtr stru)
 {
+    mevalcounters.startRecording();
     mevaluator->updateValue(*this, stru);
+    mevalcounters.lapTimer(EvalCounters::PAIR_SUM_TIME);
     this->finishValue();
+    mevalcounters.lapTimer(EvalCounters::FINISH_TIME);
+    mevalcounters.stopRecording();
     return this->value();
 }
 
@@ -69,9 +75,8 @@ const QuantityType& PairQuantity::eval(StructureAdapterPtr stru)
 void PairQuantity::setStructure(StructureAdapterPtr stru)
 {
     mstructure = stru.get() ? stru : emptyStructureAdapter();
-    mstructure->customPQConfig(this);
-    this->updateMaskData();
-    this->resetValue();
+    mpackedview.assign(*mstructure);
+    this->configureStructure();
 }
 
 
@@ -117,7 +122,7 @@ string PairQuantity::getParallelData() const
 
 void PairQuantity::setRmin(double rmin)
 {
-    if (mrmin != rmin)  mticker.click();
+    if (mrmin != rmin)  this->recordRangeChange();
     mrmin = rmin;
 }
 
@@ -130,7 +135,7 @@ const double& PairQuantity::getRmin() const
 
 void PairQuantity::setRmax(double rmax)
 {
-    if (mrmax != rmax)  mticker.click();
+    if (mrmax != rmax)  this->recordRangeChange();
     mrmax = rmax;
 }
 
@@ -184,7 +189,11 @@ void PairQuantity::maskAllPairs(bool mask)
 {
     bool nochange = minvertpairmask.empty() && msiteallmask.empty() &&
         mtypemask.empty() && (mdefaultpairmask == mask);
-    if (!nochange)  mticker.click();
+    if (!nochange)
+    {
+        mticker.click();
+        mcompiledmask.invalidate();
+    }
     minvertpairmask.clear();
     msiteallmask.clear();
     mtypemask.clear();
@@ -195,6 +204,7 @@ void PairQuantity::maskAllPairs(bool mask)
 void PairQuantity::invertMask()
 {
     mticker.click();
+    mcompiledmask.invalidate();
     mdefaultpairmask = !mdefaultpairmask;
     unordered_map<int, bool>::iterator mm;
     for (mm = msiteallmask.begin(); mm != msiteallmask.end(); ++mm)
@@ -239,7 +249,11 @@ void PairQuantity::setPairMask(int i, int j, bool mask)
         {
             this->setPairMaskValue(k, l, mask);
         }
-        if (modified)  mticker.click();
+        if (modified)
+        {
+            mticker.click();
+            mcompiledmask.invalidate();
+        }
         return;
     }
     // here neither i nor j is ALLATOMSINT
@@ -257,7 +271,11 @@ void PairQuantity::setPairMask(int i, int j, bool mask)
         modified = true;
     }
     modified = this->setPairMaskValue(i, j, mask) ? true : modified;
-    if (modified)  mticker.click();
+    if (modified)
+    {
+        mticker.click();
+        mcompiledmask.invalidate();
+    }
 }
 
 
@@ -318,7 +336,11 @@ setTypeMask(string smbli, string smblj, bool mask)
     pmm = mtypemask.emplace(smblij, mask);
     if (pmm.second || pmm.first->second != mask)  modified = true;
     pmm.first->second = mask;
-    if (modified)  mticker.click();
+    if (modified)
+    {
+        mticker.click();
+        mcompiledmask.invalidate();
+    }
 }
 
 
@@ -337,6 +359,132 @@ bool PairQuantity::getTypeMask(const string& smbli, const string& smblj) const
     return rv;
 }
 
+
+const QuantityType& PairQuantity::proposeMove(
+        const SiteIndices& sites, const std::vector<Atom>& newatoms)
+{
+    if (this->hasPendingMove())
+    {
+        const char* emsg = "Trial move is pending, use commit or rollback.";
+        throw logic_error(emsg);
+    }
+    if (sites.size() != newatoms.size())
+    {
+        const char* emsg = "sites and newatoms must have the same length.";
+        throw invalid_argument(emsg);
+    }
+    AtomicStructureAdapterPtr stru0 =
+        boost::dynamic_pointer_cast<AtomicStructureAdapter>(mstructure);
+    if (!stru0)
+    {
+        const char* emsg =
+            "Trial moves require structure derived from AtomicStructureAdapter.";
+        throw invalid_argument(emsg);
+    }
+    const int cntsites = stru0->countSites();
+    SiteIndices::const_iterator ii = sites.begin();
+    for (; ii != sites.end(); ++ii)
+    {
+        if (*ii < 0 || *ii >= cntsites)
+        {
+            const char* emsg = "Index out of range.";
+            throw invalid_argument(emsg);
+        }
+    }
+    // trial structure shares all unchanged atoms and records the
+    // changed sites in its journal for a fast OPTIMIZED update.
+    StructureAdapterPtr trial = stru0->clone();
+    AtomicStructureAdapter& astru1 =
+        dynamic_cast<AtomicStructureAdapter&>(*trial);
+    std::vector<Atom>::const_iterator ai = newatoms.begin();
+    for (ii = sites.begin(); ii != sites.end(); ++ii, ++ai)
+    {
+        astru1.setAtom(*ii, *ai);
+    }
+    // keep the original evaluator and value for rollback
+    mmovestash.structure = mstructure;
+    mmovestash.evaluator = mevaluator;
+    mevaluator = mevaluator->clone();
+    this->stashMoveValue();
+    try
+    {
+        this->eval(trial);
+    }
+    catch (...)
+    {
+        this->rollback();
+        throw;
+    }
+    return this->value();
+}
+
+
+void PairQuantity::commit()
+{
+    if (!this->hasPendingMove())
+    {
+        const char* emsg = "There is no trial move to commit.";
+        throw logic_error(emsg);
+    }
+    // copy trial atoms to the original structure.  Both structures then
+    // share the same atoms version, which the evaluator has seen already.
+    AtomicStructureAdapter& astru0 =
+        dynamic_cast<AtomicStructureAdapter&>(*mmovestash.structure);
+    const AtomicStructureAdapter& astru1 =
+        dynamic_cast<const AtomicStructureAdapter&>(*mstructure);
+    astru0 = astru1;
+    mstructure = mmovestash.structure;
+    mmovestash.structure.reset();
+    mmovestash.evaluator.reset();
+    this->discardMoveValue();
+}
+
+
+void PairQuantity::rollback()
+{
+    if (!this->hasPendingMove())
+    {
+        const char* emsg = "There is no trial move to roll back.";
+        throw logic_error(emsg);
+    }
+    this->setStructure(mmovestash.structure);
+    mevaluator = mmovestash.evaluator;
+    this->restoreMoveValue();
+    mmovestash.structure.reset();
+    mmovestash.evaluator.reset();
+}
+
+
+bool PairQuantity::hasPendingMove() const
+{
+    return bool(mmovestash.structure);
+}
+
+// instrumentation
+
+const EvalCounters& PairQuantity::getEvalCounters() const
+{
+    return mevalcounters;
+}
+
+
+EvalCounters& PairQuantity::getEvalCounters()
+{
+    return mevalcounters;
+}
+
+
+PQEvaluatorCheck& PairQuantity::getCheckEvaluator()
+{
+    PQEvaluatorCheck* rv = dynamic_cast<PQEvaluatorCheck*>(mevaluator.get());
+    if (!rv)
+    {
+        const char* emsg = "EvaluatorType must be CHECK.";
+        throw logic_error(emsg);
+    }
+    return *rv;
+}
+
 // Protected Methods ---------------------------------------------------------
 
 void PairQuantity::resizeValue(size_t sz)
@@ -349,6 +497,8 @@ void PairQuantity::resetValue()
 {
     mmergedvaluescount = 0;
     fill(mvalue.begin(), mvalue.end(), 0.0);
+    // r-range update needs a complete value from the next evaluation
+    mrangeticks.before.click();
 }
 
 
@@ -381,6 +531,21 @@ int PairQuantity::countSites() const
 }
 
 
+const PackedStructureView& PairQuantity::getPackedView() const
+{
+    return mpackedview;
+}
+
+
+void PairQuantity::updateStructure(const StructureDifference& sd)
+{
+    assert(sd.stru1);
+    mstructure = boost::const_pointer_cast<StructureAdapter>(sd.stru1);
+    mpackedview.update(sd);
+    this->configureStructure();
+}
+
+
 bool PairQuantity::hasMask() const
 {
     bool rv = !(mdefaultpairmask && minvertpairmask.empty() &&
@@ -402,6 +567,13 @@ bool PairQuantity::hasTypeMask() const
 }
 
 
+const CompiledPairMask& PairQuantity::getCompiledPairMask() const
+{
+    if (!mcompiledmask.isValid())  this->compilePairMask();
+    return mcompiledmask;
+}
+
+
 void PairQuantity::stashPartialValue()
 {
     const char* emsg =
@@ -417,8 +589,62 @@ void PairQuantity::restorePartialValue()
     throw logic_error(emsg);
 }
 
+
+bool PairQuantity::popCachedSites(const StructureDifference& sd)
+{
+    return false;
+}
+
+
+bool PairQuantity::hasOnlyRangeChanges(
+        const eventticker::EventTicker& valuetick) const
+{
+    bool rv = (mrangeticks.before < valuetick) &&
+        (this->ticker() <= mrangeticks.last);
+    return rv;
+}
+
+
+bool PairQuantity::stashRangeValue()
+{
+    return false;
+}
+
+
+bool PairQuantity::restoreRangeValue(RangeShells& shells)
+{
+    return false;
+}
+
+
+void PairQuantity::stashMoveValue()
+{
+    mmovestash.value = mvalue;
+}
+
+
+void PairQuantity::restoreMoveValue()
+{
+    mvalue.swap(mmovestash.value);
+    mmovestash.value.clear();
+}
+
+
+void PairQuantity::discardMoveValue()
+{
+    mmovestash.value.clear();
+}
+
 // Private Methods -----------------------------------------------------------
 
+void PairQuantity::configureStructure()
+{
+    mstructure->customPQConfig(this);
+    this->updateMaskData();
+    this->resetValue();
+}
+
+
 void PairQuantity::updateMaskData()
 {
     int cntsites = this->countSites();
@@ -474,6 +700,10 @@ void PairQuantity::updateMaskData()
             }
         }
     }
+    // compile the mask for the evaluators while the site count is known.
+    // PQEvaluatorOptimized uses it for the old structure in the next update.
+    mcompiledmask.invalidate();
+    if (this->hasMask())  this->compilePairMask();
 }
 
 
@@ -488,6 +718,65 @@ bool PairQuantity::setPairMaskValue(int i, int j, bool mask)
     return rv;
 }
 
+void PairQuantity::compilePairMask() const
+{
+    int cntsites = this->countSites();
+    mcompiledmask.reset(cntsites, mdefaultpairmask);
+    // index masks are expressed with site masks and exceptional pairs
+    if (mtypemask.empty())
+    {
+        unordered_map<int, bool>::const_iterator ia;
+        for (ia = msiteallmask.begin(); ia != msiteallmask.end(); ++ia)
+        {
+            if (ia->first < cntsites)
+            {
+                mcompiledmask.setSiteMask(ia->first, ia->second);
+            }
+        }
+        PairMaskStorage::const_iterator ij;
+        for (ij = minvertpairmask.begin(); ij != minvertpairmask.end(); ++ij)
+        {
+            if (ij->first >= cntsites || ij->second >= cntsites)  continue;
+            mcompiledmask.setPairException(
+                    ij->first, ij->second, !mdefaultpairmask);
+        }
+        mcompiledmask.finalize();
+        return;
+    }
+    // type masks are uniform for all sites of the same atom type
+    unordered_map<string, int> typeids;
+    SiteIndices sitetypes(cntsites);
+    SiteIndices firstsites;
+    for (int i = 0; i < cntsites; ++i)
+    {
+        const string& smbl = mstructure->siteAtomType(i);
+        pair<unordered_map<string, int>::iterator, bool> tid;
+        tid = typeids.emplace(smbl, int(firstsites.size()));
+        if (tid.second)  firstsites.push_back(i);
+        sitetypes[i] = tid.first->second;
+    }
+    const int cnttypes = firstsites.size();
+    mcompiledmask.setSiteTypes(sitetypes, cnttypes);
+    for (int ti = 0; ti < cnttypes; ++ti)
+    {
+        for (int tj = ti; tj < cnttypes; ++tj)
+        {
+            bool msk = this->getPairMask(firstsites[ti], firstsites[tj]);
+            mcompiledmask.setTypePairMask(ti, tj, msk);
+        }
+    }
+}
+
+
+void PairQuantity::recordRangeChange()
+{
+    // start a new series of r-range changes if anything else changed
+    const eventticker::EventTicker& tic = this->ticker();
+    if (tic > mrangeticks.last)  mrangeticks.before.updateFrom(tic);
+    mticker.click();
+    mrangeticks.last = mticker;
+}
+
 // Other functions -----------------------------------------------------------
 
 /// The purpose of this function is to support Python pickling of
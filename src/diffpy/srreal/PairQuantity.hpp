@@ -27,6 +27,9 @@
 #include <boost/functional/hash.hpp>
 
 #include <diffpy/srreal/PQEvaluator.hpp>
+#include <diffpy/srreal/CompiledPairMask.hpp>
+#include <diffpy/srreal/EvalCounters.hpp>
+#include <diffpy/srreal/PackedStructureView.hpp>
 #include <diffpy/srreal/StructureAdapter.hpp>
 #include <diffpy/srreal/QuantityType.hpp>
 #include <diffpy/Attributes.hpp>
@@ -36,6 +39,8 @@ namespace diffpy {
 namespace srreal {
 
 class BaseBondGenerator;
+class Atom;
+class BondBlock;
 
 class PairQuantity : public diffpy::Attributes
 {
@@ -77,6 +82,25 @@ class PairQuantity : public diffpy::Attributes
         void setTypeMask(std::string, std::string, bool mask);
         bool getTypeMask(const std::string&, const std::string&) const;
 
+        // trial moves
+        /// evaluate trial value with atoms at sites replaced by newatoms.
+        /// The structure must be derived from AtomicStructureAdapter.
+        const QuantityType& proposeMove(const SiteIndices& sites,
+                const std::vector<Atom>& newatoms);
+        /// accept the trial move and apply it to the structure
+        void commit();
+        /// discard the trial move and restore the previous value
+        void rollback();
+        bool hasPendingMove() const;
+
+        // instrumentation
+        /// work counters and timers of the last eval call
+        const EvalCounters& getEvalCounters() const;
+        EvalCounters& getEvalCounters();
+        /// sampling setup and mismatch statistics of the CHECK evaluator,
+        /// throw logic_error for other evaluator types
+        PQEvaluatorCheck& getCheckEvaluator();
+
         // ticker for any updates in configuration
         virtual eventticker::EventTicker& ticker() const  { return mticker; }
 
@@ -84,6 +108,7 @@ class PairQuantity : public diffpy::Attributes
 
         friend class PQEvaluatorBasic;
         friend class PQEvaluatorOptimized;
+        friend class PairQuantityGroup;
         friend StructureAdapterPtr
             replacePairQuantityStructure(PairQuantity&, StructureAdapterPtr);
 
@@ -92,15 +117,46 @@ class PairQuantity : public diffpy::Attributes
         virtual void resetValue();
         virtual void configureBondGenerator(BaseBondGenerator&) const;
         virtual void addPairContribution(const BaseBondGenerator&, int) { }
+        /// return true if addPairContributions handles bond blocks
+        virtual bool usesBondBlocks() const  { return false; }
+        virtual void addPairContributions(const BondBlock&) { }
         virtual void executeParallelMerge(const std::string& pdata);
         virtual void finishValue() { }
         int countSites() const;
+        /// site data of the structure copied in the last setStructure
+        const PackedStructureView& getPackedView() const;
         // support methods for PQEvaluatorOptimized
+        /// set the new structure sd.stru1 and copy only its sites
+        /// changed in sd to the packed view
+        void updateStructure(const StructureDifference& sd);
         bool hasMask() const;
         bool hasPairMask() const;
         bool hasTypeMask() const;
+        /// pair mask compiled for fast lookup in the evaluator loops
+        const CompiledPairMask& getCompiledPairMask() const;
         virtual void stashPartialValue();
         virtual void restorePartialValue();
+        /// remove cached contributions of the popped sites in sd,
+        /// return true when they do not need to be summed over pairs
+        virtual bool popCachedSites(const StructureDifference& sd);
+        // support methods for incremental r-range updates
+        /// intervals of bond distances summed in the r-range update
+        typedef std::vector< std::pair<double,double> > RangeShells;
+        /// return true if the r-range is the only configuration change
+        /// after the value was calculated at valuetick
+        bool hasOnlyRangeChanges(
+                const eventticker::EventTicker& valuetick) const;
+        /// stash the value and its r-range before setStructure,
+        /// return false if the r-range update is not supported
+        virtual bool stashRangeValue();
+        /// restore the stashed value for the current r-range and obtain
+        /// bond shells to be summed, return false if they take more work
+        virtual bool restoreRangeValue(RangeShells& shells);
+        virtual void finishRangeUpdate()  { }
+        // support methods for trial moves
+        virtual void stashMoveValue();
+        virtual void restoreMoveValue();
+        virtual void discardMoveValue();
 
         // data
         typedef std::unordered_set<
@@ -122,12 +178,33 @@ class PairQuantity : public diffpy::Attributes
         TypeMaskStorage mtypemask;
         int mmergedvaluescount;
         mutable eventticker::EventTicker mticker;
+        /// counters of the last eval, const getters may add to them
+        mutable EvalCounters mevalcounters;
 
     private:
 
         // methods
+        void configureStructure();
         void updateMaskData();
         bool setPairMaskValue(int i, int j, bool mask);
+        void compilePairMask() const;
+        void recordRangeChange();
+
+        // data
+        /// tickers of the last change or value reset before the r-range
+        /// changes and of the last r-range change
+        struct {
+            eventticker::EventTicker before;
+            eventticker::EventTicker last;
+        } mrangeticks;
+        /// state before the pending trial move
+        struct {
+            StructureAdapterPtr structure;
+            PQEvaluatorPtr evaluator;
+            QuantityType value;
+        } mmovestash;
+        mutable CompiledPairMask mcompiledmask;
+        PackedStructureView mpackedview;
 
         // serialization
         friend class boost::serialization::access;
@@ -145,6 +222,8 @@ class PairQuantity : public diffpy::Attributes
             ar & mtypemask;
             ar & mmergedvaluescount;
             ar & mticker;
+            // the view is a cache that is rebuilt after loading
+            if (Archive::is_loading::value)  mpackedview.assign(*mstructure);
         }
 
 };
@@ -0,0 +1,238 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class PairQuantityGroup -- evaluate several PairQuantity instances
+*     for one structure from a single bond enumeration
+*
+*****************************************************************************/
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <diffpy/srreal/PairQuantityGroup.hpp>
+#include <diffpy/srreal/BaseBondGenerator.hpp>
+#include <diffpy/srreal/BondBlock.hpp>
+#include <diffpy/srreal/PQEvaluator.hpp>
+#include <diffpy/mathutils.hpp>
+
+using namespace std;
+
+namespace diffpy {
+namespace srreal {
+
+using diffpy::mathutils::DOUBLE_MAX;
+
+//////////////////////////////////////////////////////////////////////////////
+// class PairQuantityGroup
+//////////////////////////////////////////////////////////////////////////////
+
+// Public Methods ------------------------------------------------------------
+
+// members
+
+void PairQuantityGroup::addMember(PairQuantityPtr pq)
+{
+    if (!pq)
+    {
+        const char* emsg = "Member PairQuantity must be defined.";
+        throw invalid_argument(emsg);
+    }
+    mmembers.push_back(pq);
+}
+
+
+int PairQuantityGroup::countMembers() const
+{
+    return mmembers.size();
+}
+
+
+PairQuantity& PairQuantityGroup::getMember(int idx)
+{
+    this->ensureMemberIndex(idx);
+    return *(mmembers[idx]);
+}
+
+
+const PairQuantity& PairQuantityGroup::getMember(int idx) const
+{
+    this->ensureMemberIndex(idx);
+    return *(mmembers[idx]);
+}
+
+
+void PairQuantityGroup::clearMembers()
+{
+    mmembers.clear();
+    msetup.clear();
+}
+
+// evaluation
+
+void PairQuantityGroup::eval(StructureAdapterPtr stru)
+{
+    for (const PairQuantityPtr& pq : mmembers)
+    {
+        if (pq->mevaluator->isParallel())
+        {
+            const char* emsg = "Group evaluation cannot split parallel runs.";
+            throw logic_error(emsg);
+        }
+    }
+    mevalcounters.startRecording();
+    if (!mmembers.empty())
+    {
+        for (PairQuantityPtr& pq : mmembers)  pq->setStructure(stru);
+        const PairQuantity& pq0 = *(mmembers.front());
+        BaseBondGeneratorPtr bnds = pq0.mstructure->createBondGenerator();
+        this->configureBondGenerator(*bnds);
+        bnds->setPackedView(&pq0.getPackedView());
+        this->sumBonds(*bnds);
+        for (PairQuantityPtr& pq : mmembers)
+        {
+            pq->mevaluator->recordCompleteUpdate(*pq);
+        }
+        DIFFPY_EVAL_COUNT(FULL_RECOMPUTES, mmembers.size());
+    }
+    mevalcounters.lapTimer(EvalCounters::PAIR_SUM_TIME);
+    for (PairQuantityPtr& pq : mmembers)  pq->finishValue();
+    mevalcounters.lapTimer(EvalCounters::FINISH_TIME);
+    mevalcounters.stopRecording();
+}
+
+
+void PairQuantityGroup::eval()
+{
+    StructureAdapterPtr stru;
+    if (!mmembers.empty())  stru = mmembers.front()->getStructure();
+    this->eval(stru);
+}
+
+// instrumentation
+
+const EvalCounters& PairQuantityGroup::getEvalCounters() const
+{
+    return mevalcounters;
+}
+
+
+EvalCounters& PairQuantityGroup::getEvalCounters()
+{
+    return mevalcounters;
+}
+
+// Private Methods -----------------------------------------------------------
+
+void PairQuantityGroup::ensureMemberIndex(int idx) const
+{
+    if (idx < 0 || idx >= this->countMembers())
+    {
+        const char* emsg = "Member index out of range.";
+        throw out_of_range(emsg);
+    }
+}
+
+
+void PairQuantityGroup::configureBondGenerator(BaseBondGenerator& bnds)
+{
+    // members may leave some settings at the generator defaults
+    const double rmin0 = bnds.getRmin();
+    const double rmax0 = bnds.getRmax();
+    const bool symred0 = bnds.getSymmetryReduction();
+    double rmin = DOUBLE_MAX;
+    double rmax = 0.0;
+    bool symred = true;
+    msetup.resize(mmembers.size());
+    for (size_t k = 0; k < mmembers.size(); ++k)
+    {
+        const PairQuantity& pq = *(mmembers[k]);
+        MemberSetup& ms = msetup[k];
+        bnds.setRmin(rmin0);
+        bnds.setRmax(rmax0);
+        bnds.setSymmetryReduction(symred0);
+        pq.configureBondGenerator(bnds);
+        ms.rmin = bnds.getRmin();
+        ms.rmax = bnds.getRmax();
+        ms.usefullsum = pq.mevaluator->getFlag(USEFULLSUM);
+        ms.usesbondblocks = pq.usesBondBlocks();
+        ms.pmask = pq.hasMask() ? &(pq.getCompiledPairMask()) : NULL;
+        rmin = min(rmin, ms.rmin);
+        rmax = max(rmax, ms.rmax);
+        // symmetry reduced bonds must be acceptable for all members
+        symred = symred && bnds.getSymmetryReduction();
+    }
+    bnds.setRmin(rmin);
+    bnds.setRmax(rmax);
+    bnds.setSymmetryReduction(symred);
+}
+
+
+void PairQuantityGroup::sumBonds(BaseBondGenerator& bnds)
+{
+    const int nmembers = mmembers.size();
+    bool usefullsum = false;
+    for (const MemberSetup& ms : msetup)
+    {
+        usefullsum = usefullsum || ms.usefullsum;
+    }
+    vector<BondBlock> blocks(nmembers);
+    const int cntsites = mmembers.front()->countSites();
+    long long cntpairs = 0;
+    for (int i0 = 0; i0 < cntsites; ++i0)
+    {
+        bnds.selectAnchorSite(i0);
+        int i1hi = usefullsum ? cntsites : (i0 + 1);
+        bnds.selectSiteRange(0, i1hi);
+        for (bnds.rewind(); !bnds.finished(); bnds.next())
+        {
+            const int i1 = bnds.site1();
+            const double& d = bnds.distance();
+            for (int k = 0; k < nmembers; ++k)
+            {
+                const MemberSetup& ms = msetup[k];
+                if (d < ms.rmin || d > ms.rmax)  continue;
+                // half sum members take only the lower triangle
+                if (!ms.usefullsum && i1 > i0)  continue;
+                if (ms.pmask && !(*ms.pmask)(i0, i1))   continue;
+                const int summationscale =
+                    (ms.usefullsum || i0 == i1) ? 1 : 2;
+                DIFFPY_EVAL_TALLY(++cntpairs);
+                PairQuantity& pq = *(mmembers[k]);
+                if (!ms.usesbondblocks)
+                {
+                    pq.addPairContribution(bnds, summationscale);
+                    continue;
+                }
+                BondBlock& blk = blocks[k];
+                blk.append(bnds);
+                blk.summationscale[blk.count - 1] = summationscale;
+                if (!blk.full())  continue;
+                pq.addPairContributions(blk);
+                blk.clear();
+            }
+        }
+        // pass the remaining bonds of this anchor site
+        for (int k = 0; k < nmembers; ++k)
+        {
+            if (!blocks[k].count)  continue;
+            mmembers[k]->addPairContributions(blocks[k]);
+            blocks[k].clear();
+        }
+    }
+    DIFFPY_EVAL_COUNT(PAIR_CONTRIBUTIONS, cntpairs);
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+// End of file
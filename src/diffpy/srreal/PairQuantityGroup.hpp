@@ -0,0 +1,100 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class PairQuantityGroup -- evaluate several PairQuantity instances
+*     for one structure from a single bond enumeration
+*
+* The bonds are generated once up to the largest cutoff of the members.
+* Every bond is passed to each member whose configureBondGenerator range
+* contains it and whose pair mask allows it.  Members that sum over half
+* of the pair matrix receive only bonds with site1 <= site0 and doubled
+* summation scale.  The group always sums over all pairs and records
+* the update in the member evaluators, so that their later OPTIMIZED
+* evaluations start from the group value.
+*
+*****************************************************************************/
+
+#ifndef PAIRQUANTITYGROUP_HPP_INCLUDED
+#define PAIRQUANTITYGROUP_HPP_INCLUDED
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include <diffpy/srreal/PairQuantity.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+typedef boost::shared_ptr<PairQuantity> PairQuantityPtr;
+
+class PairQuantityGroup
+{
+    public:
+
+        // members
+        void addMember(PairQuantityPtr pq);
+        int countMembers() const;
+        PairQuantity& getMember(int);
+        const PairQuantity& getMember(int) const;
+        void clearMembers();
+
+        // evaluation
+        /// evaluate all members for the structure
+        void eval(StructureAdapterPtr);
+        template <class T> void eval(const T&);
+        /// evaluate all members for the structure of the first member
+        void eval();
+
+        // instrumentation
+        /// work counters and timers of the last group eval
+        const EvalCounters& getEvalCounters() const;
+        EvalCounters& getEvalCounters();
+
+    private:
+
+        // types
+        /// bond range and summation setup of one member
+        struct MemberSetup
+        {
+            double rmin;
+            double rmax;
+            bool usefullsum;
+            bool usesbondblocks;
+            const CompiledPairMask* pmask;
+        };
+
+        // methods
+        void ensureMemberIndex(int) const;
+        /// configure the shared generator for the widest member range
+        void configureBondGenerator(BaseBondGenerator&);
+        void sumBonds(BaseBondGenerator&);
+
+        // data
+        std::vector<PairQuantityPtr> mmembers;
+        std::vector<MemberSetup> msetup;
+        EvalCounters mevalcounters;
+};
+
+// Template Public Methods ---------------------------------------------------
+
+template <class T>
+void PairQuantityGroup::eval(const T& stru)
+{
+    StructureAdapterPtr pstru = convertToStructureAdapter(stru);
+    this->eval(pstru);
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+#endif  // PAIRQUANTITYGROUP_HPP_INCLUDED
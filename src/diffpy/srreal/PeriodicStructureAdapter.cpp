@@ -15,13 +15,28 @@
 * class PeriodicStructureAdapter -- universal adapter for structure with
 *     periodic boundary conditions that has no space group symmetry
 *
+* class PeriodicCellList -- sites binned to a grid of cells in the unit
+*     cell for finding the neighbors in large periodic cells
+*
 * class PeriodicStructureBondGenerator -- bond generator
 *
+* class PeriodicBondCache -- cell images of all pairs within a cutoff
+*     distance that remain valid for a strained lattice
+*
+* class PeriodicBondCacheGenerator -- bond generator that replays
+*     the cached pairs with the current lattice and positions
+*
 *****************************************************************************/
 
 #include <cassert>
+#include <limits>
+#include <algorithm>
+#include <numeric>
+#include <boost/make_shared.hpp>
 
 #include <diffpy/serialization.ipp>
+#include <diffpy/srreal/BondBlock.hpp>
+#include <diffpy/srreal/EvalCounters.hpp>
 #include <diffpy/srreal/PointsInSphere.hpp>
 #include <diffpy/srreal/StructureDifference.hpp>
 #include <diffpy/srreal/PeriodicStructureAdapter.hpp>
@@ -31,6 +46,60 @@ using namespace std;
 namespace diffpy {
 namespace srreal {
 
+// Local Helpers -------------------------------------------------------------
+
+namespace {
+
+/// smallest eigenvalue of a symmetric 3x3 matrix
+double smallestEigenvalue(const R3::Matrix& S)
+{
+    const double p1 = S(0,1) * S(0,1) + S(0,2) * S(0,2) + S(1,2) * S(1,2);
+    const double q = (S(0,0) + S(1,1) + S(2,2)) / 3.0;
+    if (p1 == 0.0)  return min(S(0,0), min(S(1,1), S(2,2)));
+    const double p2 = pow(S(0,0) - q, 2) + pow(S(1,1) - q, 2) +
+        pow(S(2,2) - q, 2) + 2 * p1;
+    const double p = sqrt(p2 / 6.0);
+    R3::Matrix B = S;
+    for (int i = 0; i < R3::Ndim; ++i)  B(i,i) -= q;
+    B /= p;
+    const double r = max(-1.0, min(1.0, R3::determinant(B) / 2.0));
+    const double phi = acos(r) / 3.0;
+    double rv = q + 2 * p * cos(phi + 2 * M_PI / 3.0);
+    return rv;
+}
+
+
+template <class T>
+bool compareImageSites(const T& img0, const T& img1)
+{
+    return img0.site1 < img1.site1;
+}
+
+
+/// order of PointsInSphere, by lattice translation and then by site
+bool compareImageTranslations(
+        const PeriodicCellList::Image& img0,
+        const PeriodicCellList::Image& img1)
+{
+    const int* t0 = img0.translation;
+    const int* t1 = img1.translation;
+    if (!equal(t0, t0 + R3::Ndim, t1))
+    {
+        return lexicographical_compare(
+                t0, t0 + R3::Ndim, t1, t1 + R3::Ndim);
+    }
+    return img0.site1 < img1.site1;
+}
+
+
+/// integer division rounded towards minus infinity for positive n
+int floorDivide(int m, int n)
+{
+    return (m >= 0) ? (m / n) : -((n - 1 - m) / n);
+}
+
+}   // namespace
+
 //////////////////////////////////////////////////////////////////////////////
 // class PeriodicStructureAdapter
 //////////////////////////////////////////////////////////////////////////////
@@ -46,8 +115,15 @@ StructureAdapterPtr PeriodicStructureAdapter::clone() const
 
 BaseBondGeneratorPtr PeriodicStructureAdapter::createBondGenerator() const
 {
-    BaseBondGeneratorPtr bnds(
-            new PeriodicStructureBondGenerator(shared_from_this()));
+    BaseBondGeneratorPtr bnds;
+    if (this->getBondCacheSkin() > 0)
+    {
+        bnds.reset(new PeriodicBondCacheGenerator(shared_from_this()));
+    }
+    else
+    {
+        bnds.reset(new PeriodicStructureBondGenerator(shared_from_this()));
+    }
     return bnds;
 }
 
@@ -63,15 +139,14 @@ double PeriodicStructureAdapter::numberDensity() const
 StructureDifference
 PeriodicStructureAdapter::diff(StructureAdapterConstPtr other) const
 {
-    StructureDifference sd = this->StructureAdapter::diff(other);
-    if (sd.stru0 == sd.stru1)  return sd;
     typedef boost::shared_ptr<const class PeriodicStructureAdapter> PPtr;
     PPtr pother = boost::dynamic_pointer_cast<PPtr::element_type>(other);
-    if (!pother)  return sd;
-    assert(pother == sd.stru1);
-    if (this->getLattice() != pother->getLattice())  return sd;
-    sd = this->AtomicStructureAdapter::diff(other);
-    return sd;
+    // atoms can be compared only within the same lattice
+    if (pother && this->getLattice() == pother->getLattice())
+    {
+        return this->AtomicStructureAdapter::diff(other);
+    }
+    return this->StructureAdapter::diff(other);
 }
 
 
@@ -104,6 +179,17 @@ void PeriodicStructureAdapter::toFractional(Atom& a) const
     a.uij_cartn = L.fractionalMatrix(a.uij_cartn);
 }
 
+
+boost::shared_ptr<const PeriodicBondCache>
+PeriodicStructureAdapter::getBondCache(double rmax) const
+{
+    if (mbondcache && mbondcache->covers(*this, rmax))  return mbondcache;
+    // build a new instance, the old cache may be still used by the clones
+    mbondcache = boost::make_shared<PeriodicBondCache>(
+            *this, rmax + this->getBondCacheSkin());
+    return mbondcache;
+}
+
 // Comparison functions ------------------------------------------------------
 
 bool operator==(
@@ -137,7 +223,11 @@ PeriodicStructureBondGenerator::PeriodicStructureBondGenerator(
 {
     mpstructure = dynamic_cast<const PeriodicStructureAdapter*>(adpt.get());
     assert(mpstructure);
+    mcelllistenabled = true;
     int cntsites = mpstructure->countSites();
+    mrangefirst = 0;
+    mrangelast = cntsites;
+    musesselection = false;
     mcartesian_positions_uc.reserve(cntsites);
     const Lattice& L = mpstructure->getLattice();
     PeriodicStructureAdapter::const_iterator ai = mpstructure->begin();
@@ -155,13 +245,34 @@ void PeriodicStructureBondGenerator::rewind()
 {
     // Delay msphere instantiation to here instead of in constructor,
     // so it is possible to use setRmin, setRmax.
-    if (!msphere.get())
+    const Lattice& L = mpstructure->getLattice();
+    if (!msphere.get() && !mcelllist.get())
     {
-        const Lattice& L = mpstructure->getLattice();
-        double buffzone = L.ucMaxDiagonalLength();
-        double rsphmin = this->getRmin() - buffzone;
-        double rsphmax = this->getRmax() + buffzone;
-        msphere.reset(new PointsInSphere(rsphmin, rsphmax, L));
+        if (mcelllistenabled &&
+                PeriodicCellList::isSuitable(L, this->getRmax()))
+        {
+            mcelllist.reset(new PeriodicCellList(
+                        L, mcartesian_positions_uc, this->getRmax()));
+        }
+        else
+        {
+            double buffzone = L.ucMaxDiagonalLength();
+            double rsphmin = this->getRmin() - buffzone;
+            double rsphmax = this->getRmax() + buffzone;
+            msphere.reset(new PointsInSphere(rsphmin, rsphmax, L));
+        }
+    }
+    if (mcelllist.get())  this->rewindCellList();
+    // restore the site selection that may be narrowed by the cell list
+    else if (musesselection)
+    {
+        msite_first = mselection.begin();
+        msite_last = mselection.end();
+    }
+    else
+    {
+        msite_first = msite_all.begin() + mrangefirst;
+        msite_last = msite_all.begin() + mrangelast;
     }
     // BaseBondGenerator::rewind calls this->rewindSymmetry,
     // which takes care of msphere configuration
@@ -169,6 +280,50 @@ void PeriodicStructureBondGenerator::rewind()
 }
 
 
+int PeriodicStructureBondGenerator::fillBlock(BondBlock& blk)
+{
+    if (!mdirectfillenabled)  return this->BaseBondGenerator::fillBlock(blk);
+    const int cnt0 = blk.count;
+    if (this->finished())  return 0;
+    const int mult = this->multiplicity();
+    const Lattice& L = mpstructure->getLattice();
+    const bool usecells = mcelllist.get();
+    while (!blk.full())
+    {
+        blk.append(msite_anchor, *msite_current, mdistance, mr01, mult);
+        // step over the cell list images or over the sites
+        // at each sphere point
+        while (true)
+        {
+            if (usecells)
+            {
+                if (++msite_current >= msite_last)  break;
+                ++mimage_current;
+                mr1 = mcartesian_positions_uc[*msite_current] +
+                    mimage_current->cell;
+            }
+            else
+            {
+                if (++msite_current >= msite_last)
+                {
+                    msphere->next();
+                    if (msphere->finished())  break;
+                    mrcsphere = L.cartesian(msphere->mno());
+                    msite_current = msite_first;
+                }
+                mr1 = mrcsphere + mcartesian_positions_uc[*msite_current];
+            }
+            this->updateDistance();
+            if (this->bondInRange())  break;
+            DIFFPY_EVAL_TALLY(++mtallyrejected);
+        }
+        if (this->finished())  break;
+        DIFFPY_EVAL_TALLY(++mtallyaccepted);
+    }
+    return blk.count - cnt0;
+}
+
+
 void PeriodicStructureBondGenerator::selectAnchorSite(int anchor)
 {
     this->BaseBondGenerator::selectAnchorSite(anchor);
@@ -176,6 +331,37 @@ void PeriodicStructureBondGenerator::selectAnchorSite(int anchor)
 }
 
 
+void PeriodicStructureBondGenerator::selectSiteRange(int first, int last)
+{
+    this->BaseBondGenerator::selectSiteRange(first, last);
+    mrangefirst = first;
+    mrangelast = last;
+    musesselection = false;
+}
+
+
+void PeriodicStructureBondGenerator::selectSites(
+        const SiteIndices& selection)
+{
+    this->selectSites(selection.begin(), selection.end());
+}
+
+
+void PeriodicStructureBondGenerator::selectSites(
+        SiteIndices::const_iterator first,
+        SiteIndices::const_iterator last)
+{
+    mselection.assign(first, last);
+    if (!is_sorted(mselection.begin(), mselection.end()))
+    {
+        sort(mselection.begin(), mselection.end());
+    }
+    musesselection = true;
+    this->BaseBondGenerator::selectSites(
+            mselection.begin(), mselection.end());
+}
+
+
 void PeriodicStructureBondGenerator::setRmin(double rmin)
 {
     // destroy msphere so it will be created on rewind with new rmin
@@ -186,8 +372,13 @@ void PeriodicStructureBondGenerator::setRmin(double rmin)
 
 void PeriodicStructureBondGenerator::setRmax(double rmax)
 {
-    // destroy msphere so it will be created on rewind with new rmax
-    if (this->getRmax() != rmax)    msphere.reset();
+    // destroy msphere and the cell list so they will be created
+    // on rewind with new rmax
+    if (this->getRmax() != rmax)
+    {
+        msphere.reset();
+        mcelllist.reset();
+    }
     this->BaseBondGenerator::setRmax(rmax);
 }
 
@@ -195,6 +386,8 @@ void PeriodicStructureBondGenerator::setRmax(double rmax)
 
 bool PeriodicStructureBondGenerator::iterateSymmetry()
 {
+    // cell list images are separate entries of the site list
+    if (mcelllist.get())  return false;
     msphere->next();
     bool done = msphere->finished();
     mrcsphere = done ? R3::zerovector :
@@ -205,6 +398,12 @@ bool PeriodicStructureBondGenerator::iterateSymmetry()
 
 void PeriodicStructureBondGenerator::rewindSymmetry()
 {
+    if (mcelllist.get())
+    {
+        mimage_current = mimages.begin() + (msite_current - msite_first);
+        this->updateCellImage();
+        return;
+    }
     msphere->rewind();
     mrcsphere = msphere->finished() ? R3::zerovector :
         mpstructure->getLattice().cartesian(msphere->mno());
@@ -214,6 +413,12 @@ void PeriodicStructureBondGenerator::rewindSymmetry()
 
 void PeriodicStructureBondGenerator::getNextBond()
 {
+    // cell list images are iterated as sites
+    if (mcelllist.get())
+    {
+        this->BaseBondGenerator::getNextBond();
+        return;
+    }
     ++msite_current;
     // go back to the first site if there is next symmetry element
     if (msite_current >= msite_last && this->iterateSymmetry())
@@ -232,6 +437,423 @@ void PeriodicStructureBondGenerator::updater1()
     this->updateDistance();
 }
 
+
+void PeriodicStructureBondGenerator::rewindCellList()
+{
+    mimages.clear();
+    mcellsites.clear();
+    if (mpstructure->countSites())
+    {
+        mcelllist->findImages(this->site0(), mimages);
+    }
+    // keep the images of the selected sites in the sphere search order
+    vector<PeriodicCellList::Image>::iterator last = mimages.begin();
+    PeriodicCellList::ImageIterator img = mimages.begin();
+    for (; img != mimages.end(); ++img)
+    {
+        const int j = img->site1;
+        bool selected = musesselection ?
+            binary_search(mselection.begin(), mselection.end(), j) :
+            (mrangefirst <= j && j < mrangelast);
+        if (!selected)  continue;
+        *(last++) = *img;
+        mcellsites.push_back(j);
+    }
+    mimages.erase(last, mimages.end());
+    msite_first = mcellsites.begin();
+    msite_last = mcellsites.end();
+}
+
+
+void PeriodicStructureBondGenerator::updateCellImage()
+{
+    mr1 = mcartesian_positions_uc[this->site1()] + mimage_current->cell;
+    this->updateDistance();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// class PeriodicCellList
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+PeriodicCellList::PeriodicCellList(const Lattice& L,
+        const vector<R3::Vector>& xyzuc, double rcut)
+{
+    const int cntsites = xyzuc.size();
+    // rcut in fractional units along the normals of the lattice planes
+    const double rcutfrac[R3::Ndim] = {
+        rcut * L.ar(), rcut * L.br(), rcut * L.cr()};
+    mbase[0] = L.va();
+    mbase[1] = L.vb();
+    mbase[2] = L.vc();
+    // use cells not thinner than rcut, but no more than 2 per site
+    const double maxcells = max(1, 2 * cntsites);
+    for (int k = 0; k < R3::Ndim; ++k)
+    {
+        double n = (rcutfrac[k] > 0.0) ? (1.0 / rcutfrac[k]) : maxcells;
+        mcells[k] = int(max(1.0, min(n, maxcells)));
+    }
+    while (double(mcells[0]) * mcells[1] * mcells[2] > maxcells)
+    {
+        int* nmax = max_element(mcells, mcells + R3::Ndim);
+        *nmax = max(1, *nmax / 2);
+    }
+    // small margin for round-off errors at the cell boundaries
+    const double eps = 1e-6;
+    for (int k = 0; k < R3::Ndim; ++k)
+    {
+        mreach[k] = int(ceil(rcutfrac[k] * mcells[k] + eps));
+    }
+    // sort sites by their cells
+    const int cntcells = this->countCells();
+    msitecells.resize(R3::Ndim * cntsites);
+    SiteIndices flatcell(cntsites);
+    mcelloffsets.assign(cntcells + 1, 0);
+    for (int i = 0; i < cntsites; ++i)
+    {
+        const R3::Vector& fi = L.fractional(xyzuc[i]);
+        int* ci = &(msitecells[R3::Ndim * i]);
+        for (int k = 0; k < R3::Ndim; ++k)
+        {
+            ci[k] = int(floor(fi[k] * mcells[k]));
+            ci[k] = max(0, min(mcells[k] - 1, ci[k]));
+        }
+        flatcell[i] = (ci[0] * mcells[1] + ci[1]) * mcells[2] + ci[2];
+        ++mcelloffsets[flatcell[i] + 1];
+    }
+    partial_sum(mcelloffsets.begin(), mcelloffsets.end(),
+            mcelloffsets.begin());
+    SiteIndices cellfill(mcelloffsets.begin(), mcelloffsets.end() - 1);
+    mcellsites.resize(cntsites);
+    for (int i = 0; i < cntsites; ++i)
+    {
+        mcellsites[cellfill[flatcell[i]]++] = i;
+    }
+}
+
+// Public Methods ------------------------------------------------------------
+
+bool PeriodicCellList::isSuitable(const Lattice& L, double rcut)
+{
+    // the smallest distance between the lattice planes
+    const double dmin = 1.0 / max(L.ar(), max(L.br(), L.cr()));
+    bool rv = (rcut > 0.0) && (dmin >= 2 * rcut);
+    return rv;
+}
+
+
+void PeriodicCellList::findImages(int site0, vector<Image>& images) const
+{
+    images.clear();
+    const int* c0 = &(msitecells[R3::Ndim * site0]);
+    Image img;
+    R3::Vector tx, txy;
+    for (int dx = -mreach[0]; dx <= mreach[0]; ++dx)
+    {
+        const int qx = floorDivide(c0[0] + dx, mcells[0]);
+        const int cx = c0[0] + dx - qx * mcells[0];
+        tx = double(qx) * mbase[0];
+        for (int dy = -mreach[1]; dy <= mreach[1]; ++dy)
+        {
+            const int qy = floorDivide(c0[1] + dy, mcells[1]);
+            const int cy = c0[1] + dy - qy * mcells[1];
+            txy = tx + double(qy) * mbase[1];
+            for (int dz = -mreach[2]; dz <= mreach[2]; ++dz)
+            {
+                const int qz = floorDivide(c0[2] + dz, mcells[2]);
+                const int cz = c0[2] + dz - qz * mcells[2];
+                const int cell = (cx * mcells[1] + cy) * mcells[2] + cz;
+                img.translation[0] = qx;
+                img.translation[1] = qy;
+                img.translation[2] = qz;
+                img.cell = txy + double(qz) * mbase[2];
+                const int* first = &(mcellsites[0]) + mcelloffsets[cell];
+                const int* last = &(mcellsites[0]) + mcelloffsets[cell + 1];
+                for (; first != last; ++first)
+                {
+                    img.site1 = *first;
+                    images.push_back(img);
+                }
+            }
+        }
+    }
+    sort(images.begin(), images.end(), compareImageTranslations);
+}
+
+
+int PeriodicCellList::countCells() const
+{
+    return mcells[0] * mcells[1] * mcells[2];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// class PeriodicBondCache
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+PeriodicBondCache::PeriodicBondCache(
+        const PeriodicStructureAdapter& stru, double rcut) :
+    mrcut(rcut)
+{
+    using diffpy::mathutils::eps_eq;
+    const Lattice& L = stru.getLattice();
+    mbase = L.base();
+    const int cntsites = stru.countSites();
+    mfractional.resize(cntsites);
+    for (int i = 0; i < cntsites; ++i)
+    {
+        mfractional[i] = L.ucvFractional(L.fractional(stru[i].xyz_cartn));
+    }
+    PeriodicStructureBondGenerator bnds(stru.shared_from_this());
+    bnds.setRmin(0.0);
+    bnds.setRmax(rcut);
+    moffsets.reserve(cntsites + 1);
+    moffsets.push_back(0);
+    for (int i = 0; i < cntsites; ++i)
+    {
+        bnds.selectAnchorSite(i);
+        bnds.selectSiteRange(0, cntsites);
+        for (bnds.rewind(); !bnds.finished(); bnds.next())
+        {
+            Image img;
+            img.site1 = bnds.site1();
+            img.cell = L.fractional(bnds.r1()) - mfractional[img.site1];
+            for (int k = 0; k < R3::Ndim; ++k)
+            {
+                img.cell[k] = floor(img.cell[k] + 0.5);
+            }
+            mimages.push_back(img);
+        }
+        // keep coincident sites, they may split apart later
+        for (int j = 0; j < cntsites; ++j)
+        {
+            if (j == i)  continue;
+            Image img;
+            img.site1 = j;
+            img.cell = mfractional[i] - mfractional[j];
+            for (int k = 0; k < R3::Ndim; ++k)
+            {
+                img.cell[k] = floor(img.cell[k] + 0.5);
+            }
+            R3::Vector r01 = mfractional[j] + img.cell - mfractional[i];
+            if (eps_eq(L.norm(r01), 0.0))  mimages.push_back(img);
+        }
+        stable_sort(mimages.begin() + moffsets.back(), mimages.end(),
+                compareImageSites<Image>);
+        moffsets.push_back(mimages.size());
+    }
+}
+
+// Public Methods ------------------------------------------------------------
+
+const double& PeriodicBondCache::getRcut() const
+{
+    return mrcut;
+}
+
+
+bool PeriodicBondCache::covers(
+        const PeriodicStructureAdapter& stru, double rmax) const
+{
+    if (stru.countSites() != int(mfractional.size()))  return false;
+    // largest displacement of the sites in the cached lattice
+    vector<R3::Vector> fpos;
+    this->getFractionalPositions(stru, fpos);
+    double dmax = 0.0;
+    for (size_t i = 0; i < fpos.size(); ++i)
+    {
+        R3::Vector df = fpos[i] - mfractional[i];
+        dmax = max(dmax, R3::norm(R3::mxvecproduct(df, mbase)));
+    }
+    // smallest length scaling of a vector by the lattice strain
+    const Lattice& L = stru.getLattice();
+    R3::Matrix T = R3::prod(R3::inverse(mbase), L.base());
+    R3::Matrix S = R3::prod(T, R3::trans(T));
+    const double lmin = smallestEigenvalue(S);
+    if (lmin <= 0.0)  return false;
+    bool rv = (sqrt(lmin) * (mrcut - 2 * dmax) >= rmax);
+    return rv;
+}
+
+
+void PeriodicBondCache::getFractionalPositions(
+        const PeriodicStructureAdapter& stru,
+        vector<R3::Vector>& fpos) const
+{
+    assert(stru.countSites() == int(mfractional.size()));
+    const Lattice& L = stru.getLattice();
+    fpos.resize(mfractional.size());
+    for (size_t i = 0; i < fpos.size(); ++i)
+    {
+        R3::Vector& fi = fpos[i];
+        fi = L.fractional(stru[i].xyz_cartn);
+        R3::Vector dcell = fi - mfractional[i];
+        for (int k = 0; k < R3::Ndim; ++k)
+        {
+            fi[k] -= floor(dcell[k] + 0.5);
+        }
+    }
+}
+
+
+pair<PeriodicBondCache::ImageIterator, PeriodicBondCache::ImageIterator>
+PeriodicBondCache::siteImages(int site0) const
+{
+    assert(0 <= site0 && site0 + 1 < int(moffsets.size()));
+    ImageIterator first = mimages.begin() + moffsets[site0];
+    ImageIterator last = mimages.begin() + moffsets[site0 + 1];
+    return make_pair(first, last);
+}
+
+
+int PeriodicBondCache::countImages() const
+{
+    return mimages.size();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// class PeriodicBondCacheGenerator
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+PeriodicBondCacheGenerator::PeriodicBondCacheGenerator(
+        StructureAdapterConstPtr adpt) : BaseBondGenerator(adpt)
+{
+    mpstructure = dynamic_cast<const PeriodicStructureAdapter*>(adpt.get());
+    assert(mpstructure);
+    mrangefirst = 0;
+    mrangelast = mpstructure->countSites();
+    musesselection = false;
+    // cached images are iterated in rewindSymmetry and iterateSymmetry
+    mdirectfillenabled = false;
+}
+
+// Public Methods ------------------------------------------------------------
+
+void PeriodicBondCacheGenerator::rewind()
+{
+    // Delay cache lookup to here, so it is possible to use setRmax.
+    if (!mcache)
+    {
+        mcache = mpstructure->getBondCache(this->getRmax());
+        mcache->getFractionalPositions(*mpstructure, mcartesian_positions);
+        const Lattice& L = mpstructure->getLattice();
+        vector<R3::Vector>::iterator xyz = mcartesian_positions.begin();
+        for (; xyz != mcartesian_positions.end(); ++xyz)
+        {
+            *xyz = L.cartesian(*xyz);
+        }
+    }
+    // iterate over the selected sites with images around the anchor
+    mneighbors.clear();
+    if (this->site0() < int(mcartesian_positions.size()))
+    {
+        mr0 = mcartesian_positions[this->site0()];
+        pair<PeriodicBondCache::ImageIterator,
+            PeriodicBondCache::ImageIterator> rng =
+                mcache->siteImages(this->site0());
+        mimage_last = rng.first;
+        manchor_last = rng.second;
+        PeriodicBondCache::ImageIterator img = rng.first;
+        for (; img != rng.second; ++img)
+        {
+            const int j = img->site1;
+            if (!mneighbors.empty() && mneighbors.back() == j)  continue;
+            bool selected = musesselection ?
+                binary_search(mselection.begin(), mselection.end(), j) :
+                (mrangefirst <= j && j < mrangelast);
+            if (selected)  mneighbors.push_back(j);
+        }
+    }
+    msite_first = mneighbors.begin();
+    msite_last = mneighbors.end();
+    this->BaseBondGenerator::rewind();
+}
+
+
+void PeriodicBondCacheGenerator::selectAnchorSite(int anchor)
+{
+    this->BaseBondGenerator::selectAnchorSite(anchor);
+    if (mcache)  mr0 = mcartesian_positions[anchor];
+}
+
+
+void PeriodicBondCacheGenerator::selectSiteRange(int first, int last)
+{
+    this->BaseBondGenerator::selectSiteRange(first, last);
+    mrangefirst = first;
+    mrangelast = last;
+    musesselection = false;
+}
+
+
+void PeriodicBondCacheGenerator::selectSites(const SiteIndices& selection)
+{
+    this->selectSites(selection.begin(), selection.end());
+}
+
+
+void PeriodicBondCacheGenerator::selectSites(
+        SiteIndices::const_iterator first,
+        SiteIndices::const_iterator last)
+{
+    mselection.assign(first, last);
+    if (!is_sorted(mselection.begin(), mselection.end()))
+    {
+        sort(mselection.begin(), mselection.end());
+    }
+    musesselection = true;
+    this->BaseBondGenerator::selectSites(
+            mselection.begin(), mselection.end());
+}
+
+
+void PeriodicBondCacheGenerator::setRmax(double rmax)
+{
+    // release the cache so it will be checked on rewind with new rmax
+    if (this->getRmax() != rmax)    mcache.reset();
+    this->BaseBondGenerator::setRmax(rmax);
+}
+
+// Protected Methods ---------------------------------------------------------
+
+bool PeriodicBondCacheGenerator::iterateSymmetry()
+{
+    if (mimage_current == mimage_last)  return false;
+    if (++mimage_current == mimage_last)  return false;
+    this->updater1();
+    return true;
+}
+
+
+void PeriodicBondCacheGenerator::rewindSymmetry()
+{
+    // sites are visited in the order of their images, so the images
+    // of site1 follow after the images of the previous site
+    PeriodicBondCache::Image key;
+    key.site1 = this->site1();
+    pair<PeriodicBondCache::ImageIterator, PeriodicBondCache::ImageIterator>
+        rng = equal_range(mimage_last, manchor_last, key,
+                compareImageSites<PeriodicBondCache::Image>);
+    assert(rng.first != rng.second);
+    mimage_current = rng.first;
+    mimage_last = rng.second;
+    this->updater1();
+}
+
+// Private Methods -----------------------------------------------------------
+
+void PeriodicBondCacheGenerator::updater1()
+{
+    const Lattice& L = mpstructure->getLattice();
+    mr1 = mcartesian_positions[this->site1()] +
+        L.cartesian(mimage_current->cell);
+    this->updateDistance();
+}
+
 }   // namespace srreal
 }   // namespace diffpy
 
@@ -15,7 +15,17 @@
 * class PeriodicStructureAdapter -- universal adapter for structure with
 *     periodic boundary conditions that has no space group symmetry
 *
-* class PeriodicStructureBondGenerator -- bond generator
+* class PeriodicCellList -- sites binned to a grid of cells in the unit
+*     cell for finding the neighbors in large periodic cells
+*
+* class PeriodicStructureBondGenerator -- bond generator, which uses
+*     the cell list when the unit cell is large compared with rmax
+*
+* class PeriodicBondCache -- cell images of all pairs within a cutoff
+*     distance that remain valid for a strained lattice
+*
+* class PeriodicBondCacheGenerator -- bond generator that replays
+*     the cached pairs with the current lattice and positions
 *
 *****************************************************************************/
 
@@ -29,6 +39,7 @@ namespace diffpy {
 namespace srreal {
 
 class PointsInSphere;
+class PeriodicBondCache;
 
 class PeriodicStructureAdapter : public AtomicStructureAdapter
 {
@@ -47,11 +58,15 @@ class PeriodicStructureAdapter : public AtomicStructureAdapter
         const Lattice& getLattice() const;
         void toCartesian(Atom&) const;
         void toFractional(Atom&) const;
+        /// cached pairs complete up to rmax, rebuild when necessary
+        boost::shared_ptr<const PeriodicBondCache>
+            getBondCache(double rmax) const;
 
     private:
 
         // data
         Lattice mlattice;
+        mutable boost::shared_ptr<const PeriodicBondCache> mbondcache;
 
         // serialization
         friend class boost::serialization::access;
@@ -72,6 +87,48 @@ bool operator==(const PeriodicStructureAdapter&, const PeriodicStructureAdapter&
 bool operator!=(const PeriodicStructureAdapter&, const PeriodicStructureAdapter&);
 
 
+class PeriodicCellList
+{
+    public:
+
+        // types
+        struct Image
+        {
+            int site1;
+            /// integer lattice translation of the site1 position
+            int translation[R3::Ndim];
+            /// Cartesian translation of the site1 position
+            R3::Vector cell;
+        };
+        typedef std::vector<Image>::const_iterator ImageIterator;
+
+        // constructor
+        /// bin the unit cell positions xyzuc in cells not thinner than rcut
+        PeriodicCellList(const Lattice& L,
+                const std::vector<R3::Vector>& xyzuc, double rcut);
+
+        // methods
+        /// return true if lattice planes are at least 2 * rcut apart
+        static bool isSuitable(const Lattice& L, double rcut);
+        /// images of all sites in the cells around site0 in the order
+        /// of the sphere search, i.e., sorted by translation and site1
+        void findImages(int site0, std::vector<Image>& images) const;
+        int countCells() const;
+
+    private:
+
+        // data
+        int mcells[R3::Ndim];
+        /// number of neighbor cells to search along each axis
+        int mreach[R3::Ndim];
+        R3::Vector mbase[R3::Ndim];
+        /// cell coordinates of every site
+        SiteIndices msitecells;
+        SiteIndices mcelloffsets;
+        SiteIndices mcellsites;
+};
+
+
 class PeriodicStructureBondGenerator : public BaseBondGenerator
 {
     public:
@@ -82,9 +139,15 @@ class PeriodicStructureBondGenerator : public BaseBondGenerator
         // methods
         // loop control
         virtual void rewind();
+        virtual int fillBlock(BondBlock& blk);
 
         // configuration
         virtual void selectAnchorSite(int);
+        virtual void selectSiteRange(int first, int last);
+        virtual void selectSites(const SiteIndices&);
+        virtual void selectSites(
+                SiteIndices::const_iterator first,
+                SiteIndices::const_iterator last);
         virtual void setRmin(double);
         virtual void setRmax(double);
 
@@ -94,6 +157,9 @@ class PeriodicStructureBondGenerator : public BaseBondGenerator
         const PeriodicStructureAdapter* mpstructure;
         std::unique_ptr<PointsInSphere> msphere;
         R3::Vector mrcsphere;
+        /// allow the cell list search, derived generators that
+        /// override the sphere iteration should disable it
+        bool mcelllistenabled;
 
         // methods
         virtual bool iterateSymmetry();
@@ -105,6 +171,110 @@ class PeriodicStructureBondGenerator : public BaseBondGenerator
 
         // data
         std::vector<R3::Vector> mcartesian_positions_uc;
+        std::unique_ptr<PeriodicCellList> mcelllist;
+        /// images of the selected sites around the anchor
+        std::vector<PeriodicCellList::Image> mimages;
+        PeriodicCellList::ImageIterator mimage_current;
+        /// site1 indices of mimages
+        SiteIndices mcellsites;
+        /// site range when mselection is not used
+        int mrangefirst;
+        int mrangelast;
+        bool musesselection;
+        /// sorted selection of sites
+        SiteIndices mselection;
+
+        // methods
+        void rewindCellList();
+        void updateCellImage();
+};
+
+
+class PeriodicBondCache
+{
+    public:
+
+        // types
+        struct Image
+        {
+            int site1;
+            R3::Vector cell;
+        };
+        typedef std::vector<Image>::const_iterator ImageIterator;
+
+        // constructor
+        PeriodicBondCache(const PeriodicStructureAdapter&, double rcut);
+
+        // methods
+        /// cutoff distance used when the cache was built
+        const double& getRcut() const;
+        /// return true if the cache has all pairs of stru up to rmax
+        bool covers(const PeriodicStructureAdapter& stru, double rmax) const;
+        /// fractional coordinates of stru sites in the cached cells
+        void getFractionalPositions(const PeriodicStructureAdapter& stru,
+                std::vector<R3::Vector>& fpos) const;
+        /// range of cached images around the anchor site0 sorted by site1
+        std::pair<ImageIterator, ImageIterator> siteImages(int site0) const;
+        int countImages() const;
+
+    private:
+
+        // data
+        double mrcut;
+        R3::Matrix mbase;
+        std::vector<R3::Vector> mfractional;
+        SiteIndices moffsets;
+        std::vector<Image> mimages;
+};
+
+
+class PeriodicBondCacheGenerator : public BaseBondGenerator
+{
+    public:
+
+        // constructors
+        PeriodicBondCacheGenerator(StructureAdapterConstPtr);
+
+        // methods
+        // loop control
+        virtual void rewind();
+
+        // configuration
+        virtual void selectAnchorSite(int);
+        virtual void selectSiteRange(int first, int last);
+        virtual void selectSites(const SiteIndices&);
+        virtual void selectSites(
+                SiteIndices::const_iterator first,
+                SiteIndices::const_iterator last);
+        virtual void setRmax(double);
+
+    protected:
+
+        // methods
+        virtual bool iterateSymmetry();
+        virtual void rewindSymmetry();
+
+    private:
+
+        // data
+        const PeriodicStructureAdapter* mpstructure;
+        boost::shared_ptr<const PeriodicBondCache> mcache;
+        std::vector<R3::Vector> mcartesian_positions;
+        PeriodicBondCache::ImageIterator mimage_current;
+        PeriodicBondCache::ImageIterator mimage_last;
+        /// end of the cached images around the anchor
+        PeriodicBondCache::ImageIterator manchor_last;
+        /// selected sites with images around the anchor
+        SiteIndices mneighbors;
+        /// site range when mselection is not used
+        int mrangefirst;
+        int mrangelast;
+        bool musesselection;
+        /// sorted selection of sites
+        SiteIndices mselection;
+
+        // methods
+        void updater1();
 };
 
 }   // namespace srreal
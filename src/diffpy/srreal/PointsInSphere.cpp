@@ -20,6 +20,7 @@
 
 #include <algorithm>
 #include <diffpy/srreal/PointsInSphere.hpp>
+#include <diffpy/srreal/EvalCounters.hpp>
 #include <diffpy/mathutils.hpp>
 
 using namespace diffpy::srreal;
@@ -90,7 +91,8 @@ PointsInSphere::PointsInSphere(double rmin, double rmax,
         const LatticeParameters& _latpar ) :
             _Rmin(rmin), _Rmax(rmax),
             latpar(_latpar),
-            _m(_mno[0]), _n(_mno[1]), _o(_mno[2])
+            _m(_mno[0]), _n(_mno[1]), _o(_mno[2]),
+            tallypoints(0)
 {
     init();
     rewind();
@@ -102,12 +104,20 @@ PointsInSphere::PointsInSphere(double rmin, double rmax,
         double _alpha, double _beta, double _gamma) :
             _Rmin(rmin), _Rmax(rmax),
             latpar(_a, _b, _c, _alpha, _beta, _gamma),
-            _m(_mno[0]), _n(_mno[1]), _o(_mno[2])
+            _m(_mno[0]), _n(_mno[1]), _o(_mno[2]),
+            tallypoints(0)
 {
     init();
     rewind();
 }
 
+// Destructor ----------------------------------------------------------------
+
+PointsInSphere::~PointsInSphere()
+{
+    DIFFPY_EVAL_COUNT(SPHERE_POINTS, tallypoints);
+}
+
 // Public Methods ------------------------------------------------------------
 
 // loop control
@@ -125,12 +135,14 @@ void PointsInSphere::rewind()
     oExclHalfSpan = 0.0;
     // get the first inside point
     next_o();
+    DIFFPY_EVAL_TALLY(tallypoints += !finished());
 }
 
 
 void PointsInSphere::next()
 {
     next_o();
+    DIFFPY_EVAL_TALLY(tallypoints += !finished());
 }
 
 
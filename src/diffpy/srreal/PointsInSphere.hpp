@@ -99,6 +99,10 @@ class PointsInSphere
         template <class L>
             PointsInSphere(double rmin, double rmax, const L&);
 
+        // destructor
+        /// add the generated points to EvalCounters
+        ~PointsInSphere();
+
         // methods
         // loop control
         void rewind();
@@ -140,6 +144,8 @@ class PointsInSphere
         double oExclHalfSpan;
         int hi_m, hi_n, hi_o, outside_o;
         double RplaneSquare;
+        // number of generated points for EvalCounters
+        long long tallypoints;
 
         // methods
         // loop advance
@@ -222,7 +228,8 @@ template <class L>
 PointsInSphere::PointsInSphere(double rmin, double rmax, const L& lat) :
     _Rmin(rmin), _Rmax(rmax),
     latpar(lat.a(), lat.b(), lat.c(), lat.alpha(), lat.beta(), lat.gamma()),
-    _m(_mno[0]), _n(_mno[1]), _o(_mno[2])
+    _m(_mno[0]), _n(_mno[1]), _o(_mno[2]),
+    tallypoints(0)
 {
     init();
     rewind();
@@ -17,6 +17,7 @@
 *****************************************************************************/
 
 #include <diffpy/srreal/ScatteringFactorTable.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
 #include <diffpy/HasClassRegistry.ipp>
 #include <diffpy/validators.hpp>
 #include <diffpy/serialization.ipp>
@@ -33,6 +34,11 @@ namespace srreal {
 
 // class ScatteringFactorTable -----------------------------------------------
 
+// constructor
+
+ScatteringFactorTable::ScatteringFactorTable() : mcustombyidvalid(false)
+{ }
+
 // public methods
 
 bool ScatteringFactorTable::registerThisType() const
@@ -62,6 +68,18 @@ double ScatteringFactorTable::lookup(const string& smbl, double q) const
 }
 
 
+double ScatteringFactorTable::lookup(int tid, double q) const
+{
+    if (!mcustombyidvalid)  this->updateCustomById();
+    if (tid < int(mcustombyid.size()) && mcustombyid[tid].first >= 0)
+    {
+        const pair<int, double>& cs = mcustombyid[tid];
+        return this->standardLookup(atomTypeName(cs.first), q) * cs.second;
+    }
+    return this->standardLookup(atomTypeName(tid), q);
+}
+
+
 void ScatteringFactorTable::setCustomAs(
         const string& smbl, const string& srcsmbl)
 {
@@ -69,6 +87,7 @@ void ScatteringFactorTable::setCustomAs(
     CustomDataStorage::mapped_type entry(srcsmbl, scale);
     if (mcustom.count(smbl) && mcustom.at(smbl) == entry)  return;
     mcustom[smbl] = entry;
+    mcustombyidvalid = false;
     mticker.click();
 }
 
@@ -82,6 +101,7 @@ void ScatteringFactorTable::setCustomAs(
     CustomDataStorage::mapped_type entry(srcsmbl, scale);
     if (mcustom.count(smbl) && mcustom.at(smbl) == entry)  return;
     mcustom[smbl] = entry;
+    mcustombyidvalid = false;
     mticker.click();
 }
 
@@ -90,6 +110,7 @@ void ScatteringFactorTable::resetCustom(const string& smbl)
 {
     if (mcustom.count(smbl))  mticker.click();
     mcustom.erase(smbl);
+    mcustombyidvalid = false;
 }
 
 
@@ -97,6 +118,7 @@ void ScatteringFactorTable::resetAll()
 {
     if (!mcustom.empty())  mticker.click();
     mcustom.clear();
+    mcustombyidvalid = false;
 }
 
 
@@ -111,6 +133,25 @@ unordered_set<string> ScatteringFactorTable::getCustomSymbols() const
     return rv;
 }
 
+// private methods
+
+void ScatteringFactorTable::updateCustomById() const
+{
+    mcustombyid.clear();
+    CustomDataStorage::const_iterator csft;
+    for (csft = mcustom.begin(); csft != mcustom.end(); ++csft)
+    {
+        const int tid = atomTypeId(csft->first);
+        const int srcid = atomTypeId(csft->second.first);
+        if (tid >= int(mcustombyid.size()))
+        {
+            mcustombyid.resize(tid + 1, make_pair(-1, 1.0));
+        }
+        mcustombyid[tid] = make_pair(srcid, csft->second.second);
+    }
+    mcustombyidvalid = true;
+}
+
 // class ScatteringFactorTableOwner ------------------------------------------
 
 void ScatteringFactorTableOwner::setScatteringFactorTable(
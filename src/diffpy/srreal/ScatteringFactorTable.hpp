@@ -23,6 +23,7 @@
 #define SCATTERINGFACTORTABLE_HPP_INCLUDED
 
 #include <unordered_set>
+#include <vector>
 
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/assume_abstract.hpp>
@@ -41,12 +42,17 @@ class ScatteringFactorTable :
 {
     public:
 
+        // constructor
+        ScatteringFactorTable();
+
         // HasClassRegistry override
         bool registerThisType() const;
 
         // own methods
         virtual const std::string& radiationType() const = 0;
         double lookup(const std::string& smbl, double q=0.0) const;
+        /// lookup by interned atom type id from atomTypeId
+        double lookup(int tid, double q=0.0) const;
         virtual double standardLookup(const std::string&, double) const = 0;
         void setCustomAs(const std::string& smbl, const std::string& srcsmbl);
         void setCustomAs(const std::string& smbl, const std::string& srcsmbl,
@@ -67,12 +73,22 @@ class ScatteringFactorTable :
 
     private:
 
+        // methods
+        void updateCustomById() const;
+
+        // data
+        /// source type id and scale of custom entries indexed by type id,
+        /// source id is -1 for standard values
+        mutable std::vector< std::pair<int, double> > mcustombyid;
+        mutable bool mcustombyidvalid;
+
         // serialization
         friend class boost::serialization::access;
         template<class Archive>
             void serialize(Archive& ar, const unsigned int version)
         {
             ar & mcustom & mticker;
+            mcustombyidvalid = false;
         }
 
 };
@@ -0,0 +1,183 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class SiteChangeJournal -- record of modified, inserted and erased sites
+*     in a structure adapter since its base version.
+*
+*****************************************************************************/
+
+#include <cassert>
+#include <algorithm>
+
+#include <diffpy/srreal/SiteChangeJournal.hpp>
+#include <diffpy/srreal/StructureDifference.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+//////////////////////////////////////////////////////////////////////////////
+// class SiteChangeJournal
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+SiteChangeJournal::SiteChangeJournal() :
+    mbaseversion(0), mcountbase(0), mcount(0), mminsize(0),
+    mhasorigins(false)
+{ }
+
+// Public Methods ------------------------------------------------------------
+
+void SiteChangeJournal::reset(unsigned long version, int cntsites)
+{
+    mbaseversion = version;
+    mcountbase = mcount = mminsize = cntsites;
+    mhasorigins = false;
+    mmodified.clear();
+    morigins.clear();
+}
+
+
+void SiteChangeJournal::invalidate()
+{
+    mbaseversion = 0;
+    mhasorigins = false;
+    mmodified.clear();
+    morigins.clear();
+}
+
+
+bool SiteChangeJournal::isValid() const
+{
+    return mbaseversion;
+}
+
+
+bool SiteChangeJournal::isValidFrom(unsigned long version) const
+{
+    return mbaseversion && (mbaseversion == version);
+}
+
+
+void SiteChangeJournal::modified(int idx)
+{
+    if (!mbaseversion)  return;
+    assert(0 <= idx && idx < mcount);
+    if (mhasorigins)
+    {
+        morigins[idx] = -1;
+        return;
+    }
+    // appended sites are reported as changed anyway
+    if (idx >= mminsize)  return;
+    mmodified.push_back(idx);
+    if (int(mmodified.size()) > 2 * mcount + 16)  this->compactModified();
+}
+
+
+void SiteChangeJournal::inserted(int idx)
+{
+    if (!mbaseversion)  return;
+    assert(0 <= idx && idx <= mcount);
+    if (idx != mcount && !mhasorigins)  this->useSiteOrigins();
+    if (mhasorigins)  morigins.insert(morigins.begin() + idx, -1);
+    ++mcount;
+}
+
+
+void SiteChangeJournal::erased(int idx)
+{
+    if (!mbaseversion)  return;
+    assert(0 <= idx && idx < mcount);
+    if (idx != mcount - 1 && !mhasorigins)  this->useSiteOrigins();
+    if (mhasorigins)  morigins.erase(morigins.begin() + idx);
+    --mcount;
+    mminsize = std::min(mminsize, mcount);
+}
+
+
+void SiteChangeJournal::cleared()
+{
+    if (!mbaseversion)  return;
+    mcount = mminsize = 0;
+    mmodified.clear();
+    morigins.clear();
+}
+
+
+void SiteChangeJournal::getDifference(StructureDifference& sd) const
+{
+    assert(mbaseversion);
+    sd.pop0.clear();
+    sd.add1.clear();
+    // the order of sites has changed
+    if (mhasorigins)
+    {
+        sd.diffmethod = StructureDifference::Method::SORTED;
+        std::vector<bool> kept(mcountbase, false);
+        SiteIndices::const_iterator oi = morigins.begin();
+        for (int i = 0; oi != morigins.end(); ++oi, ++i)
+        {
+            if (*oi < 0)  sd.add1.push_back(i);
+            else  kept[*oi] = true;
+        }
+        for (int i = 0; i < mcountbase; ++i)
+        {
+            if (!kept[i])  sd.pop0.push_back(i);
+        }
+        return;
+    }
+    // here the sites are changed in place or at the end of the structure
+    sd.diffmethod = StructureDifference::Method::SIDEBYSIDE;
+    SiteIndices changed;
+    SiteIndices::const_iterator ii = mmodified.begin();
+    for (; ii != mmodified.end(); ++ii)
+    {
+        if (*ii < mminsize)  changed.push_back(*ii);
+    }
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    sd.pop0 = changed;
+    for (int i = mminsize; i < mcountbase; ++i)  sd.pop0.push_back(i);
+    sd.add1.swap(changed);
+    for (int i = mminsize; i < mcount; ++i)  sd.add1.push_back(i);
+}
+
+// Private Methods -----------------------------------------------------------
+
+void SiteChangeJournal::useSiteOrigins()
+{
+    assert(!mhasorigins);
+    morigins.resize(mcount);
+    for (int i = 0; i < mcount; ++i)  morigins[i] = (i < mminsize) ? i : -1;
+    SiteIndices::const_iterator ii = mmodified.begin();
+    for (; ii != mmodified.end(); ++ii)
+    {
+        if (*ii < mminsize)  morigins[*ii] = -1;
+    }
+    mmodified.clear();
+    mhasorigins = true;
+}
+
+
+void SiteChangeJournal::compactModified()
+{
+    std::sort(mmodified.begin(), mmodified.end());
+    mmodified.erase(std::unique(mmodified.begin(), mmodified.end()),
+            mmodified.end());
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+// End of file
@@ -0,0 +1,84 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class SiteChangeJournal -- record of modified, inserted and erased sites
+*     in a structure adapter since its base version.
+*
+* The journal provides StructureDifference in O(changes) when the sites
+* were only modified or inserted and erased at the end.  Insertions or
+* removals inside the site array switch the journal to a site-origin map,
+* which gives the difference in O(N) without comparing the atoms.
+*
+*****************************************************************************/
+
+#ifndef SITECHANGEJOURNAL_HPP_INCLUDED
+#define SITECHANGEJOURNAL_HPP_INCLUDED
+
+#include <diffpy/srreal/forwardtypes.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+class StructureDifference;
+
+class SiteChangeJournal
+{
+    public:
+
+        // constructor
+        SiteChangeJournal();
+
+        // methods
+        /// start a new journal for cntsites at the base version
+        void reset(unsigned long version, int cntsites);
+        /// stop recording, the journal is no longer authoritative
+        void invalidate();
+        /// return true if the journal is recording changes
+        bool isValid() const;
+        /// return true if the journal tracks all changes from the version
+        bool isValidFrom(unsigned long version) const;
+        /// record a change of site idx
+        void modified(int idx);
+        /// record a new site inserted at index idx
+        void inserted(int idx);
+        /// record removal of site at index idx
+        void erased(int idx);
+        /// record removal of all sites
+        void cleared();
+        /// set pop0, add1 and diffmethod of a StructureDifference
+        /// from the base version to the current structure
+        void getDifference(StructureDifference& sd) const;
+
+    private:
+
+        // methods
+        void useSiteOrigins();
+        void compactModified();
+
+        // data
+        unsigned long mbaseversion;
+        int mcountbase;
+        int mcount;
+        int mminsize;
+        bool mhasorigins;
+        /// indices of sites modified after the base version
+        SiteIndices mmodified;
+        /// base index for every current site or -1 for changed sites
+        SiteIndices morigins;
+
+};
+
+}   // namespace srreal
+}   // namespace diffpy
+
+#endif  // SITECHANGEJOURNAL_HPP_INCLUDED
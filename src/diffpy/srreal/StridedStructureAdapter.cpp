@@ -0,0 +1,193 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class StridedStructureAdapter -- adapter to atom data in caller-owned
+*     arrays, which are used in place without copying.
+*
+*****************************************************************************/
+
+#include <cassert>
+#include <stdexcept>
+
+#include <diffpy/srreal/StridedStructureAdapter.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
+
+using namespace std;
+
+namespace diffpy {
+namespace srreal {
+
+// Local Helpers -------------------------------------------------------------
+
+namespace {
+
+void ensureValidStride(int stride, int minstride)
+{
+    if (stride < minstride)
+    {
+        const char* emsg = "Array stride is too small.";
+        throw invalid_argument(emsg);
+    }
+}
+
+}   // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// class StridedStructureAdapter
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+StridedStructureAdapter::StridedStructureAdapter() :
+    mcount(0),
+    mposition(R3::zerovector),
+    mUij(R3::zeromatrix())
+{ }
+
+// Public Methods ------------------------------------------------------------
+
+StructureAdapterPtr StridedStructureAdapter::clone() const
+{
+    StructureAdapterPtr rv(new StridedStructureAdapter(*this));
+    return rv;
+}
+
+
+BaseBondGeneratorPtr StridedStructureAdapter::createBondGenerator() const
+{
+    BaseBondGeneratorPtr bnds(new BaseBondGenerator(shared_from_this()));
+    return bnds;
+}
+
+
+int StridedStructureAdapter::countSites() const
+{
+    return mcount;
+}
+
+
+const string& StridedStructureAdapter::siteAtomType(int idx) const
+{
+    assert(0 <= idx && idx < mcount);
+    if (!mtypeids.data)  return this->StructureAdapter::siteAtomType(idx);
+    return atomTypeName(*mtypeids.at(idx));
+}
+
+
+int StridedStructureAdapter::siteAtomTypeId(int idx) const
+{
+    assert(0 <= idx && idx < mcount);
+    if (!mtypeids.data)  return this->StructureAdapter::siteAtomTypeId(idx);
+    return *mtypeids.at(idx);
+}
+
+
+const R3::Vector& StridedStructureAdapter::siteCartesianPosition(
+        int idx) const
+{
+    assert(0 <= idx && idx < mcount);
+    const double* xyz = mxyz.at(idx);
+    mposition[0] = xyz[0];
+    mposition[1] = xyz[1];
+    mposition[2] = xyz[2];
+    return mposition;
+}
+
+
+double StridedStructureAdapter::siteOccupancy(int idx) const
+{
+    assert(0 <= idx && idx < mcount);
+    return moccupancies.data ? *moccupancies.at(idx) : 1.0;
+}
+
+
+bool StridedStructureAdapter::siteAnisotropy(int idx) const
+{
+    return muij.data != NULL;
+}
+
+
+const R3::Matrix& StridedStructureAdapter::siteCartesianUij(int idx) const
+{
+    assert(0 <= idx && idx < mcount);
+    if (muij.data)
+    {
+        const double* u = muij.at(idx);
+        mUij(0, 0) = u[0];
+        mUij(1, 1) = u[1];
+        mUij(2, 2) = u[2];
+        mUij(0, 1) = mUij(1, 0) = u[3];
+        mUij(0, 2) = mUij(2, 0) = u[4];
+        mUij(1, 2) = mUij(2, 1) = u[5];
+    }
+    else
+    {
+        const double uiso = muiso.data ? *muiso.at(idx) : 0.0;
+        mUij = uiso * R3::identity();
+    }
+    return mUij;
+}
+
+
+void StridedStructureAdapter::setPositions(
+        const double* xyz, int cnt, int stride)
+{
+    ensureValidStride(stride, R3::Ndim);
+    if (cnt < 0 || (cnt > 0 && !xyz))
+    {
+        const char* emsg = "Invalid positions array.";
+        throw invalid_argument(emsg);
+    }
+    mcount = cnt;
+    mxyz.data = xyz;
+    mxyz.stride = stride;
+}
+
+
+void StridedStructureAdapter::setTypeIds(const int* tids, int stride)
+{
+    ensureValidStride(stride, 1);
+    mtypeids.data = tids;
+    mtypeids.stride = stride;
+}
+
+
+void StridedStructureAdapter::setOccupancies(const double* occ, int stride)
+{
+    ensureValidStride(stride, 1);
+    moccupancies.data = occ;
+    moccupancies.stride = stride;
+}
+
+
+void StridedStructureAdapter::setUiso(const double* uiso, int stride)
+{
+    ensureValidStride(stride, 1);
+    muiso.data = uiso;
+    muiso.stride = stride;
+    muij.data = NULL;
+}
+
+
+void StridedStructureAdapter::setUij(const double* uij, int stride)
+{
+    ensureValidStride(stride, 6);
+    muij.data = uij;
+    muij.stride = stride;
+    muiso.data = NULL;
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+// End of file
@@ -0,0 +1,94 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class StridedStructureAdapter -- adapter to atom data in caller-owned
+*     arrays, which are used in place without copying.
+*
+* Every array is given by a pointer to the first site and a stride
+* between sites in units of its element type.  The arrays must stay
+* valid while the adapter is used.  Changes of the array values are
+* seen by the next evaluation.  Clones share the arrays.  The adapter
+* does not own the data and therefore does not support serialization.
+*
+*****************************************************************************/
+
+#ifndef STRIDEDSTRUCTUREADAPTER_HPP_INCLUDED
+#define STRIDEDSTRUCTUREADAPTER_HPP_INCLUDED
+
+#include <diffpy/srreal/StructureAdapter.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+class StridedStructureAdapter : public StructureAdapter
+{
+    public:
+
+        // constructor
+        StridedStructureAdapter();
+
+        // methods - overloaded
+        virtual StructureAdapterPtr clone() const;
+        virtual BaseBondGeneratorPtr createBondGenerator() const;
+        virtual int countSites() const;
+        virtual const std::string& siteAtomType(int idx) const;
+        virtual int siteAtomTypeId(int idx) const;
+        /// returned reference is valid until the next call
+        virtual const R3::Vector& siteCartesianPosition(int idx) const;
+        virtual double siteOccupancy(int idx) const;
+        virtual bool siteAnisotropy(int idx) const;
+        /// returned reference is valid until the next call
+        virtual const R3::Matrix& siteCartesianUij(int idx) const;
+
+        // methods - own
+        /// use cnt Cartesian positions starting at xyz
+        void setPositions(const double* xyz, int cnt, int stride=3);
+        /// use interned atom type ids from atomTypeId or NULL for
+        /// blank atom types
+        void setTypeIds(const int* tids, int stride=1);
+        /// use site occupancies or NULL for full occupancy
+        void setOccupancies(const double* occ, int stride=1);
+        /// use isotropic displacement parameters or NULL for zero Uij
+        void setUiso(const double* uiso, int stride=1);
+        /// use anisotropic Cartesian displacement parameters ordered as
+        /// U11, U22, U33, U12, U13, U23, or NULL for zero Uij
+        void setUij(const double* uij, int stride=6);
+
+    private:
+
+        // types
+        template <class T>
+        struct StridedArray
+        {
+            const T* data;
+            int stride;
+            StridedArray() : data(NULL), stride(1)  { }
+            const T* at(int idx) const  { return data + idx * stride; }
+        };
+
+        // data
+        int mcount;
+        StridedArray<double> mxyz;
+        StridedArray<int> mtypeids;
+        StridedArray<double> moccupancies;
+        StridedArray<double> muiso;
+        StridedArray<double> muij;
+        mutable R3::Vector mposition;
+        mutable R3::Matrix mUij;
+
+};
+
+}   // namespace srreal
+}   // namespace diffpy
+
+#endif  // STRIDEDSTRUCTUREADAPTER_HPP_INCLUDED
@@ -24,6 +24,7 @@
 #include <diffpy/mathutils.hpp>
 #include <diffpy/srreal/StructureAdapter.hpp>
 #include <diffpy/srreal/StructureDifference.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
 
 using namespace std;
 using diffpy::mathutils::eps_eq;
@@ -58,6 +59,12 @@ const string& StructureAdapter::siteAtomType(int idx) const
 }
 
 
+int StructureAdapter::siteAtomTypeId(int idx) const
+{
+    return atomTypeId(this->siteAtomType(idx));
+}
+
+
 int StructureAdapter::siteMultiplicity(int idx) const
 {
     return 1;
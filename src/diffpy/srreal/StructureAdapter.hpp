@@ -70,6 +70,9 @@ class StructureAdapter :
         /// symbol for element or ion at the independent site @param idx
         virtual const std::string& siteAtomType(int idx) const;
 
+        /// interned id of siteAtomType, see atomTypeId in AtomUtils.hpp
+        virtual int siteAtomTypeId(int idx) const;
+
         /// Cartesian coordinates of the independent site @param idx
         virtual const R3::Vector& siteCartesianPosition(int idx) const = 0;
 
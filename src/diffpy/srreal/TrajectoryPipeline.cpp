@@ -0,0 +1,301 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class TrajectoryPipeline -- evaluate a pair quantity over trajectory
+*     frames and accumulate the running mean and variance of its output
+*
+*****************************************************************************/
+
+#include <sstream>
+#include <stdexcept>
+
+#include <diffpy/srreal/TrajectoryPipeline.hpp>
+#include <diffpy/srreal/PeriodicStructureAdapter.hpp>
+#include <diffpy/srreal/PairQuantity.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
+#include <diffpy/serialization.hpp>
+#include <diffpy/validators.hpp>
+
+using namespace std;
+
+namespace diffpy {
+namespace srreal {
+
+// Local Helpers -------------------------------------------------------------
+
+namespace {
+
+QuantityType pairQuantityValue(const PairQuantity& pq)
+{
+    return pq.value();
+}
+
+
+void ensureSameSize(const QuantityType& y0, const QuantityType& y1)
+{
+    if (y0.size() != y1.size())
+    {
+        const char* emsg = "Accumulated arrays must have the same size.";
+        throw invalid_argument(emsg);
+    }
+}
+
+}   // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// class TrajectoryPipeline
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+TrajectoryPipeline::TrajectoryPipeline(PairQuantity& pq) :
+    mpq(&pq),
+    moutput(pairQuantityValue),
+    muiso(0.0),
+    mbondcacheskin(1.0),
+    mcpuindex(0),
+    mncpu(1),
+    mperiodic(false),
+    mcount(0)
+{ }
+
+// Public Methods ------------------------------------------------------------
+
+void TrajectoryPipeline::setOutput(const OutputFunction& fnc)
+{
+    moutput = fnc ? fnc : OutputFunction(pairQuantityValue);
+}
+
+
+void TrajectoryPipeline::setUiso(double uiso)
+{
+    if (uiso != muiso)  mstructure.reset();
+    muiso = uiso;
+}
+
+
+const double& TrajectoryPipeline::getUiso() const
+{
+    return muiso;
+}
+
+
+void TrajectoryPipeline::setBondCacheSkin(double skin)
+{
+    using diffpy::validators::ensureNonNegative;
+    ensureNonNegative("skin", skin);
+    if (mstructure)  mstructure->setBondCacheSkin(skin);
+    mbondcacheskin = skin;
+}
+
+
+const double& TrajectoryPipeline::getBondCacheSkin() const
+{
+    return mbondcacheskin;
+}
+
+
+void TrajectoryPipeline::setupParallelRun(int cpuindex, int ncpu)
+{
+    if (ncpu < 1)
+    {
+        const char* emsg = "Number of CPU ncpu must be at least 1.";
+        throw invalid_argument(emsg);
+    }
+    mcpuindex = cpuindex;
+    mncpu = ncpu;
+}
+
+
+void TrajectoryPipeline::run(const TrajectorySource& src)
+{
+    const int cntframes = src.countFrames();
+    for (int k = 0; k < cntframes; ++k)
+    {
+        if (k % mncpu != mcpuindex)  continue;
+        src.readFrame(k, mframe);
+        this->addFrame(mframe);
+    }
+}
+
+
+void TrajectoryPipeline::addFrame(const TrajectoryFrame& frame)
+{
+    this->updateStructure(frame);
+    mpq->eval(mstructure);
+    const QuantityType y = moutput(*mpq);
+    this->accumulateFrame(y);
+}
+
+
+void TrajectoryPipeline::reset()
+{
+    mcount = 0;
+    mmean.clear();
+    mm2.clear();
+}
+
+
+int TrajectoryPipeline::countFrames() const
+{
+    return mcount;
+}
+
+
+const QuantityType& TrajectoryPipeline::mean() const
+{
+    return mmean;
+}
+
+
+QuantityType TrajectoryPipeline::variance() const
+{
+    QuantityType rv(mm2.size(), 0.0);
+    if (mcount < 2)  return rv;
+    for (size_t i = 0; i < rv.size(); ++i)  rv[i] = mm2[i] / (mcount - 1);
+    return rv;
+}
+
+
+string TrajectoryPipeline::getParallelData() const
+{
+    ostringstream storage(ios::binary);
+    diffpy::serialization::oarchive oa(storage, ios::binary);
+    oa << mcount << mmean << mm2;
+    return storage.str();
+}
+
+
+void TrajectoryPipeline::mergeParallelData(const string& pdata)
+{
+    istringstream storage(pdata, ios::binary);
+    diffpy::serialization::iarchive ia(storage, ios::binary);
+    int cnt;
+    QuantityType pmean;
+    QuantityType pm2;
+    ia >> cnt >> pmean >> pm2;
+    this->accumulate(cnt, pmean, pm2);
+}
+
+// Private Methods -----------------------------------------------------------
+
+void TrajectoryPipeline::updateStructure(const TrajectoryFrame& frame)
+{
+    const int cntsites = frame.positions.size();
+    if (int(frame.typeids.size()) != cntsites)
+    {
+        const char* emsg = "Frame must have one atom type per site.";
+        throw invalid_argument(emsg);
+    }
+    // build new adapter when the sites or the boundary conditions change
+    if (!mstructure || mperiodic != frame.periodic ||
+            mtypeids != frame.typeids)
+    {
+        mstructure = frame.periodic ?
+            PeriodicStructureAdapterPtr(new PeriodicStructureAdapter) :
+            AtomicStructureAdapterPtr(new AtomicStructureAdapter);
+        mstructure->setBondCacheSkin(mbondcacheskin);
+        mstructure->reserve(cntsites);
+        Atom a;
+        a.uij_cartn = muiso * R3::identity();
+        for (int i = 0; i < cntsites; ++i)
+        {
+            a.atomtype = atomTypeName(frame.typeids[i]);
+            mstructure->append(a);
+        }
+        mtypeids = frame.typeids;
+        mperiodic = frame.periodic;
+    }
+    // update positions in place to keep the neighbor list.  Only the
+    // moved sites are recorded in the change journal of the adapter.
+    const AtomicStructureAdapter& cstru = *mstructure;
+    if (!mperiodic)
+    {
+        for (int i = 0; i < cntsites; ++i)
+        {
+            const R3::Vector& xyz = frame.positions[i];
+            if (cstru[i].xyz_cartn == xyz)  continue;
+            mstructure->setAtomPosition(i, xyz);
+        }
+        return;
+    }
+    // periodic sites are placed by their fractional coordinates,
+    // because the adapter lattice uses the standard orientation
+    PeriodicStructureAdapter& pstru =
+        static_cast<PeriodicStructureAdapter&>(*mstructure);
+    const Lattice& L = frame.lattice;
+    pstru.setLatPar(L.a(), L.b(), L.c(), L.alpha(), L.beta(), L.gamma());
+    R3::Vector xyz;
+    for (int i = 0; i < cntsites; ++i)
+    {
+        xyz = pstru.getLattice().cartesian(L.fractional(frame.positions[i]));
+        if (cstru[i].xyz_cartn == xyz)  continue;
+        pstru.setAtomPosition(i, xyz);
+    }
+}
+
+
+void TrajectoryPipeline::accumulate(int cnt,
+        const QuantityType& mean, const QuantityType& m2)
+{
+    if (cnt == 0)  return;
+    if (mcount == 0)
+    {
+        mcount = cnt;
+        mmean = mean;
+        mm2 = m2;
+        return;
+    }
+    ensureSameSize(mmean, mean);
+    ensureSameSize(mm2, m2);
+    // combine the statistics of two sets of frames
+    const double cnttotal = mcount + cnt;
+    const double wcnt = cnt / cnttotal;
+    const double wm2 = double(mcount) * cnt / cnttotal;
+    for (size_t i = 0; i < mmean.size(); ++i)
+    {
+        const double d = mean[i] - mmean[i];
+        mmean[i] += d * wcnt;
+        mm2[i] += m2[i] + d * d * wm2;
+    }
+    mcount += cnt;
+}
+
+
+void TrajectoryPipeline::accumulateFrame(const QuantityType& y)
+{
+    // one frame has no deviations from its mean
+    if (mcount == 0)
+    {
+        mcount = 1;
+        mmean = y;
+        mm2.assign(y.size(), 0.0);
+        return;
+    }
+    ensureSameSize(mmean, y);
+    const double cnttotal = mcount + 1;
+    const double wcnt = 1 / cnttotal;
+    const double wm2 = mcount / cnttotal;
+    for (size_t i = 0; i < mmean.size(); ++i)
+    {
+        const double d = y[i] - mmean[i];
+        mmean[i] += d * wcnt;
+        mm2[i] += d * d * wm2;
+    }
+    ++mcount;
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+// End of file
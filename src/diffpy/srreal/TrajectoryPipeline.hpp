@@ -0,0 +1,108 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class TrajectoryPipeline -- evaluate a pair quantity over trajectory
+*     frames and accumulate the running mean and variance of its output
+*
+* The frames are loaded into one reused atomic or periodic structure
+* adapter that keeps a neighbor list with skin, so that the pairs are
+* searched again only when some atom moves more than half of the skin.
+* Parallel runs follow the PairQuantity model, every process handles
+* a subset of frames and the partial results are combined with
+* getParallelData and mergeParallelData.
+*
+*****************************************************************************/
+
+#ifndef TRAJECTORYPIPELINE_HPP_INCLUDED
+#define TRAJECTORYPIPELINE_HPP_INCLUDED
+
+#include <string>
+#include <functional>
+
+#include <diffpy/srreal/QuantityType.hpp>
+#include <diffpy/srreal/TrajectorySource.hpp>
+#include <diffpy/srreal/AtomicStructureAdapter.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+class PairQuantity;
+
+class TrajectoryPipeline
+{
+    public:
+
+        // types
+        typedef std::function<QuantityType(const PairQuantity&)>
+            OutputFunction;
+
+        // constructor
+        /// evaluate frames with pq, which must stay valid while in use
+        explicit TrajectoryPipeline(PairQuantity& pq);
+
+        // methods
+        /// set the accumulated result, by default PairQuantity::value
+        void setOutput(const OutputFunction& fnc);
+        /// isotropic displacement parameter for all sites
+        void setUiso(double uiso);
+        const double& getUiso() const;
+        /// skin of the reused neighbor list, no reuse when zero
+        void setBondCacheSkin(double skin);
+        const double& getBondCacheSkin() const;
+        /// evaluate only the frames k where k % ncpu == cpuindex
+        void setupParallelRun(int cpuindex, int ncpu);
+        /// evaluate and accumulate all frames of the source
+        void run(const TrajectorySource& src);
+        /// evaluate and accumulate one frame
+        void addFrame(const TrajectoryFrame& frame);
+        /// discard the accumulated results
+        void reset();
+        /// number of accumulated frames
+        int countFrames() const;
+        const QuantityType& mean() const;
+        /// sample variance of the output over the accumulated frames
+        QuantityType variance() const;
+        std::string getParallelData() const;
+        /// add partial results from getParallelData of another pipeline
+        void mergeParallelData(const std::string& pdata);
+
+    private:
+
+        // methods
+        void updateStructure(const TrajectoryFrame& frame);
+        void accumulate(int cnt, const QuantityType& mean,
+                const QuantityType& m2);
+        void accumulateFrame(const QuantityType& y);
+
+        // data
+        PairQuantity* mpq;
+        OutputFunction moutput;
+        double muiso;
+        double mbondcacheskin;
+        int mcpuindex;
+        int mncpu;
+        AtomicStructureAdapterPtr mstructure;
+        SiteIndices mtypeids;
+        bool mperiodic;
+        TrajectoryFrame mframe;
+        // running statistics
+        int mcount;
+        QuantityType mmean;
+        /// sum of squared deviations from the mean
+        QuantityType mm2;
+};
+
+}   // namespace srreal
+}   // namespace diffpy
+
+#endif  // TRAJECTORYPIPELINE_HPP_INCLUDED
@@ -0,0 +1,387 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class TrajectorySource and its implementations for raw arrays, XYZ
+* and LAMMPS dump files.
+*
+*****************************************************************************/
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include <diffpy/srreal/TrajectorySource.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
+#include <diffpy/runtimepath.hpp>
+#include <diffpy/validators.hpp>
+
+using namespace std;
+using diffpy::runtimepath::LineReader;
+using diffpy::validators::ensureFileOK;
+
+namespace diffpy {
+namespace srreal {
+
+// Local Helpers -------------------------------------------------------------
+
+namespace {
+
+void ensureValidFrameIndex(int k, int cntframes)
+{
+    if (k < 0 || k >= cntframes)
+    {
+        const char* emsg = "Frame index out of range.";
+        throw out_of_range(emsg);
+    }
+}
+
+
+template <class T>
+T parseWord(LineReader& lnrd, size_t idx, const string& filename)
+{
+    T rv;
+    istringstream fpw(idx < lnrd.wcount() ? lnrd.words[idx] : "");
+    if (!(fpw >> rv))  throw lnrd.format_error(filename, "");
+    return rv;
+}
+
+
+void readLine(istream& fp, LineReader& lnrd, const string& filename)
+{
+    if (!(fp >> lnrd))
+    {
+        throw lnrd.format_error(filename, "Unexpected end of file.");
+    }
+}
+
+
+/// set lat and return true if line has an extended XYZ Lattice entry
+bool parseXYZLattice(const string& line, Lattice& lat)
+{
+    const string key = "Lattice=\"";
+    string::size_type pb = line.find(key);
+    if (pb == string::npos)  return false;
+    pb += key.size();
+    string::size_type pe = line.find('"', pb);
+    istringstream fpl(line.substr(pb, pe - pb));
+    R3::Vector vabc[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!(fpl >> vabc[i][0] >> vabc[i][1] >> vabc[i][2]))
+        {
+            const char* emsg = "Invalid extended XYZ Lattice.";
+            throw runtime_error(emsg);
+        }
+    }
+    lat.setLatBase(vabc[0], vabc[1], vabc[2]);
+    return true;
+}
+
+
+bool isLAMMPSItem(const LineReader& lnrd, const string& item)
+{
+    return lnrd.wcount() > 1 &&
+        lnrd.words[0] == "ITEM:" && lnrd.words[1] == item;
+}
+
+}   // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// class RawTrajectorySource
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+RawTrajectorySource::RawTrajectorySource(
+        const double* xyz, int cntframes, int cntsites) :
+    mxyz(xyz),
+    mcountframes(cntframes),
+    mcountsites(cntsites),
+    mperiodic(false)
+{
+    if (cntframes < 0 || cntsites < 0 ||
+            (cntframes > 0 && cntsites > 0 && !xyz))
+    {
+        const char* emsg = "Invalid trajectory array.";
+        throw invalid_argument(emsg);
+    }
+    mtypeids.assign(cntsites, atomTypeId(""));
+}
+
+// Public Methods ------------------------------------------------------------
+
+int RawTrajectorySource::countFrames() const
+{
+    return mcountframes;
+}
+
+
+void RawTrajectorySource::readFrame(int k, TrajectoryFrame& frame) const
+{
+    ensureValidFrameIndex(k, mcountframes);
+    frame.typeids = mtypeids;
+    frame.positions.resize(mcountsites);
+    const double* xyz = mxyz + 3 * k * mcountsites;
+    for (int i = 0; i < mcountsites; ++i, xyz += 3)
+    {
+        frame.positions[i] = R3::Vector(xyz[0], xyz[1], xyz[2]);
+    }
+    frame.periodic = mperiodic;
+    frame.lattice = mlattice;
+}
+
+
+void RawTrajectorySource::setTypeIds(const SiteIndices& tids)
+{
+    if (int(tids.size()) != mcountsites)
+    {
+        const char* emsg = "Type ids must have one entry per site.";
+        throw invalid_argument(emsg);
+    }
+    mtypeids = tids;
+}
+
+
+void RawTrajectorySource::setLattice(const Lattice& lat)
+{
+    mlattice = lat;
+    mperiodic = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// class XYZTrajectorySource
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+XYZTrajectorySource::XYZTrajectorySource(const string& filename) :
+    mfilename(filename),
+    mfile(filename.c_str())
+{
+    ensureFileOK(mfilename, mfile);
+    LineReader lnrd;
+    lnrd.commentmark.clear();
+    while (true)
+    {
+        const streampos pos = mfile.tellg();
+        const int lineno = lnrd.lineno;
+        if (!(mfile >> lnrd))  break;
+        if (lnrd.isblank())  continue;
+        const int cnt = parseWord<int>(lnrd, 0, mfilename);
+        moffsets.push_back(pos);
+        mlinenos.push_back(lineno);
+        // skip the comment and atom lines
+        for (int i = 0; i < cnt + 1; ++i)  readLine(mfile, lnrd, mfilename);
+    }
+    mfile.clear();
+}
+
+// Public Methods ------------------------------------------------------------
+
+int XYZTrajectorySource::countFrames() const
+{
+    return moffsets.size();
+}
+
+
+void XYZTrajectorySource::readFrame(int k, TrajectoryFrame& frame) const
+{
+    ensureValidFrameIndex(k, this->countFrames());
+    mfile.clear();
+    mfile.seekg(moffsets[k]);
+    LineReader lnrd;
+    lnrd.commentmark.clear();
+    lnrd.lineno = mlinenos[k];
+    readLine(mfile, lnrd, mfilename);
+    const int cnt = parseWord<int>(lnrd, 0, mfilename);
+    readLine(mfile, lnrd, mfilename);
+    frame.periodic = parseXYZLattice(lnrd.line, frame.lattice);
+    frame.typeids.resize(cnt);
+    frame.positions.resize(cnt);
+    for (int i = 0; i < cnt; ++i)
+    {
+        readLine(mfile, lnrd, mfilename);
+        if (lnrd.wcount() < 4)  throw lnrd.format_error(mfilename, "");
+        frame.typeids[i] = atomTypeId(lnrd.words[0]);
+        R3::Vector& xyz = frame.positions[i];
+        for (int j = 0; j < R3::Ndim; ++j)
+        {
+            xyz[j] = parseWord<double>(lnrd, j + 1, mfilename);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// class LAMMPSTrajectorySource
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructor ---------------------------------------------------------------
+
+LAMMPSTrajectorySource::LAMMPSTrajectorySource(const string& filename) :
+    mfilename(filename),
+    mfile(filename.c_str())
+{
+    ensureFileOK(mfilename, mfile);
+    LineReader lnrd;
+    lnrd.commentmark.clear();
+    while (true)
+    {
+        const streampos pos = mfile.tellg();
+        const int lineno = lnrd.lineno;
+        if (!(mfile >> lnrd))  break;
+        if (!isLAMMPSItem(lnrd, "TIMESTEP"))  continue;
+        moffsets.push_back(pos);
+        mlinenos.push_back(lineno);
+    }
+    mfile.clear();
+}
+
+// Public Methods ------------------------------------------------------------
+
+int LAMMPSTrajectorySource::countFrames() const
+{
+    return moffsets.size();
+}
+
+
+void LAMMPSTrajectorySource::readFrame(int k, TrajectoryFrame& frame) const
+{
+    ensureValidFrameIndex(k, this->countFrames());
+    mfile.clear();
+    mfile.seekg(moffsets[k]);
+    LineReader lnrd;
+    lnrd.commentmark.clear();
+    lnrd.lineno = mlinenos[k];
+    readLine(mfile, lnrd, mfilename);
+    int cnt = 0;
+    R3::Vector origin = R3::zerovector;
+    frame.periodic = false;
+    // process items of the frame up to the atom records
+    while (true)
+    {
+        readLine(mfile, lnrd, mfilename);
+        if (isLAMMPSItem(lnrd, "NUMBER"))
+        {
+            readLine(mfile, lnrd, mfilename);
+            cnt = parseWord<int>(lnrd, 0, mfilename);
+        }
+        if (isLAMMPSItem(lnrd, "BOX"))
+        {
+            const int nw = lnrd.wcount();
+            const bool triclinic = (nw > 3 && lnrd.words[3] == "xy");
+            frame.periodic = (nw < 6) || (lnrd.words[nw - 1] == "pp" &&
+                    lnrd.words[nw - 2] == "pp" && lnrd.words[nw - 3] == "pp");
+            double lohi[3][2];
+            double tilt[3] = {0.0, 0.0, 0.0};
+            for (int i = 0; i < 3; ++i)
+            {
+                readLine(mfile, lnrd, mfilename);
+                lohi[i][0] = parseWord<double>(lnrd, 0, mfilename);
+                lohi[i][1] = parseWord<double>(lnrd, 1, mfilename);
+                if (!triclinic)  continue;
+                tilt[i] = parseWord<double>(lnrd, 2, mfilename);
+            }
+            // convert bounding box to the cell, tilt is xy, xz, yz
+            const double& xy = tilt[0];
+            const double& xz = tilt[1];
+            const double& yz = tilt[2];
+            lohi[0][0] -= min(min(0.0, xy), min(xz, xy + xz));
+            lohi[0][1] -= max(max(0.0, xy), max(xz, xy + xz));
+            lohi[1][0] -= min(0.0, yz);
+            lohi[1][1] -= max(0.0, yz);
+            origin = R3::Vector(lohi[0][0], lohi[1][0], lohi[2][0]);
+            frame.lattice.setLatBase(
+                    R3::Vector(lohi[0][1] - lohi[0][0], 0.0, 0.0),
+                    R3::Vector(xy, lohi[1][1] - lohi[1][0], 0.0),
+                    R3::Vector(xz, yz, lohi[2][1] - lohi[2][0]));
+        }
+        if (isLAMMPSItem(lnrd, "ATOMS"))  break;
+    }
+    // find the atom columns
+    const vector<string> columns(lnrd.words.begin() + 2, lnrd.words.end());
+    vector<string>::const_iterator ii;
+    int colid = -1;
+    int coltype = -1;
+    int colelement = -1;
+    int colxyz = -1;
+    bool scaled = false;
+    for (ii = columns.begin(); ii != columns.end(); ++ii)
+    {
+        const int c = ii - columns.begin();
+        if (*ii == "id")  colid = c;
+        if (*ii == "type")  coltype = c;
+        if (*ii == "element")  colelement = c;
+        if (*ii == "x" || *ii == "xu")
+        {
+            colxyz = c;
+            scaled = false;
+        }
+        if ((*ii == "xs" || *ii == "xsu") && colxyz < 0)
+        {
+            colxyz = c;
+            scaled = true;
+        }
+    }
+    if (colxyz < 0 || (colelement < 0 && coltype < 0))
+    {
+        const char* emsg = "Missing atom type or position columns.";
+        throw lnrd.format_error(mfilename, emsg);
+    }
+    // read atom records ordered by their id
+    vector< pair<int, int> > idorder(cnt);
+    frame.typeids.resize(cnt);
+    frame.positions.resize(cnt);
+    SiteIndices tids(cnt);
+    vector<R3::Vector> xyz(cnt);
+    for (int i = 0; i < cnt; ++i)
+    {
+        readLine(mfile, lnrd, mfilename);
+        idorder[i].first = (colid < 0) ? i :
+            parseWord<int>(lnrd, colid, mfilename);
+        idorder[i].second = i;
+        if (colelement >= 0)
+        {
+            tids[i] = atomTypeId(
+                    parseWord<string>(lnrd, colelement, mfilename));
+        }
+        else
+        {
+            const int t = parseWord<int>(lnrd, coltype, mfilename);
+            const bool named = (0 < t && t <= int(mtypenames.size()));
+            tids[i] = atomTypeId(named ? mtypenames[t - 1] :
+                    lnrd.words[coltype]);
+        }
+        for (int j = 0; j < R3::Ndim; ++j)
+        {
+            xyz[i][j] = parseWord<double>(lnrd, colxyz + j, mfilename);
+        }
+        if (scaled)  xyz[i] = origin + frame.lattice.cartesian(xyz[i]);
+    }
+    sort(idorder.begin(), idorder.end());
+    for (int i = 0; i < cnt; ++i)
+    {
+        frame.typeids[i] = tids[idorder[i].second];
+        frame.positions[i] = xyz[idorder[i].second];
+    }
+}
+
+
+void LAMMPSTrajectorySource::setTypeNames(const vector<string>& names)
+{
+    mtypenames = names;
+}
+
+}   // namespace srreal
+}   // namespace diffpy
+
+// End of file
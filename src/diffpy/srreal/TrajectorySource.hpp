@@ -0,0 +1,163 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* struct TrajectoryFrame -- atom types and positions in one trajectory frame
+*
+* class TrajectorySource -- abstract random-access source of trajectory
+*     frames
+*
+* class RawTrajectorySource -- frames in a caller-owned array of doubles,
+*     for example a memory-mapped binary file
+*
+* class XYZTrajectorySource -- frames in a multi-frame XYZ file
+*
+* class LAMMPSTrajectorySource -- frames in a LAMMPS text dump file
+*
+* The text sources index the frame offsets once in the constructor and
+* parse the frames on demand in readFrame.
+*
+*****************************************************************************/
+
+#ifndef TRAJECTORYSOURCE_HPP_INCLUDED
+#define TRAJECTORYSOURCE_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <boost/shared_ptr.hpp>
+
+#include <diffpy/srreal/R3linalg.hpp>
+#include <diffpy/srreal/Lattice.hpp>
+#include <diffpy/srreal/forwardtypes.hpp>
+
+namespace diffpy {
+namespace srreal {
+
+struct TrajectoryFrame
+{
+    // constructor
+    TrajectoryFrame() : periodic(false)  { }
+
+    // data
+    /// interned atom type ids of the sites
+    SiteIndices typeids;
+    /// Cartesian coordinates of the sites
+    std::vector<R3::Vector> positions;
+    /// true when the sites are in a periodic cell given by lattice
+    bool periodic;
+    Lattice lattice;
+};
+
+
+class TrajectorySource
+{
+    public:
+
+        // destructor
+        virtual ~TrajectorySource()  { }
+
+        // methods
+        virtual int countFrames() const = 0;
+        /// fill frame with the data of the k-th frame
+        virtual void readFrame(int k, TrajectoryFrame& frame) const = 0;
+};
+
+typedef boost::shared_ptr<TrajectorySource> TrajectorySourcePtr;
+
+
+class RawTrajectorySource : public TrajectorySource
+{
+    public:
+
+        // constructor
+        /// use cntframes frames of cntsites x, y, z Cartesian coordinates
+        /// stored consecutively in xyz.  The array must stay valid while
+        /// the source is used.
+        RawTrajectorySource(const double* xyz, int cntframes, int cntsites);
+
+        // methods - overloaded
+        virtual int countFrames() const;
+        virtual void readFrame(int k, TrajectoryFrame& frame) const;
+
+        // methods - own
+        /// interned atom type ids of the sites, common to all frames
+        void setTypeIds(const SiteIndices& tids);
+        /// periodic cell common to all frames
+        void setLattice(const Lattice& lat);
+
+    private:
+
+        // data
+        const double* mxyz;
+        int mcountframes;
+        int mcountsites;
+        SiteIndices mtypeids;
+        bool mperiodic;
+        Lattice mlattice;
+};
+
+
+class XYZTrajectorySource : public TrajectorySource
+{
+    public:
+
+        // constructor
+        /// index frames in the XYZ file.  Frames with extended XYZ
+        /// Lattice="ax ay az bx by bz cx cy cz" comments are periodic.
+        explicit XYZTrajectorySource(const std::string& filename);
+
+        // methods - overloaded
+        virtual int countFrames() const;
+        virtual void readFrame(int k, TrajectoryFrame& frame) const;
+
+    private:
+
+        // data
+        std::string mfilename;
+        mutable std::ifstream mfile;
+        std::vector<std::streampos> moffsets;
+        std::vector<int> mlinenos;
+};
+
+
+class LAMMPSTrajectorySource : public TrajectorySource
+{
+    public:
+
+        // constructor
+        /// index frames in the LAMMPS dump file.  Atom types are taken
+        /// from the element column when present.
+        explicit LAMMPSTrajectorySource(const std::string& filename);
+
+        // methods - overloaded
+        virtual int countFrames() const;
+        virtual void readFrame(int k, TrajectoryFrame& frame) const;
+
+        // methods - own
+        /// atom type names for the numeric LAMMPS types 1, 2, ...
+        void setTypeNames(const std::vector<std::string>& names);
+
+    private:
+
+        // data
+        std::string mfilename;
+        mutable std::ifstream mfile;
+        std::vector<std::streampos> moffsets;
+        std::vector<int> mlinenos;
+        std::vector<std::string> mtypenames;
+};
+
+}   // namespace srreal
+}   // namespace diffpy
+
+#endif  // TRAJECTORYSOURCE_HPP_INCLUDED
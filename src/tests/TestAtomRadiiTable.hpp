@@ -22,6 +22,7 @@
 #include "serialization_helpers.hpp"
 #include <diffpy/srreal/AtomRadiiTable.hpp>
 #include <diffpy/srreal/ConstantRadiiTable.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
 
 using namespace std;
 using namespace diffpy::srreal;
@@ -59,6 +60,21 @@ class TestAtomRadiiTable : public CxxTest::TestSuite
         }
 
 
+        void test_lookupById()
+        {
+            const int idC = atomTypeId("C");
+            TS_ASSERT_EQUALS(0.0, mrtb->lookup(idC));
+            mrtb->fromString("C:1.4");
+            TS_ASSERT_EQUALS(1.4, mrtb->lookup(idC));
+            mrtb->setCustom("C", 1.5);
+            TS_ASSERT_EQUALS(1.5, mrtb->lookup(idC));
+            const int idX = atomTypeId("X-radius-test");
+            TS_ASSERT_EQUALS(0.0, mrtb->lookup(idX));
+            mrtb->resetCustom("C");
+            TS_ASSERT_EQUALS(0.0, mrtb->lookup(idC));
+        }
+
+
         void test_fromString()
         {
             TS_ASSERT_EQUALS(0u, mrtb->getAllCustom().size());
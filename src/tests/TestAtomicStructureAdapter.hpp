@@ -17,12 +17,15 @@
 *
 *****************************************************************************/
 
+#include <typeinfo>
 #include <cxxtest/TestSuite.h>
 
 #include <boost/make_shared.hpp>
 
 #include <diffpy/srreal/AtomicStructureAdapter.hpp>
 #include <diffpy/srreal/StructureDifference.hpp>
+#include <diffpy/srreal/BondCalculator.hpp>
+#include <diffpy/srreal/PDFCalculator.hpp>
 #include "serialization_helpers.hpp"
 
 namespace diffpy {
@@ -30,6 +33,35 @@ namespace srreal {
 
 using namespace std;
 
+// Local Helpers -------------------------------------------------------------
+
+namespace {
+
+typedef vector< pair<pair<int,int>, double> > BondList;
+
+BondList sortedBonds(StructureAdapterConstPtr stru, double rmax,
+        const SiteIndices* selection=NULL)
+{
+    BondList rv;
+    BaseBondGeneratorPtr bnds = stru->createBondGenerator();
+    bnds->setRmax(rmax);
+    for (int i = 0; i < stru->countSites(); ++i)
+    {
+        bnds->selectAnchorSite(i);
+        if (selection)  bnds->selectSites(*selection);
+        else  bnds->selectSiteRange(0, stru->countSites());
+        for (bnds->rewind(); !bnds->finished(); bnds->next())
+        {
+            pair<int,int> ij(bnds->site0(), bnds->site1());
+            rv.push_back(make_pair(ij, bnds->distance()));
+        }
+    }
+    sort(rv.begin(), rv.end());
+    return rv;
+}
+
+}   // namespace
+
 //////////////////////////////////////////////////////////////////////////////
 // class TestAtomicStructureAdapter
 //////////////////////////////////////////////////////////////////////////////
@@ -119,6 +151,7 @@ class TestAtomicStructureAdapter : public CxxTest::TestSuite
             ai.xyz_cartn = R3::Vector(4, 5, 6);
             ai.anisotropy = false;
             mpstru->append(ai);
+            mpstru->setBondCacheSkin(0.3);
             StructureAdapterPtr stru1;
             stru1 = dumpandload(mstru);
             AtomicStructureAdapterPtr astru1 =
@@ -126,6 +159,7 @@ class TestAtomicStructureAdapter : public CxxTest::TestSuite
             TS_ASSERT_EQUALS(2, astru1->countSites());
             TS_ASSERT_EQUALS((*mpstru)[0], (*astru1)[0]);
             TS_ASSERT_EQUALS((*mpstru)[1], (*astru1)[1]);
+            TS_ASSERT_EQUALS(0.3, astru1->getBondCacheSkin());
         }
 
 
@@ -148,6 +182,311 @@ class TestAtomicStructureAdapter : public CxxTest::TestSuite
             TS_ASSERT(!(*mpstru == *cpstru));
         }
 
+
+        void test_copy_on_write()
+        {
+            Atom ai;
+            ai.atomtype = "C";
+            mpstru->append(ai);
+            mpstru->append(ai);
+            StructureAdapterPtr stru1 = mstru->clone();
+            AtomicStructureAdapterPtr astru1 =
+                boost::dynamic_pointer_cast<AtomicStructureAdapter>(stru1);
+            const AtomicStructureAdapter& castru0 = *mpstru;
+            const AtomicStructureAdapter& castru1 = *astru1;
+            TS_ASSERT_EQUALS(&castru0[0], &castru1[0]);
+            TS_ASSERT_EQUALS(mpstru->getAtomsVersion(),
+                    astru1->getAtomsVersion());
+            StructureDifference sd = mstru->diff(stru1);
+            TS_ASSERT(sd.pop0.empty());
+            TS_ASSERT(sd.add1.empty());
+            (*astru1)[1].xyz_cartn[0] = 1.0;
+            TS_ASSERT_DIFFERS(&castru0[0], &castru1[0]);
+            TS_ASSERT_DIFFERS(mpstru->getAtomsVersion(),
+                    astru1->getAtomsVersion());
+            TS_ASSERT_EQUALS(0.0, castru0[1].xyz_cartn[0]);
+            sd = mstru->diff(stru1);
+            TS_ASSERT_EQUALS(1u, sd.pop0.size());
+            TS_ASSERT_EQUALS(1, sd.add1.at(0));
+            // non-const access changes version even if atoms do not change
+            AtomicStructureAdapterPtr astru2 =
+                boost::make_shared<AtomicStructureAdapter>(*mpstru);
+            mpstru->begin();
+            TS_ASSERT_DIFFERS(mpstru->getAtomsVersion(),
+                    astru2->getAtomsVersion());
+            TS_ASSERT_EQUALS(*mpstru, *astru2);
+        }
+
+
+        void test_held_reference()
+        {
+            Atom ai;
+            ai.atomtype = "C";
+            for (int i = 0; i < 10; ++i)
+            {
+                ai.xyz_cartn[0] = i;
+                mpstru->append(ai);
+            }
+            Atom& a3 = (*mpstru)[3];
+            TS_ASSERT(mpstru->hasExposedAtoms());
+            diffpy::mathutils::EpsilonEqual allclose;
+            PDFCalculator pdfc, pdfcb;
+            pdfc.setEvaluatorType(OPTIMIZED);
+            pdfcb.setEvaluatorType(BASIC);
+            pdfc.eval(mstru);
+            // the reference is still valid and changes the structure,
+            // but not the snapshot kept by the evaluator
+            StructureAdapterPtr stru1 = mstru->clone();
+            a3.xyz_cartn[1] = 0.7;
+            TS_ASSERT_EQUALS(0.7, mpstru->siteCartesianPosition(3)[1]);
+            TS_ASSERT_EQUALS(0.0, stru1->siteCartesianPosition(3)[1]);
+            StructureDifference sd = stru1->diff(mstru);
+            TS_ASSERT_EQUALS(1u, sd.pop0.size());
+            pdfc.eval(mstru);
+            pdfcb.eval(mstru);
+            TS_ASSERT_EQUALS(OPTIMIZED, pdfc.getEvaluatorTypeUsed());
+            TS_ASSERT(allclose(pdfcb.getPDF(), pdfc.getPDF()));
+            // references stay valid after the assignment of other atoms
+            AtomicStructureAdapter astru2(*mpstru);
+            astru2.setAtom(3, ai);
+            *mpstru = astru2;
+            TS_ASSERT_EQUALS(9.0, a3.xyz_cartn[0]);
+            a3.xyz_cartn[1] = 0.3;
+            pdfc.eval(mstru);
+            pdfcb.eval(mstru);
+            TS_ASSERT(allclose(pdfcb.getPDF(), pdfc.getPDF()));
+        }
+
+
+        void test_change_journal()
+        {
+            typedef StructureDifference::Method DM;
+            Atom ai;
+            ai.atomtype = "C";
+            const int SZ = 10;
+            for (int i = 0; i < SZ; ++i)
+            {
+                ai.xyz_cartn[0] = i;
+                mpstru->append(ai);
+            }
+            TS_ASSERT(!mpstru->hasChangeJournal());
+            StructureAdapterPtr stru0 = mstru->clone();
+            TS_ASSERT(mpstru->hasChangeJournal());
+            const AtomicStructureAdapter& castru = *mpstru;
+            Atom a3 = castru[3];
+            a3.xyz_cartn[1] = 0.5;
+            a3.xyz_cartn[2] = 0.5;
+            mpstru->setAtom(3, a3);
+            mpstru->append(ai);
+            TS_ASSERT(!mpstru->hasExposedAtoms());
+            StructureDifference sd = stru0->diff(mstru);
+            TS_ASSERT_EQUALS(DM::SIDEBYSIDE, sd.diffmethod);
+            TS_ASSERT_EQUALS(1u, sd.pop0.size());
+            TS_ASSERT_EQUALS(3, sd.pop0[0]);
+            TS_ASSERT_EQUALS(2u, sd.add1.size());
+            TS_ASSERT_EQUALS(SZ, sd.add1[1]);
+            TS_ASSERT_EQUALS(3, sd.add1[0]);
+            TS_ASSERT_EQUALS(SZ, sd.add1[1]);
+            // removal at the end keeps side-by-side difference
+            mpstru->erase(SZ);
+            mpstru->erase(SZ - 1);
+            sd = stru0->diff(mstru);
+            TS_ASSERT_EQUALS(DM::SIDEBYSIDE, sd.diffmethod);
+            TS_ASSERT_EQUALS(2u, sd.pop0.size());
+            TS_ASSERT_EQUALS(SZ - 1, sd.pop0[1]);
+            TS_ASSERT_EQUALS(1u, sd.add1.size());
+            // removal inside the structure
+            mpstru->erase(0);
+            sd = stru0->diff(mstru);
+            TS_ASSERT_EQUALS(DM::SORTED, sd.diffmethod);
+            TS_ASSERT_EQUALS(3u, sd.pop0.size());
+            TS_ASSERT_EQUALS(0, sd.pop0[0]);
+            TS_ASSERT_EQUALS(1u, sd.add1.size());
+            TS_ASSERT_EQUALS(2, sd.add1[0]);
+            // erase returns an iterator so the atoms are compared for
+            // the clones made from now on
+            TS_ASSERT(mpstru->hasExposedAtoms());
+            StructureAdapterPtr stru1 = mstru->clone();
+            mpstru->insert(1, ai);
+            sd = stru1->diff(mstru);
+            TS_ASSERT(sd.pop0.empty());
+            TS_ASSERT_EQUALS(1u, sd.add1.size());
+            TS_ASSERT_EQUALS(1, sd.add1[0]);
+            // stale clone falls back to the atom comparison
+            sd = stru0->diff(mstru);
+            TS_ASSERT_EQUALS(DM::SORTED, sd.diffmethod);
+            TS_ASSERT_EQUALS(2u, sd.pop0.size());
+            // the journal restarts with a new clone
+            mpstru->clear();
+            TS_ASSERT(!mpstru->hasExposedAtoms());
+            for (int i = 0; i < SZ; ++i)  mpstru->append(ai);
+            StructureAdapterPtr stru2 = mstru->clone();
+            mpstru->append(ai);
+            mpstru->setAtom(0, castru[2]);
+            sd = stru2->diff(mstru);
+            TS_ASSERT_EQUALS(DM::SIDEBYSIDE, sd.diffmethod);
+            TS_ASSERT_EQUALS(1u, sd.pop0.size());
+            TS_ASSERT_EQUALS(2u, sd.add1.size());
+            TS_ASSERT_EQUALS(SZ, sd.add1[1]);
+            // position setter keeps the journal and does not expose atoms
+            StructureAdapterPtr stru3 = mstru->clone();
+            const R3::Vector xyz4(0.0, 1.0, 2.0);
+            mpstru->setAtomPosition(4, xyz4);
+            TS_ASSERT(!mpstru->hasExposedAtoms());
+            TS_ASSERT_EQUALS(xyz4, castru[4].xyz_cartn);
+            TS_ASSERT_DIFFERS(xyz4, stru3->siteCartesianPosition(4));
+            sd = stru3->diff(mstru);
+            TS_ASSERT_EQUALS(DM::SIDEBYSIDE, sd.diffmethod);
+            TS_ASSERT_EQUALS(SiteIndices(1, 4), sd.pop0);
+            TS_ASSERT_EQUALS(SiteIndices(1, 4), sd.add1);
+            // iterator access stops the journal
+            mpstru->begin();
+            TS_ASSERT(!mpstru->hasChangeJournal());
+        }
+
+
+        void test_siteAtomTypeId()
+        {
+            Atom ai;
+            ai.atomtype = "C";
+            mpstru->append(ai);
+            ai.atomtype = "O";
+            mpstru->append(ai);
+            const int tidC = atomTypeId("C");
+            const int tidO = atomTypeId("O");
+            const int tidN = atomTypeId("N");
+            TS_ASSERT_EQUALS(tidC, mpstru->siteAtomTypeId(0));
+            TS_ASSERT_EQUALS(tidO, mpstru->siteAtomTypeId(1));
+            // cached ids follow the tracked changes, but not in the clones
+            StructureAdapterPtr stru1 = mstru->clone();
+            ai.atomtype = "N";
+            mpstru->setAtom(0, ai);
+            mpstru->append(ai);
+            vector<Atom> atoms(2, ai);
+            atoms[0].atomtype = "O";
+            mpstru->insert(mpstru->end(), atoms.begin(), atoms.end());
+            TS_ASSERT_EQUALS(tidN, mpstru->siteAtomTypeId(0));
+            TS_ASSERT_EQUALS(tidO, mpstru->siteAtomTypeId(1));
+            TS_ASSERT_EQUALS(tidN, mpstru->siteAtomTypeId(2));
+            TS_ASSERT_EQUALS(tidO, mpstru->siteAtomTypeId(3));
+            TS_ASSERT_EQUALS(tidN, mpstru->siteAtomTypeId(4));
+            TS_ASSERT_EQUALS(tidC, stru1->siteAtomTypeId(0));
+            // exposed atoms are looked up every time
+            Atom& a1 = (*mpstru)[1];
+            a1.atomtype = "C";
+            TS_ASSERT_EQUALS(tidC, mpstru->siteAtomTypeId(1));
+            a1.atomtype = "N";
+            TS_ASSERT_EQUALS(tidN, mpstru->siteAtomTypeId(1));
+            mpstru->clear();
+            mpstru->append(ai);
+            TS_ASSERT_EQUALS(tidN, mpstru->siteAtomTypeId(0));
+        }
+
+
+        void test_neighbor_list()
+        {
+            const double rmax = 3.0;
+            Atom a;
+            a.atomtype = "C";
+            for (int i = 0; i < 64; ++i)
+            {
+                a.xyz_cartn = R3::Vector(
+                        1.5 * (i % 4) + 0.01 * i,
+                        1.5 * (i / 4 % 4) - 0.02 * (i % 3),
+                        1.5 * (i / 16) + 0.03 * (i % 5));
+                mpstru->append(a);
+            }
+            // coincident sites must be also kept in the list
+            mpstru->append(mpstru->at(5));
+            AtomicStructureAdapterPtr stru1 =
+                boost::dynamic_pointer_cast<AtomicStructureAdapter>(
+                        mpstru->clone());
+            TS_ASSERT_EQUALS(0.0, stru1->getBondCacheSkin());
+            TS_ASSERT_THROWS(stru1->setBondCacheSkin(-0.1), invalid_argument);
+            stru1->setBondCacheSkin(0.4);
+            BaseBondGeneratorPtr bnds1 = stru1->createBondGenerator();
+            BaseBondGenerator& r_bnds1 = *bnds1;
+            TS_ASSERT(typeid(AtomicBondCacheGenerator) == typeid(r_bnds1));
+            BondList b0 = sortedBonds(mstru, rmax);
+            TS_ASSERT(!b0.empty());
+            TS_ASSERT_EQUALS(b0, sortedBonds(stru1, rmax));
+            boost::shared_ptr<const AtomicBondCache> nbl =
+                stru1->getNeighborList(rmax);
+            TS_ASSERT_EQUALS(3.4, nbl->getRcut());
+            // unsorted site selection
+            SiteIndices sel;
+            sel.push_back(17);
+            sel.push_back(3);
+            sel.push_back(64);
+            sel.push_back(5);
+            TS_ASSERT_EQUALS(sortedBonds(mstru, rmax, &sel),
+                    sortedBonds(stru1, rmax, &sel));
+            // displacements within half of the skin reuse the list
+            mpstru->at(64).xyz_cartn[0] += 0.15;
+            stru1->at(64).xyz_cartn[0] += 0.15;
+            mpstru->at(20).xyz_cartn[2] -= 0.2;
+            stru1->at(20).xyz_cartn[2] -= 0.2;
+            TS_ASSERT_EQUALS(sortedBonds(mstru, rmax),
+                    sortedBonds(stru1, rmax));
+            TS_ASSERT_EQUALS(nbl, stru1->getNeighborList(rmax));
+            mpstru->at(20).xyz_cartn[2] -= 0.1;
+            stru1->at(20).xyz_cartn[2] -= 0.1;
+            TS_ASSERT_EQUALS(sortedBonds(mstru, rmax),
+                    sortedBonds(stru1, rmax));
+            TS_ASSERT_DIFFERS(nbl, stru1->getNeighborList(rmax));
+            // the list works for any pair quantity
+            BondCalculator bc0, bc1;
+            bc0.setRmax(rmax);
+            bc1.setRmax(rmax);
+            bc0.eval(mstru);
+            bc1.eval(stru1);
+            TS_ASSERT_EQUALS(bc0.distances(), bc1.distances());
+            mpstru->at(7).xyz_cartn[1] += 0.05;
+            stru1->at(7).xyz_cartn[1] += 0.05;
+            bc0.eval(mstru);
+            bc1.eval(stru1);
+            QuantityType d0 = bc0.distances();
+            QuantityType d1 = bc1.distances();
+            sort(d0.begin(), d0.end());
+            sort(d1.begin(), d1.end());
+            TS_ASSERT_EQUALS(d0, d1);
+            // skin is preserved in copies and serialization
+            AtomicStructureAdapter stru2(*stru1);
+            TS_ASSERT_EQUALS(0.4, stru2.getBondCacheSkin());
+            StructureAdapterPtr stru3 = dumpandload(stru1);
+            TS_ASSERT_EQUALS(0.4, boost::dynamic_pointer_cast<
+                    AtomicStructureAdapter>(stru3)->getBondCacheSkin());
+            // neighbors from the cell search in a large cluster
+            AtomicStructureAdapter big;
+            for (int i = 0; i < 1000; ++i)
+            {
+                a.xyz_cartn = R3::Vector(
+                        1.1 * (i % 10) + 0.013 * (i % 7),
+                        1.3 * (i / 10 % 10) - 0.021 * (i % 3),
+                        0.9 * (i / 100) + 0.017 * (i % 11));
+                big.append(a);
+            }
+            big.append(big.at(123));
+            AtomicBondCache bignbl(big, 2.2);
+            int cntpairs = 0;
+            for (int i = 0; i < big.countSites(); ++i)
+            {
+                SiteIndices nb0;
+                for (int j = 0; j < big.countSites(); ++j)
+                {
+                    double d = R3::distance(
+                            big[i].xyz_cartn, big[j].xyz_cartn);
+                    if (j != i && d <= 2.2)  nb0.push_back(j);
+                }
+                SiteIndices nb1(bignbl.neighbors(i).first,
+                        bignbl.neighbors(i).second);
+                TS_ASSERT_EQUALS(nb0, nb1);
+                cntpairs += nb0.size();
+            }
+            TS_ASSERT_EQUALS(cntpairs, bignbl.countNeighbors());
+            TS_ASSERT_LESS_THAN(8000, cntpairs);
+        }
+
 };  // class TestAtomicStructureAdapter
 
 }   // namespace srreal
@@ -0,0 +1,306 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class TestBondCalculator -- unit tests for the bond distance calculator
+*
+*****************************************************************************/
+
+#include <cxxtest/TestSuite.h>
+
+#include <boost/make_shared.hpp>
+
+#include <diffpy/srreal/BondCalculator.hpp>
+#include <diffpy/srreal/PeriodicStructureAdapter.hpp>
+#include <diffpy/serialization.ipp>
+#include "test_helpers.hpp"
+#include "allocation_counter.hpp"
+#include "serialization_helpers.hpp"
+
+namespace diffpy {
+namespace srreal {
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////////////////
+// class TestBondCalculator
+//////////////////////////////////////////////////////////////////////////////
+
+class TestBondCalculator : public CxxTest::TestSuite
+{
+    private:
+
+        typedef BondCalculator::BondDataStorage BondDataStorage;
+
+        // data
+        boost::shared_ptr<BondCalculator> mbc;
+        PeriodicStructureAdapterPtr mnacl;
+
+        // methods
+        bool sameBonds(const BondDataStorage& b0, const BondDataStorage& b1)
+        {
+            using diffpy::mathutils::eps_eq;
+            if (b0.size() != b1.size())  return false;
+            BondDataStorage::const_iterator bi0 = b0.begin();
+            BondDataStorage::const_iterator bi1 = b1.begin();
+            for (; bi0 != b0.end(); ++bi0, ++bi1)
+            {
+                bool same = eps_eq(bi0->distance, bi1->distance) &&
+                    bi0->site0 == bi1->site0 && bi0->site1 == bi1->site1 &&
+                    eps_eq(bi0->direction0, bi1->direction0) &&
+                    eps_eq(bi0->direction1, bi1->direction1) &&
+                    eps_eq(bi0->direction2, bi1->direction2);
+                if (!same)  return false;
+            }
+            return true;
+        }
+
+    public:
+
+        void setUp()
+        {
+            mbc = boost::make_shared<BondCalculator>();
+            mbc->setRmax(5.0);
+            mnacl = boost::dynamic_pointer_cast<PeriodicStructureAdapter>(
+                    loadTestPeriodicStructure("NaCl.stru"));
+        }
+
+
+        void test_siteBonds()
+        {
+            mbc->eval(mnacl);
+            const int cntsites = mnacl->countSites();
+            QuantityType dst = mbc->distances();
+            SiteIndices s0 = mbc->sites0();
+            for (int i = 0; i < cntsites; ++i)
+            {
+                BondDataStorage sb = mbc->siteBonds(i, 2.0, 4.0);
+                size_t cnt = 0;
+                for (size_t k = 0; k < dst.size(); ++k)
+                {
+                    cnt += (s0[k] == i && 2.0 <= dst[k] && dst[k] <= 4.0);
+                }
+                TS_ASSERT_EQUALS(cnt, sb.size());
+                TS_ASSERT(!sb.empty());
+                for (size_t k = 1; k < sb.size(); ++k)
+                {
+                    TS_ASSERT(sb[k - 1].distance <= sb[k].distance);
+                }
+                mbc->setBondIndexing(true);
+                TS_ASSERT(this->sameBonds(sb, mbc->siteBonds(i, 2.0, 4.0)));
+                mbc->setBondIndexing(false);
+            }
+            TS_ASSERT_THROWS(mbc->siteBonds(cntsites, 0, 5), invalid_argument);
+            TS_ASSERT_THROWS(mbc->siteBonds(-1, 0, 5), invalid_argument);
+        }
+
+
+        void test_siteBondsInCone()
+        {
+            mbc->setBondIndexing(true);
+            mbc->eval(mnacl);
+            // there are 6 Cl neighbors in NaCl, only 1 along each axis
+            BondDataStorage sb = mbc->siteBonds(0, 2.0, 3.0);
+            TS_ASSERT_EQUALS(6u, sb.size());
+            R3::Vector zaxis(0.0, 0.0, 2.0);
+            BondDataStorage sbz = mbc->siteBondsInCone(0, 2.0, 3.0, zaxis, 1);
+            TS_ASSERT_EQUALS(1u, sbz.size());
+            TS_ASSERT_DELTA(sbz[0].distance, sbz[0].direction2, 1e-8);
+            BondDataStorage sball =
+                mbc->siteBondsInCone(0, 2.0, 3.0, zaxis, 180);
+            TS_ASSERT(this->sameBonds(sb, sball));
+            // cone queries must agree with cone filter of the calculator
+            mbc->filterCone(zaxis, 60);
+            mbc->eval(mnacl);
+            BondDataStorage sbf = mbc->siteBonds(0, 0.0, 5.0);
+            mbc->filterOff();
+            mbc->eval(mnacl);
+            BondDataStorage sbc = mbc->siteBondsInCone(0, 0.0, 5.0, zaxis, 60);
+            TS_ASSERT(this->sameBonds(sbf, sbc));
+            TS_ASSERT_THROWS(mbc->siteBondsInCone(0, 0.0, 5.0,
+                        R3::zerovector, 60), invalid_argument);
+        }
+
+
+        void test_bondsInRange()
+        {
+            mbc->eval(mnacl);
+            QuantityType dst = mbc->distances();
+            BondDataStorage b = mbc->bondsInRange(3.0, 4.0);
+            int cnt = count_if(dst.begin(), dst.end(),
+                    [](double d) { return 3.0 <= d && d <= 4.0; });
+            TS_ASSERT_EQUALS(cnt, int(b.size()));
+            TS_ASSERT(b.front().distance >= 3.0);
+            TS_ASSERT(b.back().distance <= 4.0);
+            TS_ASSERT(mbc->bondsInRange(4.0, 3.0).empty());
+        }
+
+
+        void test_index_optimized_update()
+        {
+            mbc->setBondIndexing(true);
+            mbc->setEvaluatorType(OPTIMIZED);
+            BondCalculator bcb;
+            bcb.setRmax(mbc->getRmax());
+            bcb.setEvaluatorType(BASIC);
+            bcb.setBondIndexing(true);
+            mbc->eval(mnacl);
+            // displace one atom
+            (*mnacl)[1].xyz_cartn[0] += 0.1;
+            mbc->eval(mnacl);
+            TS_ASSERT_EQUALS(OPTIMIZED, mbc->getEvaluatorTypeUsed());
+            bcb.eval(mnacl);
+            const int cntsites = mnacl->countSites();
+            for (int i = 0; i < cntsites; ++i)
+            {
+                TS_ASSERT(this->sameBonds(bcb.siteBonds(i, 0, 5),
+                            mbc->siteBonds(i, 0, 5)));
+            }
+            // remove the last atom
+            mnacl->erase(cntsites - 1);
+            mbc->eval(mnacl);
+            TS_ASSERT_EQUALS(OPTIMIZED, mbc->getEvaluatorTypeUsed());
+            bcb.eval(mnacl);
+            for (int i = 0; i < cntsites - 1; ++i)
+            {
+                TS_ASSERT(this->sameBonds(bcb.siteBonds(i, 0, 5),
+                            mbc->siteBonds(i, 0, 5)));
+            }
+            // index must agree with a fresh rebuild
+            BondDataStorage sb2 = mbc->siteBonds(2, 0, 5);
+            mbc->setBondIndexing(false);
+            TS_ASSERT(this->sameBonds(sb2, mbc->siteBonds(2, 0, 5)));
+        }
+
+
+        void test_index_range_update()
+        {
+            mbc->setBondIndexing(true);
+            mbc->eval(mnacl);
+            BondCalculator bcb;
+            bcb.setEvaluatorType(BASIC);
+            bcb.setBondIndexing(true);
+            const double rlimits[3][2] = {{0, 7}, {2, 4}, {1, 6}};
+            for (auto& rr : rlimits)
+            {
+                mbc->setRmin(rr[0]);
+                mbc->setRmax(rr[1]);
+                mbc->eval(mnacl);
+                TS_ASSERT_EQUALS(OPTIMIZED, mbc->getEvaluatorTypeUsed());
+                bcb.setRmin(rr[0]);
+                bcb.setRmax(rr[1]);
+                bcb.eval(mnacl);
+                TS_ASSERT_EQUALS(bcb.distances(), mbc->distances());
+                TS_ASSERT(this->sameBonds(bcb.siteBonds(1, 0, 7),
+                            mbc->siteBonds(1, 0, 7)));
+                typedef EvalCounters EC;
+                if (!EC::enabled())  continue;
+                const EvalCounters& cnt = mbc->getEvalCounters();
+                TS_ASSERT_EQUALS(1, cnt.count(EC::RANGE_UPDATES));
+            }
+        }
+
+
+        void test_steady_state_allocations()
+        {
+            mbc->setBondIndexing(true);
+            mbc->eval(mnacl);
+            mbc->eval(mnacl);
+            QuantityType d0 = mbc->distances();
+            QuantityType d1;
+            mbc->distances(d1);
+            const long cnt0 = countAllocations();
+            for (int i = 0; i < 3; ++i)
+            {
+                mbc->eval(mnacl);
+                mbc->distances(d1);
+            }
+            const long cnt1 = countAllocations();
+            TS_ASSERT_EQUALS(cnt0, cnt1);
+            TS_ASSERT_EQUALS(OPTIMIZED, mbc->getEvaluatorTypeUsed());
+            TS_ASSERT_EQUALS(d0, d1);
+            TS_ASSERT_EQUALS(d0, mbc->value());
+            // moving one atom allocates the same in every fast update
+            const AtomicStructureAdapter& cnacl = *mnacl;
+            R3::Vector xyz = cnacl[1].xyz_cartn;
+            long cntmove = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                const long cnt2 = countAllocations();
+                xyz[2] += 0.05;
+                mnacl->setAtomPosition(1, xyz);
+                mbc->eval(mnacl);
+                mbc->distances(d1);
+                const long cnt3 = countAllocations();
+                TS_ASSERT_EQUALS(OPTIMIZED, mbc->getEvaluatorTypeUsed());
+                if (i > 1)  TS_ASSERT_EQUALS(cntmove, cnt3 - cnt2);
+                cntmove = cnt3 - cnt2;
+            }
+            BondCalculator bcb;
+            bcb.setRmax(mbc->getRmax());
+            bcb.setEvaluatorType(BASIC);
+            bcb.eval(mnacl);
+            TS_ASSERT_EQUALS(bcb.distances(), d1);
+        }
+
+
+        void test_trial_move()
+        {
+            mbc->setBondIndexing(true);
+            mbc->eval(mnacl);
+            QuantityType d0 = mbc->distances();
+            BondDataStorage sb0 = mbc->siteBonds(1, 0, 5);
+            SiteIndices sites(1, 1);
+            std::vector<Atom> newatoms(1, mnacl->at(1));
+            newatoms[0].xyz_cartn[2] += 0.2;
+            mbc->proposeMove(sites, newatoms);
+            QuantityType d1 = mbc->distances();
+            TS_ASSERT_DIFFERS(d0, d1);
+            mbc->rollback();
+            TS_ASSERT_EQUALS(d0, mbc->distances());
+            TS_ASSERT(this->sameBonds(sb0, mbc->siteBonds(1, 0, 5)));
+            mbc->proposeMove(sites, newatoms);
+            mbc->commit();
+            BondCalculator bcb;
+            bcb.setRmax(mbc->getRmax());
+            bcb.setEvaluatorType(BASIC);
+            bcb.eval(mnacl);
+            TS_ASSERT_EQUALS(bcb.distances(), d1);
+            TS_ASSERT_EQUALS(d1, mbc->distances());
+        }
+
+
+        void test_serialization()
+        {
+            mbc->setBondIndexing(true);
+            mbc->eval(mnacl);
+            boost::shared_ptr<BondCalculator> bc1;
+            bc1 = dumpandload(mbc);
+            TS_ASSERT_DIFFERS(mbc.get(), bc1.get());
+            TS_ASSERT(bc1->getBondIndexing());
+            TS_ASSERT_EQUALS(mbc->distances(), bc1->distances());
+            const int cntsites = mnacl->countSites();
+            for (int i = 0; i < cntsites; ++i)
+            {
+                TS_ASSERT(this->sameBonds(
+                            mbc->siteBonds(i, 0, 5), bc1->siteBonds(i, 0, 5)));
+            }
+        }
+
+};  // class TestBondCalculator
+
+}   // namespace srreal
+}   // namespace diffpy
+
+using diffpy::srreal::TestBondCalculator;
+
+// End of file
@@ -214,6 +214,74 @@ class TestDebyePDFCalculator : public CxxTest::TestSuite
         }
 
 
+        void test_mixedPrecision()
+        {
+            AtomicStructureAdapterPtr stru(new AtomicStructureAdapter);
+            Atom ai = (*mstru10)[0];
+            for (int i = 0; i < 216; ++i)
+            {
+                ai.xyz_cartn = R3::Vector(
+                        1.5 * (i % 6) + 0.01 * (i % 7),
+                        1.5 * (i / 6 % 6) + 0.02 * (i % 5),
+                        1.5 * (i / 36) - 0.01 * (i % 3));
+                stru->append(ai);
+            }
+            mpdfc->setDebyePrecision(0.0);
+            DebyePDFCalculator pdfcmx = *mpdfc;
+            TS_ASSERT(!pdfcmx.getMixedPrecision());
+            pdfcmx.setMixedPrecision(true);
+            TS_ASSERT(pdfcmx.getMixedPrecision());
+            QuantityType f = mpdfc->eval(stru);
+            QuantityType fmx = pdfcmx.eval(stru);
+            TS_ASSERT_EQUALS(f.size(), fmx.size());
+            // documented bound for the sum of the pair terms
+            double sumrinv = 0.0;
+            for (int i = 0; i < stru->countSites(); ++i)
+            {
+                for (int j = 0; j < stru->countSites(); ++j)
+                {
+                    if (i == j)  continue;
+                    const R3::Vector& ri = stru->siteCartesianPosition(i);
+                    const R3::Vector& rj = stru->siteCartesianPosition(j);
+                    sumrinv += 1.0 / R3::distance(ri, rj);
+                }
+            }
+            ScatteringFactorTablePtr sftb = mpdfc->getScatteringFactorTable();
+            const double rtol = BaseDebyeSum::MIXED_PRECISION_RTOL;
+            double dfmax = 0.0;
+            for (size_t kq = 0; kq < f.size(); ++kq)
+            {
+                const double q = kq * mpdfc->getQstep();
+                const double sf = sftb->lookup("C", q);
+                const double bound = rtol * sf * sf * sumrinv;
+                TS_ASSERT_LESS_THAN_EQUALS(fabs(fmx[kq] - f[kq]), bound);
+                dfmax = max(dfmax, fabs(fmx[kq] - f[kq]));
+            }
+            TS_ASSERT_LESS_THAN(0.0, dfmax);
+            // cutoff by the Gaussian envelope stays within debyeprecision
+            mpdfc->setDebyePrecision(1e-6);
+            pdfcmx.setDebyePrecision(1e-6);
+            f = mpdfc->eval(stru);
+            fmx = pdfcmx.eval(stru);
+            const double npairs = 216 * 215;
+            for (size_t kq = 0; kq < f.size(); ++kq)
+            {
+                const double q = kq * mpdfc->getQstep();
+                const double sf = sftb->lookup("C", q);
+                const double bound = rtol * sf * sf * sumrinv + npairs * 1e-6;
+                TS_ASSERT_LESS_THAN_EQUALS(fabs(fmx[kq] - f[kq]), bound);
+            }
+            // flag is preserved in serialization
+            stringstream storage(ios::in | ios::out | ios::binary);
+            diffpy::serialization::oarchive oa(storage, ios::binary);
+            oa << pdfcmx;
+            diffpy::serialization::iarchive ia(storage, ios::binary);
+            DebyePDFCalculator pdfc1;
+            ia >> pdfc1;
+            TS_ASSERT(pdfc1.getMixedPrecision());
+        }
+
+
         void test_DBPDF_change_atom()
         {
             using std::placeholders::_1;
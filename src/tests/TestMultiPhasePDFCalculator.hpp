@@ -0,0 +1,216 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class TestMultiPhasePDFCalculator -- unit tests for the sum of phase PDFs
+*     on a shared r-grid
+*
+*****************************************************************************/
+
+#include <stdexcept>
+#include <cxxtest/TestSuite.h>
+
+#include <diffpy/srreal/MultiPhasePDFCalculator.hpp>
+#include <diffpy/srreal/PeriodicStructureAdapter.hpp>
+#include <diffpy/mathutils.hpp>
+#include "test_helpers.hpp"
+
+using namespace std;
+using namespace diffpy::srreal;
+using diffpy::mathutils::EpsilonEqual;
+
+// Local Helpers -------------------------------------------------------------
+
+namespace {
+
+StructureAdapterPtr loadIsotropicStructure(const string& tailname, double uiso)
+{
+    PeriodicStructureAdapterPtr stru =
+        boost::dynamic_pointer_cast<PeriodicStructureAdapter>(
+                loadTestPeriodicStructure(tailname));
+    for (Atom& a : *stru)  a.uij_cartn = uiso * R3::identity();
+    return stru;
+}
+
+}   // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// class TestMultiPhasePDFCalculator
+//////////////////////////////////////////////////////////////////////////////
+
+class TestMultiPhasePDFCalculator : public CxxTest::TestSuite
+{
+    private:
+
+        StructureAdapterPtr mni;
+        StructureAdapterPtr mcatio3;
+        MultiPhasePDFCalculator mmpc;
+
+        // methods
+        /// calculator for Ni or CaTiO3 phase with its scale and widths
+        PDFCalculatorPtr createPhase(int idx)
+        {
+            PDFCalculatorPtr rv(new PDFCalculator);
+            rv->setDoubleAttr("scale", (idx == 0) ? 0.7 : 0.3);
+            if (idx == 1)  rv->setDoubleAttr("delta2", 2.0);
+            return rv;
+        }
+
+
+        MultiPhasePDFCalculator createComposite()
+        {
+            MultiPhasePDFCalculator rv;
+            rv.setRmax(8.0);
+            rv.setQmax(20.0);
+            rv.addPhase(this->createPhase(0), mni);
+            rv.addPhase(this->createPhase(1), mcatio3);
+            return rv;
+        }
+
+    public:
+
+        void setUp()
+        {
+            if (!mni)  mni = loadIsotropicStructure("Ni.stru", 0.005);
+            if (!mcatio3)
+            {
+                mcatio3 = loadIsotropicStructure("CaTiO3.stru", 0.004);
+            }
+            mmpc = this->createComposite();
+        }
+
+
+        void test_phases()
+        {
+            TS_ASSERT_EQUALS(2, mmpc.countPhases());
+            TS_ASSERT_EQUALS(8.0, mmpc.getPhase(1).getRmax());
+            TS_ASSERT_EQUALS(20.0, mmpc.getPhase(0).getQmax());
+            TS_ASSERT_THROWS(mmpc.getPhase(2), out_of_range);
+            TS_ASSERT_THROWS(mmpc.addPhase(PDFCalculatorPtr(), mni),
+                    invalid_argument);
+            mmpc.clearPhases();
+            TS_ASSERT_EQUALS(0, mmpc.countPhases());
+            TS_ASSERT(mmpc.getPDF().empty());
+        }
+
+
+        void test_getPDF()
+        {
+            EpsilonEqual allclose(1e-8);
+            mmpc.eval();
+            const QuantityType g = mmpc.getPDF();
+            PDFCalculator& pc0 = mmpc.getPhase(0);
+            PDFCalculator& pc1 = mmpc.getPhase(1);
+            const QuantityType g0 = pc0.getPDF();
+            const QuantityType g1 = pc1.getPDF();
+            TS_ASSERT_EQUALS(pc0.getRgrid(), mmpc.getRgrid());
+            TS_ASSERT_EQUALS(g0.size(), g.size());
+            // scale envelopes commute with the Q-range termination
+            QuantityType gsum(g.size());
+            for (size_t i = 0; i < g.size(); ++i)  gsum[i] = g0[i] + g1[i];
+            TS_ASSERT(allclose(gsum, g));
+            // shared envelopes apply to the terminated sum
+            mmpc.addEnvelopeByType("scale");
+            mmpc.getEnvelopeByType("scale")->setDoubleAttr("scale", 2.0);
+            const QuantityType g2 = mmpc.getPDF();
+            for (size_t i = 0; i < g.size(); ++i)  gsum[i] = 2 * g[i];
+            TS_ASSERT(allclose(gsum, g2));
+            // shared grid setup is applied to the phases in eval
+            pc1.setRmax(5.0);
+            mmpc.setRstep(0.02);
+            mmpc.eval();
+            TS_ASSERT_EQUALS(8.0, pc1.getRmax());
+            TS_ASSERT_EQUALS(400u, mmpc.getPDF().size());
+        }
+
+
+        void test_onePhase()
+        {
+            // r-dependent envelopes apply after the termination of a phase
+            MultiPhasePDFCalculator mpc;
+            mpc.setRmax(8.0);
+            mpc.setQmax(20.0);
+            PDFCalculatorPtr pc(new PDFCalculator);
+            pc->setDoubleAttr("qdamp", 0.08);
+            pc->addEnvelopeByType("sphericalshape");
+            pc->setDoubleAttr("spdiameter", 8.0);
+            mpc.addPhase(pc, mni);
+            mpc.eval();
+            TS_ASSERT_EQUALS(pc->getRgrid(), mpc.getRgrid());
+            TS_ASSERT_EQUALS(pc->getPDF(), mpc.getPDF());
+            // same for a phase with the scale envelope only
+            EpsilonEqual allclose(1e-8);
+            MultiPhasePDFCalculator mpc1;
+            mpc1.setRmax(8.0);
+            mpc1.setQmax(20.0);
+            mpc1.addPhase(this->createPhase(1), mcatio3);
+            mpc1.eval();
+            TS_ASSERT(allclose(mpc1.getPhase(0).getPDF(), mpc1.getPDF()));
+        }
+
+
+        void test_phaseOrder()
+        {
+            EpsilonEqual allclose(1e-8);
+            // wide peaks shrink the extended grid of the second phase
+            StructureAdapterPtr niwide =
+                loadIsotropicStructure("Ni.stru", 0.1);
+            MultiPhasePDFCalculator mpc[2];
+            for (int i = 0; i < 2; ++i)
+            {
+                mpc[i].setRmax(8.0);
+                mpc[i].setQmax(20.0);
+                mpc[i].setMaxExtension(3.0);
+                PDFCalculatorPtr pc0 = this->createPhase(0);
+                PDFCalculatorPtr pc1 = this->createPhase(1);
+                PDFCalculatorPtr pc2 = this->createPhase(1);
+                pc2->setDoubleAttr("qdamp", 0.05);
+                if (i == 0)  mpc[i].addPhase(pc0, mni);
+                mpc[i].addPhase(pc1, niwide);
+                mpc[i].addPhase(pc2, mcatio3);
+                if (i == 1)  mpc[i].addPhase(pc0, mni);
+                mpc[i].eval();
+            }
+            const PDFCalculator& pc0 = mpc[0].getPhase(0);
+            const PDFCalculator& pc1 = mpc[0].getPhase(1);
+            TS_ASSERT_LESS_THAN(pc1.getDoubleAttr("extendedrmax"),
+                    pc0.getDoubleAttr("extendedrmax"));
+            TS_ASSERT(allclose(mpc[0].getPDF(), mpc[1].getPDF()));
+        }
+
+
+        void test_parallel()
+        {
+            EpsilonEqual allclose(1e-8);
+            MultiPhasePDFCalculator workers[2] = {
+                this->createComposite(), this->createComposite()};
+            MultiPhasePDFCalculator master = this->createComposite();
+            mmpc.eval();
+            for (int cpuindex = 0; cpuindex < 2; ++cpuindex)
+            {
+                workers[cpuindex].setupParallelRun(cpuindex, 2);
+                workers[cpuindex].eval();
+                master.mergeParallelData(
+                        workers[cpuindex].getParallelData(), 2);
+            }
+            TS_ASSERT(allclose(mmpc.getPDF(), master.getPDF()));
+            TS_ASSERT(!allclose(mmpc.getPDF(), workers[0].getPDF()));
+            TS_ASSERT_THROWS(master.mergeParallelData(
+                        workers[0].getParallelData(), 2), runtime_error);
+            master.addPhase(this->createPhase(0), mni);
+            TS_ASSERT_THROWS(master.mergeParallelData(
+                        workers[0].getParallelData(), 2), invalid_argument);
+        }
+
+};  // class TestMultiPhasePDFCalculator
+
+// End of file
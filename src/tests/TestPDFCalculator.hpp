@@ -19,6 +19,8 @@
 #include <cxxtest/TestSuite.h>
 
 #include <diffpy/srreal/StructureAdapter.hpp>
+#include <diffpy/srreal/PeriodicStructureAdapter.hpp>
+#include <diffpy/srreal/CrystalStructureAdapter.hpp>
 #include <diffpy/srreal/PDFCalculator.hpp>
 #include <diffpy/srreal/JeongPeakWidth.hpp>
 #include <diffpy/srreal/ConstantPeakWidth.hpp>
@@ -29,6 +31,55 @@
 using namespace std;
 using namespace diffpy::srreal;
 
+// Local Helpers -------------------------------------------------------------
+
+namespace {
+
+/// fluorite CaF2 in the Fm-3m space group
+CrystalStructureAdapterPtr fluoriteCrystal()
+{
+    CrystalStructureAdapterPtr stru(new CrystalStructureAdapter);
+    stru->setLatPar(5.46, 5.46, 5.46, 90, 90, 90);
+    const int perms[6][3] = {
+        {0, 1, 2}, {1, 2, 0}, {2, 0, 1}, {0, 2, 1}, {2, 1, 0}, {1, 0, 2}};
+    const R3::Vector centering[4] = {
+        R3::Vector(0.0, 0.0, 0.0), R3::Vector(0.0, 0.5, 0.5),
+        R3::Vector(0.5, 0.0, 0.5), R3::Vector(0.5, 0.5, 0.0)};
+    for (int ip = 0; ip < 6; ++ip)
+    {
+        for (int signs = 0; signs < 8; ++signs)
+        {
+            R3::Matrix R = R3::zeromatrix();
+            for (int i = 0; i < 3; ++i)
+            {
+                R(i, perms[ip][i]) = (signs & (1 << i)) ? -1 : 1;
+            }
+            for (int ic = 0; ic < 4; ++ic)  stru->addSymOp(R, centering[ic]);
+        }
+    }
+    Atom a;
+    a.atomtype = "Ca";
+    a.xyz_cartn = R3::zerovector;
+    a.uij_cartn = 0.008 * R3::identity();
+    stru->append(a);
+    a.atomtype = "F";
+    a.xyz_cartn = R3::Vector(0.25, 0.25, 0.25);
+    stru->toCartesian(a);
+    a.uij_cartn = 0.012 * R3::identity();
+    stru->append(a);
+    return stru;
+}
+
+
+int countBonds(BaseBondGenerator& bnds)
+{
+    int rv = 0;
+    for (bnds.rewind(); !bnds.finished(); bnds.next())  ++rv;
+    return rv;
+}
+
+}   // namespace
+
 class TestPDFCalculator : public CxxTest::TestSuite
 {
     private:
@@ -251,6 +302,370 @@ class TestPDFCalculator : public CxxTest::TestSuite
         }
 
 
+        void test_localPDF()
+        {
+            using diffpy::mathutils::EpsilonEqual;
+            EpsilonEqual allclose(meps);
+            PeriodicStructureAdapterPtr catio3 =
+                boost::dynamic_pointer_cast<PeriodicStructureAdapter>(
+                        loadTestPeriodicStructure("CaTiO3.stru"));
+            const int ALL = mpdfc->ALLATOMSINT;
+            SiteIndices lsites = {3, 1, 3};
+            mpdfc->setLocalSites(lsites);
+            TS_ASSERT_EQUALS(2u, mpdfc->getLocalSites().size());
+            mpdfc->eval(catio3);
+            TS_ASSERT_LESS_THAN(0u, mpdfc->getLocalMemoryUsage());
+            PDFCalculator pdfcm;
+            for (int site : mpdfc->getLocalSites())
+            {
+                pdfcm.maskAllPairs(false);
+                pdfcm.setPairMask(site, ALL, true);
+                pdfcm.eval(catio3);
+                TS_ASSERT(allclose(pdfcm.getRDF(), mpdfc->getLocalRDF(site)));
+                TS_ASSERT(allclose(pdfcm.getPDF(), mpdfc->getLocalPDF(site)));
+            }
+            // local rows follow the OPTIMIZED updates
+            (*catio3)[3].xyz_cartn[2] += 0.1;
+            (*catio3)[7].xyz_cartn[0] -= 0.1;
+            mpdfc->eval(catio3);
+            TS_ASSERT_EQUALS(OPTIMIZED, mpdfc->getEvaluatorTypeUsed());
+            for (int site : mpdfc->getLocalSites())
+            {
+                pdfcm.maskAllPairs(false);
+                pdfcm.setPairMask(site, ALL, true);
+                pdfcm.eval(catio3);
+                TS_ASSERT(allclose(pdfcm.getRDF(), mpdfc->getLocalRDF(site)));
+            }
+            TS_ASSERT_THROWS(mpdfc->getLocalRDF(0), invalid_argument);
+            lsites.push_back(-1);
+            TS_ASSERT_THROWS(mpdfc->setLocalSites(lsites), invalid_argument);
+            mpdfc->setLocalSites(SiteIndices());
+            mpdfc->eval(catio3);
+            TS_ASSERT_EQUALS(0u, mpdfc->getLocalMemoryUsage());
+        }
+
+
+        void test_evalCounters()
+        {
+            typedef EvalCounters EC;
+            if (!EC::enabled())  return;
+            CrystalStructureAdapterPtr caf2 = fluoriteCrystal();
+            mpdfc->setQmax(25.0);
+            mpdfc->eval(caf2);
+            const EvalCounters& cnt = mpdfc->getEvalCounters();
+            // each expansion creates 4 Ca and 8 F sites
+            TS_ASSERT_LESS_THAN(0, cnt.count(EC::SYMMETRY_IMAGES));
+            TS_ASSERT_EQUALS(0, cnt.count(EC::SYMMETRY_IMAGES) % (4 + 8));
+            TS_ASSERT_LESS_THAN(0, cnt.count(EC::SPHERE_POINTS));
+            TS_ASSERT_LESS_THAN(0, cnt.count(EC::PAIR_CONTRIBUTIONS));
+            TS_ASSERT_LESS_THAN_EQUALS(cnt.count(EC::PAIR_CONTRIBUTIONS),
+                    cnt.count(EC::BONDS_ACCEPTED));
+            TS_ASSERT_LESS_THAN(cnt.count(EC::BONDS_ACCEPTED),
+                    cnt.count(EC::BONDS_VISITED));
+            TS_ASSERT_LESS_THAN(cnt.count(EC::PAIR_CONTRIBUTIONS),
+                    cnt.count(EC::GRID_POINTS));
+            TS_ASSERT_EQUALS(1, cnt.count(EC::FULL_RECOMPUTES));
+            TS_ASSERT_EQUALS(0.0, cnt.seconds(EC::PAIR_SUM_TIME));
+            // transforms in getPDF are added to the last evaluation
+            TS_ASSERT_EQUALS(0, cnt.count(EC::FFT_CALLS));
+            mpdfc->getPDF();
+            // forward and inverse transform for the Qmax termination
+            TS_ASSERT_EQUALS(2, cnt.count(EC::FFT_CALLS));
+            TS_ASSERT_LESS_THAN(cnt.count(EC::FFT_CALLS),
+                    cnt.count(EC::FFT_POINTS));
+            // only the first query after evaluation is counted
+            const long long fftpoints = cnt.count(EC::FFT_POINTS);
+            mpdfc->getPDF();
+            mpdfc->getF();
+            mpdfc->getPDF();
+            TS_ASSERT_EQUALS(2, cnt.count(EC::FFT_CALLS));
+            TS_ASSERT_EQUALS(fftpoints, cnt.count(EC::FFT_POINTS));
+            TS_ASSERT_LESS_THAN(0, cnt.count(EC::PAIR_CONTRIBUTIONS));
+            mpdfc->getEvalCounters().setTimersEnabled(true);
+            mpdfc->setRmax(5.0);
+            mpdfc->eval(caf2);
+            TS_ASSERT_EQUALS(0, cnt.count(EC::FFT_CALLS));
+            TS_ASSERT_LESS_THAN(0.0, cnt.seconds(EC::PAIR_SUM_TIME));
+            TS_ASSERT_LESS_THAN(0.0, cnt.seconds(EC::FINISH_TIME));
+            TS_ASSERT_EQUALS(string("grid_points"),
+                    EC::counterName(EC::GRID_POINTS));
+        }
+
+
+        void test_continuum()
+        {
+            const double rc = 12.0;
+            CrystalStructureAdapterPtr caf2 = fluoriteCrystal();
+            PDFCalculator pdfcx, pdfcc;
+            for (PDFCalculator* pc : {&pdfcx, &pdfcc})
+            {
+                pc->setRmax(30.0);
+                pc->setDoubleAttr("qbroad", 0.05);
+            }
+            TS_ASSERT_EQUALS(0.0, pdfcc.getRcontinuum());
+            TS_ASSERT_THROWS(pdfcc.setRcontinuum(-1), invalid_argument);
+            pdfcc.setDoubleAttr("rcontinuum", rc);
+            TS_ASSERT_EQUALS(rc, pdfcc.getRcontinuum());
+            pdfcx.eval(caf2);
+            pdfcc.eval(caf2);
+            const QuantityType rgrid = pdfcx.getRgrid();
+            const QuantityType gx = pdfcx.getPDF();
+            const QuantityType gc = pdfcc.getPDF();
+            const double gerr = pdfcc.getContinuumError();
+            TS_ASSERT_LESS_THAN(0.0, gerr);
+            double dnear = 0.0;
+            double dfar = 0.0;
+            for (size_t i = 0; i < rgrid.size(); ++i)
+            {
+                double& dmax = (rgrid[i] < rc) ? dnear : dfar;
+                dmax = max(dmax, fabs(gc[i] - gx[i]));
+            }
+            TS_ASSERT_DELTA(0.0, dnear, 1e-10);
+            TS_ASSERT_LESS_THAN(0.0, dfar);
+            TS_ASSERT_LESS_THAN_EQUALS(dfar, gerr);
+            // far-field G(r) is close to zero for the fitted density
+            TS_ASSERT_LESS_THAN(fabs(gc.back()), 0.05 * gerr);
+            typedef EvalCounters EC;
+            if (!EC::enabled())  return;
+            TS_ASSERT_LESS_THAN(
+                    4 * pdfcc.getEvalCounters().count(EC::BONDS_ACCEPTED),
+                    pdfcx.getEvalCounters().count(EC::BONDS_ACCEPTED));
+        }
+
+
+        void test_continuumTolerance()
+        {
+            const double rc = 6.0;
+            CrystalStructureAdapterPtr caf2 = fluoriteCrystal();
+            PDFCalculator pdfcx, pdfcc;
+            for (PDFCalculator* pc : {&pdfcx, &pdfcc})
+            {
+                pc->setRmax(40.0);
+                pc->setDoubleAttr("qbroad", 0.2);
+            }
+            pdfcc.setRcontinuum(rc);
+            pdfcx.eval(caf2);
+            pdfcc.eval(caf2);
+            TS_ASSERT_EQUALS(0.0, pdfcc.getContinuumTolerance());
+            TS_ASSERT_EQUALS(rc, pdfcc.getRcontinuumUsed());
+            const double gerr0 = pdfcc.getContinuumError();
+            TS_ASSERT_THROWS(pdfcc.setContinuumTolerance(-1),
+                    invalid_argument);
+            const double tol = gerr0 / 3;
+            pdfcc.setDoubleAttr("continuumtolerance", tol);
+            TS_ASSERT_EQUALS(tol, pdfcc.getContinuumTolerance());
+            pdfcc.eval(caf2);
+            const double rcused = pdfcc.getRcontinuumUsed();
+            TS_ASSERT_EQUALS(rc, pdfcc.getRcontinuum());
+            TS_ASSERT_LESS_THAN(rc, rcused);
+            TS_ASSERT_LESS_THAN(rcused, pdfcc.getRmax());
+            TS_ASSERT_LESS_THAN_EQUALS(pdfcc.getContinuumError(), tol);
+            const QuantityType rgrid = pdfcx.getRgrid();
+            const QuantityType gx = pdfcx.getPDF();
+            QuantityType gc = pdfcc.getPDF();
+            double dnear = 0.0;
+            double dfar = 0.0;
+            for (size_t i = 0; i < rgrid.size(); ++i)
+            {
+                double& dmax = (rgrid[i] < rcused) ? dnear : dfar;
+                dmax = max(dmax, fabs(gc[i] - gx[i]));
+            }
+            TS_ASSERT_DELTA(0.0, dnear, 1e-10);
+            TS_ASSERT_LESS_THAN_EQUALS(dfar, tol);
+            // the extended rc is kept in the next evaluation
+            pdfcc.eval(caf2);
+            TS_ASSERT_EQUALS(rcused, pdfcc.getRcontinuumUsed());
+            // unattainable tolerance gives the exact PDF
+            pdfcc.setContinuumTolerance(1e-8);
+            TS_ASSERT_EQUALS(rc, pdfcc.getRcontinuumUsed());
+            pdfcc.eval(caf2);
+            gc = pdfcc.getPDF();
+            TS_ASSERT_EQUALS(0.0, pdfcc.getContinuumError());
+            for (size_t i = 0; i < rgrid.size(); ++i)
+            {
+                TS_ASSERT_DELTA(gx[i], gc[i], 1e-10);
+            }
+            pdfcc.setRcontinuum(rc);
+            TS_ASSERT_EQUALS(rc, pdfcc.getRcontinuumUsed());
+        }
+
+
+        void test_continuumRmin()
+        {
+            const double rc = 12.0;
+            CrystalStructureAdapterPtr caf2 = fluoriteCrystal();
+            PDFCalculator pdfcx, pdfc0, pdfcc;
+            for (PDFCalculator* pc : {&pdfcx, &pdfc0, &pdfcc})
+            {
+                pc->setRmin(10.0);
+                pc->setRmax(30.0);
+                pc->setDoubleAttr("qbroad", 0.05);
+            }
+            pdfc0.setRmin(0.0);
+            pdfc0.setRcontinuum(rc);
+            pdfcc.setRcontinuum(rc);
+            pdfcx.eval(caf2);
+            pdfc0.eval(caf2);
+            pdfcc.eval(caf2);
+            const QuantityType rgrid = pdfcx.getRgrid();
+            const QuantityType gx = pdfcx.getPDF();
+            const QuantityType gc = pdfcc.getPDF();
+            const double gerr = pdfcc.getContinuumError();
+            TS_ASSERT_LESS_THAN(0.0, gerr);
+            for (size_t i = 0; i < rgrid.size(); ++i)
+            {
+                const double eps = (rgrid[i] < rc) ? 1e-10 : gerr;
+                TS_ASSERT_DELTA(gx[i], gc[i], eps);
+            }
+            // the pairs below rc/2 are not needed for the density fit
+            typedef EvalCounters EC;
+            if (!EC::enabled())  return;
+            TS_ASSERT_LESS_THAN(
+                    pdfcc.getEvalCounters().count(EC::BONDS_ACCEPTED),
+                    pdfc0.getEvalCounters().count(EC::BONDS_ACCEPTED));
+        }
+
+
+        void test_rangeUpdate()
+        {
+            typedef EvalCounters EC;
+            diffpy::mathutils::EpsilonEqual allclose(1e-10);
+            CrystalStructureAdapterPtr caf2 = fluoriteCrystal();
+            PDFCalculator pdfc, pdfcf;
+            for (PDFCalculator* pc : {&pdfc, &pdfcf})
+            {
+                pc->setDoubleAttr("qbroad", 0.05);
+                pc->setRmax(8.0);
+            }
+            const EvalCounters& cnt = pdfc.getEvalCounters();
+            const EvalCounters& cntf = pdfcf.getEvalCounters();
+            pdfc.eval(caf2);
+            // grow, shrink and shift the r-range
+            const double rlimits[3][2] = {{0, 16}, {0, 14}, {3, 15}};
+            for (auto& rr : rlimits)
+            {
+                pdfc.setRmin(rr[0]);
+                pdfc.setRmax(rr[1]);
+                pdfc.eval(caf2);
+                pdfcf.setRmin(rr[0]);
+                pdfcf.setRmax(rr[1]);
+                pdfcf.setStructure(caf2);
+                pdfcf.eval();
+                TS_ASSERT(allclose(pdfcf.getPDF(), pdfc.getPDF()));
+                if (!EC::enabled())  continue;
+                TS_ASSERT_EQUALS(1, cnt.count(EC::RANGE_UPDATES));
+                TS_ASSERT_EQUALS(0, cnt.count(EC::FULL_RECOMPUTES));
+                TS_ASSERT_LESS_THAN(cnt.count(EC::PAIR_CONTRIBUTIONS),
+                        cntf.count(EC::PAIR_CONTRIBUTIONS));
+            }
+            // any other change needs the full calculation
+            pdfc.setRmax(16.0);
+            pdfc.setDoubleAttr("qbroad", 0.04);
+            pdfc.setRmax(15.0);
+            pdfc.eval(caf2);
+            if (!EC::enabled())  return;
+            TS_ASSERT_EQUALS(1, cnt.count(EC::FULL_RECOMPUTES));
+        }
+
+
+        void test_rangeUpdateAfterGridChange()
+        {
+            diffpy::mathutils::EpsilonEqual allclose(1e-10);
+            PeriodicStructureAdapterPtr stru(new PeriodicStructureAdapter);
+            stru->setLatPar(8, 8, 8, 90, 90, 90);
+            const char* elements[3] = {"C", "O", "Ni"};
+            Atom a;
+            for (int i = 0; i < 20; ++i)
+            {
+                a.atomtype = elements[i % 3];
+                a.xyz_cartn = R3::Vector(
+                        fmod(2.9 * i, 8.0), fmod(1.7 * i + 0.3, 8.0),
+                        fmod(3.7 * i + 0.5, 8.0));
+                double uiso = (i == 8) ? 0.012 : (0.004 + 0.0002 * i);
+                a.uij_cartn = uiso * R3::identity();
+                stru->append(a);
+            }
+            PDFCalculator pdfc, pdfcb;
+            pdfc.setEvaluatorType(OPTIMIZED);
+            pdfcb.setEvaluatorType(BASIC);
+            for (PDFCalculator* pc : {&pdfc, &pdfcb})
+            {
+                pc->setQmax(25);
+                pc->setRmax(12);
+            }
+            pdfc.eval(stru);
+            // removal of the widest peaks shrinks the calculated grid
+            stru->erase(8);
+            pdfc.eval(stru);
+            pdfcb.eval(stru);
+            TS_ASSERT(allclose(pdfcb.getPDF(), pdfc.getPDF()));
+            pdfc.setRmax(15);
+            pdfcb.setRmax(15);
+            pdfc.eval(stru);
+            pdfcb.eval(stru);
+            TS_ASSERT(allclose(pdfcb.getPDF(), pdfc.getPDF()));
+        }
+
+
+        void test_crystalSymmetryReduction()
+        {
+            CrystalStructureAdapterPtr caf2 = fluoriteCrystal();
+            TS_ASSERT_EQUALS(4, caf2->siteMultiplicity(0));
+            TS_ASSERT_EQUALS(8, caf2->siteMultiplicity(1));
+            PeriodicStructureAdapterPtr caf2p1(new PeriodicStructureAdapter);
+            caf2p1->setLatPar(5.46, 5.46, 5.46, 90, 90, 90);
+            for (int i = 0; i < caf2->countSites(); ++i)
+            {
+                const CrystalStructureAdapter::AtomVector& eqatoms =
+                    caf2->getEquivalentAtoms(i);
+                for (size_t j = 0; j < eqatoms.size(); ++j)
+                {
+                    caf2p1->append(eqatoms[j]);
+                }
+            }
+            // bonds from the F site, there are 8 F and 4 Ca per cell
+            BaseBondGeneratorPtr bnds = caf2->createBondGenerator();
+            bnds->setRmax(8.0);
+            bnds->selectAnchorSite(1);
+            bnds->selectSiteRange(0, 2);
+            const int cntfull = countBonds(*bnds);
+            TS_ASSERT(sameBlockBonds(*bnds));
+            bnds->setSymmetryReduction(true);
+            const int cntreduced = countBonds(*bnds);
+            TS_ASSERT(sameBlockBonds(*bnds));
+            TS_ASSERT_LESS_THAN(4 * cntreduced, cntfull);
+            int cntweighted = 0;
+            for (bnds->rewind(); !bnds->finished(); bnds->next())
+            {
+                cntweighted += bnds->multiplicity() / caf2->siteMultiplicity(1);
+            }
+            TS_ASSERT_EQUALS(cntfull, cntweighted);
+            // PDF must agree with the structure expanded to P1
+            mpdfc->setRmax(10.0);
+            mpdfc->eval(caf2);
+            QuantityType gcr = mpdfc->getPDF();
+            mpdfc->eval(caf2p1);
+            QuantityType gp1 = mpdfc->getPDF();
+            TS_ASSERT_EQUALS(gcr.size(), gp1.size());
+            double gmaxdiff = 0.0;
+            for (size_t i = 0; i < gcr.size(); ++i)
+            {
+                gmaxdiff = max(gmaxdiff, fabs(gcr[i] - gp1[i]));
+            }
+            TS_ASSERT_DELTA(0.0, gmaxdiff, 1e-8);
+            // no reduction when displacements break the site symmetry
+            R3::Matrix& U0 = caf2->at(0).uij_cartn;
+            U0(0, 0) = 0.004;
+            U0(0, 1) = U0(1, 0) = 0.002;
+            bnds = caf2->createBondGenerator();
+            bnds->setRmax(8.0);
+            bnds->selectAnchorSite(1);
+            bnds->selectSiteRange(0, 2);
+            bnds->setSymmetryReduction(true);
+            TS_ASSERT_EQUALS(cntfull, countBonds(*bnds));
+        }
+
+
         void test_serialization()
         {
             // build customized PDFCalculator
@@ -278,6 +693,67 @@ class TestPDFCalculator : public CxxTest::TestSuite
                     pdfc1->getScatteringFactorTable()->lookup("H"));
         }
 
+
+        void test_serializationSiteCache()
+        {
+            diffpy::mathutils::EpsilonEqual allclose(meps);
+            PeriodicStructureAdapterPtr catio3 =
+                boost::dynamic_pointer_cast<PeriodicStructureAdapter>(
+                        loadTestPeriodicStructure("CaTiO3.stru"));
+            mpdfc->setSiteCaching(true);
+            mpdfc->eval(catio3);
+            TS_ASSERT_EQUALS(catio3->countSites(), mpdfc->countCachedSites());
+            stringstream storage(ios::in | ios::out | ios::binary);
+            diffpy::serialization::oarchive oa(storage, ios::binary);
+            oa << mpdfc;
+            diffpy::serialization::iarchive ia(storage, ios::binary);
+            boost::shared_ptr<PDFCalculator> pdfc1;
+            ia >> pdfc1;
+            // site contributions are rebuilt in the next evaluation
+            TS_ASSERT(pdfc1->getSiteCaching());
+            TS_ASSERT_EQUALS(0, pdfc1->countCachedSites());
+            TS_ASSERT(allclose(mpdfc->getPDF(), pdfc1->getPDF()));
+            (*catio3)[3].xyz_cartn[2] += 0.1;
+            pdfc1->eval(catio3);
+            mpdfc->setEvaluatorType(BASIC);
+            mpdfc->eval(catio3);
+            TS_ASSERT(allclose(mpdfc->getPDF(), pdfc1->getPDF()));
+            TS_ASSERT_EQUALS(catio3->countSites(), pdfc1->countCachedSites());
+        }
+
+
+        void test_serializationLocalSites()
+        {
+            diffpy::mathutils::EpsilonEqual allclose(meps);
+            PeriodicStructureAdapterPtr catio3 =
+                boost::dynamic_pointer_cast<PeriodicStructureAdapter>(
+                        loadTestPeriodicStructure("CaTiO3.stru"));
+            const int ALL = mpdfc->ALLATOMSINT;
+            SiteIndices lsites = {1, 3};
+            mpdfc->setLocalSites(lsites);
+            mpdfc->eval(catio3);
+            stringstream storage(ios::in | ios::out | ios::binary);
+            diffpy::serialization::oarchive oa(storage, ios::binary);
+            oa << mpdfc;
+            diffpy::serialization::iarchive ia(storage, ios::binary);
+            boost::shared_ptr<PDFCalculator> pdfc1;
+            ia >> pdfc1;
+            TS_ASSERT_EQUALS(lsites, pdfc1->getLocalSites());
+            // local rows are not saved, but rebuilt in the next evaluation
+            QuantityType zeros(mpdfc->getRDF().size(), 0.0);
+            TS_ASSERT_EQUALS(zeros, pdfc1->getLocalRDF(3));
+            (*catio3)[3].xyz_cartn[2] += 0.1;
+            pdfc1->eval(catio3);
+            PDFCalculator pdfcm;
+            for (int site : lsites)
+            {
+                pdfcm.maskAllPairs(false);
+                pdfcm.setPairMask(site, ALL, true);
+                pdfcm.eval(catio3);
+                TS_ASSERT(allclose(pdfcm.getRDF(), pdfc1->getLocalRDF(site)));
+            }
+        }
+
 };  // class TestPDFCalculator
 
 // End of file
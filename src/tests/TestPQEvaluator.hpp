@@ -22,6 +22,7 @@
 #include <functional>
 #include <boost/make_shared.hpp>
 
+#include <diffpy/serialization.hpp>
 #include <diffpy/srreal/PQEvaluator.hpp>
 #include <diffpy/srreal/AtomicStructureAdapter.hpp>
 #include <diffpy/srreal/PeriodicStructureAdapter.hpp>
@@ -29,6 +30,7 @@
 #include <diffpy/srreal/PDFCalculator.hpp>
 #include <diffpy/srreal/OverlapCalculator.hpp>
 #include "test_helpers.hpp"
+#include "allocation_counter.hpp"
 
 namespace diffpy {
 namespace srreal {
@@ -47,6 +49,15 @@ class BadPairCounter : public PairCounter
         virtual void restorePartialValue()  { }
 };
 
+// calculator that exposes its packed structure view
+
+class ViewPDFCalculator : public PDFCalculator
+{
+    public:
+
+        using PDFCalculator::getPackedView;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 // class TestPQEvaluator
 //////////////////////////////////////////////////////////////////////////////
@@ -79,6 +90,56 @@ class TestPQEvaluator : public CxxTest::TestSuite
             return rv;
         }
 
+
+        /// allocations in the fast update of pdfc after moving one atom,
+        /// which must be the same in every update after the first one
+        long countMoveAllocations(PDFCalculator& pdfc,
+                AtomicStructureAdapterPtr stru)
+        {
+            const AtomicStructureAdapter& cstru = *stru;
+            R3::Vector xyz = cstru[3].xyz_cartn;
+            pdfc.eval(stru);
+            long rv = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                const long cnt0 = countAllocations();
+                xyz[1] += 0.05;
+                stru->setAtomPosition(3, xyz);
+                pdfc.eval(stru);
+                const long cnt1 = countAllocations();
+                TS_ASSERT_EQUALS(OPTIMIZED, pdfc.getEvaluatorTypeUsed());
+                if (i > 1)  TS_ASSERT_EQUALS(rv, cnt1 - cnt0);
+                rv = cnt1 - cnt0;
+            }
+            return rv;
+        }
+
+
+        void checkPackedView(const PackedStructureView& sv,
+                const StructureAdapter& stru)
+        {
+            TS_ASSERT_EQUALS(stru.countSites(), sv.countSites());
+            double totocc = 0.0;
+            for (int i = 0; i < sv.countSites(); ++i)
+            {
+                TS_ASSERT_EQUALS(stru.siteAtomType(i), sv.siteAtomType(i));
+                TS_ASSERT_EQUALS(stru.siteCartesianPosition(i),
+                        sv.siteCartesianPosition(i));
+                TS_ASSERT_EQUALS(stru.siteOccupancy(i), sv.siteOccupancy(i));
+                TS_ASSERT_EQUALS(stru.siteAnisotropy(i),
+                        sv.siteAnisotropy(i));
+                TS_ASSERT_EQUALS(stru.siteCartesianUij(i)(0, 0),
+                        sv.siteUiso(i));
+                if (sv.siteAnisotropy(i))
+                {
+                    TS_ASSERT_EQUALS(stru.siteCartesianUij(i),
+                            sv.siteCartesianUij(i));
+                }
+                totocc += stru.siteOccupancy(i) * stru.siteMultiplicity(i);
+            }
+            TS_ASSERT_EQUALS(totocc, sv.totalOccupancy());
+        }
+
      public:
 
         void setUp()
@@ -171,6 +232,123 @@ class TestPQEvaluator : public CxxTest::TestSuite
         }
 
 
+        void test_PDF_change_journal()
+        {
+            mpdfco.eval(mstru10);
+            Atom a = mstru10->at(2);
+            a.xyz_cartn[1] = 0.7;
+            mstru10->append(a);
+            mstru10->at(4).occupancy = 0.5;
+            TS_ASSERT(allclose(mzeros, this->pdfcdiff(mstru10)));
+            TS_ASSERT_EQUALS(OPTIMIZED, mpdfco.getEvaluatorTypeUsed());
+            mstru10->erase(1);
+            mstru10->insert(5, a);
+            TS_ASSERT(allclose(mzeros, this->pdfcdiff(mstru10)));
+            TS_ASSERT_EQUALS(OPTIMIZED, mpdfco.getEvaluatorTypeUsed());
+            mstru10->erase(mstru10->countSites() - 1);
+            TS_ASSERT(allclose(mzeros, this->pdfcdiff(mstru10)));
+            TS_ASSERT_EQUALS(OPTIMIZED, mpdfco.getEvaluatorTypeUsed());
+        }
+
+
+        void test_PDF_site_caching()
+        {
+            TS_ASSERT(!mpdfco.getSiteCaching());
+            mpdfco.setSiteCaching(true);
+            TS_ASSERT(mpdfco.getSiteCaching());
+            mpdfco.eval(mstru10);
+            TS_ASSERT_EQUALS(10, mpdfco.countCachedSites());
+            mpdfcb.setSiteCaching(true);
+            mpdfcb.eval(mstru10);
+            TS_ASSERT_EQUALS(0, mpdfcb.countCachedSites());
+            // remove 2 cached sites with a mutual pair
+            mstru10->at(2).xyz_cartn[1] = 0.3;
+            mstru10->at(7).xyz_cartn[2] = -0.2;
+            TS_ASSERT(allclose(mzeros, this->pdfcdiff(mstru10)));
+            TS_ASSERT_EQUALS(OPTIMIZED, mpdfco.getEvaluatorTypeUsed());
+            // all other sites are partners of the changed ones
+            TS_ASSERT_EQUALS(2, mpdfco.countCachedSites());
+            mstru10->at(2).xyz_cartn[1] = 0.1;
+            TS_ASSERT(allclose(mzeros, this->pdfcdiff(mstru10)));
+            TS_ASSERT_EQUALS(1, mpdfco.countCachedSites());
+            // stale sites are summed over pairs and cached again
+            mstru10->at(5).occupancy = 0.5;
+            TS_ASSERT(allclose(mzeros, this->pdfcdiff(mstru10)));
+            TS_ASSERT_EQUALS(1, mpdfco.countCachedSites());
+            mstru10->append(mstru10->at(5));
+            mstru10->at(10).xyz_cartn[2] = 1.0;
+            TS_ASSERT(allclose(mzeros, this->pdfcdiff(mstru10)));
+            TS_ASSERT_EQUALS(OPTIMIZED, mpdfco.getEvaluatorTypeUsed());
+            // rejected trial move keeps the cache
+            QuantityType g0 = mpdfco.getPDF();
+            const int cnt0 = mpdfco.countCachedSites();
+            SiteIndices sites(1, 10);
+            std::vector<Atom> newatoms(1, mstru10->at(10));
+            newatoms[0].xyz_cartn[0] = 3.5;
+            mpdfco.proposeMove(sites, newatoms);
+            mpdfco.rollback();
+            TS_ASSERT_EQUALS(cnt0, mpdfco.countCachedSites());
+            mstru10->at(10).xyz_cartn[1] = -0.4;
+            TS_ASSERT(allclose(mzeros, this->pdfcdiff(mstru10)));
+            mpdfco.setEvaluatorType(CHECK);
+            mpdfco.eval(mstru10);
+            mstru10->at(10).xyz_cartn[1] = 0.4;
+            TS_ASSERT_THROWS_NOTHING(mpdfco.eval(mstru10));
+            TS_ASSERT_EQUALS(CHECK, mpdfco.getEvaluatorTypeUsed());
+            mstru10->at(10).xyz_cartn[1] = 0.2;
+            TS_ASSERT_THROWS_NOTHING(mpdfco.eval(mstru10));
+            TS_ASSERT_EQUALS(CHECK, mpdfco.getEvaluatorTypeUsed());
+            TS_ASSERT_EQUALS(11, mpdfco.countCachedSites());
+        }
+
+
+        void test_PDF_trial_move()
+        {
+            mpdfco.eval(mstru10);
+            QuantityType g0 = mpdfco.getPDF();
+            SiteIndices sites(1, 3);
+            std::vector<Atom> newatoms(1, mstru10->at(3));
+            newatoms[0].xyz_cartn[1] = 0.3;
+            AtomicStructureAdapterPtr stru1 =
+                boost::make_shared<AtomicStructureAdapter>(*mstru10);
+            (*stru1)[3] = newatoms[0];
+            mpdfcb.eval(stru1);
+            QuantityType gb1 = mpdfcb.getPDF();
+            mpdfco.proposeMove(sites, newatoms);
+            TS_ASSERT(mpdfco.hasPendingMove());
+            TS_ASSERT_EQUALS(OPTIMIZED, mpdfco.getEvaluatorTypeUsed());
+            TS_ASSERT(allclose(gb1, mpdfco.getPDF()));
+            TS_ASSERT_THROWS(mpdfco.proposeMove(sites, newatoms), logic_error);
+            mpdfco.rollback();
+            TS_ASSERT(!mpdfco.hasPendingMove());
+            TS_ASSERT_EQUALS(g0, mpdfco.getPDF());
+            TS_ASSERT_EQUALS(mstru10, mpdfco.getStructure());
+            TS_ASSERT_EQUALS(0.0, mstru10->at(3).xyz_cartn[1]);
+            mpdfco.eval(mstru10);
+            TS_ASSERT_EQUALS(OPTIMIZED, mpdfco.getEvaluatorTypeUsed());
+            TS_ASSERT(allclose(g0, mpdfco.getPDF()));
+            // accepted move is applied to the structure
+            mpdfco.proposeMove(sites, newatoms);
+            mpdfco.commit();
+            TS_ASSERT_EQUALS(mstru10, mpdfco.getStructure());
+            TS_ASSERT_EQUALS(newatoms[0], mstru10->at(3));
+            TS_ASSERT(allclose(gb1, mpdfco.getPDF()));
+            mpdfco.eval(mstru10);
+            TS_ASSERT_EQUALS(OPTIMIZED, mpdfco.getEvaluatorTypeUsed());
+            TS_ASSERT(allclose(gb1, mpdfco.getPDF()));
+            // invalid calls
+            TS_ASSERT_THROWS(mpdfco.commit(), logic_error);
+            TS_ASSERT_THROWS(mpdfco.rollback(), logic_error);
+            sites.push_back(4);
+            TS_ASSERT_THROWS(mpdfco.proposeMove(sites, newatoms),
+                    invalid_argument);
+            sites.assign(1, 10);
+            TS_ASSERT_THROWS(mpdfco.proposeMove(sites, newatoms),
+                    invalid_argument);
+            TS_ASSERT(!mpdfco.hasPendingMove());
+        }
+
+
         void test_PDF_type_mask()
         {
             mpdfcb.setTypeMask("O2-", "all", false);
@@ -234,6 +412,192 @@ class TestPQEvaluator : public CxxTest::TestSuite
         }
 
 
+        void test_packed_view()
+        {
+            ViewPDFCalculator pdfc;
+            pdfc.eval(mstru10d1);
+            const PackedStructureView& sv = pdfc.getPackedView();
+            TS_ASSERT_EQUALS(10, sv.countSites());
+            TS_ASSERT_EQUALS(2, sv.countTypes());
+            TS_ASSERT_EQUALS("Au", sv.atomTypes()[0]);
+            TS_ASSERT_EQUALS("C", sv.atomTypes()[1]);
+            TS_ASSERT_EQUALS(10.0, sv.totalOccupancy());
+            for (int i = 0; i < sv.countSites(); ++i)
+            {
+                TS_ASSERT_EQUALS(int(i > 0), sv.siteTypeId(i));
+                TS_ASSERT_EQUALS(mstru10d1->siteAtomType(i),
+                        sv.siteAtomType(i));
+                TS_ASSERT_EQUALS(mstru10d1->siteCartesianPosition(i),
+                        sv.siteCartesianPosition(i));
+                TS_ASSERT_EQUALS(0.004, sv.siteUiso(i));
+                TS_ASSERT_EQUALS(1, sv.siteMultiplicity(i));
+                TS_ASSERT_EQUALS(1.0, sv.siteOccupancy(i));
+                TS_ASSERT(!sv.siteAnisotropy(i));
+            }
+            // generators give the same bonds with and without the view
+            BaseBondGeneratorPtr bnds0 = mstru10d1->createBondGenerator();
+            BaseBondGeneratorPtr bnds1 = mstru10d1->createBondGenerator();
+            bnds1->setPackedView(&sv);
+            bnds0->setRmax(5);
+            bnds1->setRmax(5);
+            bnds0->selectAnchorSite(3);
+            bnds1->selectAnchorSite(3);
+            bnds0->rewind();
+            bnds1->rewind();
+            int cnt = 0;
+            for (; !bnds0->finished(); bnds0->next(), bnds1->next(), ++cnt)
+            {
+                TS_ASSERT(!bnds1->finished());
+                TS_ASSERT_EQUALS(bnds0->site1(), bnds1->site1());
+                TS_ASSERT_EQUALS(bnds0->distance(), bnds1->distance());
+                TS_ASSERT_EQUALS(bnds0->msd(), bnds1->msd());
+                TS_ASSERT_EQUALS(bnds0->multiplicity(),
+                        bnds1->multiplicity());
+            }
+            TS_ASSERT(bnds1->finished());
+            TS_ASSERT_EQUALS(8, cnt);
+            // the view follows the structure in the next evaluation
+            (*mstru10d1)[0].atomtype = "C";
+            pdfc.eval(mstru10d1);
+            TS_ASSERT_EQUALS(1, sv.countTypes());
+            PDFCalculator pdfc1;
+            pdfc1.eval(mstru10);
+            TS_ASSERT(allclose(pdfc1.getPDF(), pdfc.getPDF()));
+        }
+
+
+        void test_packed_view_update()
+        {
+            ViewPDFCalculator pdfc;
+            pdfc.setEvaluatorType(OPTIMIZED);
+            const PackedStructureView& sv = pdfc.getPackedView();
+            AtomicStructureAdapterPtr stru =
+                boost::make_shared<AtomicStructureAdapter>(*mstru10d1);
+            const AtomicStructureAdapter& cstru = *stru;
+            pdfc.eval(stru);
+            // move one atom and make another one anisotropic
+            stru->setAtomPosition(4, R3::Vector(4.1, 0.2, 0.0));
+            Atom a6 = cstru[6];
+            a6.anisotropy = true;
+            a6.uij_cartn(0, 1) = a6.uij_cartn(1, 0) = 0.001;
+            a6.occupancy = 0.5;
+            stru->setAtom(6, a6);
+            pdfc.eval(stru);
+            TS_ASSERT_EQUALS(OPTIMIZED, pdfc.getEvaluatorTypeUsed());
+            this->checkPackedView(sv, *stru);
+            TS_ASSERT_EQUALS(2, sv.countTypes());
+            // anisotropic sites give the same bonds with the view
+            BaseBondGeneratorPtr bnds0 = stru->createBondGenerator();
+            BaseBondGeneratorPtr bnds1 = stru->createBondGenerator();
+            bnds1->setPackedView(&sv);
+            bnds0->selectAnchorSite(6);
+            bnds1->selectAnchorSite(6);
+            bnds0->rewind();
+            bnds1->rewind();
+            for (; !bnds0->finished(); bnds0->next(), bnds1->next())
+            {
+                TS_ASSERT_EQUALS(bnds0->site1(), bnds1->site1());
+                TS_ASSERT_EQUALS(bnds0->Ucartesian0(), bnds1->Ucartesian0());
+                TS_ASSERT_EQUALS(bnds0->Ucartesian1(), bnds1->Ucartesian1());
+                TS_ASSERT_EQUALS(bnds0->msd(), bnds1->msd());
+            }
+            // remove the last site and make another one anisotropic
+            stru->erase(9);
+            a6.xyz_cartn = cstru[2].xyz_cartn;
+            stru->setAtom(2, a6);
+            pdfc.eval(stru);
+            TS_ASSERT_EQUALS(OPTIMIZED, pdfc.getEvaluatorTypeUsed());
+            this->checkPackedView(sv, *stru);
+            // the Au site gets a new atom type
+            stru->setAtom(0, cstru[1]);
+            pdfc.eval(stru);
+            TS_ASSERT_EQUALS(OPTIMIZED, pdfc.getEvaluatorTypeUsed());
+            this->checkPackedView(sv, *stru);
+            TS_ASSERT_EQUALS(1, sv.countTypes());
+            PDFCalculator pdfcb;
+            pdfcb.eval(stru);
+            TS_ASSERT(allclose(pdfcb.getPDF(), pdfc.getPDF()));
+        }
+
+
+        void test_eval_counters()
+        {
+            typedef EvalCounters EC;
+            if (!EC::enabled())  return;
+            PDFCalculator pdfc;
+            pdfc.setEvaluatorType(OPTIMIZED);
+            const EvalCounters& cnt = pdfc.getEvalCounters();
+            pdfc.eval(mstru10);
+            TS_ASSERT_EQUALS(1, cnt.count(EC::FULL_RECOMPUTES));
+            TS_ASSERT_EQUALS(0, cnt.count(EC::FAST_UPDATES));
+            TS_ASSERT_EQUALS(45, cnt.count(EC::PAIR_CONTRIBUTIONS));
+            TS_ASSERT_EQUALS(0, cnt.count(EC::SPHERE_POINTS));
+            // fast update removes and adds the pairs of one site
+            mstru10->at(3).xyz_cartn[1] = 0.2;
+            pdfc.eval(mstru10);
+            TS_ASSERT_EQUALS(0, cnt.count(EC::FULL_RECOMPUTES));
+            TS_ASSERT_EQUALS(1, cnt.count(EC::FAST_UPDATES));
+            TS_ASSERT_EQUALS(2 * 9, cnt.count(EC::PAIR_CONTRIBUTIONS));
+            mpdfcb.eval(mstru10);
+            TS_ASSERT_EQUALS(1, mpdfcb.getEvalCounters().count(
+                        EC::FULL_RECOMPUTES));
+        }
+
+
+        void test_steady_state_allocations()
+        {
+            PDFCalculator pdfc;
+            pdfc.setEvaluatorType(OPTIMIZED);
+            pdfc.eval(mstru10);
+            pdfc.eval(mstru10);
+            const QuantityType g0 = pdfc.getPDF();
+            QuantityType rdf, rgrid, rgrid_ext;
+            pdfc.getExtendedRDF(rdf);
+            pdfc.getRgrid(rgrid);
+            pdfc.getExtendedRgrid(rgrid_ext);
+            const long cnt0 = countAllocations();
+            for (int i = 0; i < 3; ++i)
+            {
+                pdfc.eval(mstru10);
+                pdfc.getExtendedRDF(rdf);
+                pdfc.getRgrid(rgrid);
+                pdfc.getExtendedRgrid(rgrid_ext);
+            }
+            const long cnt1 = countAllocations();
+            TS_ASSERT_EQUALS(cnt0, cnt1);
+            TS_ASSERT_EQUALS(OPTIMIZED, pdfc.getEvaluatorTypeUsed());
+            TS_ASSERT_EQUALS(g0, pdfc.getPDF());
+            TS_ASSERT_EQUALS(pdfc.getExtendedRDF(), rdf);
+            TS_ASSERT_EQUALS(pdfc.getRgrid(), rgrid);
+            TS_ASSERT_EQUALS(pdfc.getExtendedRgrid(), rgrid_ext);
+            // moving one atom allocates the same in every fast update
+            // regardless of the structure size
+            const AtomicStructureAdapter& cstru10 = *mstru10;
+            AtomicStructureAdapterPtr stru10 =
+                boost::make_shared<AtomicStructureAdapter>(cstru10);
+            AtomicStructureAdapterPtr stru20 =
+                boost::make_shared<AtomicStructureAdapter>(cstru10);
+            for (int i = 0; i < 10; ++i)
+            {
+                Atom a = cstru10[i];
+                a.xyz_cartn[1] = 3.0;
+                stru20->append(a);
+            }
+            const long cntmove10 = this->countMoveAllocations(pdfc, stru10);
+            TS_ASSERT(!allclose(g0, pdfc.getPDF()));
+            PDFCalculator pdfcb;
+            pdfcb.setEvaluatorType(BASIC);
+            pdfcb.eval(stru10);
+            TS_ASSERT(allclose(pdfcb.getPDF(), pdfc.getPDF()));
+            PDFCalculator pdfc20;
+            pdfc20.setEvaluatorType(OPTIMIZED);
+            const long cntmove20 = this->countMoveAllocations(pdfc20, stru20);
+            TS_ASSERT_EQUALS(cntmove10, cntmove20);
+            pdfcb.eval(stru20);
+            TS_ASSERT(allclose(pdfcb.getPDF(), pdfc20.getPDF()));
+        }
+
+
         void test_optimized_supported()
         {
             mpdfcb.eval(mstru10);
@@ -288,6 +652,63 @@ class TestPQEvaluator : public CxxTest::TestSuite
             TS_ASSERT_EQUALS(CHECK, badcounter.getEvaluatorTypeUsed());
         }
 
+
+        void test_checkevaluator_sampling()
+        {
+            BadPairCounter badcounter;
+            TS_ASSERT_THROWS(badcounter.getCheckEvaluator(), logic_error);
+            badcounter.setEvaluatorType(CHECK);
+            PQEvaluatorCheck& pqev = badcounter.getCheckEvaluator();
+            TS_ASSERT_EQUALS(1, pqev.getCheckInterval());
+            TS_ASSERT(pqev.getThrowOnMismatch());
+            TS_ASSERT_THROWS(pqev.setCheckInterval(0), invalid_argument);
+            pqev.setCheckInterval(3);
+            pqev.setThrowOnMismatch(false);
+            badcounter(mstru10);
+            TS_ASSERT_EQUALS(BASIC, badcounter.getEvaluatorTypeUsed());
+            for (int i = 0; i < 6; ++i)
+            {
+                badcounter(mstru10);
+                const bool checked = (i % 3 == 2);
+                TS_ASSERT_EQUALS(checked ? CHECK : OPTIMIZED,
+                        badcounter.getEvaluatorTypeUsed());
+                // failed check leaves the correct BASIC value
+                if (checked)  TS_ASSERT_EQUALS(45, badcounter.value()[0]);
+                const EvalCounters& cnt = badcounter.getEvalCounters();
+                if (!EvalCounters::enabled())  continue;
+                TS_ASSERT_EQUALS(checked, cnt.count(EvalCounters::CHECKS));
+                TS_ASSERT_EQUALS(checked,
+                        cnt.count(EvalCounters::CHECK_MISMATCHES));
+            }
+            TS_ASSERT_EQUALS(2, pqev.countChecks());
+            TS_ASSERT_EQUALS(2, pqev.countMismatches());
+            TS_ASSERT_LESS_THAN(0.0, pqev.getMaxDeviation());
+            pqev.resetStatistics();
+            TS_ASSERT_EQUALS(0, pqev.countChecks());
+            TS_ASSERT_EQUALS(0.0, pqev.getMaxDeviation());
+            // sampled checks of a correct calculator pass
+            PDFCalculator pdfc;
+            pdfc.setEvaluatorType(CHECK);
+            pdfc.getCheckEvaluator().setCheckInterval(2);
+            pdfc.eval(mstru10);
+            pdfc.eval(mstru10d1);
+            TS_ASSERT_EQUALS(OPTIMIZED, pdfc.getEvaluatorTypeUsed());
+            pdfc.eval(mstru9);
+            TS_ASSERT_EQUALS(CHECK, pdfc.getEvaluatorTypeUsed());
+            TS_ASSERT_EQUALS(1, pdfc.getCheckEvaluator().countChecks());
+            TS_ASSERT_EQUALS(0, pdfc.getCheckEvaluator().countMismatches());
+            // sampling setup is preserved by serialization
+            stringstream storage(ios::in | ios::out | ios::binary);
+            diffpy::serialization::oarchive oa(storage, ios::binary);
+            oa << pdfc;
+            diffpy::serialization::iarchive ia(storage, ios::binary);
+            PDFCalculator pdfc1;
+            ia >> pdfc1;
+            TS_ASSERT_EQUALS(CHECK, pdfc1.getEvaluatorType());
+            TS_ASSERT_EQUALS(2, pdfc1.getCheckEvaluator().getCheckInterval());
+            TS_ASSERT_EQUALS(1, pdfc1.getCheckEvaluator().countChecks());
+        }
+
 };  // class TestPQEvaluator
 
 }   // namespace srreal
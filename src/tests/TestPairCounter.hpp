@@ -20,10 +20,24 @@
 
 #include <diffpy/srreal/AtomicStructureAdapter.hpp>
 #include <diffpy/srreal/PairCounter.hpp>
+#include <diffpy/srreal/BondBlock.hpp>
+#include "test_helpers.hpp"
 
 using namespace std;
 using namespace diffpy::srreal;
 
+namespace {
+
+// PairCounter that receives one bond at a time
+class PerBondCounter : public PairCounter
+{
+    protected:
+
+        bool usesBondBlocks() const  { return false; }
+};
+
+}   // namespace
+
 class TestPairCounter : public CxxTest::TestSuite
 {
 
@@ -128,6 +142,52 @@ public:
     }
 
 
+    void test_compiledMask()
+    {
+        PairCounter pcount;
+        pcount.setStructure(mline100);
+        // count of masked pairs from the public lookup
+        auto maskedpairs = [&pcount]() {
+            int rv = 0;
+            for (int i = 0; i < 100; ++i)
+            {
+                for (int j = i + 1; j < 100; ++j)
+                {
+                    rv += pcount.getPairMask(i, j);
+                }
+            }
+            return rv;
+        };
+        int cnt;
+        pcount.maskAllPairs(false);
+        pcount.setPairMask(3, pcount.ALLATOMSINT, true);
+        pcount.setPairMask(7, pcount.ALLATOMSINT, true);
+        TS_ASSERT_EQUALS(99 + 98, pcount(mline100));
+        pcount.setPairMask(3, 8, false);
+        pcount.setPairMask(20, 30, true);
+        pcount.setPairMask(40, pcount.ALLATOMSINT, false);
+        cnt = pcount(mline100);
+        TS_ASSERT_EQUALS(maskedpairs(), cnt);
+        pcount.invertMask();
+        cnt = pcount(mline100);
+        TS_ASSERT_EQUALS(maskedpairs(), cnt);
+        // type masks
+        for (int i = 0; i < 100; ++i)
+        {
+            (*mline100)[i].atomtype = (i % 3) ? "Na" : "Cl";
+        }
+        pcount.setTypeMask("all", "all", false);
+        pcount.setTypeMask("Na", "Cl", true);
+        TS_ASSERT_EQUALS(34 * 66, pcount(mline100));
+        pcount.setTypeMask("Cl", "all", true);
+        cnt = pcount(mline100);
+        TS_ASSERT_EQUALS(maskedpairs(), cnt);
+        pcount.setTypeMask("Na", "Na", true);
+        TS_ASSERT_EQUALS(100 * 99 / 2, pcount(mline100));
+        for (int i = 0; i < 100; ++i)  (*mline100)[i].atomtype.clear();
+    }
+
+
     void test_parallel()
     {
         const int ncpu = 7;
@@ -152,6 +212,64 @@ public:
         TS_ASSERT_EQUALS(100 * 99 / 2, pmaster.value()[0]);
     }
 
+
+    void test_bondBlocks()
+    {
+        BaseBondGeneratorPtr bnds = mline100->createBondGenerator();
+        bnds->setRmax(10.5);
+        bnds->selectAnchorSite(3);
+        bnds->selectSiteRange(0, 100);
+        vector<int> sites1;
+        for (bnds->rewind(); !bnds->finished(); bnds->next())
+        {
+            sites1.push_back(bnds->site1());
+        }
+        TS_ASSERT_EQUALS(13u, sites1.size());
+        BondBlock blk;
+        vector<int> bsites1;
+        bnds->rewind();
+        while (!bnds->finished())
+        {
+            blk.clear();
+            int n = bnds->fillBlock(blk);
+            TS_ASSERT_EQUALS(n, blk.count);
+            TS_ASSERT(n > 0);
+            for (int k = 0; k < blk.count; ++k)
+            {
+                TS_ASSERT_EQUALS(3, blk.site0[k]);
+                TS_ASSERT_EQUALS(abs(3 - blk.site1[k]), blk.distance[k]);
+                TS_ASSERT_EQUALS(blk.site1[k] - 3, blk.r01[0][k]);
+                bsites1.push_back(blk.site1[k]);
+            }
+        }
+        TS_ASSERT_EQUALS(sites1, bsites1);
+        // direct block loops of the plain and neighbor list generators
+        bnds->setRmax(80);
+        bnds->selectAnchorSite(50);
+        TS_ASSERT(sameBlockBonds(*bnds));
+        AtomicStructureAdapterPtr line1(new AtomicStructureAdapter(*mline100));
+        line1->setBondCacheSkin(0.5);
+        bnds = line1->createBondGenerator();
+        bnds->setRmax(80);
+        bnds->selectAnchorSite(50);
+        TS_ASSERT(sameBlockBonds(*bnds));
+        // block and per-bond evaluations must agree
+        PairCounter pcount;
+        PerBondCounter pcount1;
+        pcount.setRmax(50.5);
+        pcount1.setRmax(50.5);
+        pcount.setPairMask(7, PairQuantity::ALLATOMSINT, false);
+        pcount1.setPairMask(7, PairQuantity::ALLATOMSINT, false);
+        const int c0 = pcount(mline100);
+        TS_ASSERT_EQUALS(c0, pcount1(mline100));
+        TS_ASSERT(c0 > 0);
+        pcount.setupParallelRun(1, 3);
+        pcount1.setupParallelRun(1, 3);
+        const int c1 = pcount(mline100);
+        TS_ASSERT_EQUALS(c1, pcount1(mline100));
+        TS_ASSERT(0 < c1 && c1 < c0);
+    }
+
 };  // class TestPairCounter
 
 // End of file
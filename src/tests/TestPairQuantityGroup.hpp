@@ -0,0 +1,173 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class TestPairQuantityGroup -- unit tests for evaluation of several
+*     pair quantities from one bond enumeration
+*
+*****************************************************************************/
+
+#include <algorithm>
+#include <stdexcept>
+#include <cxxtest/TestSuite.h>
+
+#include <diffpy/srreal/PairQuantityGroup.hpp>
+#include <diffpy/srreal/PDFCalculator.hpp>
+#include <diffpy/srreal/BVSCalculator.hpp>
+#include <diffpy/srreal/OverlapCalculator.hpp>
+#include <diffpy/srreal/BondCalculator.hpp>
+#include <diffpy/srreal/PeriodicStructureAdapter.hpp>
+#include <diffpy/mathutils.hpp>
+#include "test_helpers.hpp"
+
+using namespace std;
+using namespace diffpy::srreal;
+using diffpy::mathutils::EpsilonEqual;
+
+//////////////////////////////////////////////////////////////////////////////
+// class TestPairQuantityGroup
+//////////////////////////////////////////////////////////////////////////////
+
+class TestPairQuantityGroup : public CxxTest::TestSuite
+{
+    private:
+
+        PeriodicStructureAdapterPtr mnacl;
+        PairQuantityGroup mgroup;
+        boost::shared_ptr<PDFCalculator> mpdfc;
+        boost::shared_ptr<BVSCalculator> mbvc;
+        boost::shared_ptr<OverlapCalculator> molc;
+        boost::shared_ptr<BondCalculator> mbdc;
+
+        // methods
+        /// create calculators with different ranges and summations
+        void createMembers()
+        {
+            mpdfc.reset(new PDFCalculator);
+            mpdfc->setRmax(8.0);
+            mbvc.reset(new BVSCalculator);
+            molc.reset(new OverlapCalculator);
+            molc->getAtomRadiiTable()->setCustom("Na1+", 1.5);
+            molc->getAtomRadiiTable()->setCustom("Cl1-", 1.8);
+            mbdc.reset(new BondCalculator);
+            mbdc->setRmin(2.0);
+            mbdc->setRmax(4.5);
+            mbdc->setPairMask(0, 4, false);
+        }
+
+
+        QuantityType sortedDistances(const OverlapCalculator& olc)
+        {
+            QuantityType rv = olc.distances();
+            sort(rv.begin(), rv.end());
+            return rv;
+        }
+
+    public:
+
+        void setUp()
+        {
+            if (!mnacl)
+            {
+                mnacl = boost::dynamic_pointer_cast<PeriodicStructureAdapter>(
+                        loadTestPeriodicStructure("NaCl.stru"));
+                for (Atom& a : *mnacl)  a.uij_cartn = 0.01 * R3::identity();
+            }
+            this->createMembers();
+            mgroup.clearMembers();
+            mgroup.addMember(mpdfc);
+            mgroup.addMember(mbvc);
+            mgroup.addMember(molc);
+            mgroup.addMember(mbdc);
+        }
+
+
+        void test_members()
+        {
+            TS_ASSERT_EQUALS(4, mgroup.countMembers());
+            TS_ASSERT_EQUALS(mbdc.get(), &(mgroup.getMember(3)));
+            TS_ASSERT_THROWS(mgroup.getMember(4), out_of_range);
+            TS_ASSERT_THROWS(mgroup.addMember(PairQuantityPtr()),
+                    invalid_argument);
+            mgroup.clearMembers();
+            TS_ASSERT_EQUALS(0, mgroup.countMembers());
+            mgroup.eval(mnacl);
+        }
+
+
+        void test_eval()
+        {
+            EpsilonEqual allclose(1e-10);
+            mgroup.eval(mnacl);
+            PeriodicStructureAdapterPtr nacl1(
+                    new PeriodicStructureAdapter(*mnacl));
+            PDFCalculator& pdfc = *mpdfc;
+            BVSCalculator& bvc = *mbvc;
+            OverlapCalculator& olc = *molc;
+            BondCalculator& bdc = *mbdc;
+            const QuantityType g = pdfc.getPDF();
+            const QuantityType bvs = bvc.value();
+            const QuantityType olcd = this->sortedDistances(olc);
+            const double olctot = olc.totalSquareOverlap();
+            const QuantityType bdcd = bdc.distances();
+            // compare with separate evaluations
+            this->createMembers();
+            mpdfc->eval(nacl1);
+            mbvc->eval(nacl1);
+            molc->eval(nacl1);
+            mbdc->eval(nacl1);
+            TS_ASSERT(!g.empty());
+            TS_ASSERT(allclose(mpdfc->getPDF(), g));
+            TS_ASSERT_EQUALS(8u, bvs.size());
+            TS_ASSERT(allclose(mbvc->value(), bvs));
+            TS_ASSERT(!olcd.empty());
+            TS_ASSERT(allclose(this->sortedDistances(*molc), olcd));
+            TS_ASSERT_DELTA(molc->totalSquareOverlap(), olctot, 1e-10);
+            TS_ASSERT_EQUALS(mbdc->distances(), bdcd);
+            TS_ASSERT_LESS_THAN_EQUALS(2.0, bdcd.front());
+            TS_ASSERT_LESS_THAN_EQUALS(bdcd.back(), 4.5);
+        }
+
+
+        void test_optimized_update()
+        {
+            EpsilonEqual allclose(1e-10);
+            mpdfc->setEvaluatorType(OPTIMIZED);
+            mgroup.eval(mnacl);
+            TS_ASSERT_EQUALS(BASIC, mpdfc->getEvaluatorTypeUsed());
+            // member continues from the group value
+            PeriodicStructureAdapterPtr nacl1(
+                    new PeriodicStructureAdapter(*mnacl));
+            nacl1->at(2).xyz_cartn[0] += 0.1;
+            mpdfc->eval(nacl1);
+            TS_ASSERT_EQUALS(OPTIMIZED, mpdfc->getEvaluatorTypeUsed());
+            PDFCalculator pdfcb;
+            pdfcb.setRmax(8.0);
+            pdfcb.eval(nacl1);
+            TS_ASSERT(allclose(pdfcb.getPDF(), mpdfc->getPDF()));
+            const EvalCounters& cnt = mgroup.getEvalCounters();
+            if (!EvalCounters::enabled())  return;
+            TS_ASSERT_EQUALS(4, cnt.count(EvalCounters::FULL_RECOMPUTES));
+            TS_ASSERT_LESS_THAN(0,
+                    cnt.count(EvalCounters::PAIR_CONTRIBUTIONS));
+        }
+
+
+        void test_parallel()
+        {
+            mbvc->setupParallelRun(0, 2);
+            TS_ASSERT_THROWS(mgroup.eval(mnacl), logic_error);
+        }
+
+};  // class TestPairQuantityGroup
+
+// End of file
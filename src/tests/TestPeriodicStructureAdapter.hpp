@@ -45,6 +45,103 @@ int countBonds(BaseBondGenerator& bnds)
 }
 
 
+QuantityType sortedBondLengths(StructureAdapterPtr stru, double rmax)
+{
+    QuantityType rv;
+    BaseBondGeneratorPtr bnds = stru->createBondGenerator();
+    bnds->setRmax(rmax);
+    for (int i = 0; i < stru->countSites(); ++i)
+    {
+        bnds->selectAnchorSite(i);
+        bnds->selectSiteRange(0, stru->countSites());
+        for (bnds->rewind(); !bnds->finished(); bnds->next())
+        {
+            rv.push_back(bnds->distance());
+        }
+    }
+    sort(rv.begin(), rv.end());
+    return rv;
+}
+
+
+void strainLattice(PeriodicStructureAdapter& stru,
+        double sa, double sb, double sc, double dgamma)
+{
+    const Lattice L = stru.getLattice();
+    PeriodicStructureAdapter::iterator ai = stru.begin();
+    for (; ai != stru.end(); ++ai)  stru.toFractional(*ai);
+    stru.setLatPar(L.a() * sa, L.b() * sb, L.c() * sc,
+            L.alpha(), L.beta(), L.gamma() + dgamma);
+    for (ai = stru.begin(); ai != stru.end(); ++ai)  stru.toCartesian(*ai);
+}
+
+
+PeriodicStructureAdapterPtr makeSupercell(const PeriodicStructureAdapter& stru,
+        int na, int nb, int nc)
+{
+    const Lattice& L = stru.getLattice();
+    PeriodicStructureAdapterPtr rv(new PeriodicStructureAdapter);
+    rv->setLatPar(na * L.a(), nb * L.b(), nc * L.c(),
+            L.alpha(), L.beta(), L.gamma());
+    const R3::Vector nabc(na, nb, nc);
+    PeriodicStructureAdapter::const_iterator ai = stru.begin();
+    for (; ai != stru.end(); ++ai)
+    {
+        Atom a = *ai;
+        stru.toFractional(a);
+        const R3::Vector xyz0 = a.xyz_cartn;
+        for (int i = 0; i < na * nb * nc; ++i)
+        {
+            const R3::Vector cell(i / (nb * nc), (i / nc) % nb, i % nc);
+            for (int k = 0; k < R3::Ndim; ++k)
+            {
+                a.xyz_cartn[k] = (xyz0[k] + cell[k]) / nabc[k];
+            }
+            rv->toCartesian(a);
+            rv->append(a);
+        }
+    }
+    return rv;
+}
+
+
+/// bond generator that always searches the sphere of lattice points
+class SphereBondGenerator : public PeriodicStructureBondGenerator
+{
+    public:
+
+        SphereBondGenerator(StructureAdapterConstPtr stru) :
+            PeriodicStructureBondGenerator(stru)
+        {
+            mcelllistenabled = false;
+        }
+};
+
+
+QuantityType sortedBondLengths(BaseBondGenerator& bnds)
+{
+    QuantityType rv;
+    for (bnds.rewind(); !bnds.finished(); bnds.next())
+    {
+        rv.push_back(bnds.distance());
+    }
+    sort(rv.begin(), rv.end());
+    return rv;
+}
+
+
+/// site1 indices of the bonds in the order of the generator
+SiteIndices bondSites1(BaseBondGenerator& bnds)
+{
+    SiteIndices rv;
+    for (bnds.rewind(); !bnds.finished(); bnds.next())
+    {
+        rv.push_back(bnds.site1());
+    }
+    return rv;
+}
+
+
 template <class Tstru, class Tbnds>
 double testmsd0(const Tstru& stru, const Tbnds& bnds)
 {
@@ -252,6 +349,91 @@ class TestPeriodicStructureAdapter : public CxxTest::TestSuite
             TS_ASSERT_DIFFERS(kbise0, kbise2);
         }
 
+
+        void test_bondCache()
+        {
+            using diffpy::mathutils::EpsilonEqual;
+            typedef PeriodicStructureAdapter PSA;
+            const double eps = 1e-10;
+            const double rmax = 6.0;
+            boost::shared_ptr<PSA> stru0 =
+                boost::dynamic_pointer_cast<PSA>(m_catio3->clone());
+            boost::shared_ptr<PSA> stru1 =
+                boost::dynamic_pointer_cast<PSA>(m_catio3->clone());
+            TS_ASSERT_EQUALS(0.0, stru1->getBondCacheSkin());
+            TS_ASSERT_THROWS(stru1->setBondCacheSkin(-1), invalid_argument);
+            stru1->setBondCacheSkin(0.5);
+            BaseBondGeneratorPtr bnds1 = stru1->createBondGenerator();
+            BaseBondGenerator& r_bnds1 = *bnds1;
+            TS_ASSERT(typeid(PeriodicBondCacheGenerator) == typeid(r_bnds1));
+            QuantityType d0 = sortedBondLengths(stru0, rmax);
+            TS_ASSERT_EQUALS(d0, sortedBondLengths(stru1, rmax));
+            boost::shared_ptr<const PeriodicBondCache> bc =
+                stru1->getBondCache(rmax);
+            TS_ASSERT_EQUALS(6.5, bc->getRcut());
+            TS_ASSERT(bc->countImages() > int(d0.size()));
+            // small isotropic and anisotropic strains reuse the cache
+            strainLattice(*stru0, 1.01, 1.01, 1.01, 0.0);
+            strainLattice(*stru1, 1.01, 1.01, 1.01, 0.0);
+            d0 = sortedBondLengths(stru0, rmax);
+            QuantityType d1 = sortedBondLengths(stru1, rmax);
+            TS_ASSERT_EQUALS(d0.size(), d1.size());
+            TS_ASSERT(std::equal(d0.begin(), d0.end(), d1.begin(),
+                        EpsilonEqual(eps)));
+            TS_ASSERT_EQUALS(bc, stru1->getBondCache(rmax));
+            strainLattice(*stru0, 0.98, 1.02, 1.0, 1.5);
+            strainLattice(*stru1, 0.98, 1.02, 1.0, 1.5);
+            d0 = sortedBondLengths(stru0, rmax);
+            d1 = sortedBondLengths(stru1, rmax);
+            TS_ASSERT_EQUALS(d0.size(), d1.size());
+            TS_ASSERT(std::equal(d0.begin(), d0.end(), d1.begin(),
+                        EpsilonEqual(eps)));
+            TS_ASSERT_EQUALS(bc, stru1->getBondCache(rmax));
+            // small displacement is still covered by the skin
+            (*stru0)[3].xyz_cartn[1] += 0.05;
+            (*stru1)[3].xyz_cartn[1] += 0.05;
+            d0 = sortedBondLengths(stru0, rmax);
+            d1 = sortedBondLengths(stru1, rmax);
+            TS_ASSERT_EQUALS(d0.size(), d1.size());
+            TS_ASSERT(std::equal(d0.begin(), d0.end(), d1.begin(),
+                        EpsilonEqual(eps)));
+            TS_ASSERT_EQUALS(bc, stru1->getBondCache(rmax));
+            // large compression requires a new cache
+            strainLattice(*stru0, 0.9, 0.9, 0.9, 0.0);
+            strainLattice(*stru1, 0.9, 0.9, 0.9, 0.0);
+            d0 = sortedBondLengths(stru0, rmax);
+            d1 = sortedBondLengths(stru1, rmax);
+            TS_ASSERT_EQUALS(d0.size(), d1.size());
+            TS_ASSERT(std::equal(d0.begin(), d0.end(), d1.begin(),
+                        EpsilonEqual(eps)));
+            TS_ASSERT_DIFFERS(bc, stru1->getBondCache(rmax));
+            // site selections pick the matching images of the anchor
+            EpsilonEqual allclose(eps);
+            BaseBondGeneratorPtr bnds0 = stru0->createBondGenerator();
+            bnds1 = stru1->createBondGenerator();
+            bnds0->setRmax(rmax);
+            bnds1->setRmax(rmax);
+            SiteIndices selection;
+            selection.push_back(17);
+            selection.push_back(2);
+            selection.push_back(11);
+            for (int i = 0; i < stru1->countSites(); ++i)
+            {
+                bnds0->selectAnchorSite(i);
+                bnds1->selectAnchorSite(i);
+                bnds0->selectSiteRange(5, 14);
+                bnds1->selectSiteRange(5, 14);
+                d0 = sortedBondLengths(*bnds0);
+                TS_ASSERT(!d0.empty());
+                TS_ASSERT(allclose(d0, sortedBondLengths(*bnds1)));
+                bnds0->selectSites(selection);
+                bnds1->selectSites(selection);
+                d0 = sortedBondLengths(*bnds0);
+                TS_ASSERT(!d0.empty());
+                TS_ASSERT(allclose(d0, sortedBondLengths(*bnds1)));
+            }
+        }
+
 };  // class TestPeriodicStructureAdapter
 
 //////////////////////////////////////////////////////////////////////////////
@@ -417,6 +599,74 @@ class TestPeriodicStructureBondGenerator : public CxxTest::TestSuite
             }
         }
 
+
+
+        void test_cellList()
+        {
+            using diffpy::mathutils::EpsilonEqual;
+            EpsilonEqual allclose(1e-10);
+            StructureAdapterPtr zns =
+                loadTestPeriodicStructure("ZnS_wurtzite.stru");
+            PeriodicStructureAdapterPtr stru = makeSupercell(
+                    static_cast<PeriodicStructureAdapter&>(*zns), 4, 4, 3);
+            const int cntsites = stru->countSites();
+            TS_ASSERT_EQUALS(192, cntsites);
+            const Lattice& L = stru->getLattice();
+            TS_ASSERT(PeriodicCellList::isSuitable(L, 5.0));
+            TS_ASSERT(!PeriodicCellList::isSuitable(L, 8.0));
+            TS_ASSERT(!PeriodicCellList::isSuitable(L, 0.0));
+            BaseBondGeneratorPtr bnds = stru->createBondGenerator();
+            SphereBondGenerator sbnds(stru);
+            SiteIndices selection;
+            selection.push_back(150);
+            selection.push_back(5);
+            selection.push_back(77);
+            selection.push_back(3);
+            // cell list is used for rmax 5 and sphere search for 8
+            const double rmaxs[3] = {5.0, 8.0, 4.5};
+            for (int n = 0; n < 3; ++n)
+            {
+                bnds->setRmax(rmaxs[n]);
+                sbnds.setRmax(rmaxs[n]);
+                int cntbonds = 0;
+                for (int i = 0; i < cntsites; i += 7)
+                {
+                    bnds->selectAnchorSite(i);
+                    sbnds.selectAnchorSite(i);
+                    bnds->selectSiteRange(0, cntsites);
+                    sbnds.selectSiteRange(0, cntsites);
+                    QuantityType d = sortedBondLengths(*bnds);
+                    TS_ASSERT(allclose(sortedBondLengths(sbnds), d));
+                    TS_ASSERT(sameBlockBonds(*bnds));
+                    TS_ASSERT(sameBlockBonds(sbnds));
+                    // bonds come in the same order as from the sphere
+                    TS_ASSERT_EQUALS(bondSites1(sbnds), bondSites1(*bnds));
+                    cntbonds += d.size();
+                    bnds->selectSiteRange(10, 100);
+                    sbnds.selectSiteRange(10, 100);
+                    d = sortedBondLengths(*bnds);
+                    TS_ASSERT(allclose(sortedBondLengths(sbnds), d));
+                    TS_ASSERT_EQUALS(bondSites1(sbnds), bondSites1(*bnds));
+                    bnds->selectSites(selection);
+                    sbnds.selectSites(selection);
+                    d = sortedBondLengths(*bnds);
+                    TS_ASSERT(allclose(sortedBondLengths(sbnds), d));
+                    TS_ASSERT_EQUALS(bondSites1(sbnds), bondSites1(*bnds));
+                }
+                TS_ASSERT_LESS_THAN(28 * 15, cntbonds);
+            }
+            // small cell needs several images of the same site
+            PeriodicStructureAdapterPtr ni =
+                boost::dynamic_pointer_cast<PeriodicStructureAdapter>(
+                        loadTestPeriodicStructure("Ni.stru"));
+            const Lattice& Lni = ni->getLattice();
+            PeriodicCellList cells(Lni, vector<R3::Vector>(1), 3.0);
+            TS_ASSERT_EQUALS(1, cells.countCells());
+            vector<PeriodicCellList::Image> images;
+            cells.findImages(0, images);
+            TS_ASSERT_EQUALS(27u, images.size());
+        }
+
 };  // class TestPeriodicStructureBondGenerator
 
 }   // namespace srreal
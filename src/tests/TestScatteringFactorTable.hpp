@@ -22,6 +22,7 @@
 #include <cxxtest/TestSuite.h>
 
 #include <diffpy/srreal/ScatteringFactorTable.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
 #include <diffpy/mathutils.hpp>
 #include "serialization_helpers.hpp"
 
@@ -97,6 +98,32 @@ class TestScatteringFactorTable : public CxxTest::TestSuite
         }
 
 
+        void test_lookupById()
+        {
+            msftb = ScatteringFactorTable::createByType("X");
+            const int idC = atomTypeId("C");
+            const int idCc = atomTypeId("Ccustom");
+            TS_ASSERT_EQUALS(idC, atomTypeId("C"));
+            TS_ASSERT_EQUALS("Ccustom", atomTypeName(idCc));
+            TS_ASSERT(idCc < countAtomTypeIds());
+            TS_ASSERT_EQUALS(msftb->lookup("C", 2), msftb->lookup(idC, 2));
+            TS_ASSERT_THROWS(msftb->lookup(idCc), invalid_argument);
+            msftb->setCustomAs("Ccustom", "C", 6.5);
+            TS_ASSERT_DELTA(6.5, msftb->lookup(idCc), meps);
+            TS_ASSERT_EQUALS(msftb->lookup("Ccustom", 2),
+                    msftb->lookup(idCc, 2));
+            // ids interned after the custom values were indexed
+            const int idCa = atomTypeId("Calias-test");
+            TS_ASSERT_THROWS(msftb->lookup(idCa), invalid_argument);
+            msftb->setCustomAs("Calias-test", "C");
+            TS_ASSERT_EQUALS(msftb->lookup(idC), msftb->lookup(idCa));
+            ScatteringFactorTablePtr sftb1 = msftb->clone();
+            msftb->resetAll();
+            TS_ASSERT_THROWS(msftb->lookup(idCc), invalid_argument);
+            TS_ASSERT_DELTA(6.5, sftb1->lookup(idCc), meps);
+        }
+
+
         void test_getCustomSymbols()
         {
             msftb = ScatteringFactorTable::createByType("X");
@@ -0,0 +1,156 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class TestStridedStructureAdapter -- unit tests for an adapter to atom
+*     data in caller-owned arrays
+*
+*****************************************************************************/
+
+#include <stdexcept>
+#include <cxxtest/TestSuite.h>
+
+#include <diffpy/srreal/StridedStructureAdapter.hpp>
+#include <diffpy/srreal/AtomicStructureAdapter.hpp>
+#include <diffpy/srreal/PDFCalculator.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
+#include <diffpy/mathutils.hpp>
+
+using namespace std;
+using namespace diffpy::srreal;
+
+//////////////////////////////////////////////////////////////////////////////
+// class TestStridedStructureAdapter
+//////////////////////////////////////////////////////////////////////////////
+
+class TestStridedStructureAdapter : public CxxTest::TestSuite
+{
+    private:
+
+        enum { SZ = 12, NCOL = 5 };
+
+        // data
+        // every row holds x, y, z, occupancy and Uiso
+        double mdata[SZ][NCOL];
+        int mtypeids[SZ];
+        boost::shared_ptr<StridedStructureAdapter> mstru;
+
+        // methods
+        AtomicStructureAdapterPtr atomicCopy() const
+        {
+            AtomicStructureAdapterPtr rv(new AtomicStructureAdapter);
+            Atom a;
+            for (int i = 0; i < SZ; ++i)
+            {
+                a.atomtype = atomTypeName(mtypeids[i]);
+                a.xyz_cartn = R3::Vector(
+                        mdata[i][0], mdata[i][1], mdata[i][2]);
+                a.occupancy = mdata[i][3];
+                a.uij_cartn = mdata[i][4] * R3::identity();
+                rv->append(a);
+            }
+            return rv;
+        }
+
+    public:
+
+        void setUp()
+        {
+            for (int i = 0; i < SZ; ++i)
+            {
+                mdata[i][0] = 1.5 * (i % 3);
+                mdata[i][1] = 1.7 * ((i / 3) % 2);
+                mdata[i][2] = 1.9 * (i / 6);
+                mdata[i][3] = (i % 4) ? 1.0 : 0.5;
+                mdata[i][4] = 0.004 + 0.001 * (i % 2);
+                mtypeids[i] = atomTypeId((i % 3) ? "Na" : "Cl");
+            }
+            mstru.reset(new StridedStructureAdapter);
+            mstru->setPositions(&mdata[0][0], SZ, NCOL);
+            mstru->setOccupancies(&mdata[0][3], NCOL);
+            mstru->setUiso(&mdata[0][4], NCOL);
+            mstru->setTypeIds(mtypeids);
+        }
+
+
+        void test_siteData()
+        {
+            TS_ASSERT_EQUALS(SZ, mstru->countSites());
+            TS_ASSERT_EQUALS("Cl", mstru->siteAtomType(0));
+            TS_ASSERT_EQUALS("Na", mstru->siteAtomType(1));
+            TS_ASSERT_EQUALS(mtypeids[1], mstru->siteAtomTypeId(1));
+            TS_ASSERT_EQUALS(R3::Vector(1.5, 1.7, 0.0),
+                    mstru->siteCartesianPosition(4));
+            TS_ASSERT_EQUALS(0.5, mstru->siteOccupancy(4));
+            TS_ASSERT_EQUALS(1.0, mstru->siteOccupancy(5));
+            TS_ASSERT(!mstru->siteAnisotropy(1));
+            TS_ASSERT_EQUALS(0.005, mstru->siteCartesianUij(1)(1, 1));
+            TS_ASSERT_EQUALS(0.0, mstru->siteCartesianUij(1)(0, 1));
+            // arrays are used in place
+            mdata[4][2] = 3.0;
+            TS_ASSERT_EQUALS(3.0, mstru->siteCartesianPosition(4)[2]);
+            // anisotropic displacements
+            double uij[6] = {0.01, 0.02, 0.03, 0.004, 0.005, 0.006};
+            mstru->setUij(uij);
+            TS_ASSERT_THROWS(mstru->setUij(uij, 5), invalid_argument);
+            StructureAdapterPtr stru1 = mstru->clone();
+            mstru->setPositions(&mdata[0][0], 1, NCOL);
+            TS_ASSERT_EQUALS(SZ, stru1->countSites());
+            TS_ASSERT(stru1->siteAnisotropy(0));
+            const R3::Matrix& U = stru1->siteCartesianUij(0);
+            TS_ASSERT_EQUALS(0.02, U(1, 1));
+            TS_ASSERT_EQUALS(0.006, U(1, 2));
+            TS_ASSERT_EQUALS(0.006, U(2, 1));
+            // default values
+            StridedStructureAdapter stru2;
+            TS_ASSERT_EQUALS(0, stru2.countSites());
+            TS_ASSERT_THROWS(stru2.setPositions(NULL, 2), invalid_argument);
+            TS_ASSERT_THROWS(stru2.setPositions(&mdata[0][0], 2, 2),
+                    invalid_argument);
+            stru2.setPositions(&mdata[0][0], 2, NCOL);
+            TS_ASSERT_EQUALS("", stru2.siteAtomType(1));
+            TS_ASSERT_EQUALS(1.0, stru2.siteOccupancy(1));
+            TS_ASSERT_EQUALS(R3::zeromatrix(), stru2.siteCartesianUij(1));
+        }
+
+
+        void test_PDF()
+        {
+            using diffpy::mathutils::EpsilonEqual;
+            EpsilonEqual allclose(1e-10);
+            PDFCalculator pdfc;
+            pdfc.setRmax(8.0);
+            PDFCalculator pdfc1 = pdfc;
+            pdfc.eval(mstru);
+            pdfc1.eval(this->atomicCopy());
+            TS_ASSERT(allclose(pdfc1.getPDF(), pdfc.getPDF()));
+            // evaluation picks up changes of the arrays in place
+            mdata[3][0] += 0.3;
+            mdata[7][4] = 0.01;
+            mtypeids[5] = atomTypeId("Cl");
+            QuantityType g0 = pdfc.getPDF();
+            pdfc.eval(mstru);
+            pdfc1.eval(this->atomicCopy());
+            TS_ASSERT(!allclose(g0, pdfc.getPDF()));
+            TS_ASSERT(allclose(pdfc1.getPDF(), pdfc.getPDF()));
+            // OPTIMIZED evaluation falls back to full sum on shared arrays
+            pdfc.setEvaluatorType(OPTIMIZED);
+            pdfc.eval(mstru);
+            mdata[0][1] -= 0.2;
+            pdfc.eval(mstru);
+            pdfc1.eval(this->atomicCopy());
+            TS_ASSERT(allclose(pdfc1.getPDF(), pdfc.getPDF()));
+        }
+
+};  // class TestStridedStructureAdapter
+
+// End of file
@@ -0,0 +1,305 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* class TestTrajectorySource -- unit tests for trajectory frame sources
+*
+* class TestTrajectoryPipeline -- unit tests for averaging over trajectory
+*     frames
+*
+*****************************************************************************/
+
+#include <stdexcept>
+#include <cxxtest/TestSuite.h>
+
+#include <diffpy/srreal/TrajectoryPipeline.hpp>
+#include <diffpy/srreal/PeriodicStructureAdapter.hpp>
+#include <diffpy/srreal/PDFCalculator.hpp>
+#include <diffpy/srreal/AtomUtils.hpp>
+#include <diffpy/mathutils.hpp>
+#include "test_helpers.hpp"
+
+using namespace std;
+using namespace diffpy::srreal;
+
+namespace {
+
+QuantityType getPDF(const PairQuantity& pq)
+{
+    return static_cast<const PDFCalculator&>(pq).getPDF();
+}
+
+
+/// structure adapter with the sites of a trajectory frame
+AtomicStructureAdapterPtr frameStructure(
+        const TrajectoryFrame& frame, double uiso)
+{
+    AtomicStructureAdapterPtr rv;
+    PeriodicStructureAdapterPtr pstru;
+    if (frame.periodic)
+    {
+        const Lattice& L = frame.lattice;
+        pstru.reset(new PeriodicStructureAdapter);
+        pstru->setLatPar(L.a(), L.b(), L.c(),
+                L.alpha(), L.beta(), L.gamma());
+        rv = pstru;
+    }
+    else  rv.reset(new AtomicStructureAdapter);
+    Atom a;
+    a.uij_cartn = uiso * R3::identity();
+    for (size_t i = 0; i < frame.positions.size(); ++i)
+    {
+        a.atomtype = atomTypeName(frame.typeids[i]);
+        a.xyz_cartn = frame.positions[i];
+        if (pstru)
+        {
+            a.xyz_cartn = frame.lattice.fractional(a.xyz_cartn);
+            pstru->toCartesian(a);
+        }
+        rv->append(a);
+    }
+    return rv;
+}
+
+}   // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// class TestTrajectorySource
+//////////////////////////////////////////////////////////////////////////////
+
+class TestTrajectorySource : public CxxTest::TestSuite
+{
+    public:
+
+        void test_XYZ()
+        {
+            XYZTrajectorySource src(prepend_testdata_dir("NiO_cluster.xyz"));
+            TS_ASSERT_EQUALS(4, src.countFrames());
+            TrajectoryFrame frame;
+            src.readFrame(2, frame);
+            TS_ASSERT_EQUALS(8u, frame.positions.size());
+            TS_ASSERT(!frame.periodic);
+            TS_ASSERT_EQUALS("O", atomTypeName(frame.typeids[7]));
+            src.readFrame(0, frame);
+            TS_ASSERT_EQUALS("Ni", atomTypeName(frame.typeids[0]));
+            TS_ASSERT_EQUALS(R3::Vector(-0.0352, -0.0698, 0.0302),
+                    frame.positions[0]);
+            TS_ASSERT_THROWS(src.readFrame(4, frame), out_of_range);
+            TS_ASSERT_THROWS(XYZTrajectorySource("does/not/exist.xyz"),
+                    runtime_error);
+        }
+
+
+        void test_LAMMPS()
+        {
+            LAMMPSTrajectorySource src(
+                    prepend_testdata_dir("Ni_fcc.lammpstrj"));
+            TS_ASSERT_EQUALS(3, src.countFrames());
+            TrajectoryFrame frame;
+            src.readFrame(1, frame);
+            TS_ASSERT(frame.periodic);
+            TS_ASSERT_EQUALS(4u, frame.positions.size());
+            TS_ASSERT_DELTA(3.55, frame.lattice.a(), 1e-12);
+            TS_ASSERT_DELTA(90.0, frame.lattice.gamma(), 1e-12);
+            src.readFrame(0, frame);
+            // sites are sorted by the atom id
+            TS_ASSERT_EQUALS(R3::Vector(-1.0349, -1.0324, -1.0268),
+                    frame.positions[0]);
+            TS_ASSERT_EQUALS(R3::Vector(0.7363, 0.7104, -1.0081),
+                    frame.positions[1]);
+            TS_ASSERT_EQUALS("Ni", atomTypeName(frame.typeids[3]));
+        }
+
+
+        void test_Raw()
+        {
+            const double xyz[2][2][3] = {
+                {{0.0, 0.0, 0.0}, {1.0, 2.0, 3.0}},
+                {{0.1, 0.0, 0.0}, {1.0, 2.5, 3.0}},
+            };
+            RawTrajectorySource src(&xyz[0][0][0], 2, 2);
+            TS_ASSERT_EQUALS(2, src.countFrames());
+            SiteIndices tids(2, atomTypeId("C"));
+            src.setTypeIds(tids);
+            TS_ASSERT_THROWS(src.setTypeIds(SiteIndices(3)),
+                    invalid_argument);
+            TrajectoryFrame frame;
+            src.readFrame(1, frame);
+            TS_ASSERT(!frame.periodic);
+            TS_ASSERT_EQUALS(tids, frame.typeids);
+            TS_ASSERT_EQUALS(R3::Vector(1.0, 2.5, 3.0), frame.positions[1]);
+            src.setLattice(Lattice(4, 5, 6, 90, 90, 90));
+            src.readFrame(0, frame);
+            TS_ASSERT(frame.periodic);
+            TS_ASSERT_EQUALS(5.0, frame.lattice.b());
+            TS_ASSERT_THROWS(src.readFrame(-1, frame), out_of_range);
+        }
+
+};  // class TestTrajectorySource
+
+//////////////////////////////////////////////////////////////////////////////
+// class TestTrajectoryPipeline
+//////////////////////////////////////////////////////////////////////////////
+
+class TestTrajectoryPipeline : public CxxTest::TestSuite
+{
+    private:
+
+        PDFCalculator mpdfc;
+
+    public:
+
+        void setUp()
+        {
+            mpdfc = PDFCalculator();
+            mpdfc.setRmax(6.0);
+        }
+
+
+        void test_meanVariance()
+        {
+            using diffpy::mathutils::EpsilonEqual;
+            EpsilonEqual allclose(1e-10);
+            XYZTrajectorySource src(prepend_testdata_dir("NiO_cluster.xyz"));
+            TrajectoryPipeline pipeline(mpdfc);
+            pipeline.setOutput(getPDF);
+            pipeline.setUiso(0.005);
+            pipeline.run(src);
+            TS_ASSERT_EQUALS(4, pipeline.countFrames());
+            // direct evaluation of every frame
+            PDFCalculator pdfc = mpdfc;
+            TrajectoryFrame frame;
+            vector<QuantityType> gs;
+            for (int k = 0; k < src.countFrames(); ++k)
+            {
+                src.readFrame(k, frame);
+                pdfc.eval(frameStructure(frame, 0.005));
+                gs.push_back(pdfc.getPDF());
+            }
+            const int npts = gs[0].size();
+            QuantityType gmean(npts, 0.0);
+            QuantityType gvar(npts, 0.0);
+            for (int i = 0; i < npts; ++i)
+            {
+                for (int k = 0; k < 4; ++k)  gmean[i] += gs[k][i] / 4;
+                for (int k = 0; k < 4; ++k)
+                {
+                    gvar[i] += pow(gs[k][i] - gmean[i], 2) / 3;
+                }
+            }
+            TS_ASSERT(allclose(gmean, pipeline.mean()));
+            TS_ASSERT(allclose(gvar, pipeline.variance()));
+            TS_ASSERT(!allclose(QuantityType(npts, 0.0), gvar));
+            pipeline.reset();
+            TS_ASSERT_EQUALS(0, pipeline.countFrames());
+            TS_ASSERT(pipeline.mean().empty());
+        }
+
+
+        void test_parallel()
+        {
+            using diffpy::mathutils::EpsilonEqual;
+            EpsilonEqual allclose(1e-10);
+            LAMMPSTrajectorySource src(
+                    prepend_testdata_dir("Ni_fcc.lammpstrj"));
+            PDFCalculator pdfc0 = mpdfc;
+            PDFCalculator pdfc1 = mpdfc;
+            TrajectoryPipeline serial(mpdfc);
+            TrajectoryPipeline part0(pdfc0);
+            TrajectoryPipeline part1(pdfc1);
+            TrajectoryPipeline* pipelines[3] = {&serial, &part0, &part1};
+            for (TrajectoryPipeline* pp : pipelines)
+            {
+                pp->setOutput(getPDF);
+                pp->setUiso(0.004);
+            }
+            part0.setupParallelRun(0, 2);
+            part1.setupParallelRun(1, 2);
+            serial.run(src);
+            part0.run(src);
+            part1.run(src);
+            TS_ASSERT_EQUALS(2, part0.countFrames());
+            TS_ASSERT_EQUALS(1, part1.countFrames());
+            part0.mergeParallelData(part1.getParallelData());
+            TS_ASSERT_EQUALS(3, part0.countFrames());
+            TS_ASSERT(allclose(serial.mean(), part0.mean()));
+            TS_ASSERT(allclose(serial.variance(), part0.variance()));
+            // periodic frames match the direct evaluation
+            PDFCalculator pdfc = mpdfc;
+            TrajectoryFrame frame;
+            src.readFrame(2, frame);
+            pdfc.eval(frameStructure(frame, 0.004));
+            TrajectoryPipeline last(mpdfc);
+            last.setOutput(getPDF);
+            last.setUiso(0.004);
+            last.addFrame(frame);
+            TS_ASSERT(allclose(pdfc.getPDF(), last.mean()));
+            TS_ASSERT_THROWS(part0.setupParallelRun(0, 0), invalid_argument);
+        }
+
+
+        void test_neighborReuse()
+        {
+            using diffpy::mathutils::EpsilonEqual;
+            EpsilonEqual allclose(1e-10);
+            XYZTrajectorySource src(prepend_testdata_dir("NiO_cluster.xyz"));
+            PDFCalculator pdfc = mpdfc;
+            TrajectoryPipeline pipeline(mpdfc);
+            TrajectoryPipeline nocache(pdfc);
+            pipeline.setUiso(0.005);
+            nocache.setUiso(0.005);
+            nocache.setBondCacheSkin(0.0);
+            TS_ASSERT_EQUALS(1.0, pipeline.getBondCacheSkin());
+            TS_ASSERT_THROWS(nocache.setBondCacheSkin(-1), invalid_argument);
+            pipeline.run(src);
+            nocache.run(src);
+            TS_ASSERT(allclose(nocache.mean(), pipeline.mean()));
+            TS_ASSERT(allclose(nocache.variance(), pipeline.variance()));
+        }
+
+
+        void test_movedSites()
+        {
+            using diffpy::mathutils::EpsilonEqual;
+            EpsilonEqual allclose(1e-10);
+            XYZTrajectorySource src(prepend_testdata_dir("NiO_cluster.xyz"));
+            TrajectoryFrame frame;
+            src.readFrame(0, frame);
+            TrajectoryPipeline pipeline(mpdfc);
+            pipeline.setOutput(getPDF);
+            pipeline.setUiso(0.005);
+            pipeline.addFrame(frame);
+            PDFCalculator pdfc;
+            pdfc.setRmax(mpdfc.getRmax());
+            pdfc.eval(frameStructure(frame, 0.005));
+            QuantityType gmean = pdfc.getPDF();
+            // frame with one moved site is a fast update of that site
+            frame.positions[2][0] += 0.05;
+            pipeline.addFrame(frame);
+            TS_ASSERT_EQUALS(OPTIMIZED, mpdfc.getEvaluatorTypeUsed());
+            pdfc.eval(frameStructure(frame, 0.005));
+            const QuantityType g1 = pdfc.getPDF();
+            for (size_t i = 0; i < gmean.size(); ++i)
+            {
+                gmean[i] = (gmean[i] + g1[i]) / 2;
+            }
+            TS_ASSERT(allclose(gmean, pipeline.mean()));
+            typedef EvalCounters EC;
+            if (!EC::enabled())  return;
+            const EvalCounters& cnt = mpdfc.getEvalCounters();
+            TS_ASSERT_EQUALS(0, cnt.count(EC::FULL_RECOMPUTES));
+            TS_ASSERT_EQUALS(1, cnt.count(EC::FAST_UPDATES));
+        }
+
+};  // class TestTrajectoryPipeline
+
+// End of file
@@ -0,0 +1,64 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* Replacement of the global operator new that counts heap allocations
+* in the tests of allocation-free evaluation.  This file must not be
+* linked into the benchmark driver.
+*
+*****************************************************************************/
+
+#include <cstdlib>
+#include <new>
+
+#include "allocation_counter.hpp"
+
+namespace {
+
+long allocation_count = 0;
+
+}   // namespace
+
+
+long countAllocations()
+{
+    return allocation_count;
+}
+
+
+void* operator new(std::size_t sz)
+{
+    ++allocation_count;
+    void* rv = std::malloc(sz ? sz : 1);
+    if (!rv)  throw std::bad_alloc();
+    return rv;
+}
+
+
+void* operator new[](std::size_t sz)
+{
+    return operator new(sz);
+}
+
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+// End of allocation_counter.cpp
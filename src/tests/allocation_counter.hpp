@@ -0,0 +1,25 @@
+/*****************************************************************************
+*
+* libdiffpy         Complex Modeling Initiative
+*                   (c) 2026 libdiffpy contributors.
+*                   All rights reserved.
+*
+* File coded by:    agent
+*
+* See AUTHORS.txt for a list of people who contributed.
+* See LICENSE.txt for license information.
+*
+******************************************************************************
+*
+* Counter of heap allocations for the unit tests.  The replacement of
+* the global operator new is linked only into the unit test driver.
+*
+*****************************************************************************/
+
+#ifndef ALLOCATION_COUNTER_HPP_INCLUDED
+#define ALLOCATION_COUNTER_HPP_INCLUDED
+
+/// number of calls to the global operator new since the program start
+long countAllocations();
+
+#endif  // ALLOCATION_COUNTER_HPP_INCLUDED
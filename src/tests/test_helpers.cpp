@@ -18,6 +18,7 @@
 
 #include <fstream>
 #include <sstream>
+#include <vector>
 #include <cassert>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
@@ -25,6 +26,7 @@
 
 #include <diffpy/runtimepath.hpp>
 #include <diffpy/srreal/PeriodicStructureAdapter.hpp>
+#include <diffpy/srreal/BondBlock.hpp>
 
 #include "test_helpers.hpp"
 
@@ -138,4 +140,34 @@ diffpy::srreal::StructureAdapterPtr
     return pstru;
 }
 
+// Compare bonds from the block and per-bond loops of a generator.
+
+bool sameBlockBonds(diffpy::srreal::BaseBondGenerator& bnds)
+{
+    using namespace diffpy::srreal;
+    std::vector<double> bonds, bbonds;
+    for (bnds.rewind(); !bnds.finished(); bnds.next())
+    {
+        const R3::Vector& rv = bnds.r01();
+        const double b[] = {double(bnds.site0()), double(bnds.site1()),
+            bnds.distance(), rv[0], rv[1], rv[2],
+            double(bnds.multiplicity())};
+        bonds.insert(bonds.end(), b, b + 7);
+    }
+    BondBlock blk;
+    for (bnds.rewind(); !bnds.finished();)
+    {
+        blk.clear();
+        if (!bnds.fillBlock(blk))  return false;
+        for (int k = 0; k < blk.count; ++k)
+        {
+            const double b[] = {double(blk.site0[k]), double(blk.site1[k]),
+                blk.distance[k], blk.r01[0][k], blk.r01[1][k],
+                blk.r01[2][k], double(blk.multiplicity[k])};
+            bbonds.insert(bbonds.end(), b, b + 7);
+        }
+    }
+    return !bonds.empty() && bonds == bbonds;
+}
+
 // End of test_helpers.cpp
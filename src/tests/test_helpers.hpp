@@ -28,4 +28,8 @@ std::string prepend_testdata_dir(const std::string& f);
 diffpy::srreal::StructureAdapterPtr
     loadTestPeriodicStructure(const std::string& tailname);
 
+/// true if bnds has some bonds and fillBlock gives the same bonds
+/// as the next() loop
+bool sameBlockBonds(diffpy::srreal::BaseBondGenerator& bnds);
+
 #endif  // TEST_HELPERS_HPP_INCLUDED